@@ -0,0 +1,47 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2026 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <string>
+#include <cstdio>
+
+//! escapes "str" for use inside a JSON string (quotes, backslashes and control characters)
+inline std::string json_escape(const std::string& str) {
+	std::string escaped;
+	escaped.reserve(str.size());
+	for (const auto& ch : str) {
+		switch (ch) {
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\r': escaped += "\\r"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if ((unsigned char)ch < 0x20u) {
+					char code[8];
+					snprintf(code, sizeof(code), "\\u%04x", (unsigned int)(unsigned char)ch);
+					escaped += code;
+				} else {
+					escaped += ch;
+				}
+				break;
+		}
+	}
+	return escaped;
+}
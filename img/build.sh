@@ -410,7 +410,7 @@ if [ $BUILD_OS != "macos" -a $BUILD_OS != "ios" ]; then
 	COMMON_FLAGS="${COMMON_FLAGS} -fno-pic -fno-pie -Xclang -mrelocation-model -Xclang pic -Xclang -pic-level -Xclang 2"
 	
 	# pkg-config: required libraries/packages and optional libraries/packages
-	PACKAGES="sdl3"
+	PACKAGES="sdl3 sdl3-image"
 	PACKAGES_OPT=""
 	if [ ${BUILD_CONF_OPENVR} -gt 0 ]; then
 		PACKAGES_OPT="${PACKAGES_OPT} openvr"
@@ -543,7 +543,7 @@ else
 	
 	# frameworks and libs
 	LDFLAGS="${LDFLAGS} -F/Library/Frameworks"
-	LDFLAGS="${LDFLAGS} -framework SDL3"
+	LDFLAGS="${LDFLAGS} -framework SDL3 -framework SDL3_image"
 	if [ ${BUILD_CONF_OPENVR} -gt 0 ]; then
 		LDFLAGS="${LDFLAGS} -lopenvr_api"
 	fi
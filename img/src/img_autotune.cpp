@@ -0,0 +1,184 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "img_autotune.hpp"
+#include <floor/core/timer.hpp>
+#include <floor/core/file_io.hpp>
+#include <fstream>
+
+img_autotune::img_autotune(compute_context& ctx_, const compute_device& dev_, compute_queue& dev_queue_, img_blur& blur_,
+						   const string& tuning_file_name_, const bool retune_) :
+ctx(ctx_), dev(dev_), dev_queue(dev_queue_), blur(blur_), tuning_file_name(tuning_file_name_), retune(retune_) {
+	load();
+}
+
+uint32_t img_autotune::image_class(const uint2& image_size) {
+	const auto pixel_count = uint64_t(image_size.x) * uint64_t(image_size.y);
+	uint32_t img_class = 512u;
+	while (img_class < 4096u && uint64_t(img_class) * uint64_t(img_class) < pixel_count) {
+		img_class <<= 1u;
+	}
+	return img_class;
+}
+
+string img_autotune::make_key(const uint32_t img_class, const uint32_t tap_count) const {
+	// NOTE: not all backends report a driver version -> never write an empty field
+	const auto& driver_version = (!dev.driver_version_str.empty() ? dev.driver_version_str : "unknown"s);
+	return (string(compute_type_to_string(ctx.get_compute_type())) + "\t" + dev.name + "\t" + driver_version + "\t" +
+			to_string(img_class) + "\t" + to_string(tap_count));
+}
+
+blur_variant_t img_autotune::get_variant(const uint32_t radius, const uint2& image_size) {
+	if (radius == 0 || radius > max_tap_blur_radius) {
+		return {};
+	}
+	const auto img_class = image_class(image_size);
+	const auto key = make_key(img_class, blur_tap_count(radius));
+	
+	// known and not to be retuned -> look up the variant by its name
+	if (const auto iter = entries.find(key); iter != entries.end() && (!retune || tuned_keys.count(key) > 0)) {
+		const auto variant_name = core::tokenize(iter->second, '\t')[0];
+		for (const auto& variant : blur_variant_t::all()) {
+			if (variant.name() == variant_name) {
+				return variant;
+			}
+		}
+		log_warn("unknown blur variant in the tuning file: $ -> retuning", variant_name);
+	}
+	
+	const auto tuned = tune(radius, img_class);
+	tuned_keys.emplace(key);
+	if (!tuned) {
+		// -> default variant
+		entries.erase(key);
+		return {};
+	}
+	entries[key] = tuned->first.name() + "\t" + to_string(tuned->second);
+	if (!save()) {
+		log_warn("failed to write the tuning file \"$\" (tuning results will not be persisted)", tuning_file_name);
+	}
+	return tuned->first;
+}
+
+optional<pair<blur_variant_t, double>> img_autotune::tune(const uint32_t radius, const uint32_t img_class) {
+	// without tap kernels, the dumb variants would time the IIR fallback -> nothing to tune, use the default variant
+	if (!blur.has_tap_program(blur_tap_count(radius))) {
+		log_warn("no blur program for radius $ -> not tuning", radius);
+		return {};
+	}
+	
+	// representative image: random content, class size (within the device limits, as a multiple of 32px)
+	const auto image_size = ((uint2 { img_class }.minned(dev.max_image_2d_dim)) / 32u) * 32u;
+	const auto pixel_count = size_t(image_size.x) * size_t(image_size.y);
+	auto img_data = make_unique<uchar4[]>(pixel_count);
+	for (size_t i = 0; i < pixel_count; ++i) {
+		img_data[i] = uchar4(uint8_t(core::rand(0, 255)), uint8_t(core::rand(0, 255)),
+							 uint8_t(core::rand(0, 255)), uint8_t(core::rand(0, 255)));
+	}
+	array<shared_ptr<compute_image>, 3> imgs;
+	for (size_t i = 0; i < imgs.size(); ++i) {
+		imgs[i] = ctx.create_image(dev_queue, image_size,
+								   COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+								   (i == 0 ? COMPUTE_IMAGE_TYPE::READ : COMPUTE_IMAGE_TYPE::READ_WRITE),
+								   span<uint8_t> { i == 0 ? (uint8_t*)img_data.get() : nullptr, i == 0 ? pixel_count * sizeof(uchar4) : 0u },
+								   COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+		if (!imgs[i]) {
+			log_error("failed to create the tuning images");
+			return {};
+		}
+	}
+	dev_queue.finish();
+	
+	log_msg("tuning blur variants for radius $ on a $ image ...", radius, image_size);
+	static constexpr const uint32_t warm_up_count { 2u };
+	static constexpr const uint32_t run_count { 10u };
+	optional<pair<blur_variant_t, double>> best;
+	for (const auto& variant : blur_variant_t::all()) {
+		// runs the variant exactly as specified (-> no fallback to other tile sizes), returns false if it's unsupported
+		const auto run = [this, &variant, &radius, &imgs] {
+			if (variant.dumb) {
+				return blur.blur(radius, variant, imgs[0], imgs[1], imgs[2]);
+			}
+			return blur.blur_single_stage(radius, single_stage_blur_kernel(variant.storage, *variant.tile_size_idx), imgs[0], imgs[2]);
+		};
+		
+		bool supported = true;
+		for (uint32_t i = 0; i < warm_up_count && supported; ++i) {
+			supported = run();
+		}
+		if (!supported) {
+			log_msg("$: not supported", variant.name());
+			continue;
+		}
+		double best_time = numeric_limits<double>::max();
+		for (uint32_t i = 0; i < run_count; ++i) {
+			// all blur kernels block until completion
+			const auto start = floor_timer::start();
+			run();
+			best_time = min(best_time, double(floor_timer::stop<chrono::microseconds>(start)) / 1000.0);
+		}
+		log_msg("$: $ms", variant.name(), best_time);
+		if (!best || best_time < best->second) {
+			best = make_pair(variant, best_time);
+		}
+	}
+	if (!best) {
+		log_error("no blur variant is supported for radius $", radius);
+		return {};
+	}
+	log_msg("fastest blur variant: $ ($ms)", best->first.name(), best->second);
+	return best;
+}
+
+bool img_autotune::load() {
+	string data;
+	if (!file_io::file_to_string(tuning_file_name, data)) {
+		// no tuning file yet
+		return false;
+	}
+	for (const auto& line : core::tokenize(data, '\n')) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		const auto tokens = core::tokenize(line, '\t');
+		// NOTE: also ignores lines of older tuning files (w/o compute type and driver version)
+		if (tokens.size() != 7) {
+			log_warn("invalid line in the tuning file \"$\": $", tuning_file_name, line);
+			continue;
+		}
+		entries[tokens[0] + "\t" + tokens[1] + "\t" + tokens[2] + "\t" + tokens[3] + "\t" + tokens[4]] = tokens[5] + "\t" + tokens[6];
+	}
+	return true;
+}
+
+bool img_autotune::save() const {
+	// sort entries, so that the file is stable across runs
+	vector<pair<string, string>> sorted_entries(entries.begin(), entries.end());
+	sort(sorted_entries.begin(), sorted_entries.end());
+	
+	ofstream file(tuning_file_name, ios::out | ios::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+	file << "# compute type\tdevice\tdriver version\timage class\ttap count\tvariant\tbest time (ms)" << endl;
+	for (const auto& entry : sorted_entries) {
+		file << entry.first << "\t" << entry.second << endl;
+	}
+	return file.good();
+}
@@ -0,0 +1,69 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FLOOR_IMG_IMG_AUTOTUNE_HPP__
+#define __FLOOR_IMG_IMG_AUTOTUNE_HPP__
+
+#include "img_blur.hpp"
+#include <unordered_set>
+
+//! blur variant autotuning: times all usable tap blur variants (single-stage kernels of each storage type and tile size,
+//! dumb f32/f16 kernels) on a representative image of the image class for the active device and persists the fastest one
+//! in a tuning file (one line per compute backend, device, driver version, image class and tap count), so that each
+//! combination is only tuned once (-> a different backend or driver update for the same device is tuned again)
+class img_autotune {
+public:
+	//! loads all known results from "tuning_file_name" (if it exists), if "retune" is set, all combinations that are
+	//! requested are tuned again (once per run)
+	img_autotune(compute_context& ctx, const compute_device& dev, compute_queue& dev_queue, img_blur& blur,
+				 const string& tuning_file_name, const bool retune);
+	
+	//! returns the fastest variant for the blur radius and image size, which is tuned (and persisted) first if necessary
+	//! NOTE: radii > max_tap_blur_radius don't have any variants (-> default variant)
+	blur_variant_t get_variant(const uint32_t radius, const uint2& image_size);
+	
+	//! image class of an image size: the pixel count rounded up to 512^2, 1024^2, 2048^2 or 4096^2 (-> 512 ... 4096),
+	//! tuning happens on an image of "image class" x "image class" px
+	static uint32_t image_class(const uint2& image_size);
+	
+protected:
+	compute_context& ctx;
+	const compute_device& dev;
+	compute_queue& dev_queue;
+	img_blur& blur;
+	const string tuning_file_name;
+	const bool retune;
+	
+	//! "<compute type>\t<device name>\t<driver version>\t<image class>\t<tap count>" -> "<variant name>\t<best time in ms>"
+	//! (all devices)
+	unordered_map<string, string> entries;
+	//! all keys that have been tuned in this run
+	unordered_set<string> tuned_keys;
+	
+	string make_key(const uint32_t img_class, const uint32_t tap_count) const;
+	
+	//! times all variants, returns the fastest one and its time (in ms)
+	optional<pair<blur_variant_t, double>> tune(const uint32_t radius, const uint32_t img_class);
+	
+	bool load();
+	bool save() const;
+	
+};
+
+#endif
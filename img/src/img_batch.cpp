@@ -0,0 +1,367 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "img_batch.hpp"
+#include <floor/core/timer.hpp>
+#include <SDL3_image/SDL_image.h>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <optional>
+
+namespace img_batch {
+
+//! fixed-capacity FIFO between two pipeline stages: push() blocks while full, pop() blocks while empty,
+//! once all producers called close(), pop() returns nothing after the queue has been drained
+template <typename T>
+class bounded_queue {
+public:
+	bounded_queue(const size_t capacity_, const uint32_t producer_count_ = 1u) :
+	capacity(capacity_), producer_count(producer_count_) {}
+	
+	void push(T&& value) {
+		unique_lock<mutex> lock(queue_lock);
+		not_full.wait(lock, [this] { return queue.size() < capacity; });
+		queue.emplace_back(std::move(value));
+		not_empty.notify_one();
+	}
+	
+	optional<T> pop() {
+		unique_lock<mutex> lock(queue_lock);
+		not_empty.wait(lock, [this] { return !queue.empty() || producer_count == 0u; });
+		if (queue.empty()) {
+			return {};
+		}
+		T value = std::move(queue.front());
+		queue.pop_front();
+		not_full.notify_one();
+		return value;
+	}
+	
+	//! called by each producer once it is done
+	void close() {
+		unique_lock<mutex> lock(queue_lock);
+		if (producer_count > 0u) {
+			--producer_count;
+		}
+		not_empty.notify_all();
+	}
+	
+protected:
+	const size_t capacity;
+	uint32_t producer_count;
+	deque<T> queue;
+	mutex queue_lock;
+	condition_variable not_full;
+	condition_variable not_empty;
+};
+
+//! device images of a single in-flight image (reallocated if the image size changes)
+struct image_set_t {
+	//! [input, intermediate, output]
+	array<shared_ptr<compute_image>, 3> imgs;
+	uint2 size;
+};
+
+//! a single image moving through the pipeline
+struct item_t {
+	string name;
+	//! actual image size and the size of "pixels" (a multiple of 32)
+	uint2 size;
+	uint2 padded_size;
+	unique_ptr<uchar4[]> pixels;
+	image_set_t* set { nullptr };
+};
+
+//! accumulated busy time of a pipeline stage (in µs)
+struct stage_stats_t {
+	const char* name;
+	uint32_t thread_count;
+	atomic<uint64_t> busy_time { 0u };
+};
+
+//! decodes a PNG file into RGBA8 pixels, padded to a multiple of 32px by replicating the right/bottom edge
+static optional<item_t> decode(const filesystem::path& file_path) {
+	SDL_Surface* surface = IMG_Load(file_path.string().c_str());
+	if (surface == nullptr) {
+		log_error("failed to load \"$\": $", file_path.string(), SDL_GetError());
+		return {};
+	}
+	// we always want R8G8B8A8 in memory order
+	if (surface->format != SDL_PIXELFORMAT_RGBA32) {
+		SDL_Surface* new_surface = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+		SDL_DestroySurface(surface);
+		if (new_surface == nullptr) {
+			log_error("failed to convert \"$\" to RGBA8: $", file_path.string(), SDL_GetError());
+			return {};
+		}
+		surface = new_surface;
+	}
+	
+	item_t item {
+		.name = file_path.filename().string(),
+		.size = { uint32_t(surface->w), uint32_t(surface->h) },
+		.padded_size = {},
+		.pixels = {},
+	};
+	item.padded_size = ((item.size + 31u) / 32u) * 32u;
+	item.pixels = make_unique<uchar4[]>(size_t(item.padded_size.x) * size_t(item.padded_size.y));
+	for (uint32_t y = 0; y < item.padded_size.y; ++y) {
+		const auto src_row = (const uchar4*)((const uint8_t*)surface->pixels + size_t(surface->pitch) * min(y, item.size.y - 1u));
+		auto dst_row = &item.pixels[size_t(y) * item.padded_size.x];
+		memcpy(dst_row, src_row, item.size.x * sizeof(uchar4));
+		for (uint32_t x = item.size.x; x < item.padded_size.x; ++x) {
+			dst_row[x] = src_row[item.size.x - 1u];
+		}
+	}
+	SDL_DestroySurface(surface);
+	return item;
+}
+
+//! encodes the unpadded part of "item" as a PNG file
+static bool encode(const item_t& item, const filesystem::path& file_path) {
+	auto surface = SDL_CreateSurfaceFrom(int(item.size.x), int(item.size.y), SDL_PIXELFORMAT_RGBA32,
+										 (void*)item.pixels.get(), int(item.padded_size.x * sizeof(uchar4)));
+	if (surface == nullptr) {
+		log_error("failed to create surface for \"$\": $", item.name, SDL_GetError());
+		return false;
+	}
+	const auto success = IMG_SavePNG(surface, file_path.string().c_str());
+	if (!success) {
+		log_error("failed to write \"$\": $", file_path.string(), SDL_GetError());
+	}
+	SDL_DestroySurface(surface);
+	return success;
+}
+
+bool run(compute_context& ctx, const compute_device& dev, const img_blur& blur, const config_t& config) {
+#if !defined(FLOOR_IOS)
+	// gather all input files
+	vector<filesystem::path> files;
+	error_code ec;
+	for (const auto& entry : filesystem::directory_iterator(config.input_dir, ec)) {
+		if (!entry.is_regular_file()) {
+			continue;
+		}
+		auto ext = entry.path().extension().string();
+		transform(ext.begin(), ext.end(), ext.begin(), [](const char c) { return char(tolower(c)); });
+		if (ext == ".png") {
+			files.emplace_back(entry.path());
+		}
+	}
+	if (ec) {
+		log_error("failed to read input directory \"$\": $", config.input_dir, ec.message());
+		return false;
+	}
+	if (files.empty()) {
+		log_error("no PNG files in \"$\"", config.input_dir);
+		return false;
+	}
+	sort(files.begin(), files.end());
+	filesystem::create_directories(config.output_dir, ec);
+	if (ec) {
+		log_error("failed to create output directory \"$\": $", config.output_dir, ec.message());
+		return false;
+	}
+	
+	const auto io_thread_count = (config.io_thread_count > 0u ?
+								  config.io_thread_count : max(thread::hardware_concurrency() / 2u, 1u));
+	log_msg("batch blur of $ images: $ -> $ ($ decode + $ encode threads)",
+			files.size(), config.input_dir, config.output_dir, io_thread_count, io_thread_count);
+	
+	// separate queues for upload, blur and download, so that these can overlap
+	auto upload_queue = ctx.create_queue(dev);
+	auto blur_queue = ctx.create_queue(dev);
+	auto download_queue = ctx.create_queue(dev);
+	img_blur batch_blur(blur, *blur_queue);
+	if (!batch_blur.prepare(config.radius)) {
+		return false;
+	}
+	
+	// one image set each for the image that is being uploaded, blurred and downloaded
+	array<image_set_t, 3> image_sets;
+	// NOTE: never closed, so that pop() always blocks until a set has been returned
+	bounded_queue<image_set_t*> free_sets(image_sets.size());
+	for (auto& set : image_sets) {
+		free_sets.push(&set);
+	}
+	
+	// pipeline: decode (pool) -> upload -> blur -> download -> encode (pool)
+	// NOTE: the queue capacities bound the amount of decoded images that are held in memory
+	bounded_queue<item_t> decoded(2u, io_thread_count);
+	bounded_queue<item_t> uploaded(1u);
+	bounded_queue<item_t> blurred(1u);
+	bounded_queue<item_t> downloaded(2u);
+	
+	array<stage_stats_t, 5> stats {{
+		{ "decode", io_thread_count },
+		{ "upload", 1u },
+		{ "blur", 1u },
+		{ "download", 1u },
+		{ "encode", io_thread_count },
+	}};
+	const auto timed = [&stats](const size_t stage_idx, auto&& func) {
+		const auto start = floor_timer::start();
+		auto ret = func();
+		stats[stage_idx].busy_time += floor_timer::stop<chrono::microseconds>(start);
+		return ret;
+	};
+	
+	atomic<uint32_t> next_file { 0u };
+	atomic<uint32_t> failed_count { 0u };
+	atomic<uint32_t> done_count { 0u };
+	atomic<uint64_t> pixel_count { 0u };
+	
+	const auto pipeline_start = floor_timer::start();
+	vector<thread> threads;
+	for (uint32_t i = 0; i < io_thread_count; ++i) {
+		threads.emplace_back([&] {
+			for (uint32_t file_idx = next_file++; file_idx < files.size(); file_idx = next_file++) {
+				auto item = timed(0, [&] { return decode(files[file_idx]); });
+				if (!item) {
+					++failed_count;
+					continue;
+				}
+				decoded.push(std::move(*item));
+			}
+			decoded.close();
+		});
+	}
+	threads.emplace_back([&] {
+		while (auto item = decoded.pop()) {
+			if ((item->padded_size > dev.max_image_2d_dim).any()) {
+				log_error("\"$\" exceeds the max image size of the device ($), use --tiled for huge images",
+						  item->name, dev.max_image_2d_dim);
+				++failed_count;
+				continue;
+			}
+			auto set = *free_sets.pop();
+			const auto success = timed(1, [&] {
+				// (re)allocate the device images if necessary
+				if (!set->imgs[0] || (set->size != item->padded_size).any()) {
+					for (size_t i = 0; i < set->imgs.size(); ++i) {
+						set->imgs[i] = ctx.create_image(*upload_queue, item->padded_size,
+														COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+														(i == 0 ? COMPUTE_IMAGE_TYPE::READ : COMPUTE_IMAGE_TYPE::READ_WRITE),
+														(i == 0 ? COMPUTE_MEMORY_FLAG::HOST_WRITE :
+														 (i == 2 ? COMPUTE_MEMORY_FLAG::HOST_READ : COMPUTE_MEMORY_FLAG::READ_WRITE)));
+						if (!set->imgs[i]) {
+							return false;
+						}
+					}
+					set->size = item->padded_size;
+				}
+				auto mapped = set->imgs[0]->map(*upload_queue, COMPUTE_MEMORY_MAP_FLAG::WRITE_INVALIDATE | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+				if (!mapped) {
+					return false;
+				}
+				memcpy(mapped, item->pixels.get(), size_t(item->padded_size.x) * size_t(item->padded_size.y) * sizeof(uchar4));
+				set->imgs[0]->unmap(*upload_queue, mapped);
+				// the blur thread uses a different queue and images are created without resource tracking
+				// -> the upload must be complete before the set is handed off
+				upload_queue->finish();
+				return true;
+			});
+			if (!success) {
+				log_error("failed to upload \"$\"", item->name);
+				++failed_count;
+				free_sets.push(std::move(set));
+				continue;
+			}
+			item->set = set;
+			uploaded.push(std::move(*item));
+		}
+		uploaded.close();
+	});
+	threads.emplace_back([&] {
+		while (auto item = uploaded.pop()) {
+			const auto& imgs = item->set->imgs;
+			if (!timed(2, [&] { return batch_blur.blur(config.radius, config.variant, imgs[0], imgs[1], imgs[2]); })) {
+				log_error("failed to blur \"$\"", item->name);
+				++failed_count;
+				free_sets.push(std::move(item->set));
+				continue;
+			}
+			blurred.push(std::move(*item));
+		}
+		blurred.close();
+	});
+	threads.emplace_back([&] {
+		while (auto item = blurred.pop()) {
+			const auto success = timed(3, [&] {
+				auto mapped = item->set->imgs[2]->map(*download_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+				if (!mapped) {
+					return false;
+				}
+				memcpy(item->pixels.get(), mapped, size_t(item->padded_size.x) * size_t(item->padded_size.y) * sizeof(uchar4));
+				item->set->imgs[2]->unmap(*download_queue, mapped);
+				return true;
+			});
+			free_sets.push(std::move(item->set));
+			item->set = nullptr;
+			if (!success) {
+				log_error("failed to download \"$\"", item->name);
+				++failed_count;
+				continue;
+			}
+			downloaded.push(std::move(*item));
+		}
+		downloaded.close();
+	});
+	for (uint32_t i = 0; i < io_thread_count; ++i) {
+		threads.emplace_back([&] {
+			while (auto item = downloaded.pop()) {
+				if (!timed(4, [&] { return encode(*item, filesystem::path(config.output_dir) / item->name); })) {
+					++failed_count;
+					continue;
+				}
+				pixel_count += uint64_t(item->size.x) * uint64_t(item->size.y);
+				++done_count;
+			}
+		});
+	}
+	for (auto& th : threads) {
+		th.join();
+	}
+	const auto total_time = floor_timer::stop<chrono::microseconds>(pipeline_start);
+	const auto total_seconds = double(total_time) / 1'000'000.0;
+	
+	log_msg("batch blur: $ images ($ failed) in $s -> $ images/s, $ MPixel/s",
+			done_count.load(), failed_count.load(), total_seconds,
+			double(done_count) / total_seconds, double(pixel_count) / 1'000'000.0 / total_seconds);
+	for (const auto& stage : stats) {
+		// occupancy: fraction of the wall time that the threads of this stage were busy
+		log_msg("$: $% occupancy ($ thread(s), $ms busy)", stage.name,
+				100.0 * double(stage.busy_time) / (double(total_time) * double(stage.thread_count)),
+				stage.thread_count, double(stage.busy_time) / 1000.0);
+	}
+	return (failed_count == 0u);
+#else
+	(void)ctx;
+	(void)dev;
+	(void)blur;
+	log_error("batch mode is not supported on iOS (input: $)", config.input_dir);
+	return false;
+#endif
+}
+	
+} // namespace img_batch
@@ -0,0 +1,46 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FLOOR_IMG_IMG_BATCH_HPP__
+#define __FLOOR_IMG_IMG_BATCH_HPP__
+
+#include "img_blur.hpp"
+
+//! batch processing of all PNG files in a directory:
+//! a bounded pipeline overlaps PNG decoding (thread pool), upload, blur, download and PNG encoding (thread pool),
+//! i.e. while image N is being blurred, image N+1 is uploaded and image N+2 (and later ones) are decoded
+//! NOTE: images of any size are supported, they are padded to a multiple of 32px (clamp-to-edge) on upload
+namespace img_batch {
+
+struct config_t {
+	string input_dir;
+	string output_dir;
+	//! amount of decode and encode threads each (0 = half of the hardware threads)
+	uint32_t io_thread_count { 0u };
+	//! blur parameters (see img_blur::blur)
+	uint32_t radius { TAP_COUNT / 2 };
+	blur_variant_t variant;
+};
+
+//! blurs all PNG files in "input_dir" and writes them into "output_dir", reports images/s and per-stage occupancy
+bool run(compute_context& ctx, const compute_device& dev, const img_blur& blur, const config_t& config);
+	
+} // namespace img_batch
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "img_benchmark.hpp"
+#include "../../common/json/json_escape.hpp"
+#include <floor/core/timer.hpp>
+#include <fstream>
+
+namespace img_benchmark {
+
+//! minimal image traffic per pixel of a blur or copy: one RGBA8 read + one RGBA8 write
+static constexpr const uint32_t bytes_per_pixel { 2u * uint32_t(sizeof(uchar4)) };
+
+//! timing statistics (per run, in ms) of all repeats of one configuration
+struct result_t {
+	uint2 image_size;
+	//! 0 for the copy kernel
+	uint32_t tap_count { 0u };
+	string kernel_name;
+	double mean_ms { 0.0 };
+	double stddev_ms { 0.0 };
+	double min_ms { 0.0 };
+	double max_ms { 0.0 };
+	//! mean effective bandwidth of the copy kernel at this image size
+	double copy_gbps { 0.0 };
+	
+	double mpixels_per_second(const double& run_ms) const {
+		return (double(image_size.x) * double(image_size.y)) / (run_ms * 1000.0);
+	}
+	double effective_gbps(const double& run_ms) const {
+		return (double(image_size.x) * double(image_size.y) * double(bytes_per_pixel)) / (run_ms * 1'000'000.0);
+	}
+	//! effective bandwidth relative to the copy kernel
+	double copy_fraction() const {
+		return (copy_gbps > 0.0 ? effective_gbps(mean_ms) / copy_gbps : 0.0);
+	}
+};
+
+vector<uint32_t> parse_uint_list(const char* str) {
+	vector<uint32_t> values;
+	while (str != nullptr && *str != '\0') {
+		char* end_ptr = nullptr;
+		const auto value = strtoul(str, &end_ptr, 10);
+		if (end_ptr == str || value == 0u) {
+			return {};
+		}
+		values.emplace_back(uint32_t(value));
+		str = (*end_ptr == ',' ? end_ptr + 1 : end_ptr);
+		if (*end_ptr != ',' && *end_ptr != '\0') {
+			return {};
+		}
+	}
+	return values;
+}
+
+//! runs "run" once to warm up (returns false if it fails, i.e. the kernel is unsupported), then times "repeats" runs
+//! NOTE: uses queue profiling if supported (-> device execution time only), falls back to wall-clock time otherwise
+template <typename run_func_type>
+static bool time_runs(const compute_queue& dev_queue, const uint32_t repeats, run_func_type&& run, result_t& result) {
+	if (!run()) {
+		return false;
+	}
+	const auto queue_profiling = dev_queue.has_profiling_support();
+	vector<double> run_times;
+	for (uint32_t i = 0; i < repeats; ++i) {
+		// all kernels block until completion
+		uint64_t microseconds = 0u;
+		if (queue_profiling) {
+			dev_queue.start_profiling();
+			run();
+			microseconds = dev_queue.stop_profiling();
+		} else {
+			const auto start = floor_timer::start();
+			run();
+			microseconds = floor_timer::stop<chrono::microseconds>(start);
+		}
+		run_times.emplace_back(double(microseconds) / 1000.0);
+	}
+	
+	result.min_ms = *min_element(run_times.begin(), run_times.end());
+	result.max_ms = *max_element(run_times.begin(), run_times.end());
+	result.mean_ms = 0.0;
+	for (const auto& time : run_times) {
+		result.mean_ms += time;
+	}
+	result.mean_ms /= double(run_times.size());
+	double variance = 0.0;
+	for (const auto& time : run_times) {
+		variance += (time - result.mean_ms) * (time - result.mean_ms);
+	}
+	result.stddev_ms = (run_times.size() > 1u ? sqrt(variance / double(run_times.size() - 1u)) : 0.0);
+	return true;
+}
+
+static bool write_json(const string& file_name, const compute_device& dev, const config_t& config, const vector<result_t>& results) {
+	ofstream json(file_name, ios::out | ios::trunc);
+	if (!json.is_open()) {
+		log_error("failed to open benchmark JSON file \"$\" for writing", file_name);
+		return false;
+	}
+	json.precision(10);
+	json << "{" << endl;
+	json << "\t\"device\": \"" << json_escape(dev.name) << "\"," << endl;
+	json << "\t\"repeats\": " << config.repeats << "," << endl;
+	json << "\t\"bytes_per_pixel\": " << bytes_per_pixel << "," << endl;
+	json << "\t\"results\": [" << endl;
+	for (size_t i = 0, count = results.size(); i < count; ++i) {
+		const auto& res = results[i];
+		json << "\t\t{ ";
+		json << "\"width\": " << res.image_size.x << ", ";
+		json << "\"height\": " << res.image_size.y << ", ";
+		json << "\"tap_count\": " << res.tap_count << ", ";
+		json << "\"kernel\": \"" << res.kernel_name << "\", ";
+		json << "\"run_ms\": { \"mean\": " << res.mean_ms << ", \"stddev\": " << res.stddev_ms;
+		json << ", \"min\": " << res.min_ms << ", \"max\": " << res.max_ms << " }, ";
+		json << "\"mpixels_per_second\": " << res.mpixels_per_second(res.mean_ms) << ", ";
+		json << "\"mpixels_per_second_best\": " << res.mpixels_per_second(res.min_ms) << ", ";
+		json << "\"effective_gbps\": " << res.effective_gbps(res.mean_ms) << ", ";
+		json << "\"copy_fraction\": " << res.copy_fraction();
+		json << " }" << (i + 1 < count ? "," : "") << endl;
+	}
+	json << "\t]" << endl;
+	json << "}" << endl;
+	if (!json.good()) {
+		log_error("failed to write benchmark JSON file \"$\"", file_name);
+		return false;
+	}
+	return true;
+}
+
+bool run(compute_context& ctx, const compute_device& dev, compute_queue& dev_queue, img_blur& blur, const config_t& config) {
+	if (config.image_sizes.empty() || config.tap_counts.empty() || config.repeats == 0u) {
+		log_error("invalid benchmark suite configuration");
+		return false;
+	}
+	auto default_prog = blur.get_default_program();
+	auto copy_kernel = (default_prog ? default_prog->get_kernel("image_copy") : nullptr);
+	if (!copy_kernel) {
+		log_error("failed to retrieve the image copy kernel");
+		return false;
+	}
+	
+	// compile all tap count programs upfront
+	vector<uint32_t> tap_counts;
+	for (const auto& tap_count : config.tap_counts) {
+		if (tap_count % 2u == 0u || tap_count < 3u || tap_count > blur_tap_count(max_tap_blur_radius)) {
+			log_warn("skipping tap count $: must be an odd number in [3, $]", tap_count, blur_tap_count(max_tap_blur_radius));
+			continue;
+		}
+		if (blur.has_fixed_tap_count() && tap_count != TAP_COUNT) {
+			// all other tap counts would execute the compiled-in TAP_COUNT kernels
+			log_warn("skipping tap count $: host compute only supports the compiled-in tap count ($)", tap_count, TAP_COUNT);
+			continue;
+		}
+		if (!blur.has_tap_program(tap_count)) {
+			log_warn("skipping tap count $: blur program is not available", tap_count);
+			continue;
+		}
+		tap_counts.emplace_back(tap_count);
+	}
+	if (tap_counts.empty()) {
+		log_error("no usable tap count");
+		return false;
+	}
+	
+	vector<result_t> results;
+	for (const auto& size : config.image_sizes) {
+		const auto image_size = ((uint2 { size }.minned(dev.max_image_2d_dim)) / 32u) * 32u;
+		if (image_size.x == 0u || image_size.y == 0u) {
+			log_warn("skipping image size $: too small", size);
+			continue;
+		}
+		if (image_size.x != size || image_size.y != size) {
+			log_warn("image size $ is not supported by the device -> using $", size, image_size);
+		}
+		
+		// random content (the actual content is irrelevant for the performance)
+		const auto pixel_count = size_t(image_size.x) * size_t(image_size.y);
+		auto img_data = make_unique<uchar4[]>(pixel_count);
+		for (size_t i = 0; i < pixel_count; ++i) {
+			img_data[i] = uchar4(uint8_t(core::rand(0, 255)), uint8_t(core::rand(0, 255)),
+								 uint8_t(core::rand(0, 255)), uint8_t(core::rand(0, 255)));
+		}
+		array<shared_ptr<compute_image>, 3> imgs;
+		for (size_t i = 0; i < imgs.size(); ++i) {
+			imgs[i] = ctx.create_image(dev_queue, image_size,
+									   COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+									   (i == 0 ? COMPUTE_IMAGE_TYPE::READ : COMPUTE_IMAGE_TYPE::READ_WRITE),
+									   span<uint8_t> { i == 0 ? (uint8_t*)img_data.get() : nullptr, i == 0 ? pixel_count * sizeof(uchar4) : 0u },
+									   COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+			if (!imgs[i]) {
+				log_error("failed to create the benchmark images (size: $)", image_size);
+				return false;
+			}
+		}
+		dev_queue.finish();
+		
+		// copy kernel: reference bandwidth
+		result_t copy_result {
+			.image_size = image_size,
+			.tap_count = 0u,
+			.kernel_name = "image_copy",
+		};
+		time_runs(dev_queue, config.repeats, [&dev_queue, &copy_kernel, &imgs, &image_size] {
+			dev_queue.execute_with_parameters(*copy_kernel, compute_queue::execution_parameters_t {
+				.execution_dim = 2u,
+				.global_work_size = image_size,
+				.local_work_size = uint2 { 32, 16 },
+				.args = {
+					imgs[0], imgs[2]
+				},
+				.wait_until_completion = true,
+				.debug_label = "image_copy",
+			});
+			return true;
+		}, copy_result);
+		copy_result.copy_gbps = copy_result.effective_gbps(copy_result.mean_ms);
+		log_msg("size: $, $: $ms (+/- $ms, min $ms) -> $ MPixel/s, $ GB/s",
+				image_size, copy_result.kernel_name, copy_result.mean_ms, copy_result.stddev_ms, copy_result.min_ms,
+				copy_result.mpixels_per_second(copy_result.mean_ms), copy_result.copy_gbps);
+		results.emplace_back(copy_result);
+		
+		for (const auto& tap_count : tap_counts) {
+			const auto radius = tap_count / 2u;
+			for (const auto& variant : blur_variant_t::all()) {
+				// runs the variant exactly as specified (-> no fallback to other tile sizes), returns false if it's unsupported
+				const auto run_variant = [&blur, &variant, &radius, &imgs] {
+					if (variant.dumb) {
+						return blur.blur(radius, variant, imgs[0], imgs[1], imgs[2]);
+					}
+					return blur.blur_single_stage(radius, single_stage_blur_kernel(variant.storage, *variant.tile_size_idx), imgs[0], imgs[2]);
+				};
+				
+				result_t result {
+					.image_size = image_size,
+					.tap_count = tap_count,
+					.kernel_name = variant.name(),
+					.copy_gbps = copy_result.copy_gbps,
+				};
+				if (!time_runs(dev_queue, config.repeats, run_variant, result)) {
+					log_msg("size: $, taps: $, $: not supported", image_size, tap_count, result.kernel_name);
+					continue;
+				}
+				log_msg("size: $, taps: $, $: $ms (+/- $ms, min $ms) -> $ MPixel/s, $ GB/s ($% of copy)",
+						image_size, tap_count, result.kernel_name, result.mean_ms, result.stddev_ms, result.min_ms,
+						result.mpixels_per_second(result.mean_ms), result.effective_gbps(result.mean_ms),
+						result.copy_fraction() * 100.0);
+				results.emplace_back(result);
+			}
+		}
+	}
+	
+	if (results.empty()) {
+		log_error("no benchmark configuration could be run");
+		return false;
+	}
+	
+	// fastest variant per image size and tap count
+	for (const auto& res : results) {
+		if (res.tap_count == 0u) {
+			continue;
+		}
+		const auto is_best = none_of(results.begin(), results.end(), [&res](const result_t& other) {
+			return ((other.image_size == res.image_size).all() && other.tap_count == res.tap_count && other.mean_ms < res.mean_ms);
+		});
+		if (is_best) {
+			log_msg("best: size: $, taps: $: $ -> $ MPixel/s ($% of copy)", res.image_size, res.tap_count, res.kernel_name,
+					res.mpixels_per_second(res.mean_ms), res.copy_fraction() * 100.0);
+		}
+	}
+	
+	if (!write_json(config.json_file_name, dev, config, results)) {
+		return false;
+	}
+	log_msg("wrote benchmark results to \"$\"", config.json_file_name);
+	return true;
+}
+	
+} // namespace img_benchmark
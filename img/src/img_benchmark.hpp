@@ -0,0 +1,51 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FLOOR_IMG_IMG_BENCHMARK_HPP__
+#define __FLOOR_IMG_IMG_BENCHMARK_HPP__
+
+#include "img_blur.hpp"
+
+//! headless blur benchmark suite: sweeps image sizes, tap counts (one compiled program per tap count) and all blur variants
+//! (single-stage storage types x tile sizes, dumb kernels), then writes all results to a JSON file
+//! throughput is reported in MPixel/s and as effective bandwidth, i.e. the minimal image traffic of a blur (one RGBA8 read
+//! and one RGBA8 write per pixel) over the run time, which is compared to the bandwidth of a plain image copy kernel
+namespace img_benchmark {
+
+struct config_t {
+	//! square image sizes (multiples of 32px, clamped to the max device image size)
+	vector<uint32_t> image_sizes { 1024u, 2048u, 4096u };
+	//! tap counts (odd, 3 - 21)
+	vector<uint32_t> tap_counts { 5u, 9u, 15u, 21u };
+	//! #timed runs per configuration (-> variance)
+	uint32_t repeats { 20u };
+	string json_file_name { "img_benchmark.json" };
+};
+
+//! runs all benchmark configurations, logs the results and writes the JSON report
+//! NOTE: this compiles the blur program for each tap count upfront (-> not possible on iOS, where only TAP_COUNT is available,
+//!       and host-compute w/o host-device support only benchmarks TAP_COUNT)
+bool run(compute_context& ctx, const compute_device& dev, compute_queue& dev_queue, img_blur& blur, const config_t& config);
+
+//! parses a comma-separated list of unsigned integers (e.g. "1024,2048,4096"), returns an empty vector on failure
+vector<uint32_t> parse_uint_list(const char* str);
+	
+} // namespace img_benchmark
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "img_blur.hpp"
+#include <floor/compute/host/host_compute.hpp>
+
+float4 compute_iir_coefficients(const float sigma) {
+	// Young, van Vliet: "Recursive implementation of the Gaussian filter" (1995)
+	const auto q = (sigma >= 2.5f ?
+					0.98711f * sigma - 0.96330f :
+					3.97156f - 4.14554f * std::sqrt(1.0f - 0.26891f * sigma));
+	const auto q2 = q * q;
+	const auto q3 = q2 * q;
+	const auto b0 = 1.57825f + 2.44413f * q + 1.4281f * q2 + 0.422205f * q3;
+	const auto b1 = 2.44413f * q + 2.85619f * q2 + 1.26661f * q3;
+	const auto b2 = -(1.4281f * q2 + 1.26661f * q3);
+	const auto b3 = 0.422205f * q3;
+	return { 1.0f - (b1 + b2 + b3) / b0, b1 / b0, b2 / b0, b3 / b0 };
+}
+
+float blur_sigma(const uint32_t radius) {
+	if (radius > max_tap_blur_radius) {
+		return blur_iir_sigma(radius);
+	}
+	
+	// same as find_effective_n()/compute_coefficients() in img_kernels.cpp: the coefficients are the middle part of
+	// the first row of pascal's triangle in which the outer coefficients still have a visible (>= 1/255) contribution
+	const auto tap_count = blur_tap_count(radius);
+	const auto binomial_row = [](const uint32_t count) {
+		vector<long double> row(count);
+		row[0] = 1.0L / std::pow(2.0L, (long double)(count - 1u));
+		for (uint32_t i = 1; i < count; ++i) {
+			row[i] = row[i - 1] * (long double)(count - i) / (long double)i;
+		}
+		return row;
+	};
+	vector<long double> row;
+	for (uint32_t count = tap_count; count < 64u; count += 2u) {
+		row = binomial_row(count);
+		const auto first_visible = (uint32_t)distance(row.begin(), find_if(row.begin(), row.end(), [](const long double& coeff) {
+			return (coeff > 1.0L / 255.0L);
+		}));
+		if (count - first_visible * 2u >= tap_count) {
+			break;
+		}
+	}
+	
+	long double sum = 0.0L, variance = 0.0L;
+	for (uint32_t i = 0, k = uint32_t(row.size() - tap_count) / 2u; i < tap_count; ++i, ++k) {
+		const auto offset = (long double)i - (long double)radius;
+		sum += row[k];
+		variance += row[k] * offset * offset;
+	}
+	return float(std::sqrt(variance / sum));
+}
+
+//! host-compute w/o host-device support: all kernels are compiled into the executable, i.e. -DTAP_COUNT has no effect
+//! and every "compiled" program contains the TAP_COUNT kernels
+static bool is_fixed_host_tap_count(const compute_context& ctx) {
+	return (ctx.get_compute_type() == COMPUTE_TYPE::HOST && !((const host_compute&)ctx).has_host_device_support());
+}
+
+img_blur::img_blur(compute_context& ctx_, const compute_device& dev_, compute_queue& dev_queue_) :
+ctx(ctx_), dev(dev_), dev_queue(dev_queue_), fixed_tap_count(is_fixed_host_tap_count(ctx_)) {}
+
+img_blur::img_blur(const img_blur& blur, compute_queue& dev_queue_) :
+ctx(blur.ctx), dev(blur.dev), dev_queue(dev_queue_), fixed_tap_count(blur.fixed_tap_count),
+tap_programs(blur.tap_programs), iir_h(blur.iir_h), iir_v(blur.iir_v) {}
+
+bool img_blur::init() {
+	auto default_prog = get_tap_program(TAP_COUNT);
+	if (!default_prog) {
+		return false;
+	}
+	iir_h = default_prog->prog->get_kernel("image_blur_iir_horizontal_f32");
+	iir_v = default_prog->prog->get_kernel("image_blur_iir_vertical_f32");
+	if (!iir_h || !iir_v) {
+		log_error("failed to retrieve IIR blur kernels from program");
+		return false;
+	}
+	return true;
+}
+
+img_blur::tap_program_t* img_blur::get_tap_program(const uint32_t tap_count) {
+	if (const auto iter = tap_programs.find(tap_count); iter != tap_programs.end()) {
+		return iter->second.get();
+	}
+	
+	if (fixed_tap_count && tap_count != TAP_COUNT) {
+		log_warn("tap count $ is not available with host-compute (only the compiled-in tap count $ is) -> using the IIR blur",
+				 tap_count, TAP_COUNT);
+		// don't retry this tap count
+		tap_programs.emplace(tap_count, nullptr);
+		return nullptr;
+	}
+	
+	auto tap_prog = make_shared<tap_program_t>();
+#if !defined(FLOOR_IOS)
+	log_debug("compiling blur program for tap count $ ...", tap_count);
+	tap_prog->prog = ctx.add_program_file(floor::data_path("../img/src/img_kernels.cpp"),
+										  "-I" + floor::data_path("../img/src") +
+										  " -DTAP_COUNT=" + to_string(tap_count));
+#else
+	// only the precompiled default tap count is available
+	if (tap_count == TAP_COUNT) {
+		tap_prog->prog = ctx.add_universal_binary(floor::data_path("img_kernels.fubar"));
+	}
+#endif
+	if (!tap_prog->prog) {
+		log_error("program compilation failed (tap count: $)", tap_count);
+		// don't retry this tap count
+		tap_programs.emplace(tap_count, nullptr);
+		return nullptr;
+	}
+	
+	for (size_t i = 0; i < size(single_stage_blur_kernel_names); ++i) {
+		tap_prog->single_stage[i] = tap_prog->prog->get_kernel(single_stage_blur_kernel_names[i]);
+		if (!tap_prog->single_stage[i]) {
+			log_warn("failed to retrieve/compile kernel: $", single_stage_blur_kernel_names[i]);
+		}
+	}
+	tap_prog->dumb_h = {
+		tap_prog->prog->get_kernel("image_blur_dumb_horizontal_f32"),
+		tap_prog->prog->get_kernel("image_blur_dumb_horizontal_f16"),
+	};
+	tap_prog->dumb_v = {
+		tap_prog->prog->get_kernel("image_blur_dumb_vertical_f32"),
+		tap_prog->prog->get_kernel("image_blur_dumb_vertical_f16"),
+	};
+	
+	auto ret = tap_prog.get();
+	tap_programs.emplace(tap_count, std::move(tap_prog));
+	return ret;
+}
+
+bool img_blur::prepare(const uint32_t radius) {
+	if (radius == 0) {
+		log_error("blur radius must be >= 1");
+		return false;
+	}
+	if (radius <= max_tap_blur_radius && get_tap_program(blur_tap_count(radius))) {
+		return true;
+	}
+	// IIR blur (or fallback)
+	return (iir_h && iir_v);
+}
+
+bool img_blur::has_tap_program(const uint32_t tap_count) {
+	return (tap_count <= blur_tap_count(max_tap_blur_radius) && get_tap_program(tap_count) != nullptr);
+}
+
+string blur_variant_t::name() const {
+	if (dumb) {
+		// NOTE: there is no packed dumb variant (no local memory is used) -> U8 uses F32
+		return "image_blur_dumb_"s + (storage == BLUR_STORAGE::F16 ? "f16" : "f32");
+	}
+	return string(single_stage_blur_kernel_names[single_stage_blur_kernel(storage, tile_size_idx.value_or(0u))]);
+}
+
+vector<blur_variant_t> blur_variant_t::all() {
+	vector<blur_variant_t> variants;
+	for (const auto storage : { BLUR_STORAGE::F32, BLUR_STORAGE::F16, BLUR_STORAGE::U8 }) {
+		for (uint32_t tile_size_idx = 0; tile_size_idx < 3; ++tile_size_idx) {
+			variants.emplace_back(blur_variant_t { .storage = storage, .dumb = false, .tile_size_idx = tile_size_idx });
+		}
+	}
+	variants.emplace_back(blur_variant_t { .storage = BLUR_STORAGE::F32, .dumb = true, .tile_size_idx = {} });
+	variants.emplace_back(blur_variant_t { .storage = BLUR_STORAGE::F16, .dumb = true, .tile_size_idx = {} });
+	return variants;
+}
+
+bool img_blur::blur(const uint32_t radius, const blur_variant_t& variant,
+					const shared_ptr<compute_image>& in_img,
+					const shared_ptr<compute_image>& tmp_img,
+					const shared_ptr<compute_image>& out_img) {
+	if (radius == 0) {
+		log_error("blur radius must be >= 1");
+		return false;
+	}
+	if (radius <= max_tap_blur_radius) {
+		if (auto tap_prog = get_tap_program(blur_tap_count(radius)); tap_prog) {
+			return blur_tap(*tap_prog, variant, in_img, tmp_img, out_img);
+		}
+		log_warn("no blur kernels for radius $ -> falling back to the IIR blur", radius);
+	}
+	return blur_iir(blur_iir_sigma(radius), in_img, tmp_img, out_img);
+}
+
+bool img_blur::blur_single_stage(const uint32_t radius, const SINGLE_STAGE_BLUR_KERNEL kernel,
+								 const shared_ptr<compute_image>& in_img,
+								 const shared_ptr<compute_image>& out_img) {
+	if (radius == 0 || radius > max_tap_blur_radius) {
+		log_error("single-stage blur kernels only support radii in [1, $]", max_tap_blur_radius);
+		return false;
+	}
+	auto tap_prog = get_tap_program(blur_tap_count(radius));
+	if (!tap_prog || !is_single_stage_supported(*tap_prog, kernel)) {
+		return false;
+	}
+	run_single_stage(*tap_prog, kernel, in_img, out_img);
+	return true;
+}
+
+bool img_blur::is_single_stage_supported(const tap_program_t& tap_prog, const SINGLE_STAGE_BLUR_KERNEL kernel) const {
+	const auto& blur_kernel = tap_prog.single_stage[kernel];
+	const auto local_size = single_stage_blur_local_size(kernel);
+	if (!blur_kernel || local_size > dev.max_total_local_size) {
+		return false;
+	}
+	const auto kernel_entry = blur_kernel->get_kernel_entry(dev);
+	return (kernel_entry && kernel_entry->max_total_local_size >= local_size);
+}
+
+void img_blur::run_single_stage(const tap_program_t& tap_prog, const SINGLE_STAGE_BLUR_KERNEL kernel,
+								const shared_ptr<compute_image>& in_img,
+								const shared_ptr<compute_image>& out_img) {
+	const uint2 image_size = in_img->get_image_dim().xy;
+	if (last_kernel_name != single_stage_blur_kernel_names[kernel]) {
+		last_kernel_name = single_stage_blur_kernel_names[kernel];
+		log_debug("using single-stage blur kernel: $", last_kernel_name);
+	}
+	
+	// run single-stage blur
+	dev_queue.execute_with_parameters(*tap_prog.single_stage[kernel], compute_queue::execution_parameters_t {
+		// run as 1D kernel
+		.execution_dim = 1u,
+		// total amount of work:
+		.global_work_size = { image_size.x * image_size.y, 0u, 0u },
+		// work per work-group:
+		.local_work_size = { single_stage_blur_local_size(kernel), 0u, 0u },
+		// kernel arguments:
+		.args = {
+			in_img, out_img
+		},
+		.wait_until_completion = true,
+		.debug_label = "blur_single_stage",
+	});
+}
+
+bool img_blur::blur_tap(tap_program_t& tap_prog, const blur_variant_t& variant,
+						const shared_ptr<compute_image>& in_img,
+						const shared_ptr<compute_image>& tmp_img,
+						const shared_ptr<compute_image>& out_img) {
+	const uint2 image_size = in_img->get_image_dim().xy;
+	
+	// NOTE: all kernels are run with "wait_until_completion" set to true, since this provides proper synchronization in the absence
+	// of automatic or manual synchronization provided by a backend queue (-> automatic resource tracking or manual dev_queue->finish())
+	if (!variant.dumb) {
+		// figure out which kernel to use: wanted or largest supported tile size
+		optional<SINGLE_STAGE_BLUR_KERNEL> selected_kernel;
+		for (uint32_t tile_size_idx = variant.tile_size_idx.value_or(0u); tile_size_idx < 3; ++tile_size_idx) {
+			const auto kernel = single_stage_blur_kernel(variant.storage, tile_size_idx);
+			if (is_single_stage_supported(tap_prog, kernel)) {
+				selected_kernel = kernel;
+				break;
+			}
+		}
+		if (!selected_kernel) {
+			log_error("no single stage blur kernel is supported by the device");
+			return false;
+		}
+		run_single_stage(tap_prog, *selected_kernel, in_img, out_img);
+	} else {
+		const auto dumb_idx = (variant.storage == BLUR_STORAGE::F16 ? 1u : 0u);
+		const auto& blur_h = tap_prog.dumb_h[dumb_idx];
+		const auto& blur_v = tap_prog.dumb_v[dumb_idx];
+		if (!blur_h || !blur_v) {
+			log_error("failed to retrieve dumb blur kernels from program");
+			return false;
+		}
+		last_kernel_name = variant.name();
+		
+		dev_queue.execute_with_parameters(*blur_h, compute_queue::execution_parameters_t {
+			// run as 2D kernel
+			.execution_dim = 2u,
+			// total amount of work:
+			.global_work_size = image_size,
+			// work per work-group:
+			.local_work_size = uint2 { 32, 16 },
+			// kernel arguments:
+			.args = {
+				in_img, tmp_img
+			},
+			.wait_until_completion = true,
+			.debug_label = "blur_horizontal",
+		});
+		dev_queue.execute_with_parameters(*blur_v, compute_queue::execution_parameters_t {
+			.execution_dim = 2u,
+			.global_work_size = image_size,
+			.local_work_size = uint2 { 32, 16 },
+			.args = {
+				tmp_img, out_img
+			},
+			.wait_until_completion = true,
+			.debug_label = "blur_vertical",
+		});
+	}
+	return true;
+}
+
+bool img_blur::blur_iir(const float sigma,
+						const shared_ptr<compute_image>& in_img,
+						const shared_ptr<compute_image>& tmp_img,
+						const shared_ptr<compute_image>& out_img) {
+	if (!iir_h || !iir_v) {
+		log_error("IIR blur kernels are not available");
+		return false;
+	}
+	const uint2 image_size = in_img->get_image_dim().xy;
+	if (!iir_scratch || (iir_scratch_dim != image_size).any()) {
+		iir_scratch = ctx.create_buffer(dev_queue, size_t(image_size.x) * size_t(image_size.y) * sizeof(float4),
+										COMPUTE_MEMORY_FLAG::READ_WRITE);
+		if (!iir_scratch) {
+			log_error("failed to allocate the IIR blur buffer");
+			return false;
+		}
+		iir_scratch_dim = image_size;
+	}
+	last_kernel_name = "image_blur_iir_f32";
+	
+	const auto coeffs = compute_iir_coefficients(sigma);
+	// one work-item per row (horizontal pass) or column (vertical pass)
+	dev_queue.execute_with_parameters(*iir_h, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { image_size.y, 0u, 0u },
+		.local_work_size = { 32u, 0u, 0u },
+		.args = {
+			in_img, tmp_img, iir_scratch, coeffs
+		},
+		.wait_until_completion = true,
+		.debug_label = "blur_iir_horizontal",
+	});
+	dev_queue.execute_with_parameters(*iir_v, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { image_size.x, 0u, 0u },
+		.local_work_size = { 32u, 0u, 0u },
+		.args = {
+			tmp_img, out_img, iir_scratch, coeffs
+		},
+		.wait_until_completion = true,
+		.debug_label = "blur_iir_vertical",
+	});
+	return true;
+}
@@ -0,0 +1,230 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FLOOR_IMG_IMG_BLUR_HPP__
+#define __FLOOR_IMG_IMG_BLUR_HPP__
+
+#include <floor/floor/floor.hpp>
+#include <floor/compute/compute_kernel.hpp>
+#include <unordered_map>
+#include <optional>
+#include "img_kernels.hpp"
+
+//! storage of the blur samples (-> local memory of the single-stage kernels)
+enum class BLUR_STORAGE : uint32_t {
+	//! float4 samples
+	F32,
+	//! half4 samples, half precision computations
+	F16,
+	//! packed uchar4 samples that are only converted to float in registers (single-stage kernels only, otherwise F32 is used)
+	U8,
+};
+
+enum SINGLE_STAGE_BLUR_KERNEL {
+	SINGLE_STAGE_BLUR_1024_32_F32,
+	SINGLE_STAGE_BLUR_256_16_F32,
+	SINGLE_STAGE_BLUR_64_8_F32,
+	SINGLE_STAGE_BLUR_1024_32_F16,
+	SINGLE_STAGE_BLUR_256_16_F16,
+	SINGLE_STAGE_BLUR_64_8_F16,
+	SINGLE_STAGE_BLUR_1024_32_U8,
+	SINGLE_STAGE_BLUR_256_16_U8,
+	SINGLE_STAGE_BLUR_64_8_U8,
+	__MAX_SINGLE_STAGE_BLUR_KERNEL
+};
+static constexpr const array single_stage_blur_kernel_names {
+	"image_blur_single_stage_32x32_f32"sv,
+	"image_blur_single_stage_16x16_f32"sv,
+	"image_blur_single_stage_8x8_f32"sv,
+	"image_blur_single_stage_32x32_f16"sv,
+	"image_blur_single_stage_16x16_f16"sv,
+	"image_blur_single_stage_8x8_f16"sv,
+	"image_blur_single_stage_32x32_u8"sv,
+	"image_blur_single_stage_16x16_u8"sv,
+	"image_blur_single_stage_8x8_u8"sv,
+};
+static_assert(size(single_stage_blur_kernel_names) == __MAX_SINGLE_STAGE_BLUR_KERNEL);
+
+//! returns the single-stage blur kernel for the specified storage and tile size index (0: 32x32, 1: 16x16, 2: 8x8)
+static constexpr SINGLE_STAGE_BLUR_KERNEL single_stage_blur_kernel(const BLUR_STORAGE storage, const uint32_t tile_size_idx) {
+	return SINGLE_STAGE_BLUR_KERNEL(uint32_t(storage) * 3u + tile_size_idx);
+}
+
+//! work-group size of a single-stage blur kernel (one work-item per pixel of the tile)
+static constexpr uint32_t single_stage_blur_local_size(const SINGLE_STAGE_BLUR_KERNEL kernel) {
+	return 1024u >> (2u * (uint32_t(kernel) % 3u));
+}
+
+//! local memory usage (in bytes) of a single-stage blur kernel work-group for the specified tap count
+//! (samples of the tile + overlap and results of the vertical pass)
+static constexpr uint32_t single_stage_blur_local_memory_size(const SINGLE_STAGE_BLUR_KERNEL kernel, const uint32_t tap_count) {
+	const auto lateral_dim = 32u >> (uint32_t(kernel) % 3u);
+	const auto sample_count_x = lateral_dim + (tap_count / 2u) * 2u;
+	const auto sample_size = 16u >> (uint32_t(kernel) / 3u) /* f32: 16, f16: 8, u8: 4 */;
+	return (sample_count_x * sample_count_x + sample_count_x * lateral_dim) * sample_size;
+}
+
+//! a tap blur kernel variant: a specific single-stage kernel or the dumb (two-pass) kernels
+struct blur_variant_t {
+	BLUR_STORAGE storage { BLUR_STORAGE::F32 };
+	//! use the dumb kernels (no local memory caching) instead of a single-stage kernel
+	bool dumb { false };
+	//! single-stage tile size index (0: 32x32, 1: 16x16, 2: 8x8), empty: largest one that is supported by the device
+	//! NOTE: if the tile size isn't supported by the device, the next smaller supported one is used
+	optional<uint32_t> tile_size_idx;
+	
+	//! returns the name of the kernel this variant runs, e.g. "image_blur_single_stage_16x16_u8" or "image_blur_dumb_f32"
+	//! (-> tile_size_idx must be set for single-stage variants)
+	string name() const;
+	
+	//! returns all variants with a set tile size (9 single-stage + 2 dumb)
+	static vector<blur_variant_t> all();
+};
+
+//! max blur radius that is handled by a TAP_COUNT-specialized kernel (-> 21 taps), larger radii use the recursive gaussian
+static constexpr const uint32_t max_tap_blur_radius { 10u };
+
+//! tap count of the binomial blur kernels for the specified radius
+static constexpr uint32_t blur_tap_count(const uint32_t radius) {
+	return radius * 2u + 1u;
+}
+
+//! sigma of the recursive gaussian for the specified radius
+//! NOTE: the 21-tap binomial kernel has an effective sigma of ~3.9 (radius 10) -> radius / 2.5 keeps both paths roughly in line
+static constexpr float blur_iir_sigma(const uint32_t radius) {
+	return float(radius) / 2.5f;
+}
+
+//! effective gaussian sigma of blur() for the specified radius, i.e. the standard deviation of the (trimmed) binomial
+//! coefficients used by the tap kernels, or the sigma of the recursive gaussian
+float blur_sigma(const uint32_t radius);
+
+//! amount of pixels around each pixel that affect the blur result for the specified radius
+//! NOTE: the recursive gaussian has an infinite support, 3 sigma are used here
+static constexpr uint32_t blur_halo(const uint32_t radius) {
+	return (radius <= max_tap_blur_radius ? radius : (radius * 6u + 4u) / 5u /* ceil(3 * radius / 2.5) */);
+}
+
+//! computes the Young/van Vliet recursive gaussian coefficients for "sigma" (>= 0.5),
+//! returns { B, b1 / b0, b2 / b0, b3 / b0 } as expected by the image_blur_iir_* kernels
+float4 compute_iir_coefficients(const float sigma);
+
+//! runtime-radius gaussian blur:
+//!  * radius <= max_tap_blur_radius: TAP_COUNT-specialized single-stage or dumb kernels, one program per tap count that is
+//!    compiled on first use and cached afterwards
+//!  * radius > max_tap_blur_radius: separable recursive (IIR) gaussian, the cost per pixel is independent of the radius
+class img_blur {
+public:
+	img_blur(compute_context& ctx, const compute_device& dev, compute_queue& dev_queue);
+	
+	//! creates a blur object that uses "dev_queue", but shares all already compiled programs of "blur"
+	//! (-> concurrent blurs on multiple queues, each object must only be used by one thread at a time)
+	img_blur(const img_blur& blur, compute_queue& dev_queue);
+	
+	//! compiles the program for the default TAP_COUNT (also contains the IIR kernels), returns false on failure
+	bool init();
+	
+	//! compiles the kernels for the specified radius if necessary (-> keeps the compilation out of measured blur() calls),
+	//! returns false if the radius can't be handled at all
+	bool prepare(const uint32_t radius);
+	
+	//! compiles the program for the specified tap count if necessary, returns true if its tap kernels are available
+	//! NOTE: unlike prepare(), this doesn't consider the IIR fallback -> use this before timing tap blur variants
+	bool has_tap_program(const uint32_t tap_count);
+	
+	//! blurs "in_img" into "out_img" using the specified radius, two-pass variants write their intermediate result into "tmp_img"
+	//! NOTE: all images must have the same size (a multiple of 32px), blocks until the blur has completed
+	//! NOTE: "variant" only applies to radii <= max_tap_blur_radius
+	bool blur(const uint32_t radius, const blur_variant_t& variant,
+			  const shared_ptr<compute_image>& in_img,
+			  const shared_ptr<compute_image>& tmp_img,
+			  const shared_ptr<compute_image>& out_img);
+	
+	//! blurs "in_img" into "out_img" using the specified single-stage kernel (-> radius <= max_tap_blur_radius),
+	//! returns false if the kernel isn't supported by the device, blocks until the blur has completed
+	bool blur_single_stage(const uint32_t radius, const SINGLE_STAGE_BLUR_KERNEL kernel,
+						   const shared_ptr<compute_image>& in_img,
+						   const shared_ptr<compute_image>& out_img);
+	
+	//! returns the program for the default TAP_COUNT (also contains all other non-blur kernels)
+	shared_ptr<compute_program> get_default_program() const {
+		const auto iter = tap_programs.find(TAP_COUNT);
+		return (iter != tap_programs.end() && iter->second ? iter->second->prog : nullptr);
+	}
+	
+	//! returns true if only the TAP_COUNT program is available (host-compute w/o host-device support),
+	//! radii with other tap counts use the IIR blur then
+	bool has_fixed_tap_count() const {
+		return fixed_tap_count;
+	}
+	
+	//! returns the name of the kernel (or kernel pair) used by the last blur() call
+	const string& get_last_kernel_name() const {
+		return last_kernel_name;
+	}
+	
+protected:
+	compute_context& ctx;
+	const compute_device& dev;
+	compute_queue& dev_queue;
+	//! see has_fixed_tap_count()
+	const bool fixed_tap_count;
+	
+	//! a TAP_COUNT-specialized program and its kernels
+	struct tap_program_t {
+		shared_ptr<compute_program> prog;
+		//! single-stage kernels in SINGLE_STAGE_BLUR_KERNEL order (nullptr if unavailable)
+		array<shared_ptr<compute_kernel>, __MAX_SINGLE_STAGE_BLUR_KERNEL> single_stage;
+		//! dumb kernels: [f32, f16]
+		array<shared_ptr<compute_kernel>, 2> dumb_h;
+		array<shared_ptr<compute_kernel>, 2> dumb_v;
+	};
+	//! tap count -> program (nullptr entries mark failed compilations, so that these aren't retried)
+	unordered_map<uint32_t, shared_ptr<tap_program_t>> tap_programs;
+	
+	//! IIR kernels (contained in the default program)
+	shared_ptr<compute_kernel> iir_h;
+	shared_ptr<compute_kernel> iir_v;
+	//! IIR causal pass storage (one float4 per pixel, reallocated if the image size changes)
+	shared_ptr<compute_buffer> iir_scratch;
+	uint2 iir_scratch_dim;
+	
+	string last_kernel_name;
+	
+	//! returns the program for "tap_count", compiling it first if necessary (nullptr on failure)
+	tap_program_t* get_tap_program(const uint32_t tap_count);
+	
+	//! returns true if the single-stage "kernel" of "tap_prog" exists and can be run with its work-group size on the device
+	bool is_single_stage_supported(const tap_program_t& tap_prog, const SINGLE_STAGE_BLUR_KERNEL kernel) const;
+	void run_single_stage(const tap_program_t& tap_prog, const SINGLE_STAGE_BLUR_KERNEL kernel,
+						  const shared_ptr<compute_image>& in_img,
+						  const shared_ptr<compute_image>& out_img);
+	
+	bool blur_tap(tap_program_t& tap_prog, const blur_variant_t& variant,
+				  const shared_ptr<compute_image>& in_img,
+				  const shared_ptr<compute_image>& tmp_img,
+				  const shared_ptr<compute_image>& out_img);
+	bool blur_iir(const float sigma,
+				  const shared_ptr<compute_image>& in_img,
+				  const shared_ptr<compute_image>& tmp_img,
+				  const shared_ptr<compute_image>& out_img);
+	
+};
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "img_edge_filter.hpp"
+#include "img_blur.hpp"
+
+img_edge_filter::img_edge_filter(compute_context& ctx_, compute_queue& dev_queue_) : ctx(ctx_), dev_queue(dev_queue_) {}
+
+bool img_edge_filter::init(const compute_program& prog) {
+	bilateral_kernel = prog.get_kernel("image_bilateral");
+	grid_splat_kernel = prog.get_kernel("image_bilateral_grid_splat");
+	grid_blur_kernel = prog.get_kernel("image_bilateral_grid_blur");
+	grid_slice_kernel = prog.get_kernel("image_bilateral_grid_slice");
+	guided_coefficients_kernel = prog.get_kernel("image_guided_coefficients");
+	guided_output_kernel = prog.get_kernel("image_guided_output");
+	if (!bilateral_kernel || !grid_splat_kernel || !grid_blur_kernel || !grid_slice_kernel ||
+		!guided_coefficients_kernel || !guided_output_kernel) {
+		log_error("failed to retrieve the edge filter kernels");
+		return false;
+	}
+	return true;
+}
+
+//! one work-group per EDGE_FILTER_TILE_SIZE^2 tile of the image
+static uint32_t edge_filter_global_size(const uint2& image_size) {
+	const auto tile_count = ((image_size + EDGE_FILTER_TILE_SIZE - 1u) / EDGE_FILTER_TILE_SIZE);
+	return tile_count.x * tile_count.y * EDGE_FILTER_TILE_SIZE * EDGE_FILTER_TILE_SIZE;
+}
+
+bool img_edge_filter::bilateral(const uint32_t radius, const float range_sigma,
+								const shared_ptr<compute_image>& in_img,
+								const shared_ptr<compute_image>& out_img) {
+	if (radius <= EDGE_FILTER_MAX_RADIUS) {
+		return bilateral_brute_force(radius, blur_sigma(radius), range_sigma, in_img, out_img);
+	}
+	return bilateral_grid(blur_sigma(radius), range_sigma, in_img, out_img);
+}
+
+bool img_edge_filter::bilateral_brute_force(const uint32_t radius, const float spatial_sigma, const float range_sigma,
+											const shared_ptr<compute_image>& in_img,
+											const shared_ptr<compute_image>& out_img) {
+	if (radius > EDGE_FILTER_MAX_RADIUS) {
+		log_warn("brute-force bilateral radius $ is larger than the max radius $ -> clamping", radius, EDGE_FILTER_MAX_RADIUS);
+	}
+	const uint2 image_size = in_img->get_image_dim().xy;
+	const float2 inv_sigmas {
+		1.0f / (2.0f * spatial_sigma * spatial_sigma),
+		1.0f / (2.0f * range_sigma * range_sigma),
+	};
+	dev_queue.execute_with_parameters(*bilateral_kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { edge_filter_global_size(image_size), 0u, 0u },
+		.local_work_size = { EDGE_FILTER_TILE_SIZE * EDGE_FILTER_TILE_SIZE, 0u, 0u },
+		.args = {
+			in_img, out_img, min(radius, EDGE_FILTER_MAX_RADIUS), inv_sigmas
+		},
+		.wait_until_completion = true,
+		.debug_label = "bilateral",
+	});
+	last_filter_name = "bilateral (brute-force)";
+	return true;
+}
+
+uint4 img_edge_filter::bilateral_grid_dim(const uint2& image_size, const float spatial_sigma, const float range_sigma) {
+	// NOTE: cells smaller than 4px would make the grid larger than the image, the brute-force filter is cheaper there anyways
+	const auto cell_size = std::clamp(uint32_t(std::round(spatial_sigma)), 4u, BILATERAL_GRID_MAX_CELL_SIZE);
+	const auto depth = std::clamp(uint32_t(std::ceil(1.0f / range_sigma)) + 1u, 2u, BILATERAL_GRID_MAX_DEPTH);
+	return {
+		(image_size.x + cell_size - 1u) / cell_size,
+		(image_size.y + cell_size - 1u) / cell_size,
+		depth,
+		cell_size,
+	};
+}
+
+bool img_edge_filter::bilateral_grid(const float spatial_sigma, const float range_sigma,
+									 const shared_ptr<compute_image>& in_img,
+									 const shared_ptr<compute_image>& out_img) {
+	const uint2 image_size = in_img->get_image_dim().xy;
+	const auto grid_dim = bilateral_grid_dim(image_size, spatial_sigma, range_sigma);
+	const auto grid_entry_count = grid_dim.x * grid_dim.y * grid_dim.z;
+	const auto required_grid_size = size_t(grid_entry_count) * sizeof(float4);
+	if (grid_buffer_size < required_grid_size) {
+		for (auto& grid_buffer : grid_buffers) {
+			grid_buffer = ctx.create_buffer(dev_queue, required_grid_size, COMPUTE_MEMORY_FLAG::READ_WRITE);
+			if (!grid_buffer) {
+				log_error("failed to allocate the bilateral grid");
+				grid_buffer_size = 0u;
+				return false;
+			}
+		}
+		grid_buffer_size = required_grid_size;
+	}
+	
+	// one work-group per cell
+	static constexpr const uint32_t splat_local_size { BILATERAL_GRID_MAX_DEPTH * BILATERAL_GRID_MAX_DEPTH };
+	dev_queue.execute_with_parameters(*grid_splat_kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { grid_dim.x * grid_dim.y * splat_local_size, 0u, 0u },
+		.local_work_size = { splat_local_size, 0u, 0u },
+		.args = {
+			in_img, grid_buffers[0], grid_dim
+		},
+		.wait_until_completion = true,
+		.debug_label = "bilateral_grid_splat",
+	});
+	// one work-item per grid entry
+	dev_queue.execute_with_parameters(*grid_blur_kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { ((grid_entry_count + 255u) / 256u) * 256u, 0u, 0u },
+		.local_work_size = { 256u, 0u, 0u },
+		.args = {
+			grid_buffers[0], grid_buffers[1], grid_dim
+		},
+		.wait_until_completion = true,
+		.debug_label = "bilateral_grid_blur",
+	});
+	dev_queue.execute_with_parameters(*grid_slice_kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 2u,
+		.global_work_size = ((image_size + 31u) / 32u) * 32u,
+		.local_work_size = uint2 { 32, 16 },
+		.args = {
+			in_img, grid_buffers[1], out_img, grid_dim
+		},
+		.wait_until_completion = true,
+		.debug_label = "bilateral_grid_slice",
+	});
+	last_filter_name = "bilateral (grid)";
+	return true;
+}
+
+bool img_edge_filter::guided(const uint32_t radius, const float eps,
+							 const shared_ptr<compute_image>& in_img,
+							 const shared_ptr<compute_image>& out_img) {
+	if (radius > EDGE_FILTER_MAX_RADIUS) {
+		log_warn("guided filter radius $ is larger than the max radius $ -> clamping", radius, EDGE_FILTER_MAX_RADIUS);
+	}
+	const uint2 image_size = in_img->get_image_dim().xy;
+	if (!guided_a_img || (uint2 { guided_a_img->get_image_dim().xy } != image_size).any()) {
+		for (auto img : { &guided_a_img, &guided_b_img }) {
+			*img = ctx.create_image(dev_queue, image_size,
+									COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA16F | COMPUTE_IMAGE_TYPE::READ_WRITE,
+									COMPUTE_MEMORY_FLAG::READ_WRITE);
+			if (!*img) {
+				log_error("failed to create the guided filter coefficient images");
+				guided_a_img = nullptr;
+				return false;
+			}
+		}
+	}
+	
+	const auto clamped_radius = min(radius, EDGE_FILTER_MAX_RADIUS);
+	dev_queue.execute_with_parameters(*guided_coefficients_kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { edge_filter_global_size(image_size), 0u, 0u },
+		.local_work_size = { EDGE_FILTER_TILE_SIZE * EDGE_FILTER_TILE_SIZE, 0u, 0u },
+		.args = {
+			in_img, guided_a_img, guided_b_img, clamped_radius, eps
+		},
+		.wait_until_completion = true,
+		.debug_label = "guided_coefficients",
+	});
+	dev_queue.execute_with_parameters(*guided_output_kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { edge_filter_global_size(image_size), 0u, 0u },
+		.local_work_size = { EDGE_FILTER_TILE_SIZE * EDGE_FILTER_TILE_SIZE, 0u, 0u },
+		.args = {
+			in_img, guided_a_img, guided_b_img, out_img, clamped_radius
+		},
+		.wait_until_completion = true,
+		.debug_label = "guided_output",
+	});
+	last_filter_name = "guided";
+	return true;
+}
@@ -0,0 +1,95 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FLOOR_IMG_IMG_EDGE_FILTER_HPP__
+#define __FLOOR_IMG_IMG_EDGE_FILTER_HPP__
+
+#include <floor/floor/floor.hpp>
+#include <floor/compute/compute_kernel.hpp>
+#include "img_kernels.hpp"
+
+//! edge-preserving filters:
+//!  * brute-force bilateral filter: (2 * radius + 1)^2 taps on the local memory tile cache, radius <= EDGE_FILTER_MAX_RADIUS
+//!  * bilateral grid: splat into a coarse (x, y, luminance) grid, blur the grid, slice it at each pixel
+//!    -> the cost per pixel is (almost) independent of the spatial sigma, used for radii > EDGE_FILTER_MAX_RADIUS
+//!  * guided filter with the image as its own guide: box means on the local memory tile cache (O(radius) per pixel),
+//!    radius <= EDGE_FILTER_MAX_RADIUS
+//! range sigma and guided filter eps are relative to colors in [0, 1], the spatial sigma of bilateral() is the
+//! sigma of the regular blur at the same radius (see blur_sigma())
+class img_edge_filter {
+public:
+	img_edge_filter(compute_context& ctx, compute_queue& dev_queue);
+	
+	//! retrieves the edge filter kernels from "prog", returns false if these aren't available
+	bool init(const compute_program& prog);
+	
+	//! bilateral filter at the specified blur radius: brute-force if radius <= EDGE_FILTER_MAX_RADIUS, bilateral grid otherwise,
+	//! blocks until the filter has completed
+	bool bilateral(const uint32_t radius, const float range_sigma,
+				   const shared_ptr<compute_image>& in_img,
+				   const shared_ptr<compute_image>& out_img);
+	
+	//! brute-force bilateral filter (radius is clamped to EDGE_FILTER_MAX_RADIUS), blocks until the filter has completed
+	bool bilateral_brute_force(const uint32_t radius, const float spatial_sigma, const float range_sigma,
+							   const shared_ptr<compute_image>& in_img,
+							   const shared_ptr<compute_image>& out_img);
+	
+	//! bilateral grid approximation of the bilateral filter, blocks until the filter has completed
+	bool bilateral_grid(const float spatial_sigma, const float range_sigma,
+						const shared_ptr<compute_image>& in_img,
+						const shared_ptr<compute_image>& out_img);
+	
+	//! guided filter with a (2 * radius + 1)^2 box (radius <= EDGE_FILTER_MAX_RADIUS), blocks until the filter has completed
+	bool guided(const uint32_t radius, const float eps,
+				const shared_ptr<compute_image>& in_img,
+				const shared_ptr<compute_image>& out_img);
+	
+	//! returns the bilateral grid size { cells x, cells y, luminance bins, cell size } for the specified image size and sigmas:
+	//! the cell size is the spatial sigma (at least 4px), the bin size is the range sigma
+	static uint4 bilateral_grid_dim(const uint2& image_size, const float spatial_sigma, const float range_sigma);
+	
+	//! returns the name of the last executed filter
+	const string& get_last_filter_name() const {
+		return last_filter_name;
+	}
+	
+protected:
+	compute_context& ctx;
+	compute_queue& dev_queue;
+	
+	shared_ptr<compute_kernel> bilateral_kernel;
+	shared_ptr<compute_kernel> grid_splat_kernel;
+	shared_ptr<compute_kernel> grid_blur_kernel;
+	shared_ptr<compute_kernel> grid_slice_kernel;
+	shared_ptr<compute_kernel> guided_coefficients_kernel;
+	shared_ptr<compute_kernel> guided_output_kernel;
+	
+	//! bilateral grid + blur target (reallocated if the grid gets larger)
+	array<shared_ptr<compute_buffer>, 2> grid_buffers;
+	size_t grid_buffer_size { 0u };
+	
+	//! guided filter a/b coefficients (RGBA16F, reallocated if the image size changes)
+	shared_ptr<compute_image> guided_a_img;
+	shared_ptr<compute_image> guided_b_img;
+	
+	string last_filter_name;
+	
+};
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "img_filter_graph.hpp"
+
+img_filter_graph::img_filter_graph(compute_context& ctx_, compute_queue& dev_queue_) : ctx(ctx_), dev_queue(dev_queue_) {}
+
+bool img_filter_graph::init(const compute_program& prog) {
+	fused_kernel = prog.get_kernel("image_filter_fused");
+	if (!fused_kernel) {
+		log_error("failed to retrieve the fused filter kernel");
+		return false;
+	}
+	return true;
+}
+
+void img_filter_graph::add_stage(const filter_stage& stage) {
+	stages.emplace_back(stage);
+	for (auto& plan : plans) {
+		plan.valid = false;
+	}
+}
+
+img_filter_graph& img_filter_graph::blur(const uint32_t radius_, const float sigma_) {
+	const auto radius = math::clamp(radius_, 1u, FUSED_FILTER_MAX_HALO);
+	if (radius != radius_) {
+		log_warn("blur stage radius $ is out of range, using $ instead", radius_, radius);
+	}
+	const auto sigma = (sigma_ > 0.0f ? sigma_ : float(radius) * 0.5f);
+	
+	filter_stage stage {
+		.type = FILTER_STAGE::BLUR,
+		.radius = radius,
+		.params = {},
+		.weights = {},
+	};
+	float weight_sum = 0.0f;
+	for (uint32_t i = 0; i <= radius; ++i) {
+		stage.weights[i] = std::exp(-float(i * i) / (2.0f * sigma * sigma));
+		weight_sum += (i == 0 ? 1.0f : 2.0f) * stage.weights[i];
+	}
+	for (uint32_t i = 0; i <= radius; ++i) {
+		stage.weights[i] /= weight_sum;
+	}
+	add_stage(stage);
+	return *this;
+}
+
+img_filter_graph& img_filter_graph::sharpen(const float amount) {
+	add_stage(filter_stage {
+		.type = FILTER_STAGE::SHARPEN,
+		.radius = 1u,
+		.params = { amount, 0.0f, 0.0f },
+		.weights = {},
+	});
+	return *this;
+}
+
+img_filter_graph& img_filter_graph::tone_curve(const float exposure, const float gamma, const float contrast) {
+	add_stage(filter_stage {
+		.type = FILTER_STAGE::TONE_CURVE,
+		.radius = 0u,
+		.params = { exposure, 1.0f / std::max(gamma, 0.01f), contrast },
+		.weights = {},
+	});
+	return *this;
+}
+
+img_filter_graph& img_filter_graph::downsample() {
+	add_stage(filter_stage {
+		.type = FILTER_STAGE::DOWNSAMPLE,
+		.radius = 0u,
+		.params = {},
+		.weights = {},
+	});
+	return *this;
+}
+
+bool img_filter_graph::add_stages(const string& spec) {
+	for (const auto& stage_str : core::tokenize(spec, ',')) {
+		const auto tokens = core::tokenize(stage_str, ':');
+		if (tokens.empty() || tokens[0].empty()) {
+			continue;
+		}
+		// returns the float argument #idx or "def" if it wasn't specified
+		const auto arg = [&tokens](const size_t idx, const float def) {
+			return (idx < tokens.size() && !tokens[idx].empty() ? strtof(tokens[idx].c_str(), nullptr) : def);
+		};
+		if (tokens[0] == "blur") {
+			blur(uint32_t(arg(1, 2.0f)), arg(2, 0.0f));
+		} else if (tokens[0] == "sharpen") {
+			sharpen(arg(1, 0.5f));
+		} else if (tokens[0] == "tone") {
+			tone_curve(arg(1, 1.0f), arg(2, 1.0f), arg(3, 1.0f));
+		} else if (tokens[0] == "down") {
+			downsample();
+		} else {
+			log_error("unknown filter stage: $", tokens[0]);
+			return false;
+		}
+	}
+	return true;
+}
+
+void img_filter_graph::clear() {
+	stages.clear();
+	for (auto& plan : plans) {
+		plan = {};
+	}
+}
+
+uint2 img_filter_graph::output_size(const uint2& input_size) const {
+	auto size = input_size;
+	for (const auto& stage : stages) {
+		if (stage.type == FILTER_STAGE::DOWNSAMPLE) {
+			size /= 2u;
+		}
+	}
+	return size;
+}
+
+vector<pair<uint32_t, uint32_t>> img_filter_graph::make_groups(const bool fuse) const {
+	vector<pair<uint32_t, uint32_t>> groups;
+	uint32_t begin = 0u, halo = 0u;
+	for (uint32_t i = 0, count = uint32_t(stages.size()); i < count; ++i) {
+		const auto& stage = stages[i];
+		// close the current group if this stage doesn't fit into it anymore
+		if (i > begin && (!fuse ||
+						  (i - begin) >= FUSED_FILTER_MAX_STAGES ||
+						  halo + stage.radius > FUSED_FILTER_MAX_HALO)) {
+			groups.emplace_back(begin, i);
+			begin = i;
+			halo = 0u;
+		}
+		halo += stage.radius;
+		// resolution change -> always ends the group
+		if (stage.type == FILTER_STAGE::DOWNSAMPLE) {
+			groups.emplace_back(begin, i + 1u);
+			begin = i + 1u;
+			halo = 0u;
+		}
+	}
+	if (begin < stages.size()) {
+		groups.emplace_back(begin, uint32_t(stages.size()));
+	}
+	return groups;
+}
+
+uint32_t img_filter_graph::launch_count(const bool fuse) const {
+	return uint32_t(make_groups(fuse).size());
+}
+
+uint64_t img_filter_graph::global_memory_bytes(const uint2& input_size, const bool fuse) const {
+	// each launch reads its input image once and writes its output image once
+	uint64_t bytes = 0u;
+	auto size = input_size;
+	for (const auto& group : make_groups(fuse)) {
+		bytes += uint64_t(size.x) * uint64_t(size.y) * sizeof(uchar4);
+		if (stages[group.second - 1u].type == FILTER_STAGE::DOWNSAMPLE) {
+			size /= 2u;
+		}
+		bytes += uint64_t(size.x) * uint64_t(size.y) * sizeof(uchar4);
+	}
+	return bytes;
+}
+
+bool img_filter_graph::build_plan(plan_t& plan, const uint2& input_size, const bool fuse) {
+	plan = {};
+	auto size = input_size;
+	const auto groups = make_groups(fuse);
+	for (size_t i = 0; i < groups.size(); ++i) {
+		const auto& [begin, end] = groups[i];
+		group_t group {
+			.begin = begin,
+			.end = end,
+			.stages_buffer = ctx.create_buffer(dev_queue, sizeof(filter_stage) * (end - begin),
+											   COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE),
+			.out_img = nullptr,
+		};
+		if (!group.stages_buffer) {
+			log_error("failed to create filter stage buffer");
+			return false;
+		}
+		group.stages_buffer->write(dev_queue, &stages[begin], sizeof(filter_stage) * (end - begin));
+		
+		if (stages[end - 1u].type == FILTER_STAGE::DOWNSAMPLE) {
+			size /= 2u;
+		}
+		if (((size % FUSED_FILTER_TILE_SIZE) != 0u).any()) {
+			log_error("image size $ (after stage #$) is not a multiple of the filter tile size", size, end - 1u);
+			return false;
+		}
+		if (i + 1u < groups.size()) {
+			group.out_img = ctx.create_image(dev_queue, size,
+											 COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+											 COMPUTE_IMAGE_TYPE::READ_WRITE,
+											 COMPUTE_MEMORY_FLAG::READ_WRITE);
+			if (!group.out_img) {
+				log_error("failed to create intermediate filter image");
+				return false;
+			}
+		}
+		plan.groups.emplace_back(std::move(group));
+	}
+	plan.input_size = input_size;
+	plan.valid = true;
+	return true;
+}
+
+bool img_filter_graph::run(const shared_ptr<compute_image>& in_img, const shared_ptr<compute_image>& out_img, const bool fuse) {
+	if (!fused_kernel) {
+		log_error("filter graph has not been initialized");
+		return false;
+	}
+	if (stages.empty()) {
+		log_error("filter graph is empty");
+		return false;
+	}
+	
+	const uint2 input_size = in_img->get_image_dim().xy;
+	const uint2 out_size = out_img->get_image_dim().xy;
+	if ((out_size != output_size(input_size)).any()) {
+		log_error("invalid filter graph output image size: $ (expected $)", out_size, output_size(input_size));
+		return false;
+	}
+	
+	auto& plan = plans[fuse ? 0 : 1];
+	if (!plan.valid || (plan.input_size != input_size).any()) {
+		if (!build_plan(plan, input_size, fuse)) {
+			return false;
+		}
+	}
+	
+	const compute_image* cur_in = in_img.get();
+	for (const auto& group : plan.groups) {
+		const auto cur_out = (group.out_img ? group.out_img.get() : out_img.get());
+		const uint2 group_out_size = cur_out->get_image_dim().xy;
+		dev_queue.execute_with_parameters(*fused_kernel, compute_queue::execution_parameters_t {
+			.execution_dim = 1u,
+			// one work-item per output pixel
+			.global_work_size = { group_out_size.x * group_out_size.y, 0u, 0u },
+			.local_work_size = { FUSED_FILTER_TILE_SIZE * FUSED_FILTER_TILE_SIZE, 0u, 0u },
+			.args = {
+				cur_in, cur_out, group.stages_buffer, group.end - group.begin
+			},
+			.wait_until_completion = true,
+			.debug_label = "filter_fused",
+		});
+		cur_in = cur_out;
+	}
+	return true;
+}
@@ -0,0 +1,110 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FLOOR_IMG_IMG_FILTER_GRAPH_HPP__
+#define __FLOOR_IMG_IMG_FILTER_GRAPH_HPP__
+
+#include <floor/floor/floor.hpp>
+#include <floor/compute/compute_kernel.hpp>
+#include "img_kernels.hpp"
+
+//! small filter graph over compute_image: a linear chain of blur, sharpen, tone-curve and downsample stages
+//! (e.g. blur -> downsample -> tone-curve -> sharpen)
+//!
+//! adjacent stages are fused into as few image_filter_fused launches as possible: a fused group is closed when it reaches
+//! FUSED_FILTER_MAX_STAGES stages, when the next stencil would exceed a halo of FUSED_FILTER_MAX_HALO px, or after a
+//! downsample stage (-> resolution change) - only the group inputs/outputs go through global memory, everything
+//! else stays in registers or local memory of the resp. work-group
+//! NOTE: intermediate images between groups are RGBA8UI_NORM images, like all other images of this example
+class img_filter_graph {
+public:
+	img_filter_graph(compute_context& ctx, compute_queue& dev_queue);
+	
+	//! retrieves the fused filter kernel from "prog", returns false if it isn't available
+	bool init(const compute_program& prog);
+	
+	//! appends a gaussian blur stage (radius <= FUSED_FILTER_MAX_HALO, sigma defaults to radius / 2)
+	img_filter_graph& blur(const uint32_t radius, const float sigma = 0.0f);
+	//! appends an unsharp mask stage
+	img_filter_graph& sharpen(const float amount);
+	//! appends a tone curve stage: ((color * exposure)^(1 / gamma) - 0.5) * contrast + 0.5
+	img_filter_graph& tone_curve(const float exposure, const float gamma, const float contrast);
+	//! appends a 2x2 downsample stage
+	img_filter_graph& downsample();
+	
+	//! appends all stages of a comma-separated list, returns false if it is malformed, stage syntax:
+	//! blur[:radius[:sigma]], sharpen[:amount], tone[:exposure[:gamma[:contrast]]], down
+	//! e.g. "blur:2,down,tone:1.2:2.2:1.1,sharpen:0.5"
+	bool add_stages(const string& spec);
+	
+	//! removes all stages
+	void clear();
+	
+	bool empty() const {
+		return stages.empty();
+	}
+	
+	//! returns the output image size for the specified input image size
+	uint2 output_size(const uint2& input_size) const;
+	
+	//! returns the amount of kernel launches necessary to run the graph
+	uint32_t launch_count(const bool fuse) const;
+	
+	//! runs all stages on "in_img", writing the result to "out_img" (which must have the size returned by output_size())
+	//! if "fuse" is false, each stage is run separately (-> for comparison), blocks until everything has completed
+	bool run(const shared_ptr<compute_image>& in_img, const shared_ptr<compute_image>& out_img, const bool fuse = true);
+	
+	//! returns the amount of bytes that are read from and written to images in global memory when running the graph
+	uint64_t global_memory_bytes(const uint2& input_size, const bool fuse) const;
+	
+protected:
+	compute_context& ctx;
+	compute_queue& dev_queue;
+	shared_ptr<compute_kernel> fused_kernel;
+	
+	vector<filter_stage> stages;
+	
+	//! a single image_filter_fused launch
+	struct group_t {
+		//! [begin, end) in "stages"
+		uint32_t begin;
+		uint32_t end;
+		//! device copy of the group's stages
+		shared_ptr<compute_buffer> stages_buffer;
+		//! output image, nullptr for the last group (-> writes into the user-specified output image)
+		shared_ptr<compute_image> out_img;
+	};
+	//! launch plans for the fused/unfused execution (rebuilt if the stages or the input size change)
+	struct plan_t {
+		vector<group_t> groups;
+		uint2 input_size;
+		bool valid { false };
+	};
+	array<plan_t, 2> plans;
+	
+	//! splits the stages into fused groups ([begin, end) pairs)
+	vector<pair<uint32_t, uint32_t>> make_groups(const bool fuse) const;
+	
+	bool build_plan(plan_t& plan, const uint2& input_size, const bool fuse);
+	
+	void add_stage(const filter_stage& stage);
+	
+};
+
+#endif
@@ -73,7 +73,14 @@ static constexpr auto compute_coefficients() {
 	return ret;
 }
 
-template <uint32_t tile_size, uint32_t lateral_dim, typename storage_type>
+// converts a color in [0, 255] to a packed 8-bit sample
+floor_inline_always static uchar4 pack_sample(const float4& color) {
+	return (color + 0.5f).cast<uint8_t>();
+}
+
+// packed: if true, all samples are stored as uchar4 in local memory (values in [0, 255]) and are only converted to float
+//         in registers, otherwise samples are stored as storage_type (float4/half4 with values in [0, 1])
+template <uint32_t tile_size, uint32_t lateral_dim, typename storage_type, bool packed = false>
 static void image_blur_single_stage(const_image_2d<storage_type> in_img, image_2d<vector_n<storage_type, 4>, true> out_img) {
 	static_assert(tile_size == lateral_dim * lateral_dim);
 	static_assert(lateral_dim <= 32u);
@@ -93,10 +100,13 @@ static void image_blur_single_stage(const_image_2d<storage_type> in_img, image_2
 	// this uses local memory as a sample + compute cache
 	// note that using a float4/half4 instead of a uchar4 requires more storage, but computations using floating point
 	// values are _a_lot_ faster than integer math or doing int->float conversions + float math
+	// -> the packed variant trades int->float conversions for a 4x (f32) or 2x (f16) smaller local memory footprint,
+	//    which allows more work-groups per compute unit (or makes 32x32 tiles with larger tap counts possible at all)
+	using sample_type = conditional_t<packed, uchar4, vector_n<storage_type, 4>>;
 	static constexpr const auto sample_count_x = lateral_dim + 2u * uint32_t(overlap);
 	static constexpr const auto sample_count_y = sample_count_x;
 	static constexpr const auto sample_count = sample_count_x * sample_count_y;
-	local_buffer<vector_n<storage_type, 4>, sample_count> samples;
+	local_buffer<sample_type, sample_count> samples;
 	
 	// get image dim and compute offsets
 	const auto img_dim = in_img.dim().xy;
@@ -118,7 +128,11 @@ static void image_blur_single_stage(const_image_2d<storage_type> in_img, image_2
 			math::clamp(int(sample_idx % sample_count_x) + sample_offset_outer.x, 0, int(img_dim.x) - 1),
 			math::clamp(int(sample_idx / sample_count_x) + sample_offset_outer.y, 0, int(img_dim.y) - 1)
 		};
-		samples[sample_idx] = in_img.read(img_coord);
+		if constexpr (packed) {
+			samples[sample_idx] = pack_sample(in_img.read(img_coord) * 255.0f);
+		} else {
+			samples[sample_idx] = in_img.read(img_coord);
+		}
 	}
 	// make sure the complete tile has been read and stored
 	local_barrier();
@@ -176,7 +190,8 @@ static void image_blur_single_stage(const_image_2d<storage_type> in_img, image_2
 	// the results of the vertical pass are written into a separate block of local memory,
 	// since this prevents additional synchronization and lowers registers usage
 	// (we would need to store 2 or 3 color values for each item on the "stack", i.e. registers)
-	local_buffer<vector_n<storage_type, 4>, vertical_pass_sample_count> vertical_pass_samples;
+	// NOTE: in the packed variant, the vertical pass results are rounded to 8-bit as well (-> at most 1 LSB of additional error)
+	local_buffer<sample_type, vertical_pass_sample_count> vertical_pass_samples;
 	for (uint32_t idx = local_id.x; idx < vertical_pass_sample_count; idx += local_size.x) {
 		float4 v_color;
 		auto sample_idx = (vertical_pass_sample_offset + idx) - (overlap * sample_count_x /* Y stride */);
@@ -185,7 +200,11 @@ static void image_blur_single_stage(const_image_2d<storage_type> in_img, image_2
 			// note that this will be optimized to an fma instruction if possible
 			v_color += coeffs[size_t(overlap + i)] * samples[sample_idx].template cast<float>();
 		}
-		vertical_pass_samples[idx] = v_color;
+		if constexpr (packed) {
+			vertical_pass_samples[idx] = pack_sample(v_color);
+		} else {
+			vertical_pass_samples[idx] = v_color;
+		}
 	}
 	
 	// make sure all write accesses have completed in the loop
@@ -219,7 +238,7 @@ static void image_blur_single_stage(const_image_2d<storage_type> in_img, image_2
 		lid.x + sample_offset_inner.x,
 		lid.y + sample_offset_inner.y
 	};
-	out_img.write(img_coord, h_color);
+	out_img.write(img_coord, packed ? h_color * (1.0f / 255.0f) : h_color);
 }
 
 kernel_1d(1024) void image_blur_single_stage_32x32_f32(const_image_2d<float> in_img, image_2d<float4, true> out_img) {
@@ -242,6 +261,16 @@ kernel_1d(64) void image_blur_single_stage_8x8_f16(const_image_2d<half> in_img,
 	image_blur_single_stage<64, 8, half>(in_img, out_img);
 }
 
+kernel_1d(1024) void image_blur_single_stage_32x32_u8(const_image_2d<float> in_img, image_2d<float4, true> out_img) {
+	image_blur_single_stage<1024, 32, float, true>(in_img, out_img);
+}
+kernel_1d(256) void image_blur_single_stage_16x16_u8(const_image_2d<float> in_img, image_2d<float4, true> out_img) {
+	image_blur_single_stage<256, 16, float, true>(in_img, out_img);
+}
+kernel_1d(64) void image_blur_single_stage_8x8_u8(const_image_2d<float> in_img, image_2d<float4, true> out_img) {
+	image_blur_single_stage<64, 8, float, true>(in_img, out_img);
+}
+
 // this is the dumb version of the blur, processing a horizontal or vertical line w/o manual caching
 // NOTE: this is practically the same as the opengl/glsl shader
 template <uint32_t direction /* 0 == horizontal, 1 == vertical */, typename storage_type>
@@ -280,4 +309,817 @@ kernel_2d() void image_blur_dumb_vertical_f16(const_image_2d<half> in_img, image
 	image_blur_dumb<1, half>(in_img, out_img);
 }
 
+// plain image copy: reference for the achievable image read + write bandwidth (see img_benchmark.hpp)
+kernel_2d() void image_copy(const_image_2d<float> in_img, image_2d<float4, true> out_img) {
+	out_img.write(global_id.xy, in_img.read(global_id.xy));
+}
+
+// recursive gaussian (Young/van Vliet): a causal and an anti-causal 3rd order IIR filter along each row/column,
+// i.e. the cost per pixel is independent of the blur radius (unlike the tap-based kernels above, this doesn't depend on TAP_COUNT)
+// coeffs: { B, b1 / b0, b2 / b0, b3 / b0 } (computed on the host for the wanted sigma)
+// NOTE: the causal pass output is stored in "scratch", with element i of line l at i * line_count + l,
+//       so that neighboring work-items (lines) access neighboring memory
+template <uint32_t direction /* 0 == horizontal, 1 == vertical */>
+floor_inline_always static void image_blur_iir(const_image_2d<float> in_img, image_2d<float4, true> out_img,
+											   buffer<float4> scratch, const float4 coeffs) {
+	const auto img_dim = in_img.dim().xy;
+	const auto line_count = (direction == 0 ? img_dim.y : img_dim.x);
+	const auto line_length = (direction == 0 ? img_dim.x : img_dim.y);
+	const auto line = global_id.x;
+	if (line >= line_count) {
+		return;
+	}
+	const auto coord = [&line](const uint32_t i) {
+		return (direction == 0 ? int2 { int(i), int(line) } : int2 { int(line), int(i) });
+	};
+	
+	// causal pass, starting in the steady state of the clamped-to-edge first pixel
+	float4 w_1 = in_img.read(coord(0u));
+	float4 w_2 = w_1, w_3 = w_1;
+	for (uint32_t i = 0; i < line_length; ++i) {
+		const float4 w_0 = coeffs.x * in_img.read(coord(i)) + coeffs.y * w_1 + coeffs.z * w_2 + coeffs.w * w_3;
+		scratch[i * line_count + line] = w_0;
+		w_3 = w_2;
+		w_2 = w_1;
+		w_1 = w_0;
+	}
+	
+	// anti-causal pass, starting in the steady state of the last causal output
+	float4 y_1 = w_1;
+	float4 y_2 = y_1, y_3 = y_1;
+	for (uint32_t i = line_length; i > 0; --i) {
+		const float4 y_0 = coeffs.x * scratch[(i - 1u) * line_count + line] + coeffs.y * y_1 + coeffs.z * y_2 + coeffs.w * y_3;
+		out_img.write(coord(i - 1u), y_0);
+		y_3 = y_2;
+		y_2 = y_1;
+		y_1 = y_0;
+	}
+}
+
+kernel_1d() void image_blur_iir_horizontal_f32(const_image_2d<float> in_img, image_2d<float4, true> out_img,
+											   buffer<float4> scratch, param<float4> coeffs) {
+	image_blur_iir<0>(in_img, out_img, scratch, coeffs);
+}
+kernel_1d() void image_blur_iir_vertical_f32(const_image_2d<float> in_img, image_2d<float4, true> out_img,
+											 buffer<float4> scratch, param<float4> coeffs) {
+	image_blur_iir<1>(in_img, out_img, scratch, coeffs);
+}
+
+// summed-area table (SAT): 2D inclusive scan of the image (row scan, then column scan), after which the sum of any
+// axis-aligned box can be computed from 4 SAT values, i.e. the cost of a box filter is independent of its radius
+// NOTE: values are scaled to [0, 255]: with uint32_t accumulation, the SAT itself wraps around for large images, but since
+//       box sums are computed modulo 2^32 as well, these are exact for boxes of up to 2^32 / 255 (~16.8M) pixels;
+//       float accumulation is provided for comparison, it loses precision once SAT values exceed 2^24 (~65K white pixels)
+template <typename sat_scalar_type>
+floor_inline_always static vector_n<sat_scalar_type, 4> sat_value(const float4& color) {
+	if constexpr (is_integral_v<sat_scalar_type>) {
+		return (color * 255.0f + 0.5f).template cast<sat_scalar_type>();
+	} else {
+		return color * 255.0f;
+	}
+}
+
+// row scan: one work-group per row, scanning SAT_ROW_SCAN_SIZE pixels per step (double-buffered Hillis/Steele scan in
+// local memory) and carrying the row sum over to the next step
+template <typename sat_scalar_type>
+floor_inline_always static void image_sat_rows(const_image_2d<float> in_img, buffer<vector_n<sat_scalar_type, 4>> sat) {
+	using sat_type = vector_n<sat_scalar_type, 4>;
+	const auto img_dim = in_img.dim().xy;
+	const auto row = group_id.x;
+	const auto lid = local_id.x;
+	local_buffer<sat_type, 2u * SAT_ROW_SCAN_SIZE> scan_buffer;
+	
+	sat_type carry {};
+	for (uint32_t x_offset = 0; x_offset < img_dim.x; x_offset += SAT_ROW_SCAN_SIZE) {
+		const auto x = x_offset + lid;
+		scan_buffer[lid] = (x < img_dim.x ? sat_value<sat_scalar_type>(in_img.read(int2 { int(x), int(row) })) : sat_type {});
+		local_barrier();
+		
+		uint32_t src_offset = 0u;
+#pragma clang loop unroll(full)
+		for (uint32_t offset = 1u; offset < SAT_ROW_SCAN_SIZE; offset <<= 1u) {
+			auto value = scan_buffer[src_offset + lid];
+			if (lid >= offset) {
+				value += scan_buffer[src_offset + lid - offset];
+			}
+			src_offset = SAT_ROW_SCAN_SIZE - src_offset;
+			scan_buffer[src_offset + lid] = value;
+			local_barrier();
+		}
+		
+		if (x < img_dim.x) {
+			sat[row * img_dim.x + x] = carry + scan_buffer[src_offset + lid];
+		}
+		carry += scan_buffer[src_offset + SAT_ROW_SCAN_SIZE - 1u];
+		// all reads must have completed before the next step overwrites the scan buffer
+		local_barrier();
+	}
+}
+
+// column scan (in-place): one work-item per column, i.e. neighboring work-items access neighboring memory
+template <typename sat_scalar_type>
+floor_inline_always static void image_sat_columns(buffer<vector_n<sat_scalar_type, 4>> sat, const uint2 img_dim) {
+	const auto column = global_id.x;
+	if (column >= img_dim.x) {
+		return;
+	}
+	vector_n<sat_scalar_type, 4> sum {};
+	for (uint32_t y = 0, idx = column; y < img_dim.y; ++y, idx += img_dim.x) {
+		sum += sat[idx];
+		sat[idx] = sum;
+	}
+}
+
+// (2 * radius + 1)^2 box filter on top of the SAT
+// NOTE: the box is clipped to the image and the average is taken over the clipped area (-> no clamp-to-edge weighting)
+template <typename sat_scalar_type>
+floor_inline_always static void image_box_sat(buffer<const vector_n<sat_scalar_type, 4>> sat, image_2d<float4, true> out_img,
+											  const uint32_t radius) {
+	using sat_type = vector_n<sat_scalar_type, 4>;
+	const auto img_dim = out_img.dim().xy;
+	const int2 img_coord { global_id.xy };
+	
+	// exclusive lower and inclusive upper corner, -1 == outside of the SAT (-> 0)
+	const int2 box_min {
+		math::max(img_coord.x - int(radius) - 1, -1),
+		math::max(img_coord.y - int(radius) - 1, -1),
+	};
+	const int2 box_max {
+		math::min(img_coord.x + int(radius), int(img_dim.x) - 1),
+		math::min(img_coord.y + int(radius), int(img_dim.y) - 1),
+	};
+	const auto sat_read = [&sat, &img_dim](const int x, const int y) {
+		return (x < 0 || y < 0 ? sat_type {} : sat[uint32_t(y) * img_dim.x + uint32_t(x)]);
+	};
+	const sat_type sum = (sat_read(box_max.x, box_max.y) - sat_read(box_min.x, box_max.y) -
+						  sat_read(box_max.x, box_min.y) + sat_read(box_min.x, box_min.y));
+	const auto area = float((box_max.x - box_min.x) * (box_max.y - box_min.y));
+	out_img.write(img_coord, sum.template cast<float>() * (1.0f / (area * 255.0f)));
+}
+
+kernel_1d(SAT_ROW_SCAN_SIZE) void image_sat_rows_u32(const_image_2d<float> in_img, buffer<uint4> sat) {
+	image_sat_rows<uint32_t>(in_img, sat);
+}
+kernel_1d(SAT_ROW_SCAN_SIZE) void image_sat_rows_f32(const_image_2d<float> in_img, buffer<float4> sat) {
+	image_sat_rows<float>(in_img, sat);
+}
+
+kernel_1d() void image_sat_columns_u32(buffer<uint4> sat, param<uint2> img_dim) {
+	image_sat_columns<uint32_t>(sat, img_dim);
+}
+kernel_1d() void image_sat_columns_f32(buffer<float4> sat, param<uint2> img_dim) {
+	image_sat_columns<float>(sat, img_dim);
+}
+
+kernel_2d() void image_box_sat_u32(buffer<const uint4> sat, image_2d<float4, true> out_img, param<uint32_t> radius) {
+	image_box_sat<uint32_t>(sat, out_img, radius);
+}
+kernel_2d() void image_box_sat_f32(buffer<const float4> sat, image_2d<float4, true> out_img, param<uint32_t> radius) {
+	image_box_sat<float>(sat, out_img, radius);
+}
+
+// image pyramid: each work-group reduces a PYRAMID_TILE_SIZE^2 input tile (+ halo) through "level_count" successive
+// 2x downsampling steps in local memory and writes each level, i.e. up to PYRAMID_LEVELS_PER_DISPATCH levels per dispatch
+//  * box: 2x2 box filter (mipmaps, no halo)
+//  * binomial: separable [1 3 3 1] / 8 filter (gaussian pyramid), level N needs a halo of 2 * halo(N) + 1 px at level N - 1
+// NOTE: levels are stored as packed 8-bit values in local memory (-> same values as in the level images, i.e. the result
+//       is the same as with one dispatch per level), reads are clamped-to-edge at each level like separate dispatches would
+template <bool binomial>
+static constexpr uint32_t pyramid_halo(const uint32_t level, const uint32_t level_count) {
+	// the last level of a dispatch doesn't need a halo
+	uint32_t halo = 0u;
+	for (uint32_t i = level_count; i > level; --i) {
+		halo = 2u * halo + (binomial ? 1u : 0u);
+	}
+	return halo;
+}
+
+// computes "level" from the "src_region" of level - 1 (+ stores it in "dst_region" if another level follows),
+// returns the image size of "level"
+template <uint32_t level, uint32_t level_count, bool binomial, typename src_region_type, typename dst_region_type>
+floor_inline_always static uint2 image_pyramid_level(const src_region_type& src_region, dst_region_type& dst_region,
+													 image_2d<float4, true> out_img, const uint2 tile_idx, const uint2 src_dim) {
+	static constexpr const auto src_halo = int(pyramid_halo<binomial>(level - 1u, level_count));
+	static constexpr const auto src_region_dim = int(PYRAMID_TILE_SIZE >> (level - 1u)) + 2 * src_halo;
+	static constexpr const auto halo = int(pyramid_halo<binomial>(level, level_count));
+	static constexpr const auto inner_dim = int(PYRAMID_TILE_SIZE >> level);
+	static constexpr const auto region_dim = inner_dim + 2 * halo;
+	
+	const uint2 dim { math::max(src_dim.x / 2u, 1u), math::max(src_dim.y / 2u, 1u) };
+	const auto src_origin = (tile_idx * uint32_t(PYRAMID_TILE_SIZE >> (level - 1u))).template cast<int>() - src_halo;
+	const auto origin = (tile_idx * uint32_t(inner_dim)).template cast<int>() - halo;
+	
+	// clamped-to-edge at the source level, then clamped to the source region (-> only affects values outside of the image)
+	const auto src_read = [&src_region, &src_dim, &src_origin](const int x, const int y) {
+		const auto region_x = math::clamp(math::clamp(x, 0, int(src_dim.x) - 1) - src_origin.x, 0, src_region_dim - 1);
+		const auto region_y = math::clamp(math::clamp(y, 0, int(src_dim.y) - 1) - src_origin.y, 0, src_region_dim - 1);
+		return src_region[uint32_t(region_y * src_region_dim + region_x)].template cast<float>();
+	};
+	
+	for (uint32_t idx = local_id.x; idx < uint32_t(region_dim * region_dim); idx += local_size.x) {
+		const int2 region_coord { int(idx % uint32_t(region_dim)), int(idx / uint32_t(region_dim)) };
+		const int2 coord { region_coord.x + origin.x, region_coord.y + origin.y };
+		
+		// NOTE: values are in [0, 255] here
+		float4 color;
+		if constexpr (binomial) {
+			constexpr const float weights[4] { 1.0f / 8.0f, 3.0f / 8.0f, 3.0f / 8.0f, 1.0f / 8.0f };
+#pragma clang loop unroll(full)
+			for (int ty = 0; ty < 4; ++ty) {
+				float4 row_color;
+#pragma clang loop unroll(full)
+				for (int tx = 0; tx < 4; ++tx) {
+					row_color += weights[tx] * src_read(2 * coord.x - 1 + tx, 2 * coord.y - 1 + ty);
+				}
+				color += weights[ty] * row_color;
+			}
+		} else {
+			color = (src_read(2 * coord.x, 2 * coord.y) + src_read(2 * coord.x + 1, 2 * coord.y) +
+					 src_read(2 * coord.x, 2 * coord.y + 1) + src_read(2 * coord.x + 1, 2 * coord.y + 1)) * 0.25f;
+		}
+		
+		if constexpr (level < level_count) {
+			dst_region[idx] = pack_sample(color);
+		}
+		// write out the inner tile (if it's inside the image)
+		if (region_coord.x >= halo && region_coord.x < halo + inner_dim &&
+			region_coord.y >= halo && region_coord.y < halo + inner_dim &&
+			coord.x < int(dim.x) && coord.y < int(dim.y)) {
+			out_img.write(coord, color * (1.0f / 255.0f));
+		}
+	}
+	if constexpr (level < level_count) {
+		local_barrier();
+	}
+	return dim;
+}
+
+template <uint32_t level_count, bool binomial>
+floor_inline_always static void image_pyramid_down(const_image_2d<float> in_img,
+												   image_2d<float4, true> out_img_1,
+												   image_2d<float4, true> out_img_2,
+												   image_2d<float4, true> out_img_3) {
+	static_assert(level_count >= 1u && level_count <= PYRAMID_LEVELS_PER_DISPATCH);
+	static constexpr const auto region_dim_0 = PYRAMID_TILE_SIZE + 2u * pyramid_halo<binomial>(0u, level_count);
+	static constexpr const auto region_dim_1 = (PYRAMID_TILE_SIZE >> 1u) + 2u * pyramid_halo<binomial>(1u, level_count);
+	// levels 0 and 2 / level 1 (level 2 always fits into the level 0 region)
+	local_buffer<uchar4, region_dim_0 * region_dim_0> region_even;
+	local_buffer<uchar4, (level_count > 1u ? region_dim_1 * region_dim_1 : 1u)> region_odd;
+	
+	const auto in_dim = in_img.dim().xy;
+	const auto tile_count_x = (in_dim.x + PYRAMID_TILE_SIZE - 1u) / PYRAMID_TILE_SIZE;
+	const uint2 tile_idx { group_id.x % tile_count_x, group_id.x / tile_count_x };
+	
+	// load the level 0 tile + halo (clamped-to-edge)
+	const auto origin = (tile_idx * PYRAMID_TILE_SIZE).cast<int>() - int(pyramid_halo<binomial>(0u, level_count));
+	for (uint32_t idx = local_id.x; idx < region_dim_0 * region_dim_0; idx += local_size.x) {
+		region_even[idx] = pack_sample(in_img.read(int2 {
+			math::clamp(int(idx % region_dim_0) + origin.x, 0, int(in_dim.x) - 1),
+			math::clamp(int(idx / region_dim_0) + origin.y, 0, int(in_dim.y) - 1)
+		}) * 255.0f);
+	}
+	local_barrier();
+	
+	const auto dim_1 = image_pyramid_level<1u, level_count, binomial>(region_even, region_odd, out_img_1, tile_idx, in_dim);
+	if constexpr (level_count >= 2u) {
+		const auto dim_2 = image_pyramid_level<2u, level_count, binomial>(region_odd, region_even, out_img_2, tile_idx, dim_1);
+		if constexpr (level_count >= 3u) {
+			image_pyramid_level<3u, level_count, binomial>(region_even, region_odd, out_img_3, tile_idx, dim_2);
+		}
+	}
+}
+
+kernel_1d(PYRAMID_LOCAL_SIZE) void image_pyramid_box_1(const_image_2d<float> in_img, image_2d<float4, true> out_img_1) {
+	image_pyramid_down<1u, false>(in_img, out_img_1, out_img_1, out_img_1);
+}
+kernel_1d(PYRAMID_LOCAL_SIZE) void image_pyramid_box_2(const_image_2d<float> in_img, image_2d<float4, true> out_img_1,
+													   image_2d<float4, true> out_img_2) {
+	image_pyramid_down<2u, false>(in_img, out_img_1, out_img_2, out_img_2);
+}
+kernel_1d(PYRAMID_LOCAL_SIZE) void image_pyramid_box_3(const_image_2d<float> in_img, image_2d<float4, true> out_img_1,
+													   image_2d<float4, true> out_img_2, image_2d<float4, true> out_img_3) {
+	image_pyramid_down<3u, false>(in_img, out_img_1, out_img_2, out_img_3);
+}
+
+kernel_1d(PYRAMID_LOCAL_SIZE) void image_pyramid_binomial_1(const_image_2d<float> in_img, image_2d<float4, true> out_img_1) {
+	image_pyramid_down<1u, true>(in_img, out_img_1, out_img_1, out_img_1);
+}
+kernel_1d(PYRAMID_LOCAL_SIZE) void image_pyramid_binomial_2(const_image_2d<float> in_img, image_2d<float4, true> out_img_1,
+															image_2d<float4, true> out_img_2) {
+	image_pyramid_down<2u, true>(in_img, out_img_1, out_img_2, out_img_2);
+}
+kernel_1d(PYRAMID_LOCAL_SIZE) void image_pyramid_binomial_3(const_image_2d<float> in_img, image_2d<float4, true> out_img_1,
+															image_2d<float4, true> out_img_2, image_2d<float4, true> out_img_3) {
+	image_pyramid_down<3u, true>(in_img, out_img_1, out_img_2, out_img_3);
+}
+
+// bilinear 2x upsampling of the coarser pyramid level (clamped-to-edge)
+floor_inline_always static float4 pyramid_upsample(const_image_2d<float> coarse_img, const int2 coord) {
+	const auto coarse_dim = coarse_img.dim().xy;
+	// pixel center in the coarse level: (coord + 0.5) / 2 - 0.5
+	const float2 pos { float(coord.x) * 0.5f - 0.25f, float(coord.y) * 0.5f - 0.25f };
+	const int2 pos_0 { int(math::floor(pos.x)), int(math::floor(pos.y)) };
+	const float2 frac { pos.x - float(pos_0.x), pos.y - float(pos_0.y) };
+	const auto read = [&coarse_img, &coarse_dim](const int x, const int y) {
+		return coarse_img.read(int2 { math::clamp(x, 0, int(coarse_dim.x) - 1), math::clamp(y, 0, int(coarse_dim.y) - 1) });
+	};
+	const auto top = read(pos_0.x, pos_0.y) * (1.0f - frac.x) + read(pos_0.x + 1, pos_0.y) * frac.x;
+	const auto bottom = read(pos_0.x, pos_0.y + 1) * (1.0f - frac.x) + read(pos_0.x + 1, pos_0.y + 1) * frac.x;
+	return top * (1.0f - frac.y) + bottom * frac.y;
+}
+
+// laplacian pyramid level: fine - upsample(coarse)
+// NOTE: the output must be a signed (float) image
+kernel_2d() void image_pyramid_laplacian(const_image_2d<float> fine_img, const_image_2d<float> coarse_img,
+										 image_2d<float4, true> out_img) {
+	const int2 coord { global_id.xy };
+	const auto dim = out_img.dim().xy;
+	if (coord.x >= int(dim.x) || coord.y >= int(dim.y)) {
+		return;
+	}
+	out_img.write(coord, fine_img.read(coord) - pyramid_upsample(coarse_img, coord));
+}
+
+// inverse of image_pyramid_laplacian: laplacian + upsample(coarse)
+kernel_2d() void image_pyramid_collapse(const_image_2d<float> laplacian_img, const_image_2d<float> coarse_img,
+										image_2d<float4, true> out_img) {
+	const int2 coord { global_id.xy };
+	const auto dim = out_img.dim().xy;
+	if (coord.x >= int(dim.x) || coord.y >= int(dim.y)) {
+		return;
+	}
+	out_img.write(coord, laplacian_img.read(coord) + pyramid_upsample(coarse_img, coord));
+}
+
+// edge-preserving filters: the brute-force bilateral and the guided filter use the same local memory tile cache as
+// image_blur_single_stage (EDGE_FILTER_TILE_SIZE^2 output pixels per work-group, the input tile + halo is read once),
+// but with a runtime radius <= EDGE_FILTER_MAX_RADIUS and bounds-checked writes (-> no image size restrictions)
+static constexpr const uint32_t edge_filter_max_region_dim { EDGE_FILTER_TILE_SIZE + 2u * EDGE_FILTER_MAX_RADIUS };
+static constexpr const uint32_t edge_filter_max_region_count { edge_filter_max_region_dim * edge_filter_max_region_dim };
+
+// returns the image coordinate of the top left inner tile pixel of this work-group
+floor_inline_always static uint2 edge_filter_tile_origin(const uint2 img_dim) {
+	const auto tile_count_x = (img_dim.x + EDGE_FILTER_TILE_SIZE - 1u) / EDGE_FILTER_TILE_SIZE;
+	return {
+		(group_id.x % tile_count_x) * EDGE_FILTER_TILE_SIZE,
+		(group_id.x / tile_count_x) * EDGE_FILTER_TILE_SIZE,
+	};
+}
+
+// reads the tile + "radius" px halo of "img" (clamped-to-edge) into "region" (row stride: EDGE_FILTER_TILE_SIZE + 2 * radius),
+// "convert" converts each read color to the region sample type
+template <typename region_type, typename convert_func_type>
+floor_inline_always static void edge_filter_load_region(const_image_2d<float> img, region_type& region, const uint2 tile_origin,
+														const uint32_t radius, convert_func_type&& convert) {
+	const auto img_dim = img.dim().xy;
+	const auto region_dim = EDGE_FILTER_TILE_SIZE + 2u * radius;
+	const auto origin = tile_origin.cast<int>() - int(radius);
+	for (uint32_t idx = local_id.x; idx < region_dim * region_dim; idx += local_size.x) {
+		region[idx] = convert(img.read(int2 {
+			math::clamp(int(idx % region_dim) + origin.x, 0, int(img_dim.x) - 1),
+			math::clamp(int(idx / region_dim) + origin.y, 0, int(img_dim.y) - 1)
+		}));
+	}
+	local_barrier();
+}
+
+// computes the (2 * radius + 1)^2 box sums around the inner tile pixel "lid" of two values per region sample,
+// which are returned by "values(region_idx, value_0, value_1)":
+// vertical pass over the whole region width first (stored in local memory), then horizontal pass over the inner tile
+// NOTE: the cost per pixel is O(radius), not O(radius^2)
+template <typename values_func_type>
+floor_inline_always static void edge_filter_box_sums(const uint32_t radius, const uint2 lid, values_func_type&& values,
+													 float4& sum_0, float4& sum_1) {
+	static constexpr const auto vertical_sum_count = EDGE_FILTER_TILE_SIZE * edge_filter_max_region_dim;
+	local_buffer<float4, vertical_sum_count> vertical_sums_0;
+	local_buffer<float4, vertical_sum_count> vertical_sums_1;
+	const auto region_dim = EDGE_FILTER_TILE_SIZE + 2u * radius;
+	const auto box_dim = 2u * radius + 1u;
+	
+	// idx: inner tile row "idx / region_dim", region column "idx % region_dim" -> region rows [row, row + box_dim)
+	for (uint32_t idx = local_id.x; idx < EDGE_FILTER_TILE_SIZE * region_dim; idx += local_size.x) {
+		float4 v_sum_0, v_sum_1;
+		auto region_idx = idx;
+		for (uint32_t i = 0; i < box_dim; ++i, region_idx += region_dim) {
+			float4 value_0, value_1;
+			values(region_idx, value_0, value_1);
+			v_sum_0 += value_0;
+			v_sum_1 += value_1;
+		}
+		vertical_sums_0[idx] = v_sum_0;
+		vertical_sums_1[idx] = v_sum_1;
+	}
+	local_barrier();
+	
+	sum_0 = {};
+	sum_1 = {};
+	auto sample_idx = lid.y * region_dim + lid.x;
+	for (uint32_t i = 0; i < box_dim; ++i, ++sample_idx) {
+		sum_0 += vertical_sums_0[sample_idx];
+		sum_1 += vertical_sums_1[sample_idx];
+	}
+}
+
+// brute-force bilateral filter: (2 * radius + 1)^2 taps, weight = spatial gaussian * range gaussian (RGB distance)
+// inv_sigmas: { 1 / (2 * spatial sigma^2), 1 / (2 * range sigma^2) }, range sigma is relative to [0, 1] colors
+kernel_1d(EDGE_FILTER_TILE_SIZE * EDGE_FILTER_TILE_SIZE)
+void image_bilateral(const_image_2d<float> in_img, image_2d<float4, true> out_img,
+					 param<uint32_t> radius_, param<float2> inv_sigmas_) {
+	const auto radius = math::min(uint32_t(radius_), EDGE_FILTER_MAX_RADIUS);
+	const float2 inv_sigmas = inv_sigmas_;
+	// samples are in [0, 255] -> scale the range term accordingly
+	const auto inv_range = inv_sigmas.y * (1.0f / (255.0f * 255.0f));
+	const auto img_dim = in_img.dim().xy;
+	const auto tile_origin = edge_filter_tile_origin(img_dim);
+	const uint2 lid { local_id.x % EDGE_FILTER_TILE_SIZE, local_id.x / EDGE_FILTER_TILE_SIZE };
+	
+	local_buffer<uchar4, edge_filter_max_region_count> samples;
+	edge_filter_load_region(in_img, samples, tile_origin, radius, [](const float4& color) {
+		return pack_sample(color * 255.0f);
+	});
+	
+	const auto region_dim = EDGE_FILTER_TILE_SIZE + 2u * radius;
+	const auto center = samples[(lid.y + radius) * region_dim + lid.x + radius].cast<float>();
+	float4 color_sum;
+	float weight_sum = 0.0f;
+	for (int y = -int(radius); y <= int(radius); ++y) {
+		auto sample_idx = (lid.y + uint32_t(y + int(radius))) * region_dim + lid.x;
+		for (int x = -int(radius); x <= int(radius); ++x, ++sample_idx) {
+			const auto sample = samples[sample_idx].cast<float>();
+			const auto diff = sample - center;
+			const auto weight = math::exp(-float(x * x + y * y) * inv_sigmas.x -
+										  (diff.x * diff.x + diff.y * diff.y + diff.z * diff.z) * inv_range);
+			color_sum += weight * sample;
+			weight_sum += weight;
+		}
+	}
+	
+	const auto img_coord = tile_origin + lid;
+	if (img_coord.x < img_dim.x && img_coord.y < img_dim.y) {
+		// NOTE: the center weight is 1 -> weight_sum >= 1
+		out_img.write(img_coord, color_sum * (1.0f / (255.0f * weight_sum)));
+	}
+}
+
+// bilateral grid (Chen et al., "Real-time Edge-Aware Image Processing with the Bilateral Grid", 2007): for large spatial
+// sigmas, the image is splatted into a coarse 3D grid (x/y: cells of cell_size^2 px, z: luminance bins), blurred with a
+// [1 2 1] filter in all 3 dimensions and then sliced at each pixel (x, y, luminance) by trilinear interpolation
+// grid_dim: { cells x, cells y, bins (depth), cell size }, grid entries: { sum of weight * rgb, sum of weights },
+// stored at ((y * cells x) + x) * depth + z
+floor_inline_always static float bilateral_grid_luminance(const float4& color) {
+	return color.x * 0.2126f + color.y * 0.7152f + color.z * 0.0722f;
+}
+
+// splat: one work-group per cell, the cell pixels are read into local memory once, after which each work-item accumulates
+// one bin over a subset of the pixels (-> no atomics), the partial sums of all subsets are then reduced in local memory
+kernel_1d(BILATERAL_GRID_MAX_DEPTH * BILATERAL_GRID_MAX_DEPTH)
+void image_bilateral_grid_splat(const_image_2d<float> in_img, buffer<float4> grid, param<uint4> grid_dim_) {
+	static constexpr const uint32_t subset_count { BILATERAL_GRID_MAX_DEPTH };
+	const uint4 grid_dim = grid_dim_;
+	const auto depth = grid_dim.z;
+	const auto cell_size = grid_dim.w;
+	const auto img_dim = in_img.dim().xy;
+	const uint2 cell { group_id.x % grid_dim.x, group_id.x / grid_dim.x };
+	// the last cells in x/y may only be partially inside the image
+	const uint2 cell_dim {
+		math::min(cell_size, img_dim.x - cell.x * cell_size),
+		math::min(cell_size, img_dim.y - cell.y * cell_size),
+	};
+	const auto cell_pixel_count = cell_dim.x * cell_dim.y;
+	
+	local_buffer<uchar4, BILATERAL_GRID_MAX_CELL_SIZE * BILATERAL_GRID_MAX_CELL_SIZE> pixels;
+	for (uint32_t idx = local_id.x; idx < cell_pixel_count; idx += local_size.x) {
+		pixels[idx] = pack_sample(in_img.read(uint2 {
+			cell.x * cell_size + idx % cell_dim.x,
+			cell.y * cell_size + idx / cell_dim.x
+		}) * 255.0f);
+	}
+	local_barrier();
+	
+	const auto bin = local_id.x % BILATERAL_GRID_MAX_DEPTH;
+	float4 sum;
+	if (bin < depth) {
+		const auto max_bin = float(depth - 1u);
+		for (uint32_t idx = local_id.x / BILATERAL_GRID_MAX_DEPTH; idx < cell_pixel_count; idx += subset_count) {
+			const auto color = pixels[idx].cast<float>() * (1.0f / 255.0f);
+			// linear interpolation weight of this bin (-> each pixel contributes to the 2 nearest bins)
+			const auto weight = math::max(1.0f - math::abs(bilateral_grid_luminance(color) * max_bin - float(bin)), 0.0f);
+			sum += weight * float4 { color.x, color.y, color.z, 1.0f };
+		}
+	}
+	
+	local_buffer<float4, BILATERAL_GRID_MAX_DEPTH * subset_count> partial_sums;
+	partial_sums[local_id.x] = sum;
+	local_barrier();
+	
+	if (local_id.x < depth) {
+		float4 bin_sum;
+		for (uint32_t subset = 0; subset < subset_count; ++subset) {
+			bin_sum += partial_sums[subset * BILATERAL_GRID_MAX_DEPTH + local_id.x];
+		}
+		grid[(cell.y * grid_dim.x + cell.x) * depth + local_id.x] = bin_sum;
+	}
+}
+
+// [1 2 1] / 4 blur in x, y and z (clamped-to-edge), one work-item per grid entry
+kernel_1d() void image_bilateral_grid_blur(buffer<const float4> in_grid, buffer<float4> out_grid, param<uint4> grid_dim_) {
+	const uint4 grid_dim = grid_dim_;
+	const auto depth = grid_dim.z;
+	if (global_id.x >= grid_dim.x * grid_dim.y * depth) {
+		return;
+	}
+	const int z = int(global_id.x % depth);
+	const int x = int((global_id.x / depth) % grid_dim.x);
+	const int y = int((global_id.x / depth) / grid_dim.x);
+	
+	constexpr const float weights[3] { 0.25f, 0.5f, 0.25f };
+	float4 sum;
+#pragma clang loop unroll(full)
+	for (int oy = -1; oy <= 1; ++oy) {
+		const auto cy = uint32_t(math::clamp(y + oy, 0, int(grid_dim.y) - 1));
+#pragma clang loop unroll(full)
+		for (int ox = -1; ox <= 1; ++ox) {
+			const auto cx = uint32_t(math::clamp(x + ox, 0, int(grid_dim.x) - 1));
+			const auto cell_offset = (cy * grid_dim.x + cx) * depth;
+#pragma clang loop unroll(full)
+			for (int oz = -1; oz <= 1; ++oz) {
+				const auto cz = uint32_t(math::clamp(z + oz, 0, int(depth) - 1));
+				sum += (weights[oy + 1] * weights[ox + 1] * weights[oz + 1]) * in_grid[cell_offset + cz];
+			}
+		}
+	}
+	out_grid[global_id.x] = sum;
+}
+
+// slice: trilinear interpolation of the grid at (x, y, luminance) of each pixel (cell centers are at (cell + 0.5) * cell_size)
+kernel_2d() void image_bilateral_grid_slice(const_image_2d<float> in_img, buffer<const float4> grid, image_2d<float4, true> out_img,
+											param<uint4> grid_dim_) {
+	const uint4 grid_dim = grid_dim_;
+	const auto depth = grid_dim.z;
+	const auto img_dim = out_img.dim().xy;
+	const int2 coord { global_id.xy };
+	if (coord.x >= int(img_dim.x) || coord.y >= int(img_dim.y)) {
+		return;
+	}
+	
+	const auto color = in_img.read(coord);
+	const auto inv_cell_size = 1.0f / float(grid_dim.w);
+	const float grid_coord[3] {
+		math::clamp((float(coord.x) + 0.5f) * inv_cell_size - 0.5f, 0.0f, float(grid_dim.x - 1u)),
+		math::clamp((float(coord.y) + 0.5f) * inv_cell_size - 0.5f, 0.0f, float(grid_dim.y - 1u)),
+		math::clamp(bilateral_grid_luminance(color), 0.0f, 1.0f) * float(depth - 1u),
+	};
+	const uint32_t grid_max[3] { grid_dim.x - 1u, grid_dim.y - 1u, depth - 1u };
+	uint32_t lo[3], hi[3];
+	float frac[3];
+#pragma clang loop unroll(full)
+	for (uint32_t i = 0; i < 3; ++i) {
+		lo[i] = uint32_t(math::floor(grid_coord[i]));
+		hi[i] = math::min(lo[i] + 1u, grid_max[i]);
+		frac[i] = grid_coord[i] - float(lo[i]);
+	}
+	
+	const auto grid_read = [&grid, &grid_dim, &depth](const uint32_t x, const uint32_t y, const uint32_t z) {
+		return grid[(y * grid_dim.x + x) * depth + z];
+	};
+	const auto lerp = [](const float4& a, const float4& b, const float t) {
+		return a + (b - a) * t;
+	};
+	const auto value = lerp(lerp(lerp(grid_read(lo[0], lo[1], lo[2]), grid_read(hi[0], lo[1], lo[2]), frac[0]),
+								 lerp(grid_read(lo[0], hi[1], lo[2]), grid_read(hi[0], hi[1], lo[2]), frac[0]), frac[1]),
+							lerp(lerp(grid_read(lo[0], lo[1], hi[2]), grid_read(hi[0], lo[1], hi[2]), frac[0]),
+								 lerp(grid_read(lo[0], hi[1], hi[2]), grid_read(hi[0], hi[1], hi[2]), frac[0]), frac[1]),
+							frac[2]);
+	// keep the original color if nothing (or almost nothing) was splatted nearby in this luminance range
+	if (value.w > 1.0e-4f) {
+		out_img.write(coord, float4 { value.x / value.w, value.y / value.w, value.z / value.w, color.w });
+	} else {
+		out_img.write(coord, color);
+	}
+}
+
+// guided filter (He et al., "Guided Image Filtering", 2010) with the image as its own guide (per channel), using box means
+// of (2 * radius + 1)^2 px and the regularization "eps" (relative to [0, 1] colors):
+//  * pass 1: a = var(I) / (var(I) + eps), b = mean(I) - a * mean(I) (-> stored in float images)
+//  * pass 2: output = mean(a) * I + mean(b)
+kernel_1d(EDGE_FILTER_TILE_SIZE * EDGE_FILTER_TILE_SIZE)
+void image_guided_coefficients(const_image_2d<float> in_img,
+							   image_2d<float4, true> a_img, image_2d<float4, true> b_img,
+							   param<uint32_t> radius_, param<float> eps) {
+	const auto radius = math::min(uint32_t(radius_), EDGE_FILTER_MAX_RADIUS);
+	const auto img_dim = in_img.dim().xy;
+	const auto tile_origin = edge_filter_tile_origin(img_dim);
+	const uint2 lid { local_id.x % EDGE_FILTER_TILE_SIZE, local_id.x / EDGE_FILTER_TILE_SIZE };
+	
+	local_buffer<uchar4, edge_filter_max_region_count> samples;
+	edge_filter_load_region(in_img, samples, tile_origin, radius, [](const float4& color) {
+		return pack_sample(color * 255.0f);
+	});
+	
+	float4 sum, sum_sq;
+	edge_filter_box_sums(radius, lid, [&samples](const uint32_t region_idx, float4& value, float4& value_sq) {
+		value = samples[region_idx].cast<float>() * (1.0f / 255.0f);
+		value_sq = value * value;
+	}, sum, sum_sq);
+	
+	const auto inv_count = 1.0f / float((2u * radius + 1u) * (2u * radius + 1u));
+	const auto mean = sum * inv_count;
+	const auto variance = (sum_sq * inv_count - mean * mean).maxed(0.0f);
+	const auto a = variance / (variance + float(eps));
+	const auto b = mean - a * mean;
+	
+	const auto img_coord = tile_origin + lid;
+	if (img_coord.x < img_dim.x && img_coord.y < img_dim.y) {
+		a_img.write(img_coord, a);
+		b_img.write(img_coord, b);
+	}
+}
+
+kernel_1d(EDGE_FILTER_TILE_SIZE * EDGE_FILTER_TILE_SIZE)
+void image_guided_output(const_image_2d<float> in_img,
+						 const_image_2d<float> a_img, const_image_2d<float> b_img,
+						 image_2d<float4, true> out_img, param<uint32_t> radius_) {
+	const auto radius = math::min(uint32_t(radius_), EDGE_FILTER_MAX_RADIUS);
+	const auto img_dim = in_img.dim().xy;
+	const auto tile_origin = edge_filter_tile_origin(img_dim);
+	const uint2 lid { local_id.x % EDGE_FILTER_TILE_SIZE, local_id.x / EDGE_FILTER_TILE_SIZE };
+	
+	// a and b are in [0, 1] -> half precision is sufficient here and halves the local memory footprint
+	local_buffer<half4, edge_filter_max_region_count> a_samples;
+	local_buffer<half4, edge_filter_max_region_count> b_samples;
+	const auto to_half = [](const float4& value) {
+		return value.cast<half>();
+	};
+	edge_filter_load_region(a_img, a_samples, tile_origin, radius, to_half);
+	edge_filter_load_region(b_img, b_samples, tile_origin, radius, to_half);
+	
+	float4 a_sum, b_sum;
+	edge_filter_box_sums(radius, lid, [&a_samples, &b_samples](const uint32_t region_idx, float4& a, float4& b) {
+		a = a_samples[region_idx].cast<float>();
+		b = b_samples[region_idx].cast<float>();
+	}, a_sum, b_sum);
+	
+	const auto img_coord = tile_origin + lid;
+	if (img_coord.x < img_dim.x && img_coord.y < img_dim.y) {
+		const auto inv_count = 1.0f / float((2u * radius + 1u) * (2u * radius + 1u));
+		out_img.write(img_coord, (a_sum * in_img.read(img_coord) + b_sum) * inv_count);
+	}
+}
+
+// fused filter graph kernel: runs a group of up to FUSED_FILTER_MAX_STAGES filter stages on a tile of
+// FUSED_FILTER_TILE_SIZE^2 output pixels, so that intermediate results never leave the chip:
+//  * the input tile + halo (sum of all stencil radii) is read once
+//  * point-wise stages are directly applied to the values held in registers
+//  * stencil stages exchange values through local memory (same scheme as the vertical/horizontal passes of
+//    image_blur_single_stage, but with runtime radii and weights)
+//  * a final downsample stage doubles the input tile size, i.e. each work-item averages 2x2 pixels on write-out
+// NOTE: stencils are computed across the whole local region, values in the outer part become increasingly wrong
+//       with each stencil stage, but the halo ensures that the inner tile is never affected by this
+static constexpr const uint32_t fused_tile_items { FUSED_FILTER_TILE_SIZE * FUSED_FILTER_TILE_SIZE };
+static constexpr const uint32_t fused_region_max_dim { 2u * FUSED_FILTER_TILE_SIZE + 2u * FUSED_FILTER_MAX_HALO };
+static constexpr const uint32_t fused_region_max_count { fused_region_max_dim * fused_region_max_dim };
+static constexpr const uint32_t fused_values_per_item { (fused_region_max_count + fused_tile_items - 1u) / fused_tile_items };
+
+// applies a stencil to all region values, "stencil_func" computes the new value for a local region coordinate
+template <typename region_type, typename stencil_func_type>
+floor_inline_always static void fused_stencil(float4 (&values)[fused_values_per_item], region_type& region,
+											  const uint32_t region_dim, stencil_func_type&& stencil_func) {
+	const auto region_count = region_dim * region_dim;
+	for (uint32_t k = 0, idx = local_id.x; k < fused_values_per_item; ++k, idx += fused_tile_items) {
+		if (idx < region_count) {
+			region[idx] = values[k];
+		}
+	}
+	local_barrier();
+	for (uint32_t k = 0, idx = local_id.x; k < fused_values_per_item; ++k, idx += fused_tile_items) {
+		if (idx < region_count) {
+			values[k] = stencil_func(int(idx % region_dim), int(idx / region_dim));
+		}
+	}
+	// all reads must have completed before the region is overwritten again
+	local_barrier();
+}
+
+kernel_1d(fused_tile_items) void image_filter_fused(const_image_2d<float> in_img, image_2d<float4, true> out_img,
+													buffer<const filter_stage> stages, param<uint32_t> stage_count) {
+	// the halo is the sum of all stencil radii, a final downsample stage doubles the tile size in input pixels
+	uint32_t halo = 0u;
+	bool downsample = false;
+	for (uint32_t i = 0; i < stage_count; ++i) {
+		halo += stages[i].radius;
+		downsample |= (stages[i].type == FILTER_STAGE::DOWNSAMPLE);
+	}
+	const auto inner_dim = (downsample ? 2u : 1u) * FUSED_FILTER_TILE_SIZE;
+	const auto region_dim = inner_dim + 2u * halo;
+	const auto region_count = region_dim * region_dim;
+	local_buffer<float4, fused_region_max_count> region;
+	
+	const auto in_dim = in_img.dim().xy;
+	const auto tile_count_x = out_img.dim().x / FUSED_FILTER_TILE_SIZE;
+	const uint2 tile_idx { group_id.x % tile_count_x, group_id.x / tile_count_x };
+	const auto region_offset = (tile_idx * inner_dim).cast<int>() - int(halo);
+	
+	// load tile + halo (clamped-to-edge)
+	float4 values[fused_values_per_item];
+	for (uint32_t k = 0, idx = local_id.x; k < fused_values_per_item; ++k, idx += fused_tile_items) {
+		if (idx < region_count) {
+			values[k] = in_img.read(int2 {
+				math::clamp(int(idx % region_dim) + region_offset.x, 0, int(in_dim.x) - 1),
+				math::clamp(int(idx / region_dim) + region_offset.y, 0, int(in_dim.y) - 1)
+			});
+		}
+	}
+	
+	// reads within the local region: clamped to the region (-> the outer part never reads out-of-bounds) and to the
+	// image area (-> stencils see clamped-to-edge values of the previous stage, just like separately run stages would)
+	const int2 region_min {
+		math::max(-region_offset.x, 0),
+		math::max(-region_offset.y, 0),
+	};
+	const int2 region_max {
+		math::min(int(in_dim.x) - 1 - region_offset.x, int(region_dim) - 1),
+		math::min(int(in_dim.y) - 1 - region_offset.y, int(region_dim) - 1),
+	};
+	const auto region_read = [&region, &region_dim, &region_min, &region_max](const int x, const int y) {
+		return region[uint32_t(math::clamp(y, region_min.y, region_max.y)) * region_dim +
+					  uint32_t(math::clamp(x, region_min.x, region_max.x))];
+	};
+	
+	for (uint32_t i = 0; i < stage_count; ++i) {
+		const auto& stage = stages[i];
+		switch (stage.type) {
+			case FILTER_STAGE::BLUR: {
+				const auto radius = int(stage.radius);
+				// separable: horizontal, then vertical
+				fused_stencil(values, region, region_dim, [&](const int x, const int y) {
+					float4 color = stage.weights[0] * region_read(x, y);
+					for (int t = 1; t <= radius; ++t) {
+						color += stage.weights[t] * (region_read(x - t, y) + region_read(x + t, y));
+					}
+					return color;
+				});
+				fused_stencil(values, region, region_dim, [&](const int x, const int y) {
+					float4 color = stage.weights[0] * region_read(x, y);
+					for (int t = 1; t <= radius; ++t) {
+						color += stage.weights[t] * (region_read(x, y - t) + region_read(x, y + t));
+					}
+					return color;
+				});
+				break;
+			}
+			case FILTER_STAGE::SHARPEN: {
+				// unsharp mask: color + amount * (color - blur_3x3(color))
+				const auto amount = stage.params[0];
+				fused_stencil(values, region, region_dim, [&](const int x, const int y) {
+					const auto center = region_read(x, y);
+					const float4 blurred = (4.0f * center +
+											2.0f * (region_read(x - 1, y) + region_read(x + 1, y) +
+													region_read(x, y - 1) + region_read(x, y + 1)) +
+											region_read(x - 1, y - 1) + region_read(x + 1, y - 1) +
+											region_read(x - 1, y + 1) + region_read(x + 1, y + 1)) * (1.0f / 16.0f);
+					return (center + amount * (center - blurred)).clamped(0.0f, 1.0f);
+				});
+				break;
+			}
+			case FILTER_STAGE::TONE_CURVE: {
+				// point-wise -> registers only
+				const auto exposure = stage.params[0];
+				const auto inv_gamma = stage.params[1];
+				const auto contrast = stage.params[2];
+				for (uint32_t k = 0; k < fused_values_per_item; ++k) {
+					auto& color = values[k];
+					for (uint32_t c = 0; c < 3; ++c) {
+						const auto exposed = math::pow(math::max(color[c] * exposure, 0.0f), inv_gamma);
+						color[c] = math::clamp((exposed - 0.5f) * contrast + 0.5f, 0.0f, 1.0f);
+					}
+				}
+				break;
+			}
+			case FILTER_STAGE::DOWNSAMPLE:
+				// handled on write-out
+				break;
+		}
+	}
+	
+	// write out the inner tile
+	for (uint32_t k = 0, idx = local_id.x; k < fused_values_per_item; ++k, idx += fused_tile_items) {
+		if (idx < region_count) {
+			region[idx] = values[k];
+		}
+	}
+	local_barrier();
+	
+	const uint2 lid { local_id.x % FUSED_FILTER_TILE_SIZE, local_id.x / FUSED_FILTER_TILE_SIZE };
+	float4 color;
+	if (downsample) {
+		const auto src = (lid * 2u + halo).cast<int>();
+		color = (region_read(src.x, src.y) + region_read(src.x + 1, src.y) +
+				 region_read(src.x, src.y + 1) + region_read(src.x + 1, src.y + 1)) * 0.25f;
+	} else {
+		const auto src = (lid + halo).cast<int>();
+		color = region_read(src.x, src.y);
+	}
+	out_img.write(tile_idx * FUSED_FILTER_TILE_SIZE + lid, color);
+}
+
 #endif
@@ -25,6 +25,58 @@
 #define TAP_COUNT 15
 #endif
 
+// fused filter graph kernel (see img_filter_graph.hpp):
+// output tile size (per dimension) of the fused kernel, i.e. one work-item per output pixel
+#define FUSED_FILTER_TILE_SIZE 16u
+// max #stages that can be fused into a single launch
+#define FUSED_FILTER_MAX_STAGES 4u
+// max sum of all stencil radii of the fused stages (-> halo that is loaded around each tile)
+#define FUSED_FILTER_MAX_HALO 6u
+
+// summed-area table blur (see img_sat.hpp):
+// work-group size of the SAT row scan kernels (-> amount of pixels that are scanned per step)
+#define SAT_ROW_SCAN_SIZE 256u
+
+// image pyramid (see img_pyramid.hpp):
+// max amount of pyramid levels that are generated per dispatch
+#define PYRAMID_LEVELS_PER_DISPATCH 3u
+// input tile size (per dimension) of a pyramid work-group (-> 16x16, 8x8 and 4x4 px at the following levels)
+#define PYRAMID_TILE_SIZE 32u
+// work-group size of the pyramid kernels
+#define PYRAMID_LOCAL_SIZE 256u
+
+// edge-preserving filters (see img_edge_filter.hpp):
+// output tile size (per dimension) of the brute-force bilateral and guided filter kernels, i.e. one work-item per output pixel
+#define EDGE_FILTER_TILE_SIZE 16u
+// max radius of the brute-force bilateral filter and of the guided filter box (-> max halo that is loaded around each tile)
+#define EDGE_FILTER_MAX_RADIUS 8u
+// max amount of range (luminance) bins of the bilateral grid
+#define BILATERAL_GRID_MAX_DEPTH 16u
+// max spatial cell size (per dimension) of the bilateral grid
+#define BILATERAL_GRID_MAX_CELL_SIZE 32u
+
+enum class FILTER_STAGE : uint32_t {
+	//! separable gaussian blur (stencil, radius <= FUSED_FILTER_MAX_HALO)
+	BLUR,
+	//! unsharp mask using a 3x3 binomial blur (stencil, radius 1)
+	SHARPEN,
+	//! exposure/gamma/contrast tone curve, applied to RGB (point-wise)
+	TONE_CURVE,
+	//! 2x2 box downsample (must be the last stage of a fused group)
+	DOWNSAMPLE,
+};
+
+//! a single filter stage as passed to the fused filter kernel
+struct filter_stage {
+	FILTER_STAGE type;
+	//! stencil radius (0 for point-wise stages)
+	uint32_t radius;
+	//! BLUR: unused, SHARPEN: { amount }, TONE_CURVE: { exposure, 1 / gamma, contrast }
+	float params[3];
+	//! BLUR: normalized gaussian weights for offsets 0 ... radius
+	float weights[FUSED_FILTER_MAX_HALO + 1u];
+};
+
 #if defined(FLOOR_COMPUTE)
 
 #if defined(FLOOR_COMPUTE_HOST)
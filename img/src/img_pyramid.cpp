@@ -0,0 +1,177 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "img_pyramid.hpp"
+
+img_pyramid::img_pyramid(compute_context& ctx_, compute_queue& dev_queue_) : ctx(ctx_), dev_queue(dev_queue_) {}
+
+bool img_pyramid::init(const compute_program& prog) {
+	for (uint32_t i = 0; i < PYRAMID_LEVELS_PER_DISPATCH; ++i) {
+		down_kernels[0][i] = prog.get_kernel("image_pyramid_box_" + to_string(i + 1u));
+		down_kernels[1][i] = prog.get_kernel("image_pyramid_binomial_" + to_string(i + 1u));
+		if (!down_kernels[0][i] || !down_kernels[1][i]) {
+			log_error("failed to retrieve the pyramid kernels");
+			return false;
+		}
+	}
+	laplacian_kernel = prog.get_kernel("image_pyramid_laplacian");
+	collapse_kernel = prog.get_kernel("image_pyramid_collapse");
+	if (!laplacian_kernel || !collapse_kernel) {
+		log_error("failed to retrieve the laplacian pyramid kernels");
+		return false;
+	}
+	return true;
+}
+
+uint32_t img_pyramid::max_level_count(const uint2& image_size) {
+	uint32_t level_count = 0u;
+	for (uint2 size = image_size; size.x > 1u || size.y > 1u; ++level_count) {
+		size = (size / 2u).maxed(1u);
+	}
+	return level_count;
+}
+
+uint32_t img_pyramid::dispatch_count(const uint32_t level_count, const bool multi_level) {
+	return (multi_level ? (level_count + PYRAMID_LEVELS_PER_DISPATCH - 1u) / PYRAMID_LEVELS_PER_DISPATCH : level_count);
+}
+
+uint2 img_pyramid::level_size(const uint32_t level) const {
+	uint2 size = level_0->get_image_dim().xy;
+	for (uint32_t i = 0; i < level; ++i) {
+		size = (size / 2u).maxed(1u);
+	}
+	return size;
+}
+
+bool img_pyramid::create_level_images(vector<shared_ptr<compute_image>>& imgs, const uint32_t first_level, const uint32_t count,
+									  const bool signed_storage) {
+	imgs.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		const auto size = level_size(first_level + i);
+		if (imgs[i] && (uint2 { imgs[i]->get_image_dim().xy } == size).all()) {
+			continue;
+		}
+		imgs[i] = ctx.create_image(dev_queue, size,
+								   COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::READ_WRITE |
+								   (signed_storage ? COMPUTE_IMAGE_TYPE::RGBA16F : COMPUTE_IMAGE_TYPE::RGBA8UI_NORM),
+								   COMPUTE_MEMORY_FLAG::HOST_READ);
+		if (!imgs[i]) {
+			log_error("failed to create pyramid level image (level $, size $)", first_level + i, size);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool img_pyramid::build(const shared_ptr<compute_image>& in_img, const uint32_t level_count_, const FILTER filter, const bool multi_level) {
+	const auto level_count = min(level_count_, max_level_count(in_img->get_image_dim().xy));
+	if (level_count == 0) {
+		log_error("pyramid must have at least one level below the input image");
+		return false;
+	}
+	level_0 = in_img;
+	if (!create_level_images(levels, 1u, level_count, false)) {
+		return false;
+	}
+	
+	const auto& kernels = down_kernels[filter == FILTER::BINOMIAL ? 1 : 0];
+	const auto max_levels_per_dispatch = (multi_level ? PYRAMID_LEVELS_PER_DISPATCH : 1u);
+	for (uint32_t level = 0; level < level_count; level += max_levels_per_dispatch) {
+		// dispatch input: level 0 or the last level of the previous dispatch
+		const auto& src_img = (level == 0 ? in_img : levels[level - 1u]);
+		const auto levels_per_dispatch = min(max_levels_per_dispatch, level_count - level);
+		const auto src_size = level_size(level);
+		const auto group_count = ((src_size.x + PYRAMID_TILE_SIZE - 1u) / PYRAMID_TILE_SIZE) * ((src_size.y + PYRAMID_TILE_SIZE - 1u) / PYRAMID_TILE_SIZE);
+		
+		compute_queue::execution_parameters_t exec_params {
+			.execution_dim = 1u,
+			.global_work_size = { group_count * PYRAMID_LOCAL_SIZE, 0u, 0u },
+			.local_work_size = { PYRAMID_LOCAL_SIZE, 0u, 0u },
+			.args = {},
+			.wait_until_completion = true,
+			.debug_label = "pyramid_down",
+		};
+		switch (levels_per_dispatch) {
+			case 1:
+				exec_params.args = { src_img, levels[level] };
+				break;
+			case 2:
+				exec_params.args = { src_img, levels[level], levels[level + 1u] };
+				break;
+			default:
+				exec_params.args = { src_img, levels[level], levels[level + 1u], levels[level + 2u] };
+				break;
+		}
+		dev_queue.execute_with_parameters(*kernels[levels_per_dispatch - 1u], exec_params);
+	}
+	return true;
+}
+
+bool img_pyramid::build_laplacian() {
+	if (!level_0 || levels.empty()) {
+		log_error("no gaussian pyramid has been built yet");
+		return false;
+	}
+	const auto level_count = uint32_t(levels.size());
+	if (!create_level_images(laplacian_levels, 0u, level_count, true)) {
+		return false;
+	}
+	
+	for (uint32_t level = 0; level < level_count; ++level) {
+		dev_queue.execute_with_parameters(*laplacian_kernel, compute_queue::execution_parameters_t {
+			.execution_dim = 2u,
+			.global_work_size = ((level_size(level) + 31u) / 32u) * 32u,
+			.local_work_size = uint2 { 32, 16 },
+			.args = {
+				(level == 0 ? level_0 : levels[level - 1u]), levels[level], laplacian_levels[level]
+			},
+			.wait_until_completion = true,
+			.debug_label = "pyramid_laplacian",
+		});
+	}
+	return true;
+}
+
+bool img_pyramid::collapse(const shared_ptr<compute_image>& out_img) {
+	if (laplacian_levels.empty() || laplacian_levels.size() != levels.size()) {
+		log_error("no laplacian pyramid has been built yet");
+		return false;
+	}
+	const auto level_count = uint32_t(levels.size());
+	if (!create_level_images(collapse_levels, 1u, level_count - 1u, true)) {
+		return false;
+	}
+	
+	// coarse to fine, starting with the last gaussian level
+	for (uint32_t level = level_count; level > 0; --level) {
+		const auto& coarse_img = (level == level_count ? levels.back() : collapse_levels[level - 1u]);
+		const auto& dst_img = (level == 1u ? out_img : collapse_levels[level - 2u]);
+		dev_queue.execute_with_parameters(*collapse_kernel, compute_queue::execution_parameters_t {
+			.execution_dim = 2u,
+			.global_work_size = ((level_size(level - 1u) + 31u) / 32u) * 32u,
+			.local_work_size = uint2 { 32, 16 },
+			.args = {
+				laplacian_levels[level - 1u], coarse_img, dst_img
+			},
+			.wait_until_completion = true,
+			.debug_label = "pyramid_collapse",
+		});
+	}
+	return true;
+}
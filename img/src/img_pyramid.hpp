@@ -0,0 +1,99 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FLOOR_IMG_IMG_PYRAMID_HPP__
+#define __FLOOR_IMG_IMG_PYRAMID_HPP__
+
+#include <floor/floor/floor.hpp>
+#include <floor/compute/compute_kernel.hpp>
+#include "img_kernels.hpp"
+
+//! gaussian and laplacian image pyramids over compute_image:
+//!  * gaussian pyramid: level N + 1 is level N filtered and downsampled by 2 (2x2 box -> mipmaps, or [1 3 3 1] / 8 binomial),
+//!    up to PYRAMID_LEVELS_PER_DISPATCH levels are generated per dispatch, with each work-group reducing its tile through
+//!    all of these levels in local memory (-> only the level images themselves go through global memory)
+//!  * laplacian pyramid: level N = gaussian level N - upsample(gaussian level N + 1), the last level is the last gaussian level
+//!    itself, stored in RGBA16F images (signed values)
+//! NOTE: gaussian levels are RGBA8UI_NORM images, like all other images of this example, level N has a size of
+//!       max(size(N - 1) / 2, 1), level 0 is the input image
+class img_pyramid {
+public:
+	enum class FILTER : uint32_t {
+		//! 2x2 box filter (mipmaps)
+		BOX,
+		//! separable [1 3 3 1] / 8 filter (gaussian pyramid)
+		BINOMIAL,
+	};
+	
+	img_pyramid(compute_context& ctx, compute_queue& dev_queue);
+	
+	//! retrieves the pyramid kernels from "prog", returns false if these aren't available
+	bool init(const compute_program& prog);
+	
+	//! returns the amount of levels (excluding level 0) until the image is 1x1
+	static uint32_t max_level_count(const uint2& image_size);
+	
+	//! builds levels 1 ... "level_count" of the gaussian pyramid of "in_img", with up to PYRAMID_LEVELS_PER_DISPATCH levels per
+	//! dispatch if "multi_level" is set (one dispatch per level otherwise), blocks until all levels have been built
+	bool build(const shared_ptr<compute_image>& in_img, const uint32_t level_count, const FILTER filter, const bool multi_level);
+	
+	//! builds the laplacian pyramid from the last build() result
+	bool build_laplacian();
+	
+	//! reconstructs level 0 from the laplacian pyramid into "out_img" (-> same as the input image up to rounding)
+	bool collapse(const shared_ptr<compute_image>& out_img);
+	
+	//! returns the amount of dispatches that build() needs
+	static uint32_t dispatch_count(const uint32_t level_count, const bool multi_level);
+	
+	//! gaussian levels 1 ... level count
+	const vector<shared_ptr<compute_image>>& get_levels() const {
+		return levels;
+	}
+	
+	//! laplacian levels 0 ... level count - 1 (the last laplacian level is the last gaussian level)
+	const vector<shared_ptr<compute_image>>& get_laplacian_levels() const {
+		return laplacian_levels;
+	}
+	
+protected:
+	compute_context& ctx;
+	compute_queue& dev_queue;
+	
+	//! [filter][levels per dispatch - 1]
+	array<array<shared_ptr<compute_kernel>, PYRAMID_LEVELS_PER_DISPATCH>, 2> down_kernels;
+	shared_ptr<compute_kernel> laplacian_kernel;
+	shared_ptr<compute_kernel> collapse_kernel;
+	
+	shared_ptr<compute_image> level_0;
+	vector<shared_ptr<compute_image>> levels;
+	vector<shared_ptr<compute_image>> laplacian_levels;
+	//! intermediate collapse results of levels 1 ... level count - 1 (RGBA16F)
+	vector<shared_ptr<compute_image>> collapse_levels;
+	
+	//! (re)creates "imgs" with the sizes of levels "first_level" ... "first_level" + count - 1 if necessary
+	bool create_level_images(vector<shared_ptr<compute_image>>& imgs, const uint32_t first_level, const uint32_t count,
+							 const bool signed_storage);
+	
+	//! size of pyramid level "level" of the current level 0
+	uint2 level_size(const uint32_t level) const;
+	
+};
+
+#endif
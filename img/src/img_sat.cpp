@@ -0,0 +1,164 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "img_sat.hpp"
+
+img_sat::img_sat(compute_context& ctx_, compute_queue& dev_queue_) : ctx(ctx_), dev_queue(dev_queue_) {}
+
+bool img_sat::init(const compute_program& prog) {
+	sat_rows = { prog.get_kernel("image_sat_rows_u32"), prog.get_kernel("image_sat_rows_f32") };
+	sat_columns = { prog.get_kernel("image_sat_columns_u32"), prog.get_kernel("image_sat_columns_f32") };
+	box_sat = { prog.get_kernel("image_box_sat_u32"), prog.get_kernel("image_box_sat_f32") };
+	for (size_t i = 0; i < 2; ++i) {
+		if (!sat_rows[i] || !sat_columns[i] || !box_sat[i]) {
+			log_error("failed to retrieve the SAT kernels");
+			return false;
+		}
+	}
+	return true;
+}
+
+array<uint32_t, 3> img_sat::gaussian_box_radii(const float sigma) {
+	// ideal box width for n boxes: sqrt(12 * sigma^2 / n + 1), use the next smaller (w_l) and larger (w_u) odd widths,
+	// m boxes of width w_l and n - m boxes of width w_u, such that the variance of all boxes matches sigma^2 best
+	static constexpr const int box_count = 3;
+	const auto variance = 12.0f * sigma * sigma;
+	auto w_l = int(std::floor(std::sqrt(variance / float(box_count) + 1.0f)));
+	if (w_l % 2 == 0) {
+		--w_l;
+	}
+	w_l = max(w_l, 1);
+	const auto w_u = w_l + 2;
+	const auto m = int(std::round((variance - float(box_count * w_l * w_l + 4 * box_count * w_l + 3 * box_count)) /
+								  float(-4 * w_l - 4)));
+	array<uint32_t, 3> radii;
+	for (int i = 0; i < box_count; ++i) {
+		radii[size_t(i)] = uint32_t(((i < m ? w_l : w_u) - 1) / 2);
+	}
+	return radii;
+}
+
+bool img_sat::box(const uint32_t radius, const bool use_float,
+				  const shared_ptr<compute_image>& in_img,
+				  const shared_ptr<compute_image>& out_img) {
+	return box_pass(radius, use_float, in_img, out_img);
+}
+
+bool img_sat::gaussian(const float sigma, const bool use_float,
+					   const shared_ptr<compute_image>& in_img,
+					   const shared_ptr<compute_image>& out_img) {
+	// the SAT is fully built before the box filter writes its output, so that passes 2 and 3 can run in-place
+	const auto radii = gaussian_box_radii(sigma);
+	for (size_t i = 0; i < radii.size(); ++i) {
+		if (!box_pass(radii[i], use_float, (i == 0 ? in_img : out_img), out_img)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool img_sat::box_pass(const uint32_t radius, const bool use_float,
+					   const shared_ptr<compute_image>& in_img,
+					   const shared_ptr<compute_image>& out_img) {
+	const auto kernel_idx = (use_float ? 1u : 0u);
+	if (!sat_rows[kernel_idx] || !sat_columns[kernel_idx] || !box_sat[kernel_idx]) {
+		log_error("SAT kernels are not available");
+		return false;
+	}
+	const uint2 image_size = in_img->get_image_dim().xy;
+	if (!sat_buffer || (sat_dim != image_size).any()) {
+		// uint4 and float4 have the same size
+		sat_buffer = ctx.create_buffer(dev_queue, size_t(image_size.x) * size_t(image_size.y) * sizeof(uint4),
+									   COMPUTE_MEMORY_FLAG::READ_WRITE);
+		if (!sat_buffer) {
+			log_error("failed to allocate the SAT buffer");
+			return false;
+		}
+		sat_dim = image_size;
+	}
+	
+	// one work-group per row
+	dev_queue.execute_with_parameters(*sat_rows[kernel_idx], compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { image_size.y * SAT_ROW_SCAN_SIZE, 0u, 0u },
+		.local_work_size = { SAT_ROW_SCAN_SIZE, 0u, 0u },
+		.args = {
+			in_img, sat_buffer
+		},
+		.wait_until_completion = true,
+		.debug_label = "sat_rows",
+	});
+	// one work-item per column
+	dev_queue.execute_with_parameters(*sat_columns[kernel_idx], compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { image_size.x, 0u, 0u },
+		.local_work_size = { 32u, 0u, 0u },
+		.args = {
+			sat_buffer, image_size
+		},
+		.wait_until_completion = true,
+		.debug_label = "sat_columns",
+	});
+	dev_queue.execute_with_parameters(*box_sat[kernel_idx], compute_queue::execution_parameters_t {
+		.execution_dim = 2u,
+		.global_work_size = image_size,
+		.local_work_size = uint2 { 32, 16 },
+		.args = {
+			sat_buffer, out_img, radius
+		},
+		.wait_until_completion = true,
+		.debug_label = "box_sat",
+	});
+	return true;
+}
+
+image_difference_t compare_images(compute_queue& dev_queue, compute_image& img_a, compute_image& img_b, const uint32_t border) {
+	image_difference_t diff;
+	const uint2 image_size = img_a.get_image_dim().xy;
+	if ((image_size != uint2 { img_b.get_image_dim().xy }).any()) {
+		log_error("can't compare images of different sizes");
+		return diff;
+	}
+	auto pixels_a = (const uchar4*)img_a.map(dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+	auto pixels_b = (const uchar4*)img_b.map(dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+	if (pixels_a != nullptr && pixels_b != nullptr) {
+		uint64_t squared_error_sum = 0u, sample_count = 0u;
+		for (uint32_t y = border; y + border < image_size.y; ++y) {
+			for (uint32_t x = border, idx = y * image_size.x + border; x + border < image_size.x; ++x, ++idx) {
+				for (uint32_t c = 0; c < 3; ++c) {
+					const auto channel_diff = uint32_t(abs(int(pixels_a[idx][c]) - int(pixels_b[idx][c])));
+					diff.max_diff = max(diff.max_diff, channel_diff);
+					squared_error_sum += channel_diff * channel_diff;
+				}
+				sample_count += 3u;
+			}
+		}
+		const auto mse = (sample_count > 0u ? double(squared_error_sum) / double(sample_count) : 0.0);
+		diff.psnr = (mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : numeric_limits<double>::infinity());
+	} else {
+		log_error("failed to map images for comparison");
+	}
+	if (pixels_a != nullptr) {
+		img_a.unmap(dev_queue, (void*)pixels_a);
+	}
+	if (pixels_b != nullptr) {
+		img_b.unmap(dev_queue, (void*)pixels_b);
+	}
+	return diff;
+}
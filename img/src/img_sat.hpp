@@ -0,0 +1,85 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FLOOR_IMG_IMG_SAT_HPP__
+#define __FLOOR_IMG_IMG_SAT_HPP__
+
+#include <floor/floor/floor.hpp>
+#include <floor/compute/compute_kernel.hpp>
+#include "img_kernels.hpp"
+
+//! summed-area table (SAT) blurs: the image is turned into a SAT by a 2D inclusive scan (row scan, then column scan),
+//! on top of which a box filter of any radius only needs 4 reads per pixel
+//!  * box(): a single (2 * radius + 1)^2 box filter
+//!  * gaussian(): approximates a gaussian by 3 iterated box filters (Kovesi: "Fast Almost-Gaussian Filtering", 2010),
+//!    i.e. the cost per pixel is independent of sigma (same as the recursive gaussian of img_blur)
+//! the SAT is either accumulated with uint32_t (exact box sums) or float (loses precision on larger images)
+//! NOTE: intermediate results of gaussian() are stored in RGBA8UI_NORM images (-> rounded after each box pass)
+class img_sat {
+public:
+	img_sat(compute_context& ctx, compute_queue& dev_queue);
+	
+	//! retrieves the SAT kernels from "prog", returns false if these aren't available
+	bool init(const compute_program& prog);
+	
+	//! box blurs "in_img" into "out_img", blocks until the blur has completed
+	bool box(const uint32_t radius, const bool use_float,
+			 const shared_ptr<compute_image>& in_img,
+			 const shared_ptr<compute_image>& out_img);
+	
+	//! approximately gaussian blurs "in_img" into "out_img", blocks until the blur has completed
+	//! NOTE: "out_img" is also used as the input of the 2nd and 3rd box pass, i.e. it must be readable
+	bool gaussian(const float sigma, const bool use_float,
+				  const shared_ptr<compute_image>& in_img,
+				  const shared_ptr<compute_image>& out_img);
+	
+	//! returns the radii of the 3 box filters that approximate a gaussian with "sigma"
+	static array<uint32_t, 3> gaussian_box_radii(const float sigma);
+	
+protected:
+	compute_context& ctx;
+	compute_queue& dev_queue;
+	
+	//! [u32, f32]
+	array<shared_ptr<compute_kernel>, 2> sat_rows;
+	array<shared_ptr<compute_kernel>, 2> sat_columns;
+	array<shared_ptr<compute_kernel>, 2> box_sat;
+	
+	//! the SAT (one uint4 or float4 per pixel, reallocated if the image size changes)
+	shared_ptr<compute_buffer> sat_buffer;
+	uint2 sat_dim;
+	
+	//! builds the SAT of "in_img" and runs the box filter on it
+	bool box_pass(const uint32_t radius, const bool use_float,
+				  const shared_ptr<compute_image>& in_img,
+				  const shared_ptr<compute_image>& out_img);
+	
+};
+
+//! difference between two images of the same size, ignoring a border of "border" px
+struct image_difference_t {
+	//! max per-channel difference (in 8-bit steps)
+	uint32_t max_diff { 0u };
+	//! PSNR over all RGB channels (in dB, infinity if both images are equal)
+	double psnr { 0.0 };
+};
+//! compares the RGB channels of two RGBA8UI_NORM images (both must be host-readable)
+image_difference_t compare_images(compute_queue& dev_queue, compute_image& img_a, compute_image& img_b, const uint32_t border);
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "img_tiled.hpp"
+#include <floor/core/timer.hpp>
+#include <thread>
+#include <atomic>
+
+namespace img_tiled {
+
+//! device images + queue of a single in-flight tile
+struct slot_t {
+	shared_ptr<compute_queue> dev_queue;
+	unique_ptr<img_blur> blur;
+	//! [input, intermediate, output]
+	array<shared_ptr<compute_image>, 3> imgs;
+	//! accumulated per-stage times in ms
+	double upload_time { 0.0 };
+	double compute_time { 0.0 };
+	double download_time { 0.0 };
+	uint32_t tile_count { 0u };
+};
+
+static uint32_t round_up_32(const uint32_t value) {
+	return ((value + 31u) / 32u) * 32u;
+}
+
+bool process(compute_context& ctx, const compute_device& dev, const img_blur& blur,
+			 const uchar4* in, uchar4* out, const config_t& config) {
+	const auto image_size = config.image_size;
+	const auto halo = blur_halo(config.radius);
+	const auto slot_count = max(config.slot_count, 1u);
+	
+	// compile everything that is needed for this radius once, all slots share the programs
+	auto main_queue = ctx.create_queue(dev);
+	img_blur prepared_blur(blur, *main_queue);
+	if (!prepared_blur.prepare(config.radius)) {
+		return false;
+	}
+	
+	// inner tile size: fits into the max device image size and all slots only use up to half of the device memory
+	// (per slot: 3 RGBA8 images + the float4 IIR scratch buffer)
+	uint32_t tile_size = config.tile_size;
+	const auto max_dev_dim = dev.max_image_2d_dim.min_element();
+	if (max_dev_dim <= 2u * halo + 32u) {
+		log_error("blur halo ($px) is too large for the max device image size ($px)", halo, max_dev_dim);
+		return false;
+	}
+	if (tile_size == 0) {
+		tile_size = min(4096u, ((max_dev_dim - 2u * halo) / 32u) * 32u);
+		const auto slot_bytes = [&halo](const uint32_t size) {
+			const auto dim = uint64_t(round_up_32(size + 2u * halo));
+			return dim * dim * (3u * sizeof(uchar4) + sizeof(float4));
+		};
+		while (tile_size > 256u && slot_count * slot_bytes(tile_size) > dev.global_mem_size / 2u) {
+			tile_size /= 2u;
+		}
+	}
+	if (tile_size == 0 || (tile_size % 32u) != 0 || tile_size + 2u * halo > max_dev_dim) {
+		log_error("invalid tile size $ (must be a multiple of 32 and <= $ incl. the $px halo)", tile_size, max_dev_dim, halo);
+		return false;
+	}
+	// device images are a multiple of 32px (-> blur kernel requirement)
+	const auto dev_dim = round_up_32(tile_size + 2u * halo);
+	const uint2 tile_counts {
+		(image_size.x + tile_size - 1u) / tile_size,
+		(image_size.y + tile_size - 1u) / tile_size,
+	};
+	const auto total_tile_count = tile_counts.x * tile_counts.y;
+	log_msg("tiled blur: $ tiles of $px (device images: $px, halo: $px), $ slots",
+			tile_counts, tile_size, dev_dim, halo, slot_count);
+	
+	vector<slot_t> slots(slot_count);
+	for (auto& slot : slots) {
+		slot.dev_queue = ctx.create_queue(dev);
+		slot.blur = make_unique<img_blur>(prepared_blur, *slot.dev_queue);
+		for (size_t i = 0; i < slot.imgs.size(); ++i) {
+			slot.imgs[i] = ctx.create_image(*slot.dev_queue, uint2 { dev_dim },
+											COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+											(i == 0 ? COMPUTE_IMAGE_TYPE::READ : COMPUTE_IMAGE_TYPE::READ_WRITE),
+											(i == 0 ? COMPUTE_MEMORY_FLAG::HOST_WRITE :
+											 (i == 2 ? COMPUTE_MEMORY_FLAG::HOST_READ : COMPUTE_MEMORY_FLAG::READ_WRITE)));
+			if (!slot.imgs[i]) {
+				log_error("failed to create tile images");
+				return false;
+			}
+		}
+	}
+	
+	// each slot processes every slot_count-th tile: upload (with clamp-to-edge outside the image) -> blur -> download inner part
+	atomic<bool> success { true };
+	const auto process_slot = [&](slot_t& slot, const uint32_t first_tile_idx) {
+		for (uint32_t tile_idx = first_tile_idx; tile_idx < total_tile_count && success; tile_idx += slot_count) {
+			const uint2 tile_offset { (tile_idx % tile_counts.x) * tile_size, (tile_idx / tile_counts.x) * tile_size };
+			const auto region_offset = tile_offset.cast<int>() - int(halo);
+			
+			auto upload_start = floor_timer::start();
+			auto tile_in = (uchar4*)slot.imgs[0]->map(*slot.dev_queue, COMPUTE_MEMORY_MAP_FLAG::WRITE_INVALIDATE |
+																	 COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+			if (!tile_in) {
+				success = false;
+				break;
+			}
+			for (uint32_t y = 0; y < dev_dim; ++y) {
+				const auto src_y = uint32_t(math::clamp(region_offset.y + int(y), 0, int(image_size.y) - 1));
+				const auto src_row = &in[size_t(src_y) * size_t(image_size.x)];
+				auto dst_row = &tile_in[size_t(y) * dev_dim];
+				// the inner span can be copied directly, only the pixels left and right of the image need clamping
+				const auto x_begin = uint32_t(math::clamp(-region_offset.x, 0, int(dev_dim)));
+				const auto x_end = uint32_t(math::clamp(int(image_size.x) - region_offset.x, int(x_begin), int(dev_dim)));
+				for (uint32_t x = 0; x < x_begin; ++x) {
+					dst_row[x] = src_row[0];
+				}
+				if (x_end > x_begin) {
+					memcpy(&dst_row[x_begin], &src_row[region_offset.x + int(x_begin)], (x_end - x_begin) * sizeof(uchar4));
+				}
+				for (uint32_t x = x_end; x < dev_dim; ++x) {
+					dst_row[x] = src_row[image_size.x - 1u];
+				}
+			}
+			slot.imgs[0]->unmap(*slot.dev_queue, tile_in);
+			slot.upload_time += double(floor_timer::stop<chrono::microseconds>(upload_start)) / 1000.0;
+			
+			auto compute_start = floor_timer::start();
+			if (!slot.blur->blur(config.radius, config.variant, slot.imgs[0], slot.imgs[1], slot.imgs[2])) {
+				success = false;
+				break;
+			}
+			slot.compute_time += double(floor_timer::stop<chrono::microseconds>(compute_start)) / 1000.0;
+			
+			auto download_start = floor_timer::start();
+			auto tile_out = (const uchar4*)slot.imgs[2]->map(*slot.dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ |
+																		 COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+			if (!tile_out) {
+				success = false;
+				break;
+			}
+			const uint2 inner_size = (image_size - tile_offset).minned(uint2 { tile_size });
+			for (uint32_t y = 0; y < inner_size.y; ++y) {
+				memcpy(&out[size_t(tile_offset.y + y) * size_t(image_size.x) + tile_offset.x],
+					   &tile_out[size_t(halo + y) * dev_dim + halo], inner_size.x * sizeof(uchar4));
+			}
+			slot.imgs[2]->unmap(*slot.dev_queue, (void*)tile_out);
+			slot.download_time += double(floor_timer::stop<chrono::microseconds>(download_start)) / 1000.0;
+			++slot.tile_count;
+		}
+	};
+	
+	const auto start = floor_timer::start();
+	{
+		vector<thread> threads;
+		for (uint32_t i = 0; i < slot_count; ++i) {
+			threads.emplace_back(process_slot, ref(slots[i]), i);
+		}
+		for (auto& th : threads) {
+			th.join();
+		}
+	}
+	const auto total_time = double(floor_timer::stop<chrono::microseconds>(start)) / 1000.0;
+	if (!success) {
+		log_error("tiled blur failed");
+		return false;
+	}
+	
+	const auto mpixels = double(image_size.x) * double(image_size.y) / 1'000'000.0;
+	const auto processed_mpixels = double(total_tile_count) * double(dev_dim) * double(dev_dim) / 1'000'000.0;
+	log_msg("tiled blur: $ MPixel in $ms -> $ MPixel/s ($ MPixel/s incl. halos)",
+			mpixels, total_time, mpixels / (total_time / 1000.0), processed_mpixels / (total_time / 1000.0));
+	for (uint32_t i = 0; i < slot_count; ++i) {
+		const auto& slot = slots[i];
+		log_msg("slot #$: $ tiles, upload: $ms, blur: $ms, download: $ms (busy: $%)",
+				i, slot.tile_count, slot.upload_time, slot.compute_time, slot.download_time,
+				100.0 * (slot.upload_time + slot.compute_time + slot.download_time) / total_time);
+	}
+	return true;
+}
+
+bool run(compute_context& ctx, const compute_device& dev, const img_blur& blur, const config_t& config) {
+	const auto image_size = config.image_size;
+	const auto pixel_count = size_t(image_size.x) * size_t(image_size.y);
+	log_msg("tiled blur of a $ image ($ MiB host memory per image)",
+			image_size, double(pixel_count * sizeof(uchar4)) / (1024.0 * 1024.0));
+	
+	auto in = make_unique<uchar4[]>(pixel_count);
+	auto out = make_unique<uchar4[]>(pixel_count);
+	if (!in || !out) {
+		log_error("failed to allocate host images");
+		return false;
+	}
+	
+	// procedural test image (gradients + hashed noise), generated in parallel
+	{
+		const auto thread_count = max(thread::hardware_concurrency(), 1u);
+		vector<thread> threads;
+		for (uint32_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([&, i] {
+				for (uint32_t y = i; y < image_size.y; y += thread_count) {
+					for (uint32_t x = 0; x < image_size.x; ++x) {
+						auto hash = (x * 0x9E3779B1u) ^ (y * 0x85EBCA77u);
+						hash ^= hash >> 15u;
+						hash *= 0x2C1B3C6Du;
+						hash ^= hash >> 12u;
+						in[size_t(y) * image_size.x + x] = uchar4 {
+							uint8_t((uint64_t(x) * 255u) / image_size.x),
+							uint8_t((uint64_t(y) * 255u) / image_size.y),
+							uint8_t(((x / 64u) ^ (y / 64u)) & 1u ? 255u : 0u),
+							uint8_t(hash & 0xFFu),
+						};
+					}
+				}
+			});
+		}
+		for (auto& th : threads) {
+			th.join();
+		}
+	}
+	
+	if (!process(ctx, dev, blur, in.get(), out.get(), config)) {
+		return false;
+	}
+	
+	// verify against a non-tiled blur if the whole image fits onto the device
+	if ((image_size <= dev.max_image_2d_dim).all() &&
+		(image_size % 32u == 0u).all() &&
+		uint64_t(pixel_count) * (3u * sizeof(uchar4) + sizeof(float4)) <= dev.global_mem_size / 2u) {
+		auto dev_queue = ctx.create_queue(dev);
+		img_blur full_blur(blur, *dev_queue);
+		array<shared_ptr<compute_image>, 3> imgs;
+		for (size_t i = 0; i < imgs.size(); ++i) {
+			imgs[i] = ctx.create_image(*dev_queue, image_size,
+									   COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+									   (i == 0 ? COMPUTE_IMAGE_TYPE::READ : COMPUTE_IMAGE_TYPE::READ_WRITE),
+									   span<uint8_t> { i == 0 ? (uint8_t*)in.get() : nullptr, i == 0 ? pixel_count * sizeof(uchar4) : 0u },
+									   COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+			if (!imgs[i]) {
+				log_warn("failed to create the verification images -> skipping verification");
+				return true;
+			}
+		}
+		if (!full_blur.prepare(config.radius) ||
+			!full_blur.blur(config.radius, config.variant, imgs[0], imgs[1], imgs[2])) {
+			return false;
+		}
+		auto ref = (const uchar4*)imgs[2]->map(*dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+		if (!ref) {
+			log_warn("failed to map the verification image -> skipping verification");
+			return true;
+		}
+		uint32_t max_diff = 0u;
+		size_t diff_count = 0u;
+		for (size_t i = 0; i < pixel_count; ++i) {
+			const auto diff = (ref[i].cast<int>() - out[i].cast<int>()).abs().max_element();
+			max_diff = max(max_diff, uint32_t(diff));
+			diff_count += (diff != 0 ? 1u : 0u);
+		}
+		imgs[2]->unmap(*dev_queue, (void*)ref);
+		// NOTE: the tap kernels must match exactly, the recursive gaussian is truncated at 3 sigma by the tiling
+		log_msg("tiled vs. non-tiled blur: $ differing pixels, max difference: $", diff_count, max_diff);
+		if (config.radius <= max_tap_blur_radius && diff_count > 0) {
+			log_error("tiled blur result doesn't match the non-tiled blur");
+			return false;
+		}
+	} else {
+		log_msg("image doesn't fit onto the device -> skipping verification");
+	}
+	return true;
+}
+	
+} // namespace img_tiled
@@ -0,0 +1,53 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __FLOOR_IMG_IMG_TILED_HPP__
+#define __FLOOR_IMG_IMG_TILED_HPP__
+
+#include "img_blur.hpp"
+
+//! tiled processing of images that are larger than the max device image size and/or don't fit into device memory:
+//! the host image is split into tiles that overlap by the blur halo, tiles are uploaded, blurred and downloaded through a
+//! small pool of rotating device image sets ("slots"), and the inner part of each tile is stitched into the host output
+//! NOTE: each slot has its own queue and host thread, so that uploads/downloads of one slot overlap with the blur of another
+namespace img_tiled {
+
+struct config_t {
+	//! size of the processed image
+	uint2 image_size { 16384u, 16384u };
+	//! inner tile size (excluding the halo), must be a multiple of 32, 0 = chosen from the device limits
+	uint32_t tile_size { 0u };
+	//! amount of device image sets (-> tiles in flight)
+	uint32_t slot_count { 3u };
+	//! blur parameters (see img_blur::blur)
+	uint32_t radius { TAP_COUNT / 2 };
+	blur_variant_t variant;
+};
+
+//! blurs the "image_size.x * image_size.y" RGBA8 pixels of "in" into "out" tile-by-tile
+bool process(compute_context& ctx, const compute_device& dev, const img_blur& blur,
+			 const uchar4* in, uchar4* out, const config_t& config);
+
+//! runs the tiled blur on a procedurally generated image, reports the throughput in MPixel/s and verifies the result
+//! against a non-tiled blur if the image fits onto the device
+bool run(compute_context& ctx, const compute_device& dev, const img_blur& blur, const config_t& config);
+	
+} // namespace img_tiled
+
+#endif
@@ -21,6 +21,15 @@
 #include <floor/core/timer.hpp>
 #include <floor/compute/compute_kernel.hpp>
 #include "img_kernels.hpp"
+#include "img_blur.hpp"
+#include "img_autotune.hpp"
+#include "img_edge_filter.hpp"
+#include "img_filter_graph.hpp"
+#include "img_pyramid.hpp"
+#include "img_sat.hpp"
+#include "img_tiled.hpp"
+#include "img_batch.hpp"
+#include "img_benchmark.hpp"
 
 struct img_option_context {
 	// unused
@@ -29,17 +38,44 @@ struct img_option_context {
 typedef option_handler<img_option_context> img_opt_handler;
 
 static bool done { false };
-static bool use_half { false };
-static bool dumb {
+static blur_variant_t blur_variant {
+	.storage = BLUR_STORAGE::F32,
 #if !defined(FLOOR_IOS)
-	false
+	.dumb = false,
 #else
+	.dumb = true,
+#endif
+	.tile_size_idx = {},
+};
+//! if enabled, the fastest blur variant is selected automatically (unless --dumb/--half/--packed are specified)
+static bool autotune {
+#if !defined(FLOOR_IOS)
 	true
+#else
+	false
 #endif
 };
+static bool retune { false };
+static string tuning_file_name { "img_blur_tuning.txt" };
 static uint32_t cur_image { 0 };
+static uint32_t image_view_count { 3 };
 static uint2 image_size { 1024 };
-static constexpr const uint32_t tap_count { TAP_COUNT };
+static uint32_t blur_radius { TAP_COUNT / 2 };
+static bool blur_radius_changed { false };
+static string filter_graph_spec;
+static bool sat_blur { false };
+//! amount of gaussian pyramid levels below the original image (0 = disabled)
+static uint32_t pyramid_level_count { 0 };
+static img_pyramid::FILTER pyramid_filter { img_pyramid::FILTER::BINOMIAL };
+static bool edge_filters { false };
+static float range_sigma { 0.1f };
+static float guided_eps { 0.01f };
+static bool benchmark_storage { false };
+static bool tiled { false };
+static img_tiled::config_t tiled_config;
+static img_batch::config_t batch_config;
+static bool run_benchmark_suite { false };
+static img_benchmark::config_t benchmark_suite_config;
 
 //! option -> function map
 template<> vector<pair<string, img_opt_handler::option_function>> img_opt_handler::options {
@@ -48,6 +84,36 @@ template<> vector<pair<string, img_opt_handler::option_function>> img_opt_handle
 		cout << "\t--dim <width> <height>: image width * height in px (default: " << image_size << ")" << endl;
 		cout << "\t--dumb: runs the \"dumb\" version of the compute kernel (no caching)" << endl;
 		cout << "\t--half: using half precision computations instead of single precision" << endl;
+		cout << "\t--packed: stores samples as packed 8-bit values in local memory (single-stage kernels, computations are single precision)" << endl;
+		cout << "\t--no-autotune: don't select the fastest blur variant automatically (also implied by --dumb, --half and --packed)" << endl;
+		cout << "\t--retune: re-runs the blur variant autotuning for this device instead of using the tuning file" << endl;
+		cout << "\t--tuning-file <file>: file in which the autotuning results are stored (default: " << tuning_file_name << ")" << endl;
+		cout << "\t--benchmark-storage: benchmarks the f32/f16/packed 8-bit single-stage kernels for each tile size at the current blur radius" << endl;
+		cout << "\t--benchmark-suite: runs the headless benchmark suite (all combinations of image sizes, tap counts and blur variants) and exits" << endl;
+		cout << "\t--suite-sizes <size,...>: square image sizes used by the benchmark suite (multiples of 32)" << endl;
+		cout << "\t--suite-taps <count,...>: tap counts used by the benchmark suite (odd, 3 - 21)" << endl;
+		cout << "\t--suite-repeats <count>: #timed runs per configuration in the benchmark suite (default: " << benchmark_suite_config.repeats << ")" << endl;
+		cout << "\t--suite-json <file>: file the benchmark suite results are written to (default: " << benchmark_suite_config.json_file_name << ")" << endl;
+		cout << "\t--radius <px>: blur radius (default: " << blur_radius << "), radii <= " << max_tap_blur_radius
+			 << " use kernels specialized for the resp. tap count (compiled on demand), larger radii use a recursive gaussian" << endl;
+		cout << "\t--filter-graph <stages>: runs a fused filter graph on the original image and compares it to running each stage separately" << endl;
+		cout << "\t                         (timings + output difference, RGBA8 rounding of unfused intermediates is tolerated down to 40dB PSNR)" << endl;
+		cout << "\t                         comma-separated stages: blur[:radius[:sigma]], sharpen[:amount], tone[:exposure[:gamma[:contrast]]], down" << endl;
+		cout << "\t                         e.g. blur:2,down,tone:1.2:2.2:1.1,sharpen:0.5" << endl;
+		cout << "\t--sat: runs the summed-area table box/iterated-box blur at the sigma of the blur radius and compares it to the regular blur" << endl;
+		cout << "\t--pyramid <levels>: builds a gaussian and laplacian pyramid with this many levels below the original image (0 = down to 1x1)," << endl;
+		cout << "\t                    compares multi-level to single-level dispatches and verifies that the laplacian pyramid reconstructs the image" << endl;
+		cout << "\t--pyramid-box: uses a 2x2 box filter (mipmaps) instead of the [1 3 3 1] binomial filter for the pyramid" << endl;
+		cout << "\t--edge-filters: runs the bilateral filter (brute-force for radii <= " << EDGE_FILTER_MAX_RADIUS << ", bilateral grid otherwise)" << endl;
+		cout << "\t                and the guided filter at the blur radius, compares the bilateral grid to the brute-force bilateral filter" << endl;
+		cout << "\t--range-sigma <sigma>: range sigma of the bilateral filters, relative to colors in [0, 1] (default: " << range_sigma << ")" << endl;
+		cout << "\t--guided-eps <eps>: regularization of the guided filter, relative to colors in [0, 1] (default: " << guided_eps << ")" << endl;
+		cout << "\t--tiled <width> <height>: blurs a procedurally generated image of this size tile-by-tile (may exceed the max device image size/memory) and exits" << endl;
+		cout << "\t--tile-size <px>: inner tile size of the tiled mode, multiple of 32 (default: chosen from the device limits)" << endl;
+		cout << "\t--tile-slots <count>: amount of tiles in flight in the tiled mode (default: " << tiled_config.slot_count << ")" << endl;
+		cout << "\t--input-dir <dir>: blurs all PNG files in this directory (batch mode, requires --output-dir) and exits" << endl;
+		cout << "\t--output-dir <dir>: directory the blurred PNG files are written to in the batch mode" << endl;
+		cout << "\t--io-threads <count>: amount of PNG decode and encode threads each in the batch mode (default: half of the hardware threads)" << endl;
 		
 		cout << endl;
 		cout << "controls:" << endl;
@@ -55,6 +121,9 @@ template<> vector<pair<string, img_opt_handler::option_function>> img_opt_handle
 		cout << "\t1: show original image" << endl;
 		cout << "\t2: show blurred image" << endl;
 		cout << "\t3: show intermediate image" << endl;
+		cout << "\t4/5: show the filter graph and/or SAT blur output image (in this order, if --filter-graph and/or --sat are used)" << endl;
+		cout << "\tw: cycle through all images (including the edge filter outputs and pyramid levels if --edge-filters/--pyramid are used)" << endl;
+		cout << "\t-/+: decrease/increase the blur radius" << endl;
 		cout << endl;
 		done = true;
 	}},
@@ -84,13 +153,227 @@ template<> vector<pair<string, img_opt_handler::option_function>> img_opt_handle
 		cout << "image size set to: " << image_size << endl;
 	}},
 	{ "--dumb", [](img_option_context&, char**&) {
-		dumb = true;
+		blur_variant.dumb = true;
+		autotune = false;
 		cout << "running dumb kernels" << endl;
 	}},
 	{ "--half", [](img_option_context&, char**&) {
-		use_half = true;
+		blur_variant.storage = BLUR_STORAGE::F16;
+		autotune = false;
 		cout << "using half precision for computations" << endl;
 	}},
+	{ "--packed", [](img_option_context&, char**&) {
+		blur_variant.storage = BLUR_STORAGE::U8;
+		autotune = false;
+		cout << "using packed 8-bit samples in local memory" << endl;
+	}},
+	{ "--no-autotune", [](img_option_context&, char**&) {
+		autotune = false;
+	}},
+	{ "--retune", [](img_option_context&, char**&) {
+		retune = true;
+	}},
+	{ "--tuning-file", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --tuning-file!" << endl;
+			done = true;
+			return;
+		}
+		tuning_file_name = *arg_ptr;
+	}},
+	{ "--benchmark-storage", [](img_option_context&, char**&) {
+		benchmark_storage = true;
+	}},
+	{ "--benchmark-suite", [](img_option_context&, char**&) {
+		run_benchmark_suite = true;
+	}},
+	{ "--suite-sizes", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --suite-sizes!" << endl;
+			done = true;
+			return;
+		}
+		benchmark_suite_config.image_sizes = img_benchmark::parse_uint_list(*arg_ptr);
+		if (benchmark_suite_config.image_sizes.empty()) {
+			cerr << "invalid image size list: " << *arg_ptr << endl;
+			done = true;
+		}
+	}},
+	{ "--suite-taps", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --suite-taps!" << endl;
+			done = true;
+			return;
+		}
+		benchmark_suite_config.tap_counts = img_benchmark::parse_uint_list(*arg_ptr);
+		if (benchmark_suite_config.tap_counts.empty()) {
+			cerr << "invalid tap count list: " << *arg_ptr << endl;
+			done = true;
+		}
+	}},
+	{ "--suite-repeats", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --suite-repeats!" << endl;
+			done = true;
+			return;
+		}
+		benchmark_suite_config.repeats = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+		cout << "benchmark suite repeats set to: " << benchmark_suite_config.repeats << endl;
+	}},
+	{ "--suite-json", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --suite-json!" << endl;
+			done = true;
+			return;
+		}
+		benchmark_suite_config.json_file_name = *arg_ptr;
+		cout << "benchmark suite JSON file set to: " << benchmark_suite_config.json_file_name << endl;
+	}},
+	{ "--radius", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --radius!" << endl;
+			done = true;
+			return;
+		}
+		blur_radius = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		if (blur_radius == 0) {
+			cerr << "blur radius must be >= 1" << endl;
+			done = true;
+			return;
+		}
+		cout << "blur radius set to: " << blur_radius << endl;
+	}},
+	{ "--filter-graph", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --filter-graph!" << endl;
+			done = true;
+			return;
+		}
+		filter_graph_spec = *arg_ptr;
+	}},
+	{ "--sat", [](img_option_context&, char**&) {
+		sat_blur = true;
+	}},
+	{ "--pyramid", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --pyramid!" << endl;
+			done = true;
+			return;
+		}
+		pyramid_level_count = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		if (pyramid_level_count == 0) {
+			pyramid_level_count = ~0u;
+		}
+		cout << "pyramid levels set to: " << (pyramid_level_count == ~0u ? "all" : to_string(pyramid_level_count)) << endl;
+	}},
+	{ "--pyramid-box", [](img_option_context&, char**&) {
+		pyramid_filter = img_pyramid::FILTER::BOX;
+	}},
+	{ "--edge-filters", [](img_option_context&, char**&) {
+		edge_filters = true;
+	}},
+	{ "--range-sigma", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --range-sigma!" << endl;
+			done = true;
+			return;
+		}
+		range_sigma = max(strtof(*arg_ptr, nullptr), 0.01f);
+		cout << "range sigma set to: " << range_sigma << endl;
+	}},
+	{ "--guided-eps", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --guided-eps!" << endl;
+			done = true;
+			return;
+		}
+		guided_eps = max(strtof(*arg_ptr, nullptr), 1.0e-6f);
+		cout << "guided filter eps set to: " << guided_eps << endl;
+	}},
+	{ "--tiled", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --tiled!" << endl;
+			done = true;
+			return;
+		}
+		tiled_config.image_size.x = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after second --tiled parameter!" << endl;
+			done = true;
+			return;
+		}
+		tiled_config.image_size.y = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		
+		if (tiled_config.image_size.x == 0 || tiled_config.image_size.y == 0) {
+			cerr << "invalid tiled image size: " << tiled_config.image_size.x << "x" << tiled_config.image_size.y << endl;
+			done = true;
+			return;
+		}
+		tiled = true;
+	}},
+	{ "--tile-size", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --tile-size!" << endl;
+			done = true;
+			return;
+		}
+		tiled_config.tile_size = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		if ((tiled_config.tile_size % 32u) != 0) {
+			cerr << "tile size must be a multiple of 32: " << tiled_config.tile_size << endl;
+			done = true;
+			return;
+		}
+	}},
+	{ "--tile-slots", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --tile-slots!" << endl;
+			done = true;
+			return;
+		}
+		tiled_config.slot_count = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+	}},
+	{ "--input-dir", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --input-dir!" << endl;
+			done = true;
+			return;
+		}
+		batch_config.input_dir = *arg_ptr;
+	}},
+	{ "--output-dir", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --output-dir!" << endl;
+			done = true;
+			return;
+		}
+		batch_config.output_dir = *arg_ptr;
+	}},
+	{ "--io-threads", [](img_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --io-threads!" << endl;
+			done = true;
+			return;
+		}
+		batch_config.io_thread_count = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+	}},
 	// ignore xcode debug arg
 	{ "-NSDocumentRevisionsDebugMode", [](img_option_context&, char**&) {} },
 	{ "-ApplePersistenceIgnoreState", [](img_option_context&, char**&) {} },
@@ -115,8 +398,25 @@ static bool evt_handler(EVENT_TYPE type, shared_ptr<event_object> obj) {
 			case SDLK_3:
 				cur_image = 2;
 				break;
+			case SDLK_4:
+				cur_image = min(3u, image_view_count - 1u);
+				break;
+			case SDLK_5:
+				cur_image = min(4u, image_view_count - 1u);
+				break;
 			case SDLK_W:
-				cur_image = (cur_image + 1) % 3;
+				cur_image = (cur_image + 1) % image_view_count;
+				break;
+			case SDLK_MINUS:
+				if (blur_radius > 1) {
+					--blur_radius;
+					blur_radius_changed = true;
+				}
+				break;
+			case SDLK_EQUALS:
+			case SDLK_PLUS:
+				++blur_radius;
+				blur_radius_changed = true;
 				break;
 			default: break;
 		}
@@ -125,25 +425,6 @@ static bool evt_handler(EVENT_TYPE type, shared_ptr<event_object> obj) {
 	return false;
 }
 
-enum SINGLE_STAGE_BLUR_KERNEL {
-	SINGLE_STAGE_BLUR_1024_32_F32,
-	SINGLE_STAGE_BLUR_256_16_F32,
-	SINGLE_STAGE_BLUR_64_8_F32,
-	SINGLE_STAGE_BLUR_1024_32_F16,
-	SINGLE_STAGE_BLUR_256_16_F16,
-	SINGLE_STAGE_BLUR_64_8_F16,
-	__MAX_SINGLE_STAGE_BLUR_KERNEL
-};
-static constexpr const array single_stage_blur_kernel_names {
-	"image_blur_single_stage_32x32_f32"sv,
-	"image_blur_single_stage_16x16_f32"sv,
-	"image_blur_single_stage_8x8_f32"sv,
-	"image_blur_single_stage_32x32_f16"sv,
-	"image_blur_single_stage_16x16_f16"sv,
-	"image_blur_single_stage_8x8_f16"sv,
-};
-static_assert(size(single_stage_blur_kernel_names) == __MAX_SINGLE_STAGE_BLUR_KERNEL);
-
 //! profiling wrapper that either use compute_queue profiling (if available) or otherwise falls back to use floor_timer
 class start_stop_profiling {
 public:
@@ -187,12 +468,16 @@ int main(int, char* argv[]) {
 		.data_path = "data/",
 #endif
 		.app_name = "img",
-		.renderer = floor::RENDERER::DEFAULT,
+		// no window/renderer in the headless benchmark suite
+		.console_only = run_benchmark_suite,
+		.renderer = (run_benchmark_suite ? floor::RENDERER::NONE : floor::RENDERER::DEFAULT),
 		.context_flags = COMPUTE_CONTEXT_FLAGS::NO_RESOURCE_TRACKING | COMPUTE_CONTEXT_FLAGS::VULKAN_NO_BLOCKING,
 	})) {
 		return -1;
 	}
-	floor::set_screen_size(image_size);
+	if (!run_benchmark_suite) {
+		floor::set_screen_size(image_size);
+	}
 	
 	// add event handlers
 	event::handler evt_handler_fnctr(&evt_handler);
@@ -209,31 +494,66 @@ int main(int, char* argv[]) {
 	auto fastest_device = compute_ctx->get_device(compute_device::TYPE::FASTEST);
 	auto dev_queue = compute_ctx->create_queue(*fastest_device);
 	
-	// compile the program and get the kernel functions
-	static_assert(tap_count % 2u == 1u, "tap count must be an odd number!");
-#if !defined(FLOOR_IOS)
-	auto img_prog = compute_ctx->add_program_file(floor::data_path("../img/src/img_kernels.cpp"),
-												  "-I" + floor::data_path("../img/src") +
-												  " -DTAP_COUNT=" + to_string(tap_count));
-#else
-	auto img_prog = compute_ctx->add_universal_binary(floor::data_path("img_kernels.fubar"));
-#endif
-	if (!img_prog) {
-		log_error("program compilation failed");
+	// compile the program for the default tap count and get the kernel functions
+	// NOTE: programs for other tap counts are compiled on demand when the blur radius changes
+	auto blur = make_unique<img_blur>(*compute_ctx, *fastest_device, *dev_queue);
+	if (!blur->init()) {
 		return -1;
 	}
-	array<shared_ptr<compute_kernel>, size(single_stage_blur_kernel_names)> single_stage_blur_kernels;
-	for (size_t i = 0; i < size(single_stage_blur_kernel_names); ++i) {
-		single_stage_blur_kernels[i] = img_prog->get_kernel(single_stage_blur_kernel_names[i]);
-		if (!single_stage_blur_kernels[i]) {
-			log_warn("failed to retrieve/compile kernel: $", single_stage_blur_kernel_names[i]);
+	
+	// -> headless benchmark suite, no interactive mode
+	if (run_benchmark_suite) {
+		const auto suite_success = img_benchmark::run(*compute_ctx, *fastest_device, *dev_queue, *blur, benchmark_suite_config);
+		
+		floor::get_event()->remove_event_handler(evt_handler_fnctr);
+		blur = nullptr;
+		dev_queue = nullptr;
+		compute_ctx = nullptr;
+		floor::destroy();
+		return (suite_success ? 0 : -1);
+	}
+	
+	// select the fastest blur variant for this device, image size and radius (tuned on first use, persisted in the tuning file)
+	unique_ptr<img_autotune> tuner;
+	if (autotune) {
+		tuner = make_unique<img_autotune>(*compute_ctx, *fastest_device, *dev_queue, *blur, tuning_file_name, retune);
+		blur_variant = tuner->get_variant(blur_radius, tiled ? tiled_config.image_size : image_size);
+		if (blur_radius <= max_tap_blur_radius) {
+			log_msg("using blur variant: $", blur_variant.name());
 		}
 	}
-	auto image_blur_dumb_v = img_prog->get_kernel("image_blur_dumb_vertical_"s + (use_half ? "f16" : "f32"));
-	auto image_blur_dumb_h = img_prog->get_kernel("image_blur_dumb_horizontal_"s + (use_half ? "f16" : "f32"));
-	if (!image_blur_dumb_v || !image_blur_dumb_h) {
-		log_error("failed to retrieve kernel from program");
-		return -1;
+	
+	// -> tiled processing of a (huge) procedurally generated image, no interactive mode
+	if (tiled) {
+		tiled_config.radius = blur_radius;
+		tiled_config.variant = blur_variant;
+		const auto tiled_success = img_tiled::run(*compute_ctx, *fastest_device, *blur, tiled_config);
+		
+		floor::get_event()->remove_event_handler(evt_handler_fnctr);
+		blur = nullptr;
+		dev_queue = nullptr;
+		compute_ctx = nullptr;
+		floor::destroy();
+		return (tiled_success ? 0 : -1);
+	}
+	
+	// -> batch processing of all PNG files in a directory, no interactive mode
+	if (!batch_config.input_dir.empty() || !batch_config.output_dir.empty()) {
+		bool batch_success = false;
+		if (batch_config.input_dir.empty() || batch_config.output_dir.empty()) {
+			log_error("batch mode requires both --input-dir and --output-dir");
+		} else {
+			batch_config.radius = blur_radius;
+			batch_config.variant = blur_variant;
+			batch_success = img_batch::run(*compute_ctx, *fastest_device, *blur, batch_config);
+		}
+		
+		floor::get_event()->remove_event_handler(evt_handler_fnctr);
+		blur = nullptr;
+		dev_queue = nullptr;
+		compute_ctx = nullptr;
+		floor::destroy();
+		return (batch_success ? 0 : -1);
 	}
 	
 	// create images
@@ -279,91 +599,315 @@ int main(int, char* argv[]) {
 	
 	// -> compute blur
 	{
-		log_debug("running $compute blur ...", (dumb ? "dumb " : ""));
-		// NOTE: all kernels are run with "wait_until_completion" set to true, since this provides proper synchronization in the absence
-		// of automatic or manual synchronization provided by a backend queue (-> automatic resource tracking or manual dev_queue->finish())
-		if (!dumb) {
-			// figure out which kernel to use
-			compute_kernel* single_stage_blur_kernel = nullptr;
-			uint32_t single_stage_blur_local_size = 1024u;
-			uint32_t kernel_idx = (use_half ? 3u : 0u);
-			for (uint32_t i = 0; i < 3; ++i, single_stage_blur_local_size >>= 2u, ++kernel_idx) {
-				if (single_stage_blur_local_size <= fastest_device->max_total_local_size &&
-					single_stage_blur_kernels[kernel_idx]) {
-					const auto kernel_entry = single_stage_blur_kernels[kernel_idx]->get_kernel_entry(*fastest_device);
-					if (!kernel_entry || kernel_entry->max_total_local_size < single_stage_blur_local_size) {
-						continue;
+		log_debug("running $compute blur (radius: $) ...", (blur_variant.dumb ? "dumb " : ""), blur_radius);
+		// compile the kernels for this radius upfront, so that this isn't part of the measured time
+		if (!blur->prepare(blur_radius)) {
+			return -1;
+		}
+		for (size_t i = 0; i < run_count; ++i) {
+			start_stop_profiling prof(*dev_queue);
+			if (!blur->blur(blur_radius, blur_variant, imgs[0], imgs[2], imgs[1])) {
+				return -1;
+			}
+			const auto blur_end = prof.stop();
+			log_debug("blur run in $ms ($)", blur_end, blur->get_last_kernel_name());
+		}
+	}
+	
+	// -> single-stage blur storage variants (f32/f16/packed 8-bit) for each tile size
+	if (benchmark_storage) {
+		if (blur_radius > max_tap_blur_radius) {
+			log_error("single-stage blur kernels only support radii <= $", max_tap_blur_radius);
+		} else {
+			const auto mpixels = double(image_size.x) * double(image_size.y) / 1'000'000.0;
+			const auto ref_kernel_name = blur->get_last_kernel_name();
+			for (uint32_t kernel_idx = 0; kernel_idx < __MAX_SINGLE_STAGE_BLUR_KERNEL; ++kernel_idx) {
+				const auto kernel = SINGLE_STAGE_BLUR_KERNEL(kernel_idx);
+				const auto local_memory_size = single_stage_blur_local_memory_size(kernel, blur_tap_count(blur_radius));
+				double best_time = numeric_limits<double>::max();
+				for (size_t i = 0; i < run_count; ++i) {
+					start_stop_profiling prof(*dev_queue);
+					if (!blur->blur_single_stage(blur_radius, kernel, imgs[0], imgs[2])) {
+						best_time = 0.0;
+						break;
 					}
-					single_stage_blur_kernel = single_stage_blur_kernels[kernel_idx].get();
-					break;
+					best_time = min(best_time, prof.stop());
+				}
+				if (best_time == 0.0) {
+					log_msg("$: not supported by the device ($ bytes of local memory)",
+							single_stage_blur_kernel_names[kernel], local_memory_size);
+					continue;
+				}
+				const auto diff = compare_images(*dev_queue, *imgs[1], *imgs[2], 0u);
+				log_msg("$: best time $ms ($ MPixel/s), $ bytes of local memory, max difference vs. $: $",
+						single_stage_blur_kernel_names[kernel], best_time, mpixels / (best_time / 1000.0),
+						local_memory_size, ref_kernel_name, diff.max_diff);
+			}
+		}
+	}
+	
+	// -> fused filter graph
+	unique_ptr<img_filter_graph> filter_graph;
+	shared_ptr<compute_image> filter_graph_img;
+	if (!filter_graph_spec.empty()) {
+		filter_graph = make_unique<img_filter_graph>(*compute_ctx, *dev_queue);
+		if (!filter_graph->init(*blur->get_default_program()) ||
+			!filter_graph->add_stages(filter_graph_spec) ||
+			filter_graph->empty()) {
+			log_error("invalid filter graph: $", filter_graph_spec);
+			return -1;
+		}
+		filter_graph_img = compute_ctx->create_image(*dev_queue, filter_graph->output_size(image_size),
+													 COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+													 COMPUTE_IMAGE_TYPE::READ_WRITE,
+													 COMPUTE_MEMORY_FLAG::HOST_READ);
+		auto unfused_img = compute_ctx->create_image(*dev_queue, filter_graph->output_size(image_size),
+													 COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+													 COMPUTE_IMAGE_TYPE::READ_WRITE,
+													 COMPUTE_MEMORY_FLAG::HOST_READ);
+		if (!filter_graph_img || !unfused_img) {
+			log_error("failed to create filter graph output images");
+			return -1;
+		}
+		
+		// run each stage separately first (-> the fused result is the one that is displayed)
+		for (const auto fuse : { false, true }) {
+			double best_time = numeric_limits<double>::max();
+			for (size_t i = 0; i < run_count; ++i) {
+				start_stop_profiling prof(*dev_queue);
+				if (!filter_graph->run(imgs[0], fuse ? filter_graph_img : unfused_img, fuse)) {
+					return -1;
 				}
+				best_time = min(best_time, prof.stop());
 			}
-			if (!single_stage_blur_kernel) {
-				log_error("no single stage blur kernel is supported by the device");
+			log_msg("filter graph ($): $ launches, $ MiB of image reads/writes, best time $ms",
+					fuse ? "fused" : "unfused", filter_graph->launch_count(fuse),
+					double(filter_graph->global_memory_bytes(image_size, fuse)) / (1024.0 * 1024.0), best_time);
+		}
+		
+		// fused groups keep intermediates in float precision, while unfused stages round them to RGBA8 after each stage
+		// -> results aren't bit-identical, but the difference must stay within rounding noise (a single 8-bit rounding
+		//    step alone is ~59dB, following sharpen/tone stages amplify it), >= 40dB is considered a match
+		static constexpr const double filter_graph_min_psnr { 40.0 };
+		const auto diff = compare_images(*dev_queue, *filter_graph_img, *unfused_img, 0u);
+		if (diff.psnr >= filter_graph_min_psnr) {
+			log_msg("filter graph: fused vs. unfused: max difference $, PSNR $dB", diff.max_diff, diff.psnr);
+		} else {
+			log_error("filter graph: fused vs. unfused mismatch: max difference $, PSNR $dB (< $dB)",
+					  diff.max_diff, diff.psnr, filter_graph_min_psnr);
+		}
+	}
+	
+	// -> summed-area table blur, compared to the regular blur at the same sigma
+	unique_ptr<img_sat> sat;
+	shared_ptr<compute_image> sat_img;
+	if (sat_blur) {
+		sat = make_unique<img_sat>(*compute_ctx, *dev_queue);
+		if (!sat->init(*blur->get_default_program())) {
+			return -1;
+		}
+		sat_img = compute_ctx->create_image(*dev_queue, image_size,
+											COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+											COMPUTE_IMAGE_TYPE::READ_WRITE,
+											COMPUTE_MEMORY_FLAG::HOST_READ);
+		if (!sat_img) {
+			log_error("failed to create SAT blur output image");
+			return -1;
+		}
+		
+		const auto sigma = blur_sigma(blur_radius);
+		const auto box_radii = img_sat::gaussian_box_radii(sigma);
+		const auto mpixels = double(image_size.x) * double(image_size.y) / 1'000'000.0;
+		// the SAT box filter doesn't clamp-to-edge -> only compare the inner part
+		const auto border = blur_halo(blur_radius);
+		log_msg("SAT blur: sigma $ -> box radii $, $, $", sigma, box_radii[0], box_radii[1], box_radii[2]);
+		
+		// reference: regular blur (result is in imgs[1])
+		double ref_time = numeric_limits<double>::max();
+		for (size_t i = 0; i < run_count; ++i) {
+			start_stop_profiling prof(*dev_queue);
+			if (!blur->blur(blur_radius, blur_variant, imgs[0], imgs[2], imgs[1])) {
 				return -1;
 			}
-			log_debug("using single-stage blur kernel: $", single_stage_blur_kernel_names[kernel_idx]);
+			ref_time = min(ref_time, prof.stop());
+		}
+		log_msg("$: best time $ms ($ MPixel/s)", blur->get_last_kernel_name(), ref_time, mpixels / (ref_time / 1000.0));
+		
+		for (const auto use_float : { true, false }) {
+			const auto sat_type_str = (use_float ? "f32" : "u32");
+			double box_time = numeric_limits<double>::max();
+			for (size_t i = 0; i < run_count; ++i) {
+				start_stop_profiling prof(*dev_queue);
+				if (!sat->box(blur_radius, use_float, imgs[0], sat_img)) {
+					return -1;
+				}
+				box_time = min(box_time, prof.stop());
+			}
+			log_msg("SAT box ($): best time $ms ($ MPixel/s)", sat_type_str, box_time, mpixels / (box_time / 1000.0));
 			
-			// run single-stage blur
-			compute_queue::execution_parameters_t exec_params {
-				// run as 1D kernel
-				.execution_dim = 1u,
-				// total amount of work:
-				.global_work_size = { image_size.x * image_size.y, 0u, 0u },
-				// work per work-group:
-				.local_work_size = { single_stage_blur_local_size, 0u, 0u },
-				// kernel arguments:
-				.args = {
-					imgs[0], imgs[1]
-				},
-				.wait_until_completion = true,
-				.debug_label = "blur_single_stage",
-			};
+			double gaussian_time = numeric_limits<double>::max();
 			for (size_t i = 0; i < run_count; ++i) {
 				start_stop_profiling prof(*dev_queue);
-				dev_queue->execute_with_parameters(*single_stage_blur_kernel, exec_params);
-				const auto blur_end = prof.stop();
-				log_debug("blur run in $ms", blur_end);
+				if (!sat->gaussian(sigma, use_float, imgs[0], sat_img)) {
+					return -1;
+				}
+				gaussian_time = min(gaussian_time, prof.stop());
 			}
-		} else {
-			compute_queue::execution_parameters_t exec_params_horizontal {
-				// run as 2D kernel
-				.execution_dim = 2u,
-				// total amount of work:
-				.global_work_size = image_size,
-				// work per work-group:
-				.local_work_size = uint2 { 32, 16 },
-				// kernel arguments:
-				.args = {
-					imgs[0], imgs[2]
-				},
-				.wait_until_completion = true,
-				.debug_label = "blur_horizontal",
-			};
-			compute_queue::execution_parameters_t exec_params_vertical {
-				// run as 2D kernel
-				.execution_dim = 2u,
-				// total amount of work:
-				.global_work_size = image_size,
-				// work per work-group:
-				.local_work_size = uint2 { 32, 16 },
-				// kernel arguments:
-				.args = {
-					imgs[2], imgs[1]
-				},
-				.wait_until_completion = true,
-				.debug_label = "blur_vertical",
-			};
+			const auto diff = compare_images(*dev_queue, *imgs[1], *sat_img, border);
+			log_msg("SAT iterated box ($): best time $ms ($ MPixel/s), vs. $: max difference $, PSNR $dB (excluding a $px border)",
+					sat_type_str, gaussian_time, mpixels / (gaussian_time / 1000.0), blur->get_last_kernel_name(),
+					diff.max_diff, diff.psnr, border);
+		}
+	}
+	
+	// -> edge-preserving filters of the original image
+	unique_ptr<img_edge_filter> edge_filter;
+	shared_ptr<compute_image> bilateral_img, guided_img;
+	if (edge_filters) {
+		edge_filter = make_unique<img_edge_filter>(*compute_ctx, *dev_queue);
+		if (!edge_filter->init(*blur->get_default_program())) {
+			return -1;
+		}
+		for (auto img : { &bilateral_img, &guided_img }) {
+			*img = compute_ctx->create_image(*dev_queue, image_size,
+											 COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+											 COMPUTE_IMAGE_TYPE::READ_WRITE,
+											 COMPUTE_MEMORY_FLAG::HOST_READ);
+			if (!*img) {
+				log_error("failed to create edge filter output image");
+				return -1;
+			}
+		}
+		
+		const auto mpixels = double(image_size.x) * double(image_size.y) / 1'000'000.0;
+		const auto spatial_sigma = blur_sigma(blur_radius);
+		const auto time_filter = [&dev_queue, &mpixels](const string& name, const auto& filter) {
+			double best_time = numeric_limits<double>::max();
+			for (size_t i = 0; i < run_count; ++i) {
+				start_stop_profiling prof(*dev_queue);
+				if (!filter()) {
+					return false;
+				}
+				best_time = min(best_time, prof.stop());
+			}
+			log_msg("$: best time $ms ($ MPixel/s)", name, best_time, mpixels / (best_time / 1000.0));
+			return true;
+		};
+		
+		// brute-force vs. grid at the same sigmas (if the brute-force filter can handle the radius)
+		if (blur_radius <= EDGE_FILTER_MAX_RADIUS) {
+			if (!time_filter("bilateral (grid)", [&] {
+				return edge_filter->bilateral_grid(spatial_sigma, range_sigma, imgs[0], bilateral_img);
+			})) {
+				return -1;
+			}
+			auto grid_img = compute_ctx->create_image(*dev_queue, image_size,
+													  COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+													  COMPUTE_IMAGE_TYPE::READ_WRITE,
+													  COMPUTE_MEMORY_FLAG::HOST_READ);
+			if (!grid_img || !edge_filter->bilateral_grid(spatial_sigma, range_sigma, imgs[0], grid_img)) {
+				return -1;
+			}
+			if (!time_filter("bilateral (brute-force)", [&] {
+				return edge_filter->bilateral_brute_force(blur_radius, spatial_sigma, range_sigma, imgs[0], bilateral_img);
+			})) {
+				return -1;
+			}
+			const auto grid_dim = img_edge_filter::bilateral_grid_dim(image_size, spatial_sigma, range_sigma);
+			const auto diff = compare_images(*dev_queue, *bilateral_img, *grid_img, 0u);
+			log_msg("bilateral grid ($x$x$ cells of $px) vs. brute-force (radius $, spatial sigma $, range sigma $): max difference $, PSNR $dB",
+					grid_dim.x, grid_dim.y, grid_dim.z, grid_dim.w, blur_radius, spatial_sigma, range_sigma, diff.max_diff, diff.psnr);
+		} else if (!time_filter("bilateral (grid)", [&] {
+			return edge_filter->bilateral(blur_radius, range_sigma, imgs[0], bilateral_img);
+		})) {
+			return -1;
+		}
+		
+		const auto guided_radius = min(blur_radius, EDGE_FILTER_MAX_RADIUS);
+		if (!time_filter("guided (radius " + to_string(guided_radius) + ")", [&] {
+			return edge_filter->guided(guided_radius, guided_eps, imgs[0], guided_img);
+		})) {
+			return -1;
+		}
+	}
+	
+	// -> gaussian/laplacian pyramid of the original image, multi-level dispatches compared to one dispatch per level
+	unique_ptr<img_pyramid> pyramid;
+	if (pyramid_level_count > 0) {
+		pyramid = make_unique<img_pyramid>(*compute_ctx, *dev_queue);
+		auto single_level_pyramid = make_unique<img_pyramid>(*compute_ctx, *dev_queue);
+		if (!pyramid->init(*blur->get_default_program()) || !single_level_pyramid->init(*blur->get_default_program())) {
+			return -1;
+		}
+		const auto level_count = min(pyramid_level_count, img_pyramid::max_level_count(image_size));
+		const auto filter_str = (pyramid_filter == img_pyramid::FILTER::BOX ? "box" : "binomial");
+		
+		for (const auto multi_level : { false, true }) {
+			auto& cur_pyramid = (multi_level ? *pyramid : *single_level_pyramid);
+			double best_time = numeric_limits<double>::max();
 			for (size_t i = 0; i < run_count; ++i) {
 				start_stop_profiling prof(*dev_queue);
-				dev_queue->execute_with_parameters(*image_blur_dumb_h, exec_params_horizontal);
-				dev_queue->execute_with_parameters(*image_blur_dumb_v, exec_params_vertical);
-				const auto blur_end = prof.stop();
-				log_debug("dumb blur run in $ms", blur_end);
+				if (!cur_pyramid.build(imgs[0], level_count, pyramid_filter, multi_level)) {
+					return -1;
+				}
+				best_time = min(best_time, prof.stop());
 			}
+			log_msg("$ pyramid ($): $ levels, $ dispatches, best time $ms", filter_str,
+					multi_level ? "multi-level" : "single-level", level_count,
+					img_pyramid::dispatch_count(level_count, multi_level), best_time);
+		}
+		
+		// multi-level and single-level dispatches must produce the same levels
+		uint32_t max_level_diff = 0;
+		for (uint32_t level = 0; level < level_count; ++level) {
+			const auto diff = compare_images(*dev_queue, *pyramid->get_levels()[level], *single_level_pyramid->get_levels()[level], 0u);
+			max_level_diff = max(max_level_diff, diff.max_diff);
+		}
+		log_msg("pyramid: multi-level vs. single-level dispatches: max difference $", max_level_diff);
+		single_level_pyramid = nullptr;
+		
+		// laplacian pyramid -> must reconstruct the original image (up to half precision rounding)
+		auto collapse_img = compute_ctx->create_image(*dev_queue, image_size,
+													  COMPUTE_IMAGE_TYPE::IMAGE_2D | COMPUTE_IMAGE_TYPE::RGBA8UI_NORM |
+													  COMPUTE_IMAGE_TYPE::READ_WRITE,
+													  COMPUTE_MEMORY_FLAG::HOST_READ);
+		if (!collapse_img) {
+			log_error("failed to create pyramid collapse output image");
+			return -1;
+		}
+		double laplacian_time = numeric_limits<double>::max();
+		for (size_t i = 0; i < run_count; ++i) {
+			start_stop_profiling prof(*dev_queue);
+			if (!pyramid->build_laplacian()) {
+				return -1;
+			}
+			laplacian_time = min(laplacian_time, prof.stop());
+		}
+		if (!pyramid->collapse(collapse_img)) {
+			return -1;
 		}
+		const auto diff = compare_images(*dev_queue, *imgs[0], *collapse_img, 0u);
+		log_msg("laplacian pyramid: best time $ms, reconstruction vs. original: max difference $, PSNR $dB",
+				laplacian_time, diff.max_diff, diff.psnr);
 	}
 	
+	// all viewable images: original, blurred, intermediate + optional filter graph, SAT blur and edge filter output + pyramid levels
+	vector<shared_ptr<compute_image>> view_imgs(imgs.begin(), imgs.end());
+	if (filter_graph_img) {
+		view_imgs.emplace_back(filter_graph_img);
+	}
+	if (sat_img) {
+		view_imgs.emplace_back(sat_img);
+	}
+	if (bilateral_img) {
+		view_imgs.emplace_back(bilateral_img);
+		view_imgs.emplace_back(guided_img);
+	}
+	if (pyramid) {
+		view_imgs.insert(view_imgs.end(), pyramid->get_levels().begin(), pyramid->get_levels().end());
+	}
+	image_view_count = uint32_t(view_imgs.size());
+	
 	// render output image by default
 	cur_image = 1;
 	
@@ -372,27 +916,53 @@ int main(int, char* argv[]) {
 		floor::get_event()->handle_events();
 		
 		if(floor::is_new_fps_count()) {
-			floor::set_caption("img | FPS: " + to_string(floor::get_fps()));
+			floor::set_caption("img | FPS: " + to_string(floor::get_fps()) + " | radius: " + to_string(blur_radius));
+		}
+		
+		// re-run the blur if the radius was changed
+		if (blur_radius_changed) {
+			blur_radius_changed = false;
+			if (tuner) {
+				blur_variant = tuner->get_variant(blur_radius, image_size);
+			}
+			if (blur->prepare(blur_radius)) {
+				start_stop_profiling prof(*dev_queue);
+				if (blur->blur(blur_radius, blur_variant, imgs[0], imgs[2], imgs[1])) {
+					log_msg("blur (radius $) run in $ms ($)", blur_radius, prof.stop(), blur->get_last_kernel_name());
+				}
+			}
+			if (sat) {
+				start_stop_profiling prof(*dev_queue);
+				if (sat->gaussian(blur_sigma(blur_radius), false, imgs[0], sat_img)) {
+					log_msg("SAT iterated box blur (sigma $) run in $ms", blur_sigma(blur_radius), prof.stop());
+				}
+			}
 		}
 		
 		// s/w rendering
 		{
 			// grab the current image buffer data (read-only + blocking) ...
-			auto render_img = (uchar4*)imgs[cur_image]->map(*dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+			const auto& render_image = view_imgs[min(cur_image, image_view_count - 1u)];
+			const uint2 render_image_size = render_image->get_image_dim().xy;
+			auto render_img = (uchar4*)render_image->map(*dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
 			
 			// ... and blit it into the window
 			const auto wnd_surface = SDL_GetWindowSurface(floor::get_window());
 			SDL_LockSurface(wnd_surface);
-			const uint2 render_dim = image_size.minned(uint2 { floor::get_width(), floor::get_height() });
+			if ((render_image_size != image_size).any()) {
+				// smaller than the window -> clear the rest
+				SDL_FillSurfaceRect(wnd_surface, nullptr, 0);
+			}
+			const uint2 render_dim = render_image_size.minned(uint2 { floor::get_width(), floor::get_height() });
 			const auto px_format_details = SDL_GetPixelFormatDetails(wnd_surface->format);
 			for (uint32_t y = 0; y < render_dim.y; ++y) {
 				uint32_t* px_ptr = (uint32_t*)wnd_surface->pixels + ((size_t)wnd_surface->pitch / sizeof(uint32_t)) * y;
-				uint32_t img_idx = image_size.x * y;
+				uint32_t img_idx = render_image_size.x * y;
 				for (uint32_t x = 0; x < render_dim.x; ++x, ++img_idx) {
 					*px_ptr++ = SDL_MapRGB(px_format_details, nullptr, render_img[img_idx].x, render_img[img_idx].y, render_img[img_idx].z);
 				}
 			}
-			imgs[cur_image]->unmap(*dev_queue, render_img);
+			render_image->unmap(*dev_queue, render_img);
 			
 			SDL_UnlockSurface(wnd_surface);
 			SDL_UpdateWindowSurface(floor::get_window());
@@ -404,11 +974,18 @@ int main(int, char* argv[]) {
 	floor::get_event()->remove_event_handler(evt_handler_fnctr);
 	
 	// cleanup
+	view_imgs.clear();
 	imgs.fill(nullptr);
+	filter_graph_img = nullptr;
+	filter_graph = nullptr;
+	sat_img = nullptr;
+	sat = nullptr;
+	bilateral_img = nullptr;
+	guided_img = nullptr;
+	edge_filter = nullptr;
+	pyramid = nullptr;
 	
-	image_blur_dumb_v = nullptr;
-	image_blur_dumb_h = nullptr;
-	img_prog = nullptr;
+	blur = nullptr;
 	dev_queue = nullptr;
 	compute_ctx = nullptr;
 	
@@ -28,7 +28,13 @@
 #include <chrono>
 #include "unified_renderer.hpp"
 #include "nbody_state.hpp"
+#include "nbody_snapshot.hpp"
+#include "nbody_diagnostics.hpp"
+#include "nbody_benchmark.hpp"
 #include <SDL3/SDL_main.h>
+#if !defined(FLOOR_IOS)
+#include <SDL3_image/SDL_image.h>
+#endif
 using namespace std;
 
 nbody_state_struct nbody_state;
@@ -68,6 +74,16 @@ static constexpr const size_t pos_buffer_count { 3 };
 static array<shared_ptr<device_buffer>, pos_buffer_count> position_buffers;
 // nbody velocity buffer
 static shared_ptr<device_buffer> velocity_buffer;
+// block time-stepping: time step level of each body, compacted list of active bodies and their count
+static shared_ptr<device_buffer> level_buffer;
+static shared_ptr<device_buffer> active_index_buffer;
+static shared_ptr<device_buffer> active_count_buffer;
+// reads back the current distribution of bodies across all block time step levels (#bodies per level)
+static vector<uint32_t> read_block_level_counts();
+// logs the distribution of bodies across all block time step levels
+static void log_block_levels(const vector<uint32_t>& level_counts);
+// returns the amount of body/body interactions that the tile schedule of one full step executes with this level distribution
+static uint64_t compute_block_interactions(const vector<uint32_t>& level_counts);
 // iterates over [0, pos_buffer_count - 1] (-> currently active position buffer)
 static size_t buffer_flip_flop { 0 };
 // current iteration number (used to track/compute gflops, resets every 100 iterations)
@@ -80,10 +96,44 @@ static void init_system();
 static void export_nbody_system();
 // set to true when the nbody system should be exported after the next run
 static atomic<bool> export_next_run { false };
+// set to true when a snapshot of the nbody system should be written after the next run
+static atomic<bool> snapshot_next_run { false };
 // the amount of nbody compute iterations that will be performed for the benchmark
 static constexpr const uint32_t benchmark_iterations { 100 };
 // when using indirect command pipelines: this contains the full 100 iterations of the nbody benchmark
 static unique_ptr<indirect_command_pipeline> indirect_benchmark_pipeline;
+// total amount of simulation steps since the current nbody system was initialized (or at which it was loaded)
+static uint64_t sim_step { 0 };
+// total simulated time since the current nbody system was initialized (or at which it was loaded)
+static double sim_time { 0.0 };
+// if set: the nbody snapshot that is loaded instead of generating the initial nbody system
+static string snapshot_load_file;
+// if non-zero: a snapshot is written every N simulation steps
+static uint32_t snapshot_save_interval { 0u };
+// file name prefix of written snapshots (-> "<prefix>_<step>.nbody")
+static string snapshot_save_prefix { "nbody_snapshot" };
+// if set: body positions are streamed to this trajectory file every "trajectory_interval" simulation steps
+static string trajectory_file;
+static uint32_t trajectory_interval { 1u };
+// async snapshot/trajectory writer (not used in benchmark mode)
+static unique_ptr<nbody_snapshot::async_writer> snapshot_writer;
+// loads the nbody system from "snapshot_load_file"
+static bool load_nbody_system();
+// creates a snapshot header for the current nbody system
+static nbody_snapshot::header_t make_snapshot_header();
+// if non-zero: conserved-quantity diagnostics are computed every N simulation steps
+static uint32_t diagnostics_interval { 0u };
+// if set: diagnostics are also written to this CSV file
+static string diagnostics_csv_file;
+// diagnostics state/output (only created if enabled)
+static unique_ptr<nbody_diagnostics> diagnostics;
+// if set: runs the benchmark suite instead of the simulation
+static bool run_benchmark_suite { false };
+static nbody_benchmark::config_t benchmark_suite_config;
+// file name prefix of PNG frames written in headless mode (-> "<prefix>_<frame>.png")
+static string frame_prefix { "nbody_frame" };
+// writes the specified s/w rendered RGBA8 image to a PNG file
+static bool dump_frame(const string& file_name, const uchar4* img_data, const uint2& img_size);
 
 //! option -> function map
 template<> vector<pair<string, nbody_opt_handler::option_function>> nbody_opt_handler::options {
@@ -100,14 +150,32 @@ template<> vector<pair<string, nbody_opt_handler::option_function>> nbody_opt_ha
 #endif
 		cout << "\t--no-vulkan: disables vulkan rendering (uses s/w rendering instead)" << endl;
 		cout << "\t--benchmark: runs the simulation in benchmark mode, without rendering" << endl;
+		cout << "\t--benchmark-suite: runs the headless benchmark suite (all combinations of body counts, tile sizes, FMA/non-FMA and direct/indirect execution)" << endl;
+		cout << "\t--suite-counts <count,...>: body counts used by the benchmark suite" << endl;
+		cout << "\t--suite-tile-sizes <size,...>: tile sizes used by the benchmark suite" << endl;
+		cout << "\t--suite-iterations <count>: #simulation steps per timed run in the benchmark suite (default: " << benchmark_suite_config.iterations << ")" << endl;
+		cout << "\t--suite-repeats <count>: #timed runs per configuration in the benchmark suite (default: " << benchmark_suite_config.repeats << ")" << endl;
+		cout << "\t--suite-json <file>: file the benchmark suite results are written to (default: " << benchmark_suite_config.json_file_name << ")" << endl;
 		cout << "\t--type <type>: sets the initial nbody setup (default: on-sphere)" << endl;
 		for(const auto& desc : nbody_setup_desc) {
 			cout << "\t\t" << desc << endl;
 		}
-		cout << "\t--render-size <work-items>: sets the amount of work-items/work-group when using s/w rendering" << endl;
+		cout << "\t--render-size <work-items>: sets the amount of work-items/work-group of the s/w rasterizer projection and binning kernels" << endl;
 		cout << "\t--no-msaa: disable 4xMSAA rendering" << endl;
 		cout << "\t--no-indirect: disables indirect command pipeline usage" << endl;
 		cout << "\t--no-fubar: don't use the compiled FUBAR file/data if it exists (integrated or on disk)" << endl;
+		cout << "\t--load <file>: loads/resumes the nbody system from the specified snapshot file (overrides --count and --type)" << endl;
+		cout << "\t--save-every <steps>: writes a snapshot every N simulation steps (default: disabled)" << endl;
+		cout << "\t--save-prefix <prefix>: file name prefix of written snapshots (default: " << snapshot_save_prefix << ")" << endl;
+		cout << "\t--trajectory <file> <steps>: streams all body positions to the specified trajectory file every N simulation steps" << endl;
+		cout << "\t--block-levels <levels>: enables hierarchical block time-stepping with time steps of time-step / 2^[0, levels] (default: disabled)" << endl;
+		cout << "\t--block-eta <eta>: sets the accuracy parameter of the block time step criterion dt = eta * sqrt(softening / |acceleration|) (default: " << nbody_state.block_eta << ")" << endl;
+		cout << "\t--diagnostics <steps>: computes and logs total energy, linear/angular momentum and the bounding box every N simulation steps" << endl;
+		cout << "\t--diagnostics-csv <file>: also writes all diagnostics to the specified CSV file (requires --diagnostics)" << endl;
+		cout << "\t--headless <frames>: runs the simulation and s/w rasterizer for N frames without a window and writes each frame to a PNG file" << endl;
+		cout << "\t--frame-size <width> <height>: sets the image size used in headless mode (default: " << nbody_state.headless_size << ")" << endl;
+		cout << "\t--frame-prefix <prefix>: file name prefix of PNG frames written in headless mode (default: " << frame_prefix << ")" << endl;
+		cout << "\t--no-frame-dump: don't write PNG frames in headless mode (s/w rasterizer benchmarking)" << endl;
 		nbody_state.done = true;
 		
 		cout << endl;
@@ -118,6 +186,8 @@ template<> vector<pair<string, nbody_opt_handler::option_function>> nbody_opt_ha
 		cout << "\tw/s/right-mouse-drag: move camera forwards/backwards" << endl;
 		cout << "\tleft-mouse-drag: rotate camera" << endl;
 		cout << "\tt: toggle rendering between alpha/transparent and solid non-transparent particles" << endl;
+		cout << "\te: export the current body positions" << endl;
+		cout << "\tp: write a snapshot of the current nbody system" << endl;
 		cout << "\t1-5: reset simulation and set used nbody setup (";
 		for(uint32_t num = 1; num <= (uint32_t)NBODY_SETUP::__MAX_NBODY_SETUP; ++num) {
 			const string desc_str = nbody_setup_desc[num - 1];
@@ -246,6 +316,69 @@ template<> vector<pair<string, nbody_opt_handler::option_function>> nbody_opt_ha
 		nbody_state.benchmark = true;
 		cout << "benchmark mode enabled" << endl;
 	}},
+	{ "--benchmark-suite", [](nbody_option_context&, char**&) {
+		nbody_state.no_metal = true; // also disable metal
+		nbody_state.no_vulkan = true; // also disable vulkan
+		nbody_state.benchmark = true;
+		run_benchmark_suite = true;
+		cout << "benchmark suite enabled" << endl;
+	}},
+	{ "--suite-counts", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --suite-counts!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		benchmark_suite_config.body_counts = nbody_benchmark::parse_uint_list(*arg_ptr);
+		if (benchmark_suite_config.body_counts.empty()) {
+			cerr << "invalid body count list: " << *arg_ptr << endl;
+			nbody_state.done = true;
+		}
+	}},
+	{ "--suite-tile-sizes", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --suite-tile-sizes!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		benchmark_suite_config.tile_sizes = nbody_benchmark::parse_uint_list(*arg_ptr);
+		if (benchmark_suite_config.tile_sizes.empty()) {
+			cerr << "invalid tile size list: " << *arg_ptr << endl;
+			nbody_state.done = true;
+		}
+	}},
+	{ "--suite-iterations", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --suite-iterations!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		benchmark_suite_config.iterations = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+		cout << "benchmark suite iterations set to: " << benchmark_suite_config.iterations << endl;
+	}},
+	{ "--suite-repeats", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --suite-repeats!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		benchmark_suite_config.repeats = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+		cout << "benchmark suite repeats set to: " << benchmark_suite_config.repeats << endl;
+	}},
+	{ "--suite-json", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --suite-json!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		benchmark_suite_config.json_file_name = *arg_ptr;
+		cout << "benchmark suite JSON file set to: " << benchmark_suite_config.json_file_name << endl;
+	}},
 	{ "--type", [](nbody_option_context&, char**& arg_ptr) {
 		++arg_ptr;
 		if(*arg_ptr == nullptr || **arg_ptr == '-') {
@@ -290,6 +423,138 @@ template<> vector<pair<string, nbody_opt_handler::option_function>> nbody_opt_ha
 		nbody_state.no_fubar = true;
 		cout << "FUBAR disabled" << endl;
 	}},
+	{ "--load", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --load!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		snapshot_load_file = *arg_ptr;
+		cout << "loading nbody snapshot: " << snapshot_load_file << endl;
+	}},
+	{ "--save-every", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --save-every!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		snapshot_save_interval = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		cout << "writing a snapshot every " << snapshot_save_interval << " steps" << endl;
+	}},
+	{ "--save-prefix", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --save-prefix!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		snapshot_save_prefix = *arg_ptr;
+		cout << "snapshot prefix set to: " << snapshot_save_prefix << endl;
+	}},
+	{ "--trajectory", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --trajectory!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		trajectory_file = *arg_ptr;
+		
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after second --trajectory parameter!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		trajectory_interval = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+		cout << "writing trajectory to " << trajectory_file << " every " << trajectory_interval << " steps" << endl;
+	}},
+	{ "--block-levels", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --block-levels!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		nbody_state.block_levels = min((uint32_t)strtoul(*arg_ptr, nullptr, 10), 16u);
+		cout << "block time-step levels set to: " << nbody_state.block_levels << endl;
+	}},
+	{ "--block-eta", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --block-eta!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		nbody_state.block_eta = strtof(*arg_ptr, nullptr);
+		cout << "block time-step eta set to: " << nbody_state.block_eta << endl;
+	}},
+	{ "--diagnostics", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --diagnostics!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		diagnostics_interval = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		cout << "computing diagnostics every " << diagnostics_interval << " steps" << endl;
+	}},
+	{ "--diagnostics-csv", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --diagnostics-csv!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		diagnostics_csv_file = *arg_ptr;
+		cout << "writing diagnostics to: " << diagnostics_csv_file << endl;
+	}},
+	{ "--headless", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --headless!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		nbody_state.headless_frames = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+		nbody_state.no_metal = true; // also disable metal
+		nbody_state.no_vulkan = true; // also disable vulkan
+		cout << "headless mode enabled: rendering " << nbody_state.headless_frames << " frames" << endl;
+	}},
+	{ "--frame-size", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --frame-size!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		nbody_state.headless_size.x = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+		
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after second --frame-size parameter!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		nbody_state.headless_size.y = max((uint32_t)strtoul(*arg_ptr, nullptr, 10), 1u);
+		cout << "frame size set to: " << nbody_state.headless_size << endl;
+	}},
+	{ "--frame-prefix", [](nbody_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if(*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --frame-prefix!" << endl;
+			nbody_state.done = true;
+			return;
+		}
+		frame_prefix = *arg_ptr;
+		cout << "frame prefix set to: " << frame_prefix << endl;
+	}},
+	{ "--no-frame-dump", [](nbody_option_context&, char**&) {
+		nbody_state.frame_dump = false;
+		cout << "frame dump disabled" << endl;
+	}},
 	// ignore xcode debug arg
 	{ "-NSDocumentRevisionsDebugMode", [](nbody_option_context&, char**&) {} },
 	{ "-ApplePersistenceIgnoreState", [](nbody_option_context&, char**&) {} },
@@ -340,6 +605,9 @@ static bool evt_handler(EVENT_TYPE type, shared_ptr<event_object> obj) {
 			case SDLK_E:
 				export_next_run = true;
 				break;
+			case SDLK_P:
+				snapshot_next_run = true;
+				break;
 			default: break;
 		}
 		return true;
@@ -492,6 +760,18 @@ static bool evt_handler(EVENT_TYPE type, shared_ptr<event_object> obj) {
 void init_system() {
 	// finish up old execution before we start with anything new
 	dev_queue->finish();
+	if (snapshot_writer) {
+		// can't overwrite position buffers that are still being read back
+		snapshot_writer->flush();
+	}
+	if (diagnostics) {
+		// new system -> new reference energy
+		diagnostics->reset();
+	}
+	if (level_buffer) {
+		// all bodies start on the coarsest level and choose their level in the first sub-step
+		level_buffer->zero(*dev_queue);
+	}
 	
 	auto positions = (float4*)position_buffers[0]->map(*dev_queue, MEMORY_MAP_FLAG::WRITE_INVALIDATE | MEMORY_MAP_FLAG::BLOCK);
 	auto velocities = (float3*)velocity_buffer->map(*dev_queue, MEMORY_MAP_FLAG::WRITE_INVALIDATE | MEMORY_MAP_FLAG::BLOCK);
@@ -588,6 +868,50 @@ void init_system() {
 	buffer_flip_flop = 0;
 	iteration = 0;
 	sim_time_sum = 0.0L;
+	sim_step = 0;
+	sim_time = 0.0;
+}
+
+nbody_snapshot::header_t make_snapshot_header() {
+	return {
+		.body_count = nbody_state.body_count,
+		.step = sim_step,
+		.sim_time = sim_time,
+		.time_step = nbody_state.time_step,
+		.softening = nbody_state.softening,
+		.damping = nbody_state.damping,
+		.setup = uint32_t(nbody_setup),
+		.mass_min = nbody_state.mass_minmax.x,
+		.mass_max = nbody_state.mass_minmax.y,
+		.frame_interval = trajectory_interval,
+	};
+}
+
+bool load_nbody_system() {
+	dev_queue->finish();
+	
+	nbody_snapshot::header_t header;
+	if (!nbody_snapshot::load(snapshot_load_file, *dev_queue, *position_buffers[0], *velocity_buffer, header)) {
+		return false;
+	}
+	
+	if (header.setup < uint32_t(NBODY_SETUP::__MAX_NBODY_SETUP)) {
+		nbody_setup = NBODY_SETUP(header.setup);
+	}
+	nbody_state.mass_minmax = { header.mass_min, header.mass_max };
+	nbody_state.time_step = header.time_step;
+	if (header.softening != nbody_state.softening || header.damping != nbody_state.damping) {
+		log_warn("snapshot was created with softening $ and damping $, but running with softening $ and damping $",
+				 header.softening, header.damping, nbody_state.softening, nbody_state.damping);
+	}
+	
+	buffer_flip_flop = 0;
+	iteration = 0;
+	sim_time_sum = 0.0L;
+	sim_step = header.step;
+	sim_time = header.sim_time;
+	log_msg("loaded nbody snapshot \"$\": $ bodies @ step $", snapshot_load_file, header.body_count, header.step);
+	return true;
 }
 
 void export_nbody_system() {
@@ -607,6 +931,73 @@ void export_nbody_system() {
 	}
 }
 
+vector<uint32_t> read_block_level_counts() {
+	dev_queue->finish();
+	auto levels = make_unique<uint32_t[]>(nbody_state.body_count);
+	level_buffer->read(*dev_queue, levels.get(), sizeof(uint32_t) * nbody_state.body_count);
+	
+	vector<uint32_t> level_counts(nbody_state.block_levels + 1u, 0u);
+	for (uint32_t i = 0; i < nbody_state.body_count; ++i) {
+		++level_counts[min(levels[i], nbody_state.block_levels)];
+	}
+	return level_counts;
+}
+
+void log_block_levels(const vector<uint32_t>& level_counts) {
+	// a body on level k is evaluated 2^k times per full step,
+	// compared to 2^block_levels times for all bodies when using a uniform time step of the finest level
+	uint64_t force_evals { 0u };
+	string level_str;
+	for (uint32_t level = 0; level <= nbody_state.block_levels; ++level) {
+		force_evals += uint64_t(level_counts[level]) << level;
+		level_str += (level > 0 ? ", " : "") + to_string(level_counts[level]);
+	}
+	const auto uniform_force_evals = uint64_t(nbody_state.body_count) << nbody_state.block_levels;
+	log_debug("block time-step levels: [$] -> $ force evaluations per step ($x less than with a uniform time step)",
+			  level_str, force_evals, double(uniform_force_evals) / double(max(force_evals, uint64_t(1u))));
+}
+
+uint64_t compute_block_interactions(const vector<uint32_t>& level_counts) {
+	// nbody_compute_active is executed by whole work-groups over the compacted active bodies of each sub-step,
+	// with each work-item interacting with all bodies -> the active count is rounded up to the tile size
+	uint64_t interactions { 0u };
+	for (uint32_t sub_step = 0, sub_step_count = (1u << nbody_state.block_levels); sub_step < sub_step_count; ++sub_step) {
+		uint64_t active_count { 0u };
+		for (uint32_t level = 0; level <= nbody_state.block_levels; ++level) {
+			// same as is_block_active() in nbody.cpp
+			if ((sub_step & ((1u << (nbody_state.block_levels - level)) - 1u)) == 0u) {
+				active_count += level_counts[level];
+			}
+		}
+		const auto active_tiles = (active_count + nbody_state.tile_size - 1u) / nbody_state.tile_size;
+		interactions += active_tiles * nbody_state.tile_size * uint64_t(nbody_state.body_count);
+	}
+	return interactions;
+}
+
+bool dump_frame(const string& file_name, const uchar4* img_data, const uint2& img_size) {
+#if !defined(FLOOR_IOS)
+	// s/w rasterizer image data is stored as R8G8B8A8 in memory order
+	auto surface = SDL_CreateSurfaceFrom(int(img_size.x), int(img_size.y), SDL_PIXELFORMAT_RGBA32,
+										 (void*)img_data, int(img_size.x * sizeof(uchar4)));
+	if (surface == nullptr) {
+		log_error("failed to create frame surface: $", SDL_GetError());
+		return false;
+	}
+	const auto success = IMG_SavePNG(surface, file_name.c_str());
+	if (!success) {
+		log_error("failed to write frame \"$\": $", file_name, SDL_GetError());
+	}
+	SDL_DestroySurface(surface);
+	return success;
+#else
+	log_error("can't write frame \"$\": PNG output is not supported on iOS", file_name);
+	(void)img_data;
+	(void)img_size;
+	return false;
+#endif
+}
+
 // embed the compiled nbody FUBAR file if it is available
 #if __has_embed("../../data/nbody.fubar")
 static constexpr const uint8_t nbody_fubar[] {
@@ -637,9 +1028,9 @@ int main(int, char* argv[]) {
 		.data_path = "data/",
 #endif
 		.app_name = "nbody",
-		.console_only = nbody_state.benchmark,
+		.console_only = (nbody_state.benchmark || nbody_state.headless_frames > 0u),
 		.renderer = (// no renderer when running in console-only mode
-					 nbody_state.benchmark ? floor::RENDERER::NONE :
+					 (nbody_state.benchmark || nbody_state.headless_frames > 0u) ? floor::RENDERER::NONE :
 					 // if Metal/Vulkan aren't disabled, use the default renderer for the platform
 					 (!nbody_state.no_metal && !nbody_state.no_vulkan) ? floor::RENDERER::DEFAULT :
 					 // else: choose a specific one
@@ -699,6 +1090,18 @@ int main(int, char* argv[]) {
 		render_dev_queue = (render_dev != compute_dev ? render_ctx->create_queue(*render_dev) : dev_queue);
 	}
 
+	// benchmark suite: runs standalone and exits
+	if (run_benchmark_suite) {
+		benchmark_suite_config.no_indirect = nbody_state.no_indirect;
+		const auto success = nbody_benchmark::run(*compute_ctx, *compute_dev, *dev_queue, benchmark_suite_config);
+		dev_queue = nullptr;
+		render_dev_queue = nullptr;
+		compute_ctx = nullptr;
+		render_ctx = nullptr;
+		floor::destroy();
+		return (success ? 0 : -1);
+	}
+	
 	// parameter sanity check
 	if (nbody_state.tile_size > compute_dev->max_total_local_size) {
 		nbody_state.tile_size = (uint32_t)compute_dev->max_total_local_size;
@@ -714,12 +1117,52 @@ int main(int, char* argv[]) {
 				  NBODY_TILE_SIZE);
 		nbody_state.tile_size = NBODY_TILE_SIZE;
 	}
+	if (!snapshot_load_file.empty()) {
+		// body count is defined by the snapshot
+		const auto snapshot_header = nbody_snapshot::read_header(snapshot_load_file);
+		if (!snapshot_header) {
+			return -1;
+		}
+		if (snapshot_header->type != nbody_snapshot::FILE_TYPE::SNAPSHOT) {
+			log_error("\"$\" is not a snapshot file", snapshot_load_file);
+			return -1;
+		}
+		if ((snapshot_header->body_count % nbody_state.tile_size) != 0u) {
+			log_error("snapshot body count ($) must be a multiple of the tile size ($)",
+					  snapshot_header->body_count, nbody_state.tile_size);
+			return -1;
+		}
+		nbody_state.body_count = snapshot_header->body_count;
+	}
+	if (nbody_state.benchmark && (snapshot_save_interval > 0u || !trajectory_file.empty())) {
+		log_warn("snapshot and trajectory output is disabled in benchmark mode");
+		snapshot_save_interval = 0u;
+		trajectory_file.clear();
+	}
+	if (nbody_state.benchmark && nbody_state.block_levels > 0u) {
+		log_warn("block time-stepping is disabled in benchmark mode");
+		nbody_state.block_levels = 0u;
+	}
+	if (nbody_state.benchmark && diagnostics_interval > 0u) {
+		log_warn("diagnostics are disabled in benchmark mode");
+		diagnostics_interval = 0u;
+	}
+	if (!diagnostics_csv_file.empty() && diagnostics_interval == 0u) {
+		log_warn("--diagnostics-csv requires --diagnostics <steps>");
+	}
 
 	shared_ptr<device_program> nbody_prog;
 	shared_ptr<device_program> nbody_render_prog;
 	shared_ptr<device_function> nbody_compute;
 	shared_ptr<device_function> nbody_compute_fixed_delta;
-	shared_ptr<device_function> nbody_raster;
+	shared_ptr<device_function> nbody_diagnostics_function;
+	shared_ptr<device_function> nbody_block_compact;
+	shared_ptr<device_function> nbody_compute_active;
+	shared_ptr<device_function> nbody_drift;
+	shared_ptr<device_function> nbody_raster_project;
+	shared_ptr<device_function> nbody_raster_scan;
+	shared_ptr<device_function> nbody_raster_bin;
+	shared_ptr<device_function> nbody_raster_tiles;
 	
 	// if embedded FUBAR data exists + it isn't disabled, try to load this first
 #if defined(HAS_EMBEDDED_FUBAR)
@@ -764,11 +1207,31 @@ int main(int, char* argv[]) {
 	// get the kernel functions
 	nbody_compute = nbody_prog->get_function("nbody_compute");
 	nbody_compute_fixed_delta = nbody_prog->get_function("nbody_compute_fixed_delta");
-	nbody_raster = nbody_prog->get_function("nbody_raster");
-	if (nbody_compute == nullptr || nbody_compute_fixed_delta == nullptr || nbody_raster == nullptr) {
+	nbody_raster_project = nbody_prog->get_function("nbody_raster_project");
+	nbody_raster_scan = nbody_prog->get_function("nbody_raster_scan");
+	nbody_raster_bin = nbody_prog->get_function("nbody_raster_bin");
+	nbody_raster_tiles = nbody_prog->get_function("nbody_raster_tiles");
+	if (nbody_compute == nullptr || nbody_compute_fixed_delta == nullptr || nbody_raster_project == nullptr ||
+		nbody_raster_scan == nullptr || nbody_raster_bin == nullptr || nbody_raster_tiles == nullptr) {
 		log_error("failed to retrieve kernel(s) from program");
 		return -1;
 	}
+	if (nbody_state.block_levels > 0u) {
+		nbody_block_compact = nbody_prog->get_function("nbody_block_compact");
+		nbody_compute_active = nbody_prog->get_function("nbody_compute_active");
+		nbody_drift = nbody_prog->get_function("nbody_drift");
+		if (nbody_block_compact == nullptr || nbody_compute_active == nullptr || nbody_drift == nullptr) {
+			log_error("failed to retrieve block time-stepping kernel(s) from program");
+			return -1;
+		}
+	}
+	if (diagnostics_interval > 0u) {
+		nbody_diagnostics_function = nbody_prog->get_function("nbody_diagnostics");
+		if (nbody_diagnostics_function == nullptr) {
+			log_error("failed to retrieve diagnostics kernel from program");
+			return -1;
+		}
+	}
 
 	// init unified/metal/vulkan renderers (need compiled prog first)
 	if (floor_renderer != floor::RENDERER::NONE) {
@@ -803,31 +1266,80 @@ int main(int, char* argv[]) {
 		position_buffers[i] = compute_ctx->create_buffer(*dev_queue, sizeof(float4) * nbody_state.body_count,
 														 ( // will be reading and writing from the kernel
 															 MEMORY_FLAG::READ_WRITE
-															 // host will only write data
-															 | MEMORY_FLAG::HOST_WRITE
+															 // host will write data (init/load) and read data (export/snapshots)
+															 | MEMORY_FLAG::HOST_READ_WRITE
 															 // graphics sharing flags are set above
 															 | graphics_sharing_flags));
 	}
 	velocity_buffer = compute_ctx->create_buffer(*dev_queue, sizeof(float3) * nbody_state.body_count,
-												 MEMORY_FLAG::READ_WRITE | MEMORY_FLAG::HOST_WRITE);
+												 MEMORY_FLAG::READ_WRITE | MEMORY_FLAG::HOST_READ_WRITE);
+	if (nbody_state.block_levels > 0u) {
+		level_buffer = compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t) * nbody_state.body_count,
+												  MEMORY_FLAG::READ_WRITE | MEMORY_FLAG::HOST_READ);
+		active_index_buffer = compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t) * nbody_state.body_count,
+														 MEMORY_FLAG::READ_WRITE);
+		active_count_buffer = compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t), MEMORY_FLAG::READ_WRITE);
+		level_buffer->zero(*dev_queue);
+	}
 
-	// image buffers (for s/w rendering only)
-	const uint2 img_size { floor::get_physical_screen_size() };
-	size_t img_buffer_flip_flop { 0 };
-	array<shared_ptr<device_buffer>, 2> img_buffers;
+	// image and tile binning buffers (for s/w rendering only)
+	const bool is_headless = (nbody_state.headless_frames > 0u);
+	const uint2 img_size { is_headless ? nbody_state.headless_size : floor::get_physical_screen_size() };
+	const uint2 raster_tile_count { (img_size + (NBODY_RASTER_TILE_SIZE - 1u)) / NBODY_RASTER_TILE_SIZE };
+	const uint32_t raster_total_tile_count { raster_tile_count.x * raster_tile_count.y };
+	shared_ptr<device_buffer> img_buffer;
+	// projected bodies: .xy = window position, .z = radius, .w = normalized mass
+	shared_ptr<device_buffer> sprite_buffer;
+	// #sprites per tile (always zero again after binning)
+	shared_ptr<device_buffer> tile_count_buffer;
+	// offset of each tile in the tile bin list (+ total #binned sprites at the end)
+	shared_ptr<device_buffer> tile_offset_buffer;
+	// sprite indices of all tiles (a sprite overlaps at most 2x2 tiles)
+	shared_ptr<device_buffer> tile_bin_buffer;
 	if (floor_renderer == floor::RENDERER::NONE && !nbody_state.benchmark) {
-		img_buffers = { {
-			compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t) * img_size.x * img_size.y,
-									   MEMORY_FLAG::READ_WRITE | MEMORY_FLAG::HOST_READ),
-			compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t) * img_size.x * img_size.y,
-									   MEMORY_FLAG::READ_WRITE | MEMORY_FLAG::HOST_READ),
-		} };
-		img_buffers[0]->zero(*dev_queue);
-		img_buffers[1]->zero(*dev_queue);
+		img_buffer = compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t) * img_size.x * img_size.y,
+												MEMORY_FLAG::READ_WRITE | MEMORY_FLAG::HOST_READ);
+		sprite_buffer = compute_ctx->create_buffer(*dev_queue, sizeof(float4) * nbody_state.body_count, MEMORY_FLAG::READ_WRITE);
+		tile_count_buffer = compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t) * raster_total_tile_count,
+													   MEMORY_FLAG::READ_WRITE);
+		tile_offset_buffer = compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t) * (raster_total_tile_count + 1u),
+														MEMORY_FLAG::READ_WRITE);
+		tile_bin_buffer = compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t) * 4u * size_t(nbody_state.body_count),
+													 MEMORY_FLAG::READ_WRITE);
+		img_buffer->zero(*dev_queue);
+		tile_count_buffer->zero(*dev_queue);
+	}
+	// headless mode: #rendered frames
+	uint32_t headless_frame { 0u };
+	// accumulated s/w rasterizer time (in ms) and #frames since the last time it was logged
+	double raster_time_sum { 0.0 };
+	uint32_t raster_frame_count { 0u };
+	
+	// conserved-quantity diagnostics
+	if (diagnostics_interval > 0u) {
+		diagnostics = make_unique<nbody_diagnostics>(*compute_ctx, *dev_queue, nbody_state.body_count, nbody_state.tile_size,
+													 diagnostics_csv_file);
+		if (!diagnostics->is_valid()) {
+			return -1;
+		}
 	}
 
-	// init nbody system
-	init_system();
+	// init nbody system (or load it from a snapshot)
+	if (!snapshot_load_file.empty()) {
+		if (!load_nbody_system()) {
+			return -1;
+		}
+	} else {
+		init_system();
+	}
+	
+	// snapshot and trajectory output (uses its own queue for position readback)
+	if (!nbody_state.benchmark) {
+		snapshot_writer = make_unique<nbody_snapshot::async_writer>(*compute_ctx, *compute_dev);
+		if (!trajectory_file.empty() && !snapshot_writer->open_trajectory(trajectory_file, make_snapshot_header())) {
+			return -1;
+		}
+	}
 
 	// create the indirect command pipeline for benchmarking
 	if (nbody_state.benchmark && !nbody_state.no_indirect) {
@@ -877,17 +1389,18 @@ int main(int, char* argv[]) {
 		floor::get_event()->handle_events();
 		
 		// simple iteration time -> gflops mapping function (note that flops per interaction is a fixed number)
-		const auto compute_gflops = [](const double& iter_time_in_ms, const bool use_fma) {
+		// "interaction_count" is the amount of body/body interactions per iteration
+		const auto compute_gflops = [](const double& iter_time_in_ms, const uint64_t interaction_count, const bool use_fma) {
 			if(!use_fma) {
-				const size_t flops_per_body { 19 };
-				const size_t flops_per_iter { size_t(nbody_state.body_count) * size_t(nbody_state.body_count) * flops_per_body };
+				const size_t flops_per_body { NBODY_FLOPS_PER_INTERACTION };
+				const size_t flops_per_iter { interaction_count * flops_per_body };
 				return ((1000.0 / iter_time_in_ms) * (double)flops_per_iter) / 1'000'000'000.0;
 			}
 			else {
 				// NOTE: GPUs and recent CPUs support fma instructions, thus performing 2 floating point operations
 				// in 1 cycle instead of 2 -> to account for that, compute some kind of "actual ops done" metric
-				const size_t flops_per_body_fma { 13 };
-				const size_t flops_per_iter_fma { size_t(nbody_state.body_count) * size_t(nbody_state.body_count) * flops_per_body_fma };
+				const size_t flops_per_body_fma { NBODY_FLOPS_PER_INTERACTION_FMA };
+				const size_t flops_per_iter_fma { interaction_count * flops_per_body_fma };
 				return ((1000.0 / iter_time_in_ms) * (double)flops_per_iter_fma) / 1'000'000'000.0;
 			}
 		};
@@ -900,7 +1413,7 @@ int main(int, char* argv[]) {
 		const size_t next_buffer = (buffer_flip_flop + 1) % pos_buffer_count;
 		if (!nbody_state.stop) {
 			//log_debug("delta: $ms /// $ gflops", 1000.0f * float(((double)delta.count()) / time_den),
-			//		  compute_gflops(1000.0 * (((double)delta.count()) / time_den), false));
+			//		  compute_gflops(1000.0 * (((double)delta.count()) / time_den), uint64_t(nbody_state.body_count) * nbody_state.body_count, false));
 			
 			if (nbody_state.benchmark && indirect_benchmark_pipeline) {
 				// if we using an indirect command pipeline: run it here once and complete the benchmark
@@ -915,8 +1428,57 @@ int main(int, char* argv[]) {
 					.debug_label = "nbody_benchmark",
 				};
 				dev_queue->execute_indirect(*indirect_benchmark_pipeline, exec_params);
+			} else if (nbody_state.block_levels > 0u) {
+				// hierarchical block time-stepping: one full step consists of 2^block_levels sub-steps,
+				// each only computing the forces of the bodies that are active in it
+				const uint32_t sub_step_count { 1u << nbody_state.block_levels };
+				for (uint32_t sub_step = 0; sub_step < sub_step_count; ++sub_step) {
+					const block_step_params params {
+						.time_step = nbody_state.time_step,
+						.eta = nbody_state.block_eta,
+						.max_level = nbody_state.block_levels,
+						.sub_step = sub_step,
+						.body_count = nbody_state.body_count,
+					};
+					const size_t sub_cur_buffer = buffer_flip_flop;
+					const size_t sub_next_buffer = (buffer_flip_flop + 1) % pos_buffer_count;
+					if (snapshot_writer) {
+						snapshot_writer->wait_for_buffer(position_buffers[sub_next_buffer].get());
+					}
+					
+					active_count_buffer->zero(*dev_queue);
+					dev_queue->execute(*nbody_block_compact,
+									   uint1 { nbody_state.body_count },
+									   uint1 { nbody_state.tile_size },
+									   /* levels: */			level_buffer,
+									   /* active_indices: */	active_index_buffer,
+									   /* active_count: */		active_count_buffer,
+									   /* params: */			params);
+					dev_queue->execute(*nbody_compute_active,
+									   uint1 { nbody_state.body_count },
+									   uint1 { nbody_state.tile_size },
+									   /* positions: */			position_buffers[sub_cur_buffer],
+									   /* velocities: */		velocity_buffer,
+									   /* levels: */			level_buffer,
+									   /* active_indices: */	active_index_buffer,
+									   /* active_count: */		active_count_buffer,
+									   /* params: */			params);
+					dev_queue->execute(*nbody_drift,
+									   uint1 { nbody_state.body_count },
+									   uint1 { nbody_state.tile_size },
+									   /* in_positions: */		position_buffers[sub_cur_buffer],
+									   /* out_positions: */		position_buffers[sub_next_buffer],
+									   /* velocities: */		velocity_buffer,
+									   /* params: */			params);
+					buffer_flip_flop = sub_next_buffer;
+				}
+				dev_queue->finish(); // ensure all is complete
 			} else {
 				// direct, one kernel execution per iteration:
+				if (snapshot_writer) {
+					// the next position buffer must not be written while it's still being read back
+					snapshot_writer->wait_for_buffer(position_buffers[next_buffer].get());
+				}
 				dev_queue->execute(*nbody_compute,
 								   // total amount of work:
 								   uint1 { nbody_state.body_count },
@@ -932,6 +1494,27 @@ int main(int, char* argv[]) {
 				buffer_flip_flop = next_buffer;
 				dev_queue->finish(); // ensure all is complete
 			}
+			if (nbody_state.benchmark && indirect_benchmark_pipeline) {
+				sim_step += benchmark_iterations;
+				sim_time += double(benchmark_iterations) * double(NBODY_FIXED_TIME_STEP);
+			} else {
+				++sim_step;
+				sim_time += double(nbody_state.time_step);
+			}
+			
+			// snapshot and trajectory output
+			if (snapshot_writer && !trajectory_file.empty() && (sim_step % trajectory_interval) == 0u) {
+				snapshot_writer->push_trajectory_frame(position_buffers[buffer_flip_flop], sim_step, sim_time);
+			}
+			if (snapshot_save_interval > 0u && (sim_step % snapshot_save_interval) == 0u) {
+				snapshot_next_run = true;
+			}
+			
+			// diagnostics (this is roughly the cost of one additional simulation step)
+			if (diagnostics && (sim_step % diagnostics_interval) == 0u) {
+				diagnostics->compute(*dev_queue, *nbody_diagnostics_function, position_buffers[buffer_flip_flop], velocity_buffer,
+									 sim_step, sim_time);
+			}
 			
 			// time keeping
 			auto now = chrono::high_resolution_clock::now();
@@ -942,13 +1525,23 @@ int main(int, char* argv[]) {
 			sim_time_sum += ((double)delta.count()) / (time_den / 1000.0);
 			
 			if (iteration == benchmark_iterations - 1u) {
+				// block time-stepping: interactions of the tile schedule with the current level distribution
+				// NOTE: this is exact for the last step if no body has changed its level during it
+				uint64_t interaction_count { uint64_t(nbody_state.body_count) * uint64_t(nbody_state.body_count) };
+				vector<uint32_t> level_counts;
+				if (level_buffer) {
+					level_counts = read_block_level_counts();
+					interaction_count = compute_block_interactions(level_counts);
+				}
+				const auto gflops = compute_gflops(sim_time_sum / double(benchmark_iterations), interaction_count, false);
 				log_debug("avg of $ iterations: $ms ### $ gflops",
-						  benchmark_iterations, sim_time_sum / double(benchmark_iterations),
-						  compute_gflops(sim_time_sum / double(benchmark_iterations), false));
-				floor::set_caption("nbody / " + to_string(nbody_state.body_count) + " bodies / " +
-								   to_string(compute_gflops(sim_time_sum / double(benchmark_iterations), false)) + " gflops");
+						  benchmark_iterations, sim_time_sum / double(benchmark_iterations), gflops);
+				floor::set_caption("nbody / " + to_string(nbody_state.body_count) + " bodies / " + to_string(gflops) + " gflops");
 				iteration = 0;
 				sim_time_sum = 0.0L;
+				if (level_buffer) {
+					log_block_levels(level_counts);
+				}
 				
 				// benchmark is done after 100 iterations
 				if (nbody_state.benchmark) {
@@ -964,58 +1557,116 @@ int main(int, char* argv[]) {
 		if (export_next_run.exchange(false)) {
 			export_nbody_system();
 		}
+		if (snapshot_next_run.exchange(false) && snapshot_writer) {
+			dev_queue->finish();
+			snapshot_writer->write_snapshot(snapshot_save_prefix + "_" + to_string(sim_step) + ".nbody", *dev_queue,
+											*position_buffers[buffer_flip_flop], *velocity_buffer, make_snapshot_header());
+		}
 		
 		// s/w rendering
 		if (floor_renderer == floor::RENDERER::NONE && !nbody_state.benchmark) {
-			struct {
-				const matrix4f mview;
-				const uint2 img_size;
-				const float2 mass_minmax;
-				const uint32_t body_count;
-			} raster_params {
+			const raster_params params {
 				.mview = nbody_state.cam_rotation.to_matrix4() * matrix4f::translation(0.0f, 0.0f, -nbody_state.distance),
 				.img_size = img_size,
+				.tile_count = raster_tile_count,
 				.mass_minmax = nbody_state.mass_minmax,
 				.body_count = nbody_state.body_count,
 			};
-			img_buffer_flip_flop = 1 - img_buffer_flip_flop;
-			dev_queue->execute(*nbody_raster,
-							   // total amount of work:
-							   uint1 { img_size.x * img_size.y },
-							   // work per work-group:
-							   uint1 {
-								   nbody_state.render_size == 0 ?
-								   nbody_raster->get_function_entry(*compute_dev)->max_total_local_size : nbody_state.render_size
-							   },
-							   // kernel arguments:
-							   /* in_positions: */		position_buffers[buffer_flip_flop],
-							   /* img: */				img_buffers[img_buffer_flip_flop],
-							   /* img_old: */			img_buffers[1 - img_buffer_flip_flop],
-							   /* raster_params: */		raster_params);
+			const auto body_local_size = [&compute_dev](const device_function& func) {
+				return (nbody_state.render_size == 0 ?
+						uint32_t(func.get_function_entry(*compute_dev)->max_total_local_size) : nbody_state.render_size);
+			};
+			const auto body_global_size = [](const uint32_t& local_size) {
+				return ((nbody_state.body_count + local_size - 1u) / local_size) * local_size;
+			};
 			
-			if(is_vulkan || is_metal) dev_queue->finish();
+			dev_queue->finish();
+			const auto raster_start = chrono::high_resolution_clock::now();
+			
+			// project all bodies + count #sprites per tile
+			const auto project_local_size = body_local_size(*nbody_raster_project);
+			dev_queue->execute(*nbody_raster_project,
+							   uint1 { body_global_size(project_local_size) },
+							   uint1 { project_local_size },
+							   /* positions: */			position_buffers[buffer_flip_flop],
+							   /* sprites: */			sprite_buffer,
+							   /* tile_counts: */		tile_count_buffer,
+							   /* raster_params: */		params);
+			// tile counts -> tile offsets
+			dev_queue->execute(*nbody_raster_scan,
+							   uint1 { NBODY_RASTER_SCAN_SIZE },
+							   uint1 { NBODY_RASTER_SCAN_SIZE },
+							   /* tile_counts: */		tile_count_buffer,
+							   /* tile_offsets: */		tile_offset_buffer,
+							   /* total_tile_count: */	raster_total_tile_count);
+			// write sprite indices into the tile bins
+			const auto bin_local_size = body_local_size(*nbody_raster_bin);
+			dev_queue->execute(*nbody_raster_bin,
+							   uint1 { body_global_size(bin_local_size) },
+							   uint1 { bin_local_size },
+							   /* sprites: */			sprite_buffer,
+							   /* tile_counts: */		tile_count_buffer,
+							   /* tile_offsets: */		tile_offset_buffer,
+							   /* tile_bins: */			tile_bin_buffer,
+							   /* raster_params: */		params);
+			// rasterize all tiles (one work-group per tile)
+			dev_queue->execute(*nbody_raster_tiles,
+							   uint1 { raster_total_tile_count * NBODY_RASTER_TILE_SIZE * NBODY_RASTER_TILE_SIZE },
+							   uint1 { NBODY_RASTER_TILE_SIZE * NBODY_RASTER_TILE_SIZE },
+							   /* sprites: */			sprite_buffer,
+							   /* tile_offsets: */		tile_offset_buffer,
+							   /* tile_bins: */			tile_bin_buffer,
+							   /* img: */				img_buffer,
+							   /* raster_params: */		params);
+			dev_queue->finish();
+			raster_time_sum += double(chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() -
+																				  raster_start).count()) / 1000.0;
 			
 			// grab the current image buffer data (read-only + blocking) ...
-			auto img_data = (uchar4*)img_buffers[img_buffer_flip_flop]->map(*dev_queue, MEMORY_MAP_FLAG::READ | MEMORY_MAP_FLAG::BLOCK);
+			auto img_data = (uchar4*)img_buffer->map(*dev_queue, MEMORY_MAP_FLAG::READ | MEMORY_MAP_FLAG::BLOCK);
 			
-			// ... and blit it into the window
-			const auto wnd_surface = SDL_GetWindowSurface(floor::get_window());
-			SDL_LockSurface(wnd_surface);
-			const uint2 surface_dim = { uint32_t(wnd_surface->w), uint32_t(wnd_surface->h) }; // TODO: figure out how to coerce sdl to create a 2x surface
-			const uint2 render_dim = img_size.minned(floor::get_physical_screen_size());
-			const uint2 scale = render_dim / surface_dim;
-			const auto px_format_details = SDL_GetPixelFormatDetails(wnd_surface->format);
-			for (uint32_t y = 0; y < surface_dim.y; ++y) {
-				uint32_t* px_ptr = (uint32_t*)wnd_surface->pixels + ((size_t)wnd_surface->pitch / sizeof(uint32_t)) * y;
-				uint32_t img_idx = img_size.x * y * scale.y;
-				for (uint32_t x = 0; x < surface_dim.x; ++x, img_idx += scale.x) {
-					*px_ptr++ = SDL_MapRGB(px_format_details, nullptr, img_data[img_idx].x, img_data[img_idx].y, img_data[img_idx].z);
+			if (is_headless) {
+				// ... and write it to disk
+				if (nbody_state.frame_dump) {
+					stringstream frame_number;
+					frame_number << setw(6) << setfill('0') << headless_frame;
+					dump_frame(frame_prefix + "_" + frame_number.str() + ".png", img_data, img_size);
+				}
+				img_buffer->unmap(*dev_queue, img_data);
+				
+				if (++headless_frame >= nbody_state.headless_frames) {
+					const auto avg_raster_time = raster_time_sum / double(headless_frame);
+					log_msg("headless: $ frames @ $ with $ bodies: avg s/w raster time $ms ($ Mbodies/s)",
+							headless_frame, img_size, nbody_state.body_count, avg_raster_time,
+							(double(nbody_state.body_count) / 1'000'000.0) / (avg_raster_time / 1000.0));
+					nbody_state.done = true;
+				}
+			} else {
+				// ... and blit it into the window
+				const auto wnd_surface = SDL_GetWindowSurface(floor::get_window());
+				SDL_LockSurface(wnd_surface);
+				const uint2 surface_dim = { uint32_t(wnd_surface->w), uint32_t(wnd_surface->h) }; // TODO: figure out how to coerce sdl to create a 2x surface
+				const uint2 render_dim = img_size.minned(floor::get_physical_screen_size());
+				const uint2 scale = render_dim / surface_dim;
+				const auto px_format_details = SDL_GetPixelFormatDetails(wnd_surface->format);
+				for (uint32_t y = 0; y < surface_dim.y; ++y) {
+					uint32_t* px_ptr = (uint32_t*)wnd_surface->pixels + ((size_t)wnd_surface->pitch / sizeof(uint32_t)) * y;
+					uint32_t img_idx = img_size.x * y * scale.y;
+					for (uint32_t x = 0; x < surface_dim.x; ++x, img_idx += scale.x) {
+						*px_ptr++ = SDL_MapRGB(px_format_details, nullptr, img_data[img_idx].x, img_data[img_idx].y, img_data[img_idx].z);
+					}
+				}
+				img_buffer->unmap(*dev_queue, img_data);
+				
+				SDL_UnlockSurface(wnd_surface);
+				SDL_UpdateWindowSurface(floor::get_window());
+				
+				if (++raster_frame_count == benchmark_iterations) {
+					log_debug("avg s/w raster time: $ms", raster_time_sum / double(raster_frame_count));
+					raster_frame_count = 0u;
+					raster_time_sum = 0.0;
 				}
 			}
-			img_buffers[img_buffer_flip_flop]->unmap(*dev_queue, img_data);
-			
-			SDL_UnlockSurface(wnd_surface);
-			SDL_UpdateWindowSurface(floor::get_window());
 		}
 		// Metal/Vulkan rendering
 		else if (floor_renderer != floor::RENDERER::NONE && (!nbody_state.no_metal || !nbody_state.no_vulkan)) {
@@ -1030,6 +1681,9 @@ int main(int, char* argv[]) {
 	
 	// cleanup
 	dev_queue->finish();
+	// NOTE: this flushes all pending snapshot/trajectory output
+	snapshot_writer = nullptr;
+	diagnostics = nullptr;
 	if (indirect_benchmark_pipeline) {
 		indirect_benchmark_pipeline = nullptr;
 	}
@@ -1037,9 +1691,14 @@ int main(int, char* argv[]) {
 		position_buffers[i] = nullptr;
 	}
 	velocity_buffer = nullptr;
-	for(auto img_buffer : img_buffers) {
-		img_buffer = nullptr;
-	}
+	level_buffer = nullptr;
+	active_index_buffer = nullptr;
+	active_count_buffer = nullptr;
+	img_buffer = nullptr;
+	sprite_buffer = nullptr;
+	tile_count_buffer = nullptr;
+	tile_offset_buffer = nullptr;
+	tile_bin_buffer = nullptr;
 	if (floor_renderer != floor::RENDERER::NONE) {
 		unified_renderer::destroy(*render_ctx);
 	}
@@ -1047,8 +1706,14 @@ int main(int, char* argv[]) {
 	nbody_render_prog = nullptr;
 	nbody_compute = nullptr;
 	nbody_compute_fixed_delta = nullptr;
-	nbody_raster = nullptr;
-	img_buffers = {};
+	nbody_diagnostics_function = nullptr;
+	nbody_block_compact = nullptr;
+	nbody_compute_active = nullptr;
+	nbody_drift = nullptr;
+	nbody_raster_project = nullptr;
+	nbody_raster_scan = nullptr;
+	nbody_raster_bin = nullptr;
+	nbody_raster_tiles = nullptr;
 	dev_queue = nullptr;
 	render_dev_queue = nullptr;
 	compute_ctx = nullptr;
@@ -27,7 +27,7 @@ using namespace std;
 static void compute_body_interaction(const float4& shared_body,
 									 const float4& this_body,
 									 float3& acceleration) {
-#if !defined(FLOOR_DEVICE_INFO_HAS_FMA_1) // (potentially!) non-fma version
+#if !defined(FLOOR_DEVICE_INFO_HAS_FMA_1) || defined(NBODY_NO_FMA) // (potentially!) non-fma version
 	// 3 flops
 	const float3 r { shared_body.xyz - this_body.xyz };
 	// 5 flops + 1 flop = 6 flops
@@ -59,18 +59,11 @@ static void compute_body_interaction(const float4& shared_body,
 #endif
 }
 
-static void nbody_compute_impl(buffer<const float4>& in_positions,
-							   buffer<float4>& out_positions,
-							   buffer<float3>& velocities,
-							   const float delta) {
-	const auto idx = global_id.x;
-	const auto body_count = global_size.x;
-	
-	float4 position = in_positions[idx];
-	float3 velocity = velocities[idx];
-	float3 acceleration;
-	
-#if 1 // local/shared-memory caching + computation
+//! iterates over all bodies in NBODY_TILE_SIZE-sized tiles that are cached in local/shared memory,
+//! calling "interaction" for each cached body
+//! NOTE: all work-items of the work-group must call this
+template <typename F>
+floor_inline_always static void tiled_body_loop(buffer<const float4>& in_positions, const uint32_t body_count, F&& interaction) {
 	const auto local_idx = local_id.x;
 	local_buffer<float4, NBODY_TILE_SIZE> local_body_positions;
 	for(uint32_t i = 0, tile = 0, count = body_count; i < count; i += NBODY_TILE_SIZE, ++tile) {
@@ -89,10 +82,27 @@ static void nbody_compute_impl(buffer<const float4>& in_positions,
 #pragma clang loop unroll_count(16) vectorize(enable)
 #endif
 		for(uint32_t j = 0; j < NBODY_TILE_SIZE; ++j) {
-			compute_body_interaction(local_body_positions[j], position, acceleration);
+			interaction(local_body_positions[j]);
 		}
 		local_barrier();
 	}
+}
+
+static void nbody_compute_impl(buffer<const float4>& in_positions,
+							   buffer<float4>& out_positions,
+							   buffer<float3>& velocities,
+							   const float delta) {
+	const auto idx = global_id.x;
+	const auto body_count = global_size.x;
+	
+	float4 position = in_positions[idx];
+	float3 velocity = velocities[idx];
+	float3 acceleration;
+	
+#if 1 // local/shared-memory caching + computation
+	tiled_body_loop(in_positions, body_count, [&position, &acceleration](const float4& body) {
+		compute_body_interaction(body, position, acceleration);
+	});
 #else // global memory only computation
 #pragma unroll // good enough
 	for(uint32_t i = 0; i < body_count; ++i) {
@@ -118,7 +128,155 @@ kernel_1d(NBODY_TILE_SIZE) void nbody_compute(buffer<const float4> in_positions,
 kernel_1d(NBODY_TILE_SIZE) void nbody_compute_fixed_delta(buffer<const float4> in_positions,
 														  buffer<float4> out_positions,
 														  buffer<float3> velocities) {
-	nbody_compute_impl(in_positions, out_positions, velocities, 20.0f / 1000.0f /* 20ms*/);
+	nbody_compute_impl(in_positions, out_positions, velocities, NBODY_FIXED_TIME_STEP);
+}
+
+// hierarchical block time-stepping:
+// 1) nbody_block_compact: writes the indices of all bodies that are active in the current sub-step to a compacted list
+// 2) nbody_compute_active: computes the acceleration of all active bodies, chooses their new time step level
+//    and kicks their velocity with the new time step (-> the body is next active once this time step has passed)
+// 3) nbody_drift: moves all bodies by the smallest time step
+// NOTE: a body can always move to a finer level, but can only move to a coarser level once it is aligned to it
+
+//! returns true if a body on the specified level is active in the specified sub-step
+static bool is_block_active(const uint32_t level, const uint32_t sub_step, const uint32_t max_level) {
+	return ((sub_step & ((1u << (max_level - level)) - 1u)) == 0u);
+}
+
+kernel_1d(NBODY_TILE_SIZE) void nbody_block_compact(buffer<const uint32_t> levels,
+													buffer<uint32_t> active_indices,
+													buffer<uint32_t> active_count,
+													param<block_step_params> params) {
+	const auto idx = global_id.x;
+	const auto lid = local_id.x;
+	const uint32_t active = (is_block_active(levels[idx], params.sub_step, params.max_level) ? 1u : 0u);
+	
+	// work-group scan of the active flags -> local offset
+	local_buffer<uint32_t, algorithm::scan_local_memory_elements<NBODY_TILE_SIZE, uint32_t>()> lmem;
+	const auto result = algorithm::inclusive_scan_add<NBODY_TILE_SIZE>(active, lmem);
+	
+	// NOTE: scan already does a local_barrier() at the end
+	// -> reserve space for all active bodies of this work-group in the global list
+	if (lid == NBODY_TILE_SIZE - 1) {
+		lmem[0] = atomic_add(&active_count[0], result);
+	}
+	local_barrier();
+	
+	if (active) {
+		active_indices[lmem[0] + result - 1u] = idx;
+	}
+}
+
+kernel_1d(NBODY_TILE_SIZE) void nbody_compute_active(buffer<const float4> positions,
+													 buffer<float3> velocities,
+													 buffer<uint32_t> levels,
+													 buffer<const uint32_t> active_indices,
+													 buffer<const uint32_t> active_count,
+													 param<block_step_params> params) {
+	// this is dispatched for all bodies, so that no host readback of the active count is necessary
+	// -> work-groups that don't contain any active body can exit right away (uniform for the whole work-group)
+	const auto count = active_count[0];
+	if (group_id.x * NBODY_TILE_SIZE >= count) {
+		return;
+	}
+	
+	const auto is_active = (global_id.x < count);
+	const auto body_idx = active_indices[is_active ? global_id.x : 0u];
+	const float4 position = positions[body_idx];
+	float3 acceleration;
+	tiled_body_loop(positions, params.body_count, [&position, &acceleration](const float4& body) {
+		compute_body_interaction(body, position, acceleration);
+	});
+	if (!is_active) {
+		return;
+	}
+	
+	// choose the new level from the acceleration magnitude
+	const auto acc_len = math::max(acceleration.length(), 1.0e-20f);
+	const auto dt_desired = params.eta * math::sqrt(NBODY_SOFTENING / acc_len);
+	auto level = uint32_t(math::clamp(math::ceil(math::log2(params.time_step / dt_desired)), 0.0f, float(params.max_level)));
+	// can only move to a coarser level if the current sub-step is aligned to it
+	while (!is_block_active(level, params.sub_step, params.max_level)) {
+		++level;
+	}
+	levels[body_idx] = level;
+	
+	// kick
+	const auto dt = params.time_step / float(1u << level);
+	float3 velocity = velocities[body_idx];
+	velocity += acceleration * dt;
+	// damping is defined per base time step
+	velocity *= math::pow(NBODY_DAMPING, dt / params.time_step);
+	velocities[body_idx] = velocity;
+}
+
+kernel_1d(NBODY_TILE_SIZE) void nbody_drift(buffer<const float4> in_positions,
+											buffer<float4> out_positions,
+											buffer<const float3> velocities,
+											param<block_step_params> params) {
+	const auto idx = global_id.x;
+	const auto dt = params.time_step / float(1u << params.max_level);
+	float4 position = in_positions[idx];
+	position.xyz += velocities[idx] * dt;
+	out_positions[idx] = position;
+}
+
+// softened gravitational potential of "shared_body" at the position of "this_body" (G = 1, same as the force computation)
+static void compute_body_potential(const float4& shared_body,
+								   const float4& this_body,
+								   float& potential) {
+	const float3 r { shared_body.xyz - this_body.xyz };
+	const float dist_sq = r.dot(r) + (NBODY_SOFTENING * NBODY_SOFTENING);
+	potential -= shared_body.w * math::rsqrt(dist_sq);
+}
+
+// computes the per-work-group sums of kinetic/potential energy, linear/angular momentum and the bounding box of all bodies
+// -> writes NBODY_DIAGNOSTICS_VALUES_PER_GROUP float4 values per work-group:
+//    { kinetic energy, potential energy, 0, 0 }, { linear momentum, 0 }, { angular momentum, 0 }, { bbox min, 0 }, { bbox max, 0 }
+kernel_1d(NBODY_TILE_SIZE) void nbody_diagnostics(buffer<const float4> positions,
+												  buffer<const float3> velocities,
+												  buffer<float4> group_diagnostics) {
+	const auto idx = global_id.x;
+	const auto body_count = global_size.x;
+	
+	const float4 position = positions[idx];
+	const float3 velocity = velocities[idx];
+	const float mass = position.w;
+	
+	// same tiled pair loop as the force computation
+	float potential = 0.0f;
+	tiled_body_loop(positions, body_count, [&position, &potential](const float4& body) {
+		compute_body_potential(body, position, potential);
+	});
+	// remove the self-interaction (r = 0 -> 1 / softening)
+	potential += mass / NBODY_SOFTENING;
+	
+	// each pair is counted twice -> 1/2
+	float3 energy { 0.5f * mass * velocity.dot(velocity), 0.5f * mass * potential, 0.0f };
+	float3 momentum { velocity * mass };
+	float3 angular_momentum { position.xyz.crossed(velocity) * mass };
+	float3 bbox_min { position.xyz }, bbox_max { position.xyz };
+	
+	// work-group reductions (all reduce functions need the same amount of local memory here)
+	local_buffer<float3, algorithm::reduce_local_memory_elements<NBODY_TILE_SIZE, float3>()> lmem;
+	energy = algorithm::reduce_add<NBODY_TILE_SIZE>(energy, lmem);
+	local_barrier();
+	momentum = algorithm::reduce_add<NBODY_TILE_SIZE>(momentum, lmem);
+	local_barrier();
+	angular_momentum = algorithm::reduce_add<NBODY_TILE_SIZE>(angular_momentum, lmem);
+	local_barrier();
+	bbox_min = algorithm::reduce_min<NBODY_TILE_SIZE>(bbox_min, lmem);
+	local_barrier();
+	bbox_max = algorithm::reduce_max<NBODY_TILE_SIZE>(bbox_max, lmem);
+	
+	if (local_id.x == 0) {
+		const auto out_idx = group_id.x * NBODY_DIAGNOSTICS_VALUES_PER_GROUP;
+		group_diagnostics[out_idx + 0u] = { energy, 0.0f };
+		group_diagnostics[out_idx + 1u] = { momentum, 0.0f };
+		group_diagnostics[out_idx + 2u] = { angular_momentum, 0.0f };
+		group_diagnostics[out_idx + 3u] = { bbox_min, 0.0f };
+		group_diagnostics[out_idx + 4u] = { bbox_max, 0.0f };
+	}
 }
 
 static float3 compute_gradient(const float& interpolator) {
@@ -139,49 +297,180 @@ static float3 compute_gradient(const float& interpolator) {
 	return gradients[gradient_idx].interpolated(gradients[gradient_idx + 1u], wrapped_interp);
 }
 
-struct raster_params {
-	const matrix4f mview;
-	const uint2 img_size;
-	const float2 mass_minmax;
-	const uint32_t body_count;
-};
+// s/w rasterizer:
+// 1) nbody_raster_project: projects all bodies into screen space (-> sprites) and counts the #sprites per screen tile
+// 2) nbody_raster_scan: computes the start offset of each tile in the tile bin list (exclusive prefix sum of the counts)
+// 3) nbody_raster_bin: writes the index of each sprite into the bins of all tiles it overlaps
+// 4) nbody_raster_tiles: one work-group per tile, caches the binned sprites in local memory, blends them per pixel
+//    and writes each pixel exactly once
+// NOTE: sprite radius is limited so that a sprite overlaps at most 2x2 tiles -> tile bin list needs at most 4 * #bodies entries
+static constexpr const float raster_max_sprite_radius { float(NBODY_RASTER_TILE_SIZE) * 0.5f - 0.5f };
+static constexpr const uint32_t raster_tile_pixel_count { NBODY_RASTER_TILE_SIZE * NBODY_RASTER_TILE_SIZE };
 
-kernel_1d(/* can by empty */) void nbody_raster(buffer<const float4> positions,
-												buffer<uint32_t> img,
-												buffer<uint32_t> img_old,
-												param<raster_params> params) {
+//! returns the min (.xy) and max (.zw) tile covered by the specified sprite, returns false if it is not visible at all
+static bool compute_sprite_tile_range(const float4& sprite, const raster_params& params, uint4& tile_range) {
+	const auto radius = sprite.z;
+	if (radius <= 0.0f) {
+		return false;
+	}
+	const float2 sprite_min { sprite.xy - radius }, sprite_max { sprite.xy + radius };
+	if (sprite_max.x < 0.0f || sprite_max.y < 0.0f ||
+		sprite_min.x >= float(params.img_size.x) || sprite_min.y >= float(params.img_size.y)) {
+		return false;
+	}
+	const auto max_tile = params.tile_count - 1u;
+	tile_range = {
+		math::min(uint32_t(math::max(sprite_min.x, 0.0f)) / NBODY_RASTER_TILE_SIZE, max_tile.x),
+		math::min(uint32_t(math::max(sprite_min.y, 0.0f)) / NBODY_RASTER_TILE_SIZE, max_tile.y),
+		math::min(uint32_t(sprite_max.x) / NBODY_RASTER_TILE_SIZE, max_tile.x),
+		math::min(uint32_t(sprite_max.y) / NBODY_RASTER_TILE_SIZE, max_tile.y),
+	};
+	return true;
+}
+
+kernel_1d(/* can by empty */) void nbody_raster_project(buffer<const float4> positions,
+														buffer<float4> sprites,
+														buffer<uint32_t> tile_counts,
+														param<raster_params> params) {
 	const auto idx = global_id.x;
-	img_old[idx] = 0;
-	
 	if(idx >= params.body_count) return;
 	
 	const matrix4f mproj { matrix4f::perspective(90.0f, float(params.img_size.x) / float(params.img_size.y), 0.25f, 2500.0f) };
 	
 	// transform vector (*TMVP)
-	const float3 mview_vec = positions[idx].xyz * params.mview;
+	const auto position = positions[idx];
+	const float3 mview_vec = position.xyz * params.mview;
 	float3 proj_vec = mview_vec * mproj;
 	
 	// check if point is not behind cam
-	if(mview_vec.z >= 0.0f) return;
+	if(mview_vec.z >= 0.0f) {
+		sprites[idx] = {};
+		return;
+	}
 	proj_vec *= -1.0f / mview_vec.z;
 	
-	// and finally: compute window position
-	const int2 pixel {
-		(int32_t)(float(params.img_size.x) * (proj_vec.x * 0.5f + 0.5f)),
-		(int32_t)(float(params.img_size.y) * (proj_vec.y * 0.5f + 0.5f))
+	// sprite: .xy = window position, .z = radius in pixels, .w = normalized mass
+	// NOTE: size computation is the same as in the lighting vertex shader
+	const auto mass_interp = (position.w - params.mass_minmax.x) / (params.mass_minmax.y - params.mass_minmax.x);
+	const auto size = (128.0f / (1.0f - mview_vec.z)) * mass_interp * mass_interp;
+	const float4 sprite {
+		float(params.img_size.x) * (proj_vec.x * 0.5f + 0.5f),
+		float(params.img_size.y) * (proj_vec.y * 0.5f + 0.5f),
+		math::clamp(size * 0.5f, 0.75f, raster_max_sprite_radius),
+		mass_interp,
 	};
+	sprites[idx] = sprite;
+	
+	uint4 tile_range;
+	if (!compute_sprite_tile_range(sprite, params, tile_range)) {
+		return;
+	}
+	for (uint32_t y = tile_range.y; y <= tile_range.w; ++y) {
+		for (uint32_t x = tile_range.x; x <= tile_range.z; ++x) {
+			atomic_inc(&tile_counts[y * params.tile_count.x + x]);
+		}
+	}
+}
+
+kernel_1d(NBODY_RASTER_SCAN_SIZE) void nbody_raster_scan(buffer<const uint32_t> tile_counts,
+														 buffer<uint32_t> tile_offsets,
+														 param<uint32_t> total_tile_count) {
+	// single work-group scan over all tiles
+	const auto lid = local_id.x;
+	local_buffer<uint32_t, algorithm::scan_local_memory_elements<NBODY_RASTER_SCAN_SIZE, uint32_t>()> lmem;
+	uint32_t carry = 0u;
+	for (uint32_t base_idx = 0; base_idx < total_tile_count; base_idx += NBODY_RASTER_SCAN_SIZE) {
+		const auto idx = base_idx + lid;
+		const auto count = (idx < total_tile_count ? tile_counts[idx] : 0u);
+		
+		local_barrier();
+		const auto result = algorithm::inclusive_scan_add<NBODY_RASTER_SCAN_SIZE>(count, lmem);
+		if (idx < total_tile_count) {
+			tile_offsets[idx] = carry + result - count;
+		}
+		
+		// NOTE: scan already does a local_barrier() at the end
+		if (lid == NBODY_RASTER_SCAN_SIZE - 1) {
+			lmem[0] = carry + result;
+		}
+		local_barrier();
+		carry = lmem[0];
+	}
+	if (lid == 0) {
+		tile_offsets[total_tile_count] = carry;
+	}
+}
+
+kernel_1d(/* can by empty */) void nbody_raster_bin(buffer<const float4> sprites,
+													buffer<uint32_t> tile_counts,
+													buffer<const uint32_t> tile_offsets,
+													buffer<uint32_t> tile_bins,
+													param<raster_params> params) {
+	const auto idx = global_id.x;
+	if(idx >= params.body_count) return;
 	
-	const uint2 upixel { pixel }; // this also makes sure that negative positions are ignored
-	if(upixel.x < params.img_size.x && upixel.y < params.img_size.y) {
-		// compute gradient color, will just ignore alpha blending here
-		const auto color_f = (compute_gradient((positions[idx].w - params.mass_minmax.x) /
-											   (params.mass_minmax.y - params.mass_minmax.x)) * 255.0f).floor();
-		const uint32_t color = (((uint32_t(color_f.z) & 0xFFu) << 16u) |
-								((uint32_t(color_f.y) & 0xFFu) << 8u) |
-								(uint32_t(color_f.x) & 0xFFu));
+	uint4 tile_range;
+	if (!compute_sprite_tile_range(sprites[idx], params, tile_range)) {
+		return;
+	}
+	for (uint32_t y = tile_range.y; y <= tile_range.w; ++y) {
+		for (uint32_t x = tile_range.x; x <= tile_range.z; ++x) {
+			const auto tile_idx = y * params.tile_count.x + x;
+			// NOTE: decrementing the counts also resets them to zero for the next frame
+			const auto slot = atomic_dec(&tile_counts[tile_idx]) - 1u;
+			tile_bins[tile_offsets[tile_idx] + slot] = idx;
+		}
+	}
+}
+
+kernel_1d(NBODY_RASTER_TILE_SIZE * NBODY_RASTER_TILE_SIZE) void nbody_raster_tiles(buffer<const float4> sprites,
+																				   buffer<const uint32_t> tile_offsets,
+																				   buffer<const uint32_t> tile_bins,
+																				   buffer<uint32_t> img,
+																				   param<raster_params> params) {
+	const auto lid = local_id.x;
+	const auto tile_idx = group_id.x;
+	const uint2 tile { tile_idx % params.tile_count.x, tile_idx / params.tile_count.x };
+	const uint2 pixel { tile * NBODY_RASTER_TILE_SIZE + uint2 { lid % NBODY_RASTER_TILE_SIZE, lid / NBODY_RASTER_TILE_SIZE } };
+	const float2 pixel_center { pixel.cast<float>() + 0.5f };
+	
+	// .xy = window position, .z = radius^2, .w = 1 / radius^2
+	local_buffer<float4, raster_tile_pixel_count> local_sprites;
+	local_buffer<float3, raster_tile_pixel_count> local_colors;
+	
+	// blending is the same as in the h/w renderer: dst = src + dst * (1 - src),
+	// which is order-independent when written as: 1 - prod(1 - src)
+	float3 inv_color { 1.0f };
+	const auto bin_begin = tile_offsets[tile_idx], bin_end = tile_offsets[tile_idx + 1u];
+	for (uint32_t base_idx = bin_begin; base_idx < bin_end; base_idx += raster_tile_pixel_count) {
+		// cache the next (up to) #pixels-in-tile sprites in local memory
+		local_barrier();
+		if (base_idx + lid < bin_end) {
+			const auto sprite = sprites[tile_bins[base_idx + lid]];
+			const auto radius_sq = sprite.z * sprite.z;
+			local_sprites[lid] = { sprite.xy, radius_sq, 1.0f / radius_sq };
+			local_colors[lid] = compute_gradient(sprite.w);
+		}
+		local_barrier();
 		
-		// OR the color value, this is kind of hack, but it works quite well with the colors we have (and faster than a add+CAS loop)
-		atomic_or(&img[upixel.y * params.img_size.x + upixel.x], color);
+		const auto count = math::min(bin_end - base_idx, raster_tile_pixel_count);
+		for (uint32_t i = 0; i < count; ++i) {
+			const auto sprite = local_sprites[i];
+			const auto dist_sq = (pixel_center - sprite.xy).dot();
+			if (dist_sq < sprite.z) {
+				// same falloff as the dynamically computed lighting fragment shader
+				const auto val = 1.0f - dist_sq * sprite.w;
+				inv_color *= 1.0f - local_colors[i] * val;
+			}
+		}
+	}
+	
+	if (pixel.x < params.img_size.x && pixel.y < params.img_size.y) {
+		const auto color_f = ((1.0f - inv_color).clamp(0.0f, 1.0f) * 255.0f).floor();
+		img[pixel.y * params.img_size.x + pixel.x] = (0xFF000000u |
+													  ((uint32_t(color_f.z) & 0xFFu) << 16u) |
+													  ((uint32_t(color_f.y) & 0xFFu) << 8u) |
+													  (uint32_t(color_f.x) & 0xFFu));
 	}
 }
 
@@ -0,0 +1,315 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2025 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "nbody_benchmark.hpp"
+#include "nbody_state.hpp"
+#include "../../common/json/json_escape.hpp"
+#include <floor/floor.hpp>
+#include <floor/device/device_function.hpp>
+#include <floor/device/host/host_context.hpp>
+#include <floor/device/indirect_command.hpp>
+#include <chrono>
+#include <fstream>
+using namespace std;
+
+namespace nbody_benchmark {
+
+//! timing statistics (per simulation step, in ms) of all repeats of one configuration
+struct result_t {
+	uint32_t body_count { 0u };
+	uint32_t tile_size { 0u };
+	bool fma { false };
+	bool indirect { false };
+	double mean_ms { 0.0 };
+	double stddev_ms { 0.0 };
+	double min_ms { 0.0 };
+	double max_ms { 0.0 };
+	
+	double interactions_per_second(const double& step_ms) const {
+		return (double(body_count) * double(body_count)) / (step_ms / 1000.0);
+	}
+	double gflops(const double& step_ms) const {
+		return (interactions_per_second(step_ms) * double(NBODY_FLOPS_PER_INTERACTION)) / 1'000'000'000.0;
+	}
+	//! flops per byte of global memory traffic: each work-item loads one float4 per tile of "tile_size" interactions
+	double arithmetic_intensity() const {
+		return (double(NBODY_FLOPS_PER_INTERACTION) * double(tile_size)) / double(sizeof(float4));
+	}
+};
+
+vector<uint32_t> parse_uint_list(const char* str) {
+	vector<uint32_t> values;
+	while (str != nullptr && *str != '\0') {
+		char* end_ptr = nullptr;
+		const auto value = strtoul(str, &end_ptr, 10);
+		if (end_ptr == str || value == 0u) {
+			return {};
+		}
+		values.emplace_back(uint32_t(value));
+		str = (*end_ptr == ',' ? end_ptr + 1 : end_ptr);
+		if (*end_ptr != ',' && *end_ptr != '\0') {
+			return {};
+		}
+	}
+	return values;
+}
+
+//! computes mean/stddev/min/max of the specified per-step timings
+static void compute_statistics(const vector<double>& step_times, result_t& result) {
+	result.min_ms = *min_element(step_times.begin(), step_times.end());
+	result.max_ms = *max_element(step_times.begin(), step_times.end());
+	result.mean_ms = 0.0;
+	for (const auto& time : step_times) {
+		result.mean_ms += time;
+	}
+	result.mean_ms /= double(step_times.size());
+	double variance = 0.0;
+	for (const auto& time : step_times) {
+		variance += (time - result.mean_ms) * (time - result.mean_ms);
+	}
+	result.stddev_ms = (step_times.size() > 1u ? sqrt(variance / double(step_times.size() - 1u)) : 0.0);
+}
+
+static bool write_json(const string& file_name, const device& dev, const config_t& config, const vector<result_t>& results) {
+	ofstream json(file_name, ios::out | ios::trunc);
+	if (!json.is_open()) {
+		log_error("failed to open benchmark JSON file \"$\" for writing", file_name);
+		return false;
+	}
+	json.precision(10);
+	json << "{" << endl;
+	json << "\t\"device\": \"" << json_escape(dev.name) << "\"," << endl;
+	json << "\t\"iterations\": " << config.iterations << "," << endl;
+	json << "\t\"repeats\": " << config.repeats << "," << endl;
+	json << "\t\"flops_per_interaction\": " << NBODY_FLOPS_PER_INTERACTION << "," << endl;
+	json << "\t\"results\": [" << endl;
+	for (size_t i = 0, count = results.size(); i < count; ++i) {
+		const auto& res = results[i];
+		json << "\t\t{ ";
+		json << "\"body_count\": " << res.body_count << ", ";
+		json << "\"tile_size\": " << res.tile_size << ", ";
+		json << "\"fma\": " << (res.fma ? "true" : "false") << ", ";
+		json << "\"mode\": \"" << (res.indirect ? "indirect" : "direct") << "\", ";
+		json << "\"step_ms\": { \"mean\": " << res.mean_ms << ", \"stddev\": " << res.stddev_ms;
+		json << ", \"min\": " << res.min_ms << ", \"max\": " << res.max_ms << " }, ";
+		json << "\"gflops\": " << res.gflops(res.mean_ms) << ", ";
+		json << "\"gflops_best\": " << res.gflops(res.min_ms) << ", ";
+		json << "\"interactions_per_second\": " << res.interactions_per_second(res.mean_ms) << ", ";
+		json << "\"arithmetic_intensity\": " << res.arithmetic_intensity();
+		json << " }" << (i + 1 < count ? "," : "") << endl;
+	}
+	json << "\t]" << endl;
+	json << "}" << endl;
+	if (!json.good()) {
+		log_error("failed to write benchmark JSON file \"$\"", file_name);
+		return false;
+	}
+	return true;
+}
+
+bool run(device_context& ctx, const device& dev, device_queue& dev_queue, const config_t& config) {
+#if defined(FLOOR_IOS)
+	log_error("the benchmark suite requires run-time program compilation, which is not supported on iOS");
+	(void)ctx; (void)dev; (void)dev_queue; (void)config;
+	return false;
+#else
+	if (config.body_counts.empty() || config.tile_sizes.empty() || config.iterations == 0u || config.repeats == 0u) {
+		log_error("invalid benchmark suite configuration");
+		return false;
+	}
+	
+	// filter tile sizes that are unsupported by the device
+	const bool is_fixed_host_tile_size = (ctx.get_platform_type() == PLATFORM_TYPE::HOST &&
+										  !((const host_context&)ctx).has_host_device_support());
+	vector<uint32_t> tile_sizes;
+	for (const auto& tile_size : config.tile_sizes) {
+		if (tile_size > dev.max_total_local_size) {
+			log_warn("skipping tile size $: > max possible work-group size ($)", tile_size, dev.max_total_local_size);
+			continue;
+		}
+		if (is_fixed_host_tile_size && tile_size != NBODY_TILE_SIZE) {
+			log_warn("skipping tile size $: host compute requires the compiled NBODY_TILE_SIZE ($)", tile_size, NBODY_TILE_SIZE);
+			continue;
+		}
+		tile_sizes.emplace_back(tile_size);
+	}
+	if (tile_sizes.empty()) {
+		log_error("no usable tile size");
+		return false;
+	}
+	
+	// compile the nbody program for all tile sizes and FMA/non-FMA
+	// NOTE: host compute without host-device support always executes the compiled-in code -> non-FMA would be identical
+	if (is_fixed_host_tile_size) {
+		log_warn("skipping non-FMA variants: host compute always executes the compiled-in nbody code");
+	}
+	struct variant_t {
+		uint32_t tile_size;
+		bool fma;
+		shared_ptr<device_program> program;
+		shared_ptr<device_function> function;
+	};
+	vector<variant_t> variants;
+	for (const auto& tile_size : tile_sizes) {
+		for (const auto fma : { true, false }) {
+			if (!fma && is_fixed_host_tile_size) {
+				continue;
+			}
+			toolchain::compile_options options {
+				.cli = ("-I" + floor::data_path("../nbody/src") + " -DNBODY_TILE_SIZE=" + to_string(tile_size) +
+						" -DNBODY_SOFTENING=" + to_string(nbody_state.softening) + "f" +
+						" -DNBODY_DAMPING=" + to_string(nbody_state.damping) + "f" +
+						// also make sure that the compiler doesn't contract the non-FMA code path
+						(fma ? "" : " -DNBODY_NO_FMA -ffp-contract=off")),
+				.cuda.max_registers = 36,
+			};
+			auto program = ctx.add_program_file(floor::data_path("../nbody/src/nbody.cpp"), options);
+			auto function = (program ? program->get_function("nbody_compute_fixed_delta") : nullptr);
+			if (!function) {
+				log_error("failed to compile nbody program (tile size: $, FMA: $)", tile_size, fma);
+				return false;
+			}
+			variants.emplace_back(variant_t { tile_size, fma, program, function });
+		}
+	}
+	
+	vector<result_t> results;
+	for (const auto& body_count : config.body_counts) {
+		// init a random cube setup (the actual setup is irrelevant for the performance)
+		array<shared_ptr<device_buffer>, 2> position_buffers;
+		for (auto& position_buffer : position_buffers) {
+			position_buffer = ctx.create_buffer(dev_queue, sizeof(float4) * body_count,
+												MEMORY_FLAG::READ_WRITE | MEMORY_FLAG::HOST_WRITE);
+		}
+		auto velocity_buffer = ctx.create_buffer(dev_queue, sizeof(float3) * body_count, MEMORY_FLAG::READ_WRITE);
+		velocity_buffer->zero(dev_queue);
+		{
+			auto positions = make_unique<float4[]>(body_count);
+			for (uint32_t i = 0; i < body_count; ++i) {
+				positions[i].xyz = float3::random(-10.0f, 10.0f);
+				positions[i].w = core::rand(nbody_state.mass_minmax_default.x, nbody_state.mass_minmax_default.y);
+			}
+			for (auto& position_buffer : position_buffers) {
+				auto mapped_positions = position_buffer->map(dev_queue, MEMORY_MAP_FLAG::WRITE_INVALIDATE | MEMORY_MAP_FLAG::BLOCK);
+				memcpy(mapped_positions, positions.get(), sizeof(float4) * body_count);
+				position_buffer->unmap(dev_queue, mapped_positions);
+			}
+		}
+		
+		for (const auto& variant : variants) {
+			if ((body_count % variant.tile_size) != 0u) {
+				log_warn("skipping body count $ with tile size $: body count must be a multiple of the tile size",
+						 body_count, variant.tile_size);
+				continue;
+			}
+			
+			// direct and indirect (if supported) execution
+			unique_ptr<indirect_command_pipeline> indirect_pipeline;
+			if (!config.no_indirect) {
+				indirect_command_description desc {
+					.command_type = indirect_command_description::COMMAND_TYPE::COMPUTE,
+					.max_command_count = config.iterations,
+					.debug_label = "nbody_benchmark_suite_pipeline",
+				};
+				desc.compute_buffer_counts_from_functions(dev, { variant.function.get() });
+				indirect_pipeline = ctx.create_indirect_command_pipeline(desc);
+				if (indirect_pipeline && indirect_pipeline->is_valid()) {
+					for (uint32_t i = 0; i < config.iterations; ++i) {
+						indirect_pipeline->add_compute_command(dev, *variant.function)
+							.set_arguments(position_buffers[i % 2u], position_buffers[(i + 1u) % 2u], velocity_buffer)
+							.execute(body_count, variant.tile_size)
+							.barrier();
+					}
+					indirect_pipeline->complete();
+				} else {
+					log_warn("failed to create indirect command pipeline - only benchmarking direct execution");
+					indirect_pipeline = nullptr;
+				}
+			}
+			
+			for (const auto indirect : { false, true }) {
+				if (indirect && !indirect_pipeline) {
+					continue;
+				}
+				
+				const auto run_iterations = [&]() {
+					if (indirect) {
+						const device_queue::indirect_execution_parameters_t exec_params {
+							.wait_until_completion = true,
+							.debug_label = "nbody_benchmark_suite",
+						};
+						dev_queue.execute_indirect(*indirect_pipeline, exec_params);
+					} else {
+						for (uint32_t i = 0; i < config.iterations; ++i) {
+							dev_queue.execute(*variant.function,
+											  uint1 { body_count },
+											  uint1 { variant.tile_size },
+											  position_buffers[i % 2u], position_buffers[(i + 1u) % 2u], velocity_buffer);
+						}
+					}
+					dev_queue.finish();
+				};
+				
+				// warm-up, then timed repeats
+				run_iterations();
+				vector<double> step_times;
+				for (uint32_t repeat = 0; repeat < config.repeats; ++repeat) {
+					const auto start = chrono::high_resolution_clock::now();
+					run_iterations();
+					const auto duration = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start);
+					step_times.emplace_back((double(duration.count()) / 1'000'000.0) / double(config.iterations));
+				}
+				
+				result_t result {
+					.body_count = body_count,
+					.tile_size = variant.tile_size,
+					.fma = variant.fma,
+					.indirect = indirect,
+				};
+				compute_statistics(step_times, result);
+				log_msg("bodies: $, tile size: $, $, $: $ms/step (+/- $ms, min $ms) -> $ gflops, $ G interactions/s",
+						body_count, variant.tile_size, (variant.fma ? "FMA" : "non-FMA"), (indirect ? "indirect" : "direct"),
+						result.mean_ms, result.stddev_ms, result.min_ms, result.gflops(result.mean_ms),
+						result.interactions_per_second(result.mean_ms) / 1'000'000'000.0);
+				results.emplace_back(result);
+			}
+		}
+	}
+	
+	if (results.empty()) {
+		log_error("no benchmark configuration could be run");
+		return false;
+	}
+	
+	// best overall configuration
+	const auto best = max_element(results.begin(), results.end(), [](const result_t& lhs, const result_t& rhs) {
+		return lhs.gflops(lhs.mean_ms) < rhs.gflops(rhs.mean_ms);
+	});
+	log_msg("best: bodies: $, tile size: $, $, $ -> $ gflops",
+			best->body_count, best->tile_size, (best->fma ? "FMA" : "non-FMA"), (best->indirect ? "indirect" : "direct"),
+			best->gflops(best->mean_ms));
+	
+	if (!write_json(config.json_file_name, dev, config, results)) {
+		return false;
+	}
+	log_msg("wrote benchmark results to \"$\"", config.json_file_name);
+	return true;
+#endif
+}
+	
+} // nbody_benchmark
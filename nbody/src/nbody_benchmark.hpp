@@ -0,0 +1,52 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2025 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_NBODY_NBODY_BENCHMARK_HPP__
+#define __FLOOR_NBODY_NBODY_BENCHMARK_HPP__
+
+#include <floor/core/essentials.hpp>
+#include <floor/device/device_context.hpp>
+#include <floor/device/device_queue.hpp>
+using namespace fl;
+
+//! headless nbody benchmark suite: sweeps body counts, tile sizes, the FMA and non-FMA code paths
+//! and direct vs indirect command pipeline execution, then writes all results to a JSON file
+namespace nbody_benchmark {
+
+struct config_t {
+	std::vector<uint32_t> body_counts { 16384u, 32768u, 65536u, 131072u };
+	std::vector<uint32_t> tile_sizes { 64u, 128u, 256u, 512u, 1024u };
+	//! #simulation steps per timed run
+	uint32_t iterations { 100u };
+	//! #timed runs per configuration (-> variance)
+	uint32_t repeats { 5u };
+	std::string json_file_name { "nbody_benchmark.json" };
+	bool no_indirect { false };
+};
+
+//! runs all benchmark configurations, logs the results and writes the JSON report
+//! NOTE: this compiles the nbody program for each tile size and FMA/non-FMA combination
+//! NOTE: GFLOPS are always computed from NBODY_FLOPS_PER_INTERACTION (-> FMA and non-FMA results are directly comparable)
+bool run(device_context& ctx, const device& dev, device_queue& dev_queue, const config_t& config);
+
+//! parses a comma-separated list of unsigned integers (e.g. "1024,2048,4096"), returns an empty vector on failure
+std::vector<uint32_t> parse_uint_list(const char* str);
+	
+} // nbody_benchmark
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2025 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "nbody_diagnostics.hpp"
+#include "nbody_state.hpp"
+#include <floor/floor.hpp>
+using namespace std;
+
+nbody_diagnostics::nbody_diagnostics(device_context& ctx, const device_queue& dev_queue, const uint32_t body_count_,
+									 const uint32_t tile_size_, const string& csv_file_name) :
+body_count(body_count_), tile_size(tile_size_), group_count(body_count_ / tile_size_) {
+	group_diagnostics_buffer = ctx.create_buffer(dev_queue, sizeof(float4) * NBODY_DIAGNOSTICS_VALUES_PER_GROUP * group_count,
+												 MEMORY_FLAG::WRITE | MEMORY_FLAG::HOST_READ);
+	if (!group_diagnostics_buffer) {
+		log_error("failed to create diagnostics buffer");
+		return;
+	}
+	group_diagnostics = make_unique<float4[]>(NBODY_DIAGNOSTICS_VALUES_PER_GROUP * group_count);
+	
+	if (!csv_file_name.empty()) {
+		csv_file.open(csv_file_name, ios::out | ios::trunc);
+		if (!csv_file.is_open()) {
+			log_error("failed to open diagnostics CSV file \"$\" for writing", csv_file_name);
+			return;
+		}
+		csv_file << "step,sim_time,kinetic_energy,potential_energy,total_energy,energy_drift,";
+		csv_file << "momentum_x,momentum_y,momentum_z,angular_momentum_x,angular_momentum_y,angular_momentum_z,";
+		csv_file << "bbox_min_x,bbox_min_y,bbox_min_z,bbox_max_x,bbox_max_y,bbox_max_z" << endl;
+		csv_file.precision(17);
+	}
+	valid = true;
+}
+
+void nbody_diagnostics::reset() {
+	reference_energy.reset();
+}
+
+optional<nbody_diagnostics::result_t> nbody_diagnostics::compute(const device_queue& dev_queue,
+																 const device_function& diagnostics_function,
+																 const shared_ptr<device_buffer>& positions,
+																 const shared_ptr<device_buffer>& velocities,
+																 const uint64_t step, const double sim_time) {
+	if (!valid) {
+		return {};
+	}
+	
+	dev_queue.execute(diagnostics_function,
+					  uint1 { body_count },
+					  uint1 { tile_size },
+					  /* positions: */			positions,
+					  /* velocities: */			velocities,
+					  /* group_diagnostics: */	group_diagnostics_buffer);
+	group_diagnostics_buffer->read(dev_queue, group_diagnostics.get(),
+								   sizeof(float4) * NBODY_DIAGNOSTICS_VALUES_PER_GROUP * group_count);
+	
+	// combine all work-group results (in double precision)
+	result_t result {
+		.step = step,
+		.sim_time = sim_time,
+		.bbox_min = float3 { numeric_limits<float>::max() },
+		.bbox_max = float3 { -numeric_limits<float>::max() },
+	};
+	for (uint32_t group = 0; group < group_count; ++group) {
+		const auto group_values = &group_diagnostics[group * NBODY_DIAGNOSTICS_VALUES_PER_GROUP];
+		result.kinetic_energy += double(group_values[0].x);
+		result.potential_energy += double(group_values[0].y);
+		result.linear_momentum += group_values[1].xyz.cast<double>();
+		result.angular_momentum += group_values[2].xyz.cast<double>();
+		result.bbox_min.min(group_values[3].xyz);
+		result.bbox_max.max(group_values[4].xyz);
+	}
+	
+	const auto total_energy = result.total_energy();
+	if (!reference_energy) {
+		reference_energy = total_energy;
+	}
+	const auto energy_drift = (*reference_energy != 0.0 ? (total_energy - *reference_energy) / abs(*reference_energy) : 0.0);
+	
+	log_msg("diagnostics @ step $ (t = $): E = $ (kinetic: $, potential: $, drift: $%), |P| = $, |L| = $, bbox: $ -> $",
+			step, sim_time, total_energy, result.kinetic_energy, result.potential_energy, energy_drift * 100.0,
+			result.linear_momentum.length(), result.angular_momentum.length(), result.bbox_min, result.bbox_max);
+	// NOTE: with damping (< 1), kinetic energy is drained by design -> energy isn't expected to be conserved
+	if (!isfinite(total_energy)) {
+		log_warn("energy is not finite - time step and/or softening are likely too large for this system");
+	} else if (nbody_state.damping >= 1.0f && abs(energy_drift) > energy_drift_warning_threshold) {
+		log_warn("energy is not conserved (drift: $%) - time step and/or softening are likely too large for this system",
+				 energy_drift * 100.0);
+	}
+	
+	if (csv_file.is_open()) {
+		csv_file << step << "," << sim_time << "," << result.kinetic_energy << "," << result.potential_energy << ",";
+		csv_file << total_energy << "," << energy_drift << ",";
+		csv_file << result.linear_momentum.x << "," << result.linear_momentum.y << "," << result.linear_momentum.z << ",";
+		csv_file << result.angular_momentum.x << "," << result.angular_momentum.y << "," << result.angular_momentum.z << ",";
+		csv_file << result.bbox_min.x << "," << result.bbox_min.y << "," << result.bbox_min.z << ",";
+		csv_file << result.bbox_max.x << "," << result.bbox_max.y << "," << result.bbox_max.z << endl;
+	}
+	return result;
+}
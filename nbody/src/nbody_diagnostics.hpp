@@ -0,0 +1,83 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2025 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_NBODY_NBODY_DIAGNOSTICS_HPP__
+#define __FLOOR_NBODY_NBODY_DIAGNOSTICS_HPP__
+
+#include <floor/core/essentials.hpp>
+#include <floor/device/device_context.hpp>
+#include <floor/device/device_queue.hpp>
+#include <floor/device/device_buffer.hpp>
+#include <floor/device/device_function.hpp>
+#include <fstream>
+#include <optional>
+using namespace fl;
+
+//! conserved-quantity diagnostics of the current nbody system (computed on the device, combined on the host)
+class nbody_diagnostics {
+public:
+	struct result_t {
+		uint64_t step { 0u };
+		double sim_time { 0.0 };
+		double kinetic_energy { 0.0 };
+		double potential_energy { 0.0 };
+		double3 linear_momentum;
+		double3 angular_momentum;
+		float3 bbox_min;
+		float3 bbox_max;
+		
+		double total_energy() const {
+			return kinetic_energy + potential_energy;
+		}
+	};
+	
+	//! if "csv_file_name" is not empty, all results are also written to this CSV file
+	nbody_diagnostics(device_context& ctx, const device_queue& dev_queue, const uint32_t body_count,
+					  const uint32_t tile_size, const std::string& csv_file_name);
+	
+	//! returns true if the diagnostics buffer and CSV file (if requested) could be created
+	bool is_valid() const {
+		return valid;
+	}
+	
+	//! computes all diagnostics for the specified positions/velocities, logs them and writes them to the CSV file
+	//! NOTE: this blocks until the result is available
+	std::optional<result_t> compute(const device_queue& dev_queue, const device_function& diagnostics_function,
+									const std::shared_ptr<device_buffer>& positions,
+									const std::shared_ptr<device_buffer>& velocities,
+									const uint64_t step, const double sim_time);
+	
+	//! resets the reference energy that is used to compute the energy drift (e.g. when the system is re-initialized)
+	void reset();
+	
+	//! relative energy drift (to the reference energy) above which a warning is emitted (only without damping)
+	static constexpr const double energy_drift_warning_threshold { 0.01 };
+	
+protected:
+	uint32_t body_count { 0u };
+	uint32_t tile_size { 0u };
+	uint32_t group_count { 0u };
+	std::shared_ptr<device_buffer> group_diagnostics_buffer;
+	std::unique_ptr<float4[]> group_diagnostics;
+	std::ofstream csv_file;
+	std::optional<double> reference_energy;
+	bool valid { false };
+	
+};
+
+#endif
@@ -0,0 +1,306 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2025 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "nbody_snapshot.hpp"
+#include <floor/floor.hpp>
+#include <fstream>
+using namespace std;
+
+namespace nbody_snapshot {
+
+static constexpr uint64_t align_offset(const uint64_t offset, const uint64_t alignment) {
+	return ((offset + alignment - 1u) / alignment) * alignment;
+}
+
+//! writes zeros until the put position of "file" is at "offset"
+static void pad_to(ofstream& file, const uint64_t offset) {
+	static constexpr const array<char, 256> zeros {};
+	auto cur_offset = uint64_t(file.tellp());
+	while (cur_offset < offset) {
+		const auto pad_size = min(uint64_t(zeros.size()), offset - cur_offset);
+		file.write(zeros.data(), streamsize(pad_size));
+		cur_offset += pad_size;
+	}
+}
+
+optional<header_t> read_header(const string& file_name) {
+	ifstream file(file_name, ios::in | ios::binary);
+	if (!file.is_open()) {
+		log_error("failed to open nbody snapshot file \"$\"", file_name);
+		return {};
+	}
+
+	header_t header;
+	if (!file.read((char*)&header, sizeof(header_t))) {
+		log_error("nbody snapshot file \"$\" is too small", file_name);
+		return {};
+	}
+	if (header.magic != file_magic) {
+		log_error("\"$\" is not an nbody snapshot file", file_name);
+		return {};
+	}
+	if (header.version != file_version) {
+		log_error("unsupported nbody snapshot version $ in \"$\" (expected $)", header.version, file_name, file_version);
+		return {};
+	}
+	if (header.position_stride != sizeof(float4) || header.velocity_stride != sizeof(float3)) {
+		log_error("nbody snapshot \"$\" was written with an incompatible position/velocity layout", file_name);
+		return {};
+	}
+	if (header.body_count == 0u) {
+		log_error("nbody snapshot \"$\" contains no bodies", file_name);
+		return {};
+	}
+	return header;
+}
+
+bool load(const string& file_name, const device_queue& dev_queue,
+		  device_buffer& positions, device_buffer& velocities, header_t& header) {
+	const auto read_hdr = read_header(file_name);
+	if (!read_hdr) {
+		return false;
+	}
+	header = *read_hdr;
+	if (header.type != FILE_TYPE::SNAPSHOT) {
+		log_error("\"$\" is not a snapshot file (trajectories can not be resumed)", file_name);
+		return false;
+	}
+
+	const auto positions_size = size_t(header.body_count) * sizeof(float4);
+	const auto velocities_size = size_t(header.body_count) * sizeof(float3);
+	if (positions.get_size() < positions_size || velocities.get_size() < velocities_size) {
+		log_error("position/velocity buffers are too small for snapshot \"$\" ($ bodies)", file_name, header.body_count);
+		return false;
+	}
+
+	ifstream file(file_name, ios::in | ios::binary);
+	if (!file.is_open()) {
+		log_error("failed to open nbody snapshot file \"$\"", file_name);
+		return false;
+	}
+
+	// read directly into the mapped device memory
+	bool success = true;
+	auto mapped_positions = positions.map(dev_queue, MEMORY_MAP_FLAG::WRITE_INVALIDATE | MEMORY_MAP_FLAG::BLOCK);
+	file.seekg(streamoff(header.position_offset));
+	if (!file.read((char*)mapped_positions, streamsize(positions_size))) {
+		log_error("failed to read positions from nbody snapshot \"$\"", file_name);
+		success = false;
+	}
+	positions.unmap(dev_queue, mapped_positions);
+	if (!success) {
+		return false;
+	}
+
+	auto mapped_velocities = velocities.map(dev_queue, MEMORY_MAP_FLAG::WRITE_INVALIDATE | MEMORY_MAP_FLAG::BLOCK);
+	file.seekg(streamoff(header.velocity_offset));
+	if (!file.read((char*)mapped_velocities, streamsize(velocities_size))) {
+		log_error("failed to read velocities from nbody snapshot \"$\"", file_name);
+		success = false;
+	}
+	velocities.unmap(dev_queue, mapped_velocities);
+	return success;
+}
+
+//! state of the currently open trajectory file (only accessed by the worker thread after creation)
+struct async_writer::trajectory_t {
+	string file_name;
+	ofstream file;
+	header_t header;
+	//! host-side staging memory for one frame
+	unique_ptr<float4[]> frame_data;
+};
+
+async_writer::async_writer(device_context& ctx, const device& dev) : io_queue(ctx.create_queue(dev)) {
+	worker = thread([this] { run(); });
+}
+
+async_writer::~async_writer() {
+	flush();
+	{
+		unique_lock<mutex> lock(jobs_lock);
+		shutdown = true;
+	}
+	jobs_cv.notify_all();
+	if (worker.joinable()) {
+		worker.join();
+	}
+	close_trajectory();
+	io_queue = nullptr;
+}
+
+void async_writer::run() {
+	for (;;) {
+		function<void()> job;
+		{
+			unique_lock<mutex> lock(jobs_lock);
+			jobs_cv.wait(lock, [this] { return shutdown || !jobs.empty(); });
+			if (jobs.empty()) {
+				// -> shutdown
+				return;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			++active_jobs;
+		}
+		job();
+		{
+			unique_lock<mutex> lock(jobs_lock);
+			--active_jobs;
+		}
+		done_cv.notify_all();
+	}
+}
+
+void async_writer::enqueue(function<void()>&& job) {
+	{
+		unique_lock<mutex> lock(jobs_lock);
+		// bound the amount of memory/work that can be queued up
+		done_cv.wait(lock, [this] { return jobs.size() < max_pending_jobs; });
+		jobs.emplace_back(std::move(job));
+	}
+	jobs_cv.notify_one();
+}
+
+void async_writer::flush() {
+	unique_lock<mutex> lock(jobs_lock);
+	done_cv.wait(lock, [this] { return jobs.empty() && active_jobs == 0u; });
+}
+
+void async_writer::wait_for_buffer(const device_buffer* buffer) {
+	unique_lock<mutex> lock(jobs_lock);
+	done_cv.wait(lock, [this, buffer] {
+		const auto iter = pending_buffers.find(buffer);
+		return (iter == pending_buffers.end() || iter->second == 0u);
+	});
+}
+
+void async_writer::write_snapshot(const string& file_name, const device_queue& dev_queue,
+								  device_buffer& positions, device_buffer& velocities, const header_t& header_) {
+	auto header = make_shared<header_t>(header_);
+	header->type = FILE_TYPE::SNAPSHOT;
+	header->position_stride = sizeof(float4);
+	header->velocity_stride = sizeof(float3);
+	header->position_offset = block_alignment;
+	header->velocity_offset = align_offset(header->position_offset + size_t(header->body_count) * sizeof(float4), block_alignment);
+
+	// velocities are updated in-place every step -> must read back synchronously here
+	shared_ptr<float4[]> position_data(new float4[header->body_count]);
+	shared_ptr<float3[]> velocity_data(new float3[header->body_count]);
+	positions.read(dev_queue, position_data.get(), size_t(header->body_count) * sizeof(float4));
+	velocities.read(dev_queue, velocity_data.get(), size_t(header->body_count) * sizeof(float3));
+
+	enqueue([file_name, header, position_data, velocity_data] {
+		ofstream file(file_name, ios::out | ios::binary | ios::trunc);
+		if (!file.is_open()) {
+			log_error("failed to open nbody snapshot file \"$\" for writing", file_name);
+			return;
+		}
+		file.write((const char*)header.get(), sizeof(header_t));
+		pad_to(file, header->position_offset);
+		file.write((const char*)position_data.get(), streamsize(size_t(header->body_count) * sizeof(float4)));
+		pad_to(file, header->velocity_offset);
+		file.write((const char*)velocity_data.get(), streamsize(size_t(header->body_count) * sizeof(float3)));
+		if (!file.good()) {
+			log_error("failed to write nbody snapshot \"$\"", file_name);
+			return;
+		}
+		log_msg("wrote nbody snapshot \"$\" (step $)", file_name, header->step);
+	});
+}
+
+bool async_writer::open_trajectory(const string& file_name, const header_t& header) {
+	flush();
+	close_trajectory();
+
+	auto traj = make_unique<trajectory_t>();
+	traj->file_name = file_name;
+	traj->file.open(file_name, ios::out | ios::binary | ios::trunc);
+	if (!traj->file.is_open()) {
+		log_error("failed to open nbody trajectory file \"$\" for writing", file_name);
+		return false;
+	}
+	traj->header = header;
+	traj->header.type = FILE_TYPE::TRAJECTORY;
+	traj->header.position_stride = sizeof(float4);
+	traj->header.velocity_stride = sizeof(float3);
+	traj->header.first_frame_offset = block_alignment;
+	traj->header.frame_stride = align_offset(frame_alignment + size_t(header.body_count) * sizeof(float4), frame_alignment);
+	traj->header.frame_count = 0u;
+	traj->frame_data = make_unique<float4[]>(header.body_count);
+
+	// header is rewritten with the final frame count once the trajectory is closed
+	traj->file.write((const char*)&traj->header, sizeof(header_t));
+	pad_to(traj->file, traj->header.first_frame_offset);
+	trajectory = std::move(traj);
+	return true;
+}
+
+void async_writer::close_trajectory() {
+	if (!trajectory) {
+		return;
+	}
+	trajectory->file.seekp(0);
+	trajectory->file.write((const char*)&trajectory->header, sizeof(header_t));
+	trajectory->file.close();
+	log_msg("wrote nbody trajectory \"$\" ($ frames)", trajectory->file_name, trajectory->header.frame_count);
+	trajectory = nullptr;
+}
+
+void async_writer::push_trajectory_frame(shared_ptr<device_buffer> positions, const uint64_t step, const double sim_time) {
+	if (!trajectory) {
+		return;
+	}
+	{
+		unique_lock<mutex> lock(jobs_lock);
+		++pending_buffers[positions.get()];
+	}
+	enqueue([this, positions, step, sim_time] {
+		auto& traj = *trajectory;
+		const auto positions_size = size_t(traj.header.body_count) * sizeof(float4);
+		positions->read(*io_queue, traj.frame_data.get(), positions_size);
+		{
+			// readback is done -> buffer may be written again
+			unique_lock<mutex> lock(jobs_lock);
+			--pending_buffers[positions.get()];
+		}
+		done_cv.notify_all();
+
+		const frame_header_t frame_header {
+			.step = step,
+			.sim_time = sim_time,
+			.body_count = traj.header.body_count,
+		};
+		const auto frame_offset = traj.header.first_frame_offset + traj.header.frame_count * traj.header.frame_stride;
+		traj.file.write((const char*)&frame_header, sizeof(frame_header_t));
+		pad_to(traj.file, frame_offset + frame_alignment);
+		traj.file.write((const char*)traj.frame_data.get(), streamsize(positions_size));
+		pad_to(traj.file, frame_offset + traj.header.frame_stride);
+		if (!traj.file.good()) {
+			log_error("failed to write frame $ to nbody trajectory \"$\"", traj.header.frame_count, traj.file_name);
+			return;
+		}
+		if (traj.header.frame_count == 0u) {
+			traj.header.step = step;
+			traj.header.sim_time = sim_time;
+		}
+		++traj.header.frame_count;
+	});
+}
+
+} // nbody_snapshot
@@ -0,0 +1,166 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2025 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_NBODY_NBODY_SNAPSHOT_HPP__
+#define __FLOOR_NBODY_NBODY_SNAPSHOT_HPP__
+
+#include <floor/core/essentials.hpp>
+#include <floor/device/device_context.hpp>
+#include <floor/device/device_queue.hpp>
+#include <floor/device/device_buffer.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+using namespace fl;
+
+//! nbody snapshot and trajectory file format
+//!
+//! all values are stored in native (little-endian) byte order, every block starts at an aligned offset,
+//! so that a file can be memory-mapped as-is and all blocks can be accessed as plain arrays:
+//!  * snapshot:   [header (4 KiB)] [float4 position/mass block] [float3 velocity block]
+//!  * trajectory: [header (4 KiB)] [frame #0] [frame #1] ... with each frame being
+//!                [frame_header_t (256 bytes)] [float4 position/mass block]
+//!                and frame #i starting at "first_frame_offset + i * frame_stride"
+namespace nbody_snapshot {
+
+//! "NBDY"
+static constexpr const uint32_t file_magic { 0x5944424Eu };
+static constexpr const uint32_t file_version { 1u };
+//! alignment of the position/velocity blocks in snapshot files (== header size)
+static constexpr const uint64_t block_alignment { 4096u };
+//! alignment/size of each frame header in trajectory files
+static constexpr const uint64_t frame_alignment { 256u };
+
+enum class FILE_TYPE : uint32_t {
+	SNAPSHOT = 0u,
+	TRAJECTORY = 1u,
+};
+
+struct header_t {
+	uint32_t magic { file_magic };
+	uint32_t version { file_version };
+	FILE_TYPE type { FILE_TYPE::SNAPSHOT };
+	uint32_t body_count { 0u };
+
+	//! simulation step this snapshot was taken at (trajectory: step of the first frame)
+	uint64_t step { 0u };
+	//! simulated time at "step"
+	double sim_time { 0.0 };
+
+	//! simulation parameters used when the snapshot was taken
+	float time_step { 0.0f };
+	float softening { 0.0f };
+	float damping { 0.0f };
+	//! NBODY_SETUP that was used to generate the initial system
+	uint32_t setup { 0u };
+	float mass_min { 0.0f };
+	float mass_max { 0.0f };
+
+	//! sizeof(float4) and sizeof(float3) at the time of writing
+	uint32_t position_stride { 0u };
+	uint32_t velocity_stride { 0u };
+
+	//! snapshot only: absolute file offsets of the position/mass and velocity blocks
+	uint64_t position_offset { 0u };
+	uint64_t velocity_offset { 0u };
+
+	//! trajectory only: frame layout, #frames and #steps between two frames
+	uint64_t first_frame_offset { 0u };
+	uint64_t frame_stride { 0u };
+	uint64_t frame_count { 0u };
+	uint32_t frame_interval { 0u };
+	uint32_t _unused { 0u };
+};
+static_assert(sizeof(header_t) == 112u, "unexpected header size/padding");
+static_assert(sizeof(header_t) <= block_alignment);
+
+struct frame_header_t {
+	uint64_t step { 0u };
+	double sim_time { 0.0 };
+	uint32_t body_count { 0u };
+	uint32_t _unused { 0u };
+};
+static_assert(sizeof(frame_header_t) <= frame_alignment);
+
+//! reads and validates the header of the specified snapshot or trajectory file
+std::optional<header_t> read_header(const std::string& file_name);
+
+//! loads the snapshot from "file_name" directly into the specified position/velocity buffers,
+//! the buffers must be large enough to hold "body_count" bodies as specified in the snapshot header
+bool load(const std::string& file_name, const device_queue& dev_queue,
+		  device_buffer& positions, device_buffer& velocities, header_t& header);
+
+//! single worker thread that writes snapshots and trajectory frames to disk
+//! NOTE: trajectory position readback is performed on a separate device queue, so that the compute loop is never stalled
+//!       as long as the writer keeps up with the requested output interval
+class async_writer {
+public:
+	async_writer(device_context& ctx, const device& dev);
+	~async_writer();
+
+	//! synchronously reads back the current positions and velocities on "dev_queue", then writes them to "file_name" async
+	//! NOTE: all prior work on "dev_queue" must have completed
+	void write_snapshot(const std::string& file_name, const device_queue& dev_queue,
+						device_buffer& positions, device_buffer& velocities, const header_t& header);
+
+	//! starts a new trajectory file, any previously open trajectory is finalized
+	bool open_trajectory(const std::string& file_name, const header_t& header);
+
+	//! queues an async readback of "positions" on the writer queue and appends it as a new frame to the trajectory
+	//! NOTE: all work writing "positions" must have completed, "positions" must not be written again until
+	//!       "wait_for_buffer" has been called for it
+	void push_trajectory_frame(std::shared_ptr<device_buffer> positions, const uint64_t step, const double sim_time);
+
+	//! blocks until there is no pending readback of the specified buffer anymore
+	void wait_for_buffer(const device_buffer* buffer);
+
+	//! blocks until all queued work has been written to disk
+	void flush();
+
+protected:
+	std::shared_ptr<device_queue> io_queue;
+
+	std::thread worker;
+	std::mutex jobs_lock;
+	std::condition_variable jobs_cv;
+	std::condition_variable done_cv;
+	std::deque<std::function<void()>> jobs;
+	uint32_t active_jobs { 0u };
+	bool shutdown { false };
+	//! buffer -> #pending readbacks
+	std::unordered_map<const device_buffer*, uint32_t> pending_buffers;
+
+	//! the maximum amount of queued jobs before "push_trajectory_frame" starts blocking
+	static constexpr const size_t max_pending_jobs { 3u };
+
+	struct trajectory_t;
+	std::unique_ptr<trajectory_t> trajectory;
+
+	void run();
+	void enqueue(std::function<void()>&& job);
+	void close_trajectory();
+
+};
+
+} // nbody_snapshot
+
+#endif
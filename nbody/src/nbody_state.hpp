@@ -33,8 +33,52 @@
 #define NBODY_TILE_SIZE 256u
 #endif
 
+// fixed time step of the nbody_compute_fixed_delta kernel (indirect benchmark): 20ms
+#define NBODY_FIXED_TIME_STEP 0.02f
+
+// #flops per body/body interaction that are used to compute GFLOPS (interactive mode and benchmark suite)
+#define NBODY_FLOPS_PER_INTERACTION 19u
+// #flops per body/body interaction when counting each FMA as a single op
+#define NBODY_FLOPS_PER_INTERACTION_FMA 13u
+
+// #float4 values that are written per work-group by the diagnostics kernel
+#define NBODY_DIAGNOSTICS_VALUES_PER_GROUP 5u
+
+// s/w rasterizer: screen tile size (NxN pixels) and work-group size of the tile offset scan
+#if !defined(NBODY_RASTER_TILE_SIZE)
+#define NBODY_RASTER_TILE_SIZE 16u
+#endif
+
+#if !defined(NBODY_RASTER_SCAN_SIZE)
+#define NBODY_RASTER_SCAN_SIZE 256u
+#endif
+
 using namespace fl;
 
+//! hierarchical block time-stepping parameters (shared by host and device code)
+//! NOTE: bodies on level k use a time step of "time_step / 2^k", one full step consists of 2^max_level sub-steps
+struct block_step_params {
+	//! largest time step (level 0)
+	float time_step;
+	//! accuracy parameter of the time step criterion: dt = eta * sqrt(softening / |acceleration|)
+	float eta;
+	//! finest level
+	uint32_t max_level;
+	//! current sub-step in [0, 2^max_level)
+	uint32_t sub_step;
+	uint32_t body_count;
+};
+
+//! s/w rasterizer parameters (shared by host and device code)
+struct raster_params {
+	matrix4f mview;
+	uint2 img_size;
+	//! #tiles in x and y
+	uint2 tile_count;
+	float2 mass_minmax;
+	uint32_t body_count;
+};
+
 struct nbody_state_struct {
 	uint32_t body_count { 65536 };
 	
@@ -68,6 +112,15 @@ struct nbody_state_struct {
 	bool no_indirect { false };
 	bool no_fubar { false };
 	
+	// headless s/w rendering: #frames to render (0 == disabled), image size and if frames are written to disk
+	uint32_t headless_frames { 0 };
+	uint2 headless_size { 1920, 1080 };
+	bool frame_dump { true };
+	
+	// hierarchical block time-stepping: #levels below the base time step (0 == disabled) and accuracy parameter
+	uint32_t block_levels { 0 };
+	float block_eta { 0.025f };
+	
 };
 #if !defined(FLOOR_DEVICE) || defined(FLOOR_DEVICE_HOST_COMPUTE)
 extern nbody_state_struct nbody_state;
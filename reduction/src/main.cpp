@@ -20,7 +20,15 @@
 #include <floor/core/option_handler.hpp>
 #include <floor/compute/compute_kernel.hpp>
 #include <floor/core/aligned_ptr.hpp>
+#include <floor/core/timer.hpp>
 #include "reduction_state.hpp"
+#include "reduction_dispatch.hpp"
+#include "reduction_host.hpp"
+#include "reduction_segmented.hpp"
+#include "reduction_primitives.hpp"
+#include "reduction_streaming.hpp"
+#include "reduction_benchmark.hpp"
+#include "reduction_multi_device.hpp"
 reduction_state_struct reduction_state;
 
 struct reduction_option_context {
@@ -37,91 +45,77 @@ static shared_ptr<compute_queue> dev_queue;
 static const compute_device* fastest_device { nullptr };
 //
 static shared_ptr<compute_program> reduction_prog;
-// POT sizes from 32 - 1024
-#define POT_TILE_SIZES(F) \
-F(32) \
-F(64) \
-F(128) \
-F(256) \
-F(512) \
-F(1024)
-//
-#define REDUCTION_KERNEL_ENUMS(tile_size) \
-	REDUCTION_ADD_F32_##tile_size, \
-	REDUCTION_ADD_U32_##tile_size, \
-	REDUCTION_ADD_F64_##tile_size, \
-	REDUCTION_ADD_U64_##tile_size,
-#define SCAN_KERNEL_ENUMS(tile_size) \
-	INCL_SCAN_LOCAL_U32_##tile_size, \
-	EXCL_SCAN_LOCAL_U32_##tile_size, \
-	INCL_SCAN_GLOBAL_U32_##tile_size, \
-	EXCL_SCAN_GLOBAL_U32_##tile_size,
-//
-#define REDUCTION_KERNEL_NAMES(tile_size) \
-	"reduce_add_f32_" #tile_size, \
-	"reduce_add_u32_" #tile_size, \
-	"reduce_add_f64_" #tile_size, \
-	"reduce_add_u64_" #tile_size,
-#define SCAN_KERNEL_NAMES(tile_size) \
-	"incl_scan_local_u32_" #tile_size, \
-	"excl_scan_local_u32_" #tile_size, \
-	"incl_scan_global_u32_" #tile_size, \
-	"excl_scan_global_u32_" #tile_size,
-//
-enum ALGO_KERNEL_TYPE : uint32_t {
-	POT_TILE_SIZES(REDUCTION_KERNEL_ENUMS)
-	POT_TILE_SIZES(SCAN_KERNEL_ENUMS)
-	__MAX_ALGO_KERNEL_TYPE
-};
-//
-static const array<const char*, __MAX_ALGO_KERNEL_TYPE> algo_kernel_names {{
-	POT_TILE_SIZES(REDUCTION_KERNEL_NAMES)
-	POT_TILE_SIZES(SCAN_KERNEL_NAMES)
-}};
-//
-static array<shared_ptr<compute_kernel>, __MAX_ALGO_KERNEL_TYPE> algo_kernels;
-//
-static array<uint1, __MAX_ALGO_KERNEL_TYPE> algo_max_local_sizes;
-// flag each kernel as usable/unusable (based on local size and 64-bit capabilities)
-static array<bool, __MAX_ALGO_KERNEL_TYPE> algo_kernel_usable;
-//
-#define REDUCTION_KERNEL_SIZES_ARRAY(tile_size) \
-	tile_size, tile_size, tile_size, tile_size, /* 4 kernels each */
-#define SCAN_KERNEL_SIZES_ARRAY(tile_size) \
-	tile_size, tile_size, tile_size, tile_size, /* 4 kernels each */
-static const array<uint32_t, __MAX_ALGO_KERNEL_TYPE> algo_kernel_sizes {{
-	POT_TILE_SIZES(REDUCTION_KERNEL_SIZES_ARRAY)
-	POT_TILE_SIZES(SCAN_KERNEL_SIZES_ARRAY)
-}};
+// retrieves and dispatches all reduce/scan kernels
+static unique_ptr<reduction_dispatcher> dispatcher;
 
 //! option -> function map
 template<> vector<pair<string, reduction_opt_handler::option_function>> reduction_opt_handler::options {
 	{ "--help", [](reduction_option_context&, char**&) {
 		cout << "command line options:" << endl;
-		cout << "\t--size <count>: TODO" << endl;
-		cout << "\t--benchmark: runs in benchmark mode (fixed 20 iterations)" << endl;
-		cout << "\t--iterations: when not running in benchmark mode, set the amount of iterations (default: 3)" << endl;
+		cout << "\t--size <count>: amount of elements to reduce/scan, may exceed 4G (in benchmark mode: largest element count of the sweep, default: device maximum)" << endl;
+		cout << "\t--benchmark: sweeps element counts from 1K up to --size over all tile sizes and reduction algorithms (local memory, shuffle, coop)" << endl;
+		cout << "\t             and compares the achieved bandwidth against a device-to-device copy" << endl;
+		cout << "\t--benchmark-json <file>: JSON output file of the benchmark (default: reduction_benchmark.json)" << endl;
+		cout << "\t--benchmark-csv <file>: CSV output file of the benchmark (default: reduction_benchmark.csv)" << endl;
+		cout << "\t--iterations: set the amount of iterations (in benchmark mode: timed runs per configuration, default: 3)" << endl;
 		cout << "\t--reduction: performs a float reduction (default)" << endl;
 		cout << "\t--reduction-uint: performs a uint32_t reduction" << endl;
 		cout << "\t--incl-scan: performs an inclusive scan" << endl;
 		cout << "\t--excl-scan: performs an exclusive scan" << endl;
+		cout << "\t--op <name>: reduces/scans with the specified operator (default: add_f32 for reductions, add_u32 otherwise)" << endl;
+		cout << "\t             available operators:";
+		for (const auto& op : get_reduction_ops()) {
+			cout << " " << op.name;
+		}
+		cout << endl;
+		cout << "\t--segmented <count>: runs a segmented reduction/scan with <count> heavy-tailed segments and compares it against one launch per segment" << endl;
+		cout << "\t--seg-flags: specifies segments via head flags instead of segment offsets" << endl;
+		cout << "\t--primitives: runs and verifies the scan-based select/partition/run-length encoding and the histogram primitives" << endl;
+		cout << "\t--histogram-bins <count>: bin count of the histogram primitive (64, 256, 1024 or 4096, default: 256)" << endl;
+		cout << "\t--stream <file>: out-of-core reduction/scan of a file of raw input elements (streamed in chunks through the device)" << endl;
+		cout << "\t--stream-gen <count>: generates the stream file with <count> random elements first" << endl;
+		cout << "\t--stream-chunk <MiB>: size of each streamed chunk (default: 64)" << endl;
+		cout << "\t--stream-buffers <2|3>: amount of rotating device buffers used for streaming (default: 3)" << endl;
+		cout << "\t--deterministic: bitwise reproducible float reductions (per-group partials + fixed-order partials pass instead of atomics)," << endl;
+		cout << "\t                 reports the throughput cost vs. the atomic path" << endl;
+		cout << "\t--multi-device: splits the reduction/scan across all devices of the compute context (proportionally to their bandwidth)" << endl;
+		cout << "\t--multi-device-min <count>: min element count for which more than one device is used (default: 16M)" << endl;
 		reduction_state.done = true;
 	}},
 	{ "--size", [](reduction_option_context&, char**& arg_ptr) {
 		++arg_ptr;
 		if(*arg_ptr == nullptr || **arg_ptr == '-') {
-			cerr << "invalid argument after --count!" << endl;
+			cerr << "invalid argument after --size!" << endl;
 			reduction_state.done = true;
 			return;
 		}
-		// TODO
-		//reduction_state. = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
-		//cout << "size set to: " << reduction_state. << endl;
+		reduction_state.size = (uint64_t)strtoull(*arg_ptr, nullptr, 10);
+		cout << "size set to: " << reduction_state.size << endl;
 	}},
 	{ "--benchmark", [](reduction_option_context&, char**&) {
 		reduction_state.benchmark = true;
 		cout << "benchmark mode enabled" << endl;
 	}},
+	{ "--benchmark-json", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --benchmark-json!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.benchmark_json_file = *arg_ptr;
+		cout << "benchmark JSON file set to: " << reduction_state.benchmark_json_file << endl;
+	}},
+	{ "--benchmark-csv", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --benchmark-csv!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.benchmark_csv_file = *arg_ptr;
+		cout << "benchmark CSV file set to: " << reduction_state.benchmark_csv_file << endl;
+	}},
 	{ "--iterations", [](reduction_option_context&, char**& arg_ptr) {
 		++arg_ptr;
 		if (*arg_ptr == nullptr || **arg_ptr == '-') {
@@ -148,6 +142,112 @@ template<> vector<pair<string, reduction_opt_handler::option_function>> reductio
 		reduction_state.exec_mode = reduction_state_struct::EXEC_MODE::EXCLUSIVE_SCAN;
 		cout << "running exclusive scan" << endl;
 	}},
+	{ "--op", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --op!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		if (find_reduction_op(*arg_ptr) == nullptr) {
+			cerr << "unknown operator: " << *arg_ptr << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.op_name = *arg_ptr;
+		cout << "operator set to: " << reduction_state.op_name << endl;
+	}},
+	{ "--segmented", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --segmented!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.segment_count = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		cout << "segment count set to: " << reduction_state.segment_count << endl;
+	}},
+	{ "--seg-flags", [](reduction_option_context&, char**&) {
+		reduction_state.segment_head_flags = true;
+		cout << "using segment head flags" << endl;
+	}},
+	{ "--primitives", [](reduction_option_context&, char**&) {
+		reduction_state.primitives = true;
+		cout << "running primitives" << endl;
+	}},
+	{ "--histogram-bins", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --histogram-bins!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.histogram_bins = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		if (!reduction_primitives::is_valid_histogram_bin_count(reduction_state.histogram_bins)) {
+			cerr << "invalid histogram bin count: " << *arg_ptr << " (must be 64, 256, 1024 or 4096)" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		cout << "histogram bin count set to: " << reduction_state.histogram_bins << endl;
+	}},
+	{ "--stream", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --stream!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.stream_file = *arg_ptr;
+		cout << "stream file set to: " << reduction_state.stream_file << endl;
+	}},
+	{ "--stream-gen", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --stream-gen!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.stream_generate_count = (uint64_t)strtoull(*arg_ptr, nullptr, 10);
+		cout << "stream generate count set to: " << reduction_state.stream_generate_count << endl;
+	}},
+	{ "--stream-chunk", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --stream-chunk!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.stream_chunk_mib = max(1u, (uint32_t)strtoul(*arg_ptr, nullptr, 10));
+		cout << "stream chunk size set to: " << reduction_state.stream_chunk_mib << " MiB" << endl;
+	}},
+	{ "--stream-buffers", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --stream-buffers!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.stream_buffer_count = (uint32_t)strtoul(*arg_ptr, nullptr, 10);
+		cout << "stream buffer count set to: " << reduction_state.stream_buffer_count << endl;
+	}},
+	{ "--deterministic", [](reduction_option_context&, char**&) {
+		reduction_state.deterministic = true;
+		cout << "deterministic reduction enabled" << endl;
+	}},
+	{ "--multi-device", [](reduction_option_context&, char**&) {
+		reduction_state.multi_device = true;
+		cout << "multi-device mode enabled" << endl;
+	}},
+	{ "--multi-device-min", [](reduction_option_context&, char**& arg_ptr) {
+		++arg_ptr;
+		if (*arg_ptr == nullptr || **arg_ptr == '-') {
+			cerr << "invalid argument after --multi-device-min!" << endl;
+			reduction_state.done = true;
+			return;
+		}
+		reduction_state.multi_device_min_count = (uint64_t)strtoull(*arg_ptr, nullptr, 10);
+		cout << "multi-device min element count set to: " << reduction_state.multi_device_min_count << endl;
+	}},
 	// ignore xcode debug arg
 	{ "-NSDocumentRevisionsDebugMode", [](reduction_option_context&, char**&) {} },
 };
@@ -167,33 +267,16 @@ static bool compile_kernels() {
 		return false;
 	}
 	
-	decltype(algo_kernels) new_algo_kernels;
-	decltype(algo_max_local_sizes) new_algo_max_local_sizes;
-	decltype(algo_kernel_usable) new_algo_kernel_usable;
-	for (uint32_t i = 0; i < ALGO_KERNEL_TYPE::__MAX_ALGO_KERNEL_TYPE; ++i) {
-		new_algo_kernels[i] = new_reduction_prog->get_kernel(algo_kernel_names[i]);
-		if (new_algo_kernels[i] == nullptr) {
-			log_error("failed to retrieve kernel $ from program", algo_kernel_names[i]);
-			return false;
-		}
-		new_algo_max_local_sizes[i] = new_algo_kernels[i]->get_kernel_entry(*fastest_device)->max_total_local_size;
-		if (fastest_device->context->get_compute_type() != COMPUTE_TYPE::HOST) {
-			// usable if max local size >= required tile size, and if #args != 0 (i.e. kernel isn't disabled for other reasons)
-			new_algo_kernel_usable[i] = ((algo_kernel_sizes[i] <= new_algo_max_local_sizes[i].x) &&
-										 !new_algo_kernels[i]->get_kernel_entry(*fastest_device)->info->args.empty());
-		} else {
-			// always usable with host-compute
-			new_algo_kernel_usable[i] = true;
-		}
-		log_debug("$: local size: $, usable: $", algo_kernel_names[i], new_algo_max_local_sizes[i],
-				  new_algo_kernel_usable[i]);
+	auto new_dispatcher = reduction_dispatcher::create(*compute_ctx, *fastest_device, *new_reduction_prog);
+	if (!new_dispatcher) {
+		return false;
 	}
 	
+	new_dispatcher->set_deterministic(reduction_state.deterministic);
+	
 	// everything was successful, exchange objects
 	reduction_prog = new_reduction_prog;
-	algo_kernels = new_algo_kernels;
-	algo_max_local_sizes = new_algo_max_local_sizes;
-	algo_kernel_usable = new_algo_kernel_usable;
+	dispatcher = std::move(new_dispatcher);
 	return true;
 }
 
@@ -262,8 +345,21 @@ int main(int, char* argv[]) {
 	// compile the program and get the kernel functions
 	if(!compile_kernels()) return -1;
 	
+	// select the operator (default: float reduction, uint32_t reduction or uint32_t scan)
+	const auto is_scan = (reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN ||
+						  reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::EXCLUSIVE_SCAN);
+	const auto is_inclusive = (reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN);
+	if (reduction_state.op_name.empty()) {
+		reduction_state.op_name = (reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::REDUCTION_F32 ? "add_f32" : "add_u32");
+	}
+	const auto& op = *find_reduction_op(reduction_state.op_name);
+	if (is_scan && op.reduce_only) {
+		log_error("operator $ can only be used for reductions", op.name);
+		return -1;
+	}
+	
 	// reduction/scan buffers
-	uint32_t elem_count = 0;
+	uint64_t elem_count = 0;
 	if (reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::REDUCTION_F32) {
 #if !defined(FLOOR_IOS)
 		elem_count = 1024 * 1024 * 256; // == 1024 MiB (32-bit), 2048 MiB (64-bit)
@@ -278,256 +374,199 @@ int main(int, char* argv[]) {
 		elem_count = 1024 * 1024 * 64; // == 256 MiB (32-bit)
 #endif
 	} else {
-		// must use fewer elements for inclusive/exclusive scan, because we're limited to a 32-bit value range
-		elem_count = 1024 * 1024 * 32;
+		// NOTE: scan values wrap around identically on the CPU and the compute device, so the 32-bit value range is no limit here
+#if !defined(FLOOR_IOS)
+		elem_count = 1024 * 1024 * 256; // == 1024 MiB input + 1024 MiB output (32-bit)
+#else
+		elem_count = 1024 * 1024 * 64; // == 256 MiB input + 256 MiB output (32-bit)
+#endif
+	}
+	// keep the memory footprint constant for operators with larger input/output types
+	const auto elem_size = max(op.input_size, is_scan ? op.value_size : 0u);
+	elem_count = (elem_count * sizeof(uint32_t)) / elem_size;
+	if (reduction_state.size > 0u && !reduction_state.benchmark) {
+		elem_count = reduction_state.size;
+	}
+	
+	// out-of-core streaming, segmented reduce/scan, primitives, bandwidth benchmark or multi-device reduce/scan
+	if (!reduction_state.stream_file.empty() || reduction_state.segment_count > 0u || reduction_state.primitives ||
+		reduction_state.benchmark || reduction_state.multi_device) {
+		if ((reduction_state.segment_count > 0u || reduction_state.primitives) && elem_count > REDUCTION_MAX_LAUNCH_COUNT) {
+			log_error("segmented reduce/scan and primitives are limited to $ elements", REDUCTION_MAX_LAUNCH_COUNT);
+			return -1;
+		}
+		const auto iterations = reduction_state.max_iterations;
+		bool success = false;
+		if (!reduction_state.stream_file.empty()) {
+			success = reduction_streaming::run(*compute_ctx, *fastest_device, *dev_queue, *dispatcher, op, reduction_streaming::config_t {
+				.file_name = reduction_state.stream_file,
+				.generate_count = reduction_state.stream_generate_count,
+				.chunk_size = uint64_t(reduction_state.stream_chunk_mib) * 1024u * 1024u,
+				.buffer_count = reduction_state.stream_buffer_count,
+				.is_scan = is_scan,
+				.is_inclusive = is_inclusive,
+				.iterations = iterations,
+			});
+		} else if (reduction_state.multi_device) {
+			success = reduction_multi_device::run(*compute_ctx, *reduction_prog, op, elem_count, reduction_multi_device::config_t {
+				.min_count = reduction_state.multi_device_min_count,
+				.is_scan = is_scan,
+				.is_inclusive = is_inclusive,
+				.iterations = iterations,
+			});
+		} else if (reduction_state.benchmark) {
+			if (is_scan) {
+				log_warn("benchmark mode only covers reductions, ignoring the scan mode");
+			}
+			success = reduction_benchmark::run(*compute_ctx, *fastest_device, *dev_queue, *dispatcher, op, reduction_benchmark::config_t {
+				.max_count = uint32_t(min(reduction_state.size, uint64_t(REDUCTION_MAX_LAUNCH_COUNT))),
+				.repeats = iterations,
+				.json_file_name = reduction_state.benchmark_json_file,
+				.csv_file_name = reduction_state.benchmark_csv_file,
+			});
+		} else if (reduction_state.primitives) {
+			success = reduction_primitives::run(*compute_ctx, *dev_queue, *dispatcher, uint32_t(elem_count), reduction_primitives::config_t {
+				.iterations = iterations,
+				.histogram_bins = reduction_state.histogram_bins,
+			});
+		} else {
+			success = reduction_segmented::run(*compute_ctx, *dev_queue, *dispatcher, op, uint32_t(elem_count), reduction_segmented::config_t {
+				.segment_count = reduction_state.segment_count,
+				.use_head_flags = reduction_state.segment_head_flags,
+				.is_scan = is_scan,
+				.is_inclusive = is_inclusive,
+				.iterations = iterations,
+			});
+		}
+		floor::get_event()->remove_event_handler(evt_handler_fnctr);
+		dispatcher = nullptr;
+		floor::destroy();
+		return (success ? 0 : -1);
 	}
-	auto red_data_sum = compute_ctx->create_buffer(*dev_queue, sizeof(uint32_t) /* 32-bit */,
+	
+	auto red_data_sum = compute_ctx->create_buffer(*dev_queue, op.value_size,
 												   COMPUTE_MEMORY_FLAG::READ_WRITE |
 												   COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
-	auto compute_data = compute_ctx->create_buffer(*dev_queue, elem_count * sizeof(uint32_t) /* 32-bit */,
+	auto compute_data = compute_ctx->create_buffer(*dev_queue, size_t(elem_count) * op.input_size,
 												   COMPUTE_MEMORY_FLAG::READ_WRITE |
 												   COMPUTE_MEMORY_FLAG::HOST_WRITE);
 	shared_ptr<compute_buffer> compute_output_data;
-	if (reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN ||
-		reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::EXCLUSIVE_SCAN) {
-		compute_output_data = compute_ctx->create_buffer(*dev_queue, elem_count * sizeof(uint32_t) /* 32-bit */,
+	if (is_scan) {
+		compute_output_data = compute_ctx->create_buffer(*dev_queue, size_t(elem_count) * op.value_size,
 														 COMPUTE_MEMORY_FLAG::READ_WRITE |
 														 COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
 	}
-	auto cpu_data = make_aligned_ptr<uint32_t>(elem_count);
-	
-	// compute the ideal global size (#units * local size), if the unit count is unknown, assume 16, so that we still get good throughput
-	static constexpr const uint32_t unit_count_fallback { 12u };
-	if (fastest_device->units == 0) {
-		log_error("device #units is 0 - assuming $", unit_count_fallback);
-	}
-	const uint32_t dev_unit_count = (fastest_device->units != 0 ? fastest_device->units : unit_count_fallback);
-	const uint32_t reduction_global_size = dev_unit_count * 1024u * (fastest_device->is_gpu() ? 2u : 1u);
+	auto cpu_data = make_aligned_ptr<uint8_t>(size_t(elem_count) * op.input_size);
+	// expected result: one value (reduction) or one value per element (scan)
+	auto cpu_result = make_aligned_ptr<uint8_t>(is_scan ? size_t(elem_count) * op.value_size : op.value_size);
 	
-	// inclusive/exclusive scan execution parameters
-	const compute_queue::execution_parameters_t exec_params_scan_local {
-		.execution_dim = 1u,
-		.global_work_size = { elem_count, 1u, 1u },
-		.local_work_size = { 1024u, 1u, 1u },
-		.args = { compute_output_data, compute_data, elem_count },
-		.wait_until_completion = true, // must always wait
-		.debug_label = (reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN ?
-						"incl_scan_local" : "excl_scan_local"),
-	};
-	const compute_queue::execution_parameters_t exec_params_scan_global {
-		.execution_dim = 1u,
-		.global_work_size = { elem_count, 1u, 1u },
-		.local_work_size = { 1024u, 1u, 1u },
-		.args = { compute_data, compute_output_data, elem_count },
-		.wait_until_completion = true, // must always wait
-		.debug_label = (reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN ?
-						"incl_scan_global" : "excl_scan_global"),
-	};
-	
-	//
-	random_device rd;
-	mt19937 gen(rd());
+	// random data is counter-based -> a new seed per iteration, generated directly into the mapped buffer and the CPU copy
+	const auto base_seed = make_random_seed();
+	log_debug("using $ host threads for data generation and verification", host_thread_count());
 	// main loop
 	uint32_t iteration = 0;
 	while (!reduction_state.done) {
 		floor::get_event()->handle_events();
 		
 		// init data
+		const auto host_start = floor_timer::start();
 		{
-			// reduction: actually init "compute_data" directly, scan: we to flip/flop these, so init "compute_output_data"
-			auto compute_init_buffer = (reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::REDUCTION_F32 ||
-										reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::REDUCTION_U32 ?
-										compute_data.get() : compute_output_data.get());
-			auto mrdata = compute_init_buffer->map(*dev_queue, COMPUTE_MEMORY_MAP_FLAG::WRITE_INVALIDATE | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
-			const auto init_data = [&mrdata, &cpu_data, &gen, &elem_count]<bool is_float>() {
-				uniform_real_distribution<float> f32_dist { 0.0f, 0.025f };
-				uniform_int_distribution<uint32_t> u32_dist { 0, 16 };
-				
-				auto rdata_f32 = (float*)mrdata;
-				auto rdata_u32 = (uint32_t*)mrdata;
-				auto cpu_data_f32 = (float*)cpu_data.get();
-				auto cpu_data_u32 = (uint32_t*)cpu_data.get();
-				for (uint32_t i = 0; i < elem_count; ++i) {
-					if constexpr (is_float) {
-						auto val = f32_dist(gen);
-						*rdata_f32++ = val;
-						*cpu_data_f32++ = val;
-					} else {
-						auto val = u32_dist(gen);
-						*rdata_u32++ = val;
-						*cpu_data_u32++ = val;
-					}
-				}
-			};
-			switch (reduction_state.exec_mode) {
-				case reduction_state_struct::EXEC_MODE::REDUCTION_F32:
-					init_data.operator()<true>();
-					break;
-				case reduction_state_struct::EXEC_MODE::REDUCTION_U32:
-				case reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN:
-				case reduction_state_struct::EXEC_MODE::EXCLUSIVE_SCAN:
-					init_data.operator()<false>();
-					break;
-			}
-			compute_init_buffer->unmap(*dev_queue, mrdata);
+			// reduction and scan both read from "compute_data"
+			// NOTE: generating the data twice is cheaper than reading back from (possibly write-combined) mapped memory
+			const auto seed = base_seed + iteration;
+			auto mrdata = compute_data->map(*dev_queue, COMPUTE_MEMORY_MAP_FLAG::WRITE_INVALIDATE | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+			op.init_data(mrdata, elem_count, seed, 0u);
+			compute_data->unmap(*dev_queue, mrdata);
+			op.init_data(cpu_data.get(), elem_count, seed, 0u);
 		}
 		
-		long double expected_sum_ld = 0.0L;
-		float expected_sum_f = 0.0f;
-		double expected_sum = 0.0;
-		uint32_t expected_sum_u32 = 0;
-		switch (reduction_state.exec_mode) {
-			case reduction_state_struct::EXEC_MODE::REDUCTION_F32: {
-				// for expected sum on the CPU use: https://en.wikipedia.org/wiki/Kahan_summation_algorithm
-				double kahan_c = 0.0;
-				auto cpu_data_f32 = (float*)cpu_data.get();
-#pragma clang loop vectorize(enable)
-				for (uint32_t i = 0; i < elem_count; ++i) {
-					const auto rnd_val = cpu_data_f32[i];
-					const auto kahan_y = double(rnd_val) - kahan_c;
-					const auto kahan_t = expected_sum + kahan_y;
-					kahan_c = (kahan_t - expected_sum) - kahan_y;
-					expected_sum = kahan_t;
-					expected_sum_ld += (long double)rnd_val;
-					expected_sum_f += rnd_val;
-				}
-				break;
-			}
-			case reduction_state_struct::EXEC_MODE::REDUCTION_U32: {
-				auto cpu_data_u32 = (uint32_t*)cpu_data.get();
-#pragma clang loop vectorize(enable)
-				for (uint32_t i = 0; i < elem_count; ++i) {
-					expected_sum_u32 += cpu_data_u32[i];
-				}
-				break;
-			}
-			case reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN: {
-				auto cpu_data_u32 = (uint32_t*)cpu_data.get();
-				for (uint32_t i = 1; i < elem_count; ++i) {
-					cpu_data_u32[i] += cpu_data_u32[i - 1u];
-				}
-				break;
-			}
-			case reduction_state_struct::EXEC_MODE::EXCLUSIVE_SCAN: {
-				auto cpu_data_u32 = (uint32_t*)cpu_data.get();
-				uint32_t prev_sum = 0u, sum = 0u;
-				for (uint32_t i = 0; i < elem_count; ++i) {
-					sum += cpu_data_u32[i];
-					cpu_data_u32[i] = prev_sum;
-					prev_sum = sum;
-				}
-				break;
-			}
+		// compute the expected result on the CPU
+		if (is_scan) {
+			op.host_scan(cpu_data.get(), cpu_result.get(), elem_count, is_inclusive);
+		} else {
+			op.host_reduce(cpu_data.get(), elem_count, cpu_result.get());
 		}
+		log_debug("host data generation + reference computed in $ms", double(floor_timer::stop<chrono::microseconds>(host_start)) / 1000.0);
 		
 		//
-		red_data_sum->zero(*dev_queue);
 		dev_queue->finish();
 		dev_queue->start_profiling();
-		switch (reduction_state.exec_mode) {
-			case reduction_state_struct::EXEC_MODE::REDUCTION_F32:
-			case reduction_state_struct::EXEC_MODE::REDUCTION_U32: {
-				if (fastest_device->cooperative_kernel_support) {
-					dev_queue->execute_cooperative(*algo_kernels[reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::REDUCTION_F32 ?
-																 REDUCTION_ADD_F32_512 : REDUCTION_ADD_U32_512],
-												   uint1 { fastest_device->max_coop_total_local_size /* max concurrent threads */ * fastest_device->units /* #multiprocessors */ },
-												   uint1 { 512u },
-												   compute_data, red_data_sum, elem_count);
-				} else {
-					dev_queue->execute(*algo_kernels[reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::REDUCTION_F32 ?
-													 REDUCTION_ADD_F32_1024 : REDUCTION_ADD_U32_1024],
-									   uint1 { reduction_global_size },
-									   uint1 { 1024 },
-									   compute_data, red_data_sum, elem_count);
-				}
-				break;
-			}
-			case reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN: {
-				dev_queue->execute_with_parameters(*algo_kernels[INCL_SCAN_LOCAL_U32_1024], exec_params_scan_local);
-				dev_queue->execute_with_parameters(*algo_kernels[INCL_SCAN_GLOBAL_U32_1024], exec_params_scan_global);
-				break;
-			}
-			case reduction_state_struct::EXEC_MODE::EXCLUSIVE_SCAN: {
-				dev_queue->execute_with_parameters(*algo_kernels[EXCL_SCAN_LOCAL_U32_1024], exec_params_scan_local);
-				dev_queue->execute_with_parameters(*algo_kernels[EXCL_SCAN_GLOBAL_U32_1024], exec_params_scan_global);
-				break;
-			}
-		}
+		const auto dispatched = (is_scan ?
+								 dispatcher->scan(*dev_queue, op, is_inclusive, compute_data, compute_output_data, elem_count) :
+								 dispatcher->reduce(*dev_queue, op, compute_data, red_data_sum, elem_count));
 		const auto prof_time = dev_queue->stop_profiling();
 		dev_queue->finish();
+		if (!dispatched) {
+			break;
+		}
 		
-		const auto compute_bandwidth = [&elem_count](const uint64_t& microseconds) {
-			static constexpr const size_t elem_size { sizeof(float) };
-			const auto red_size = elem_size * elem_count;
+		const auto compute_bandwidth = [&elem_count, &op, &is_scan](const uint64_t& microseconds) {
+			// scans read and write each element once
+			const auto red_size = size_t(elem_count) * (op.input_size + (is_scan ? op.value_size : 0u));
 			const auto size_per_second = (double(red_size) / 1000000000.0) / (double(microseconds) / 1000000.0);
 			return size_per_second;
 		};
-		log_debug("$ computed in $ms -> $ GB/s",
-				  ((reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::REDUCTION_F32 ||
-					reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::REDUCTION_U32) ? "reduction" :
-				   (reduction_state.exec_mode == reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN ? "inclusive-scan" : "exclusive-scan")),
-				  double(prof_time) / 1000.0, compute_bandwidth(prof_time));
+		const auto& dispatch_info = dispatcher->get_last_dispatch_info();
+		log_debug("$ ($) computed in $ms -> $ GB/s (tile size: $, #groups: $, $ kernel, $)",
+				  (!is_scan ? "reduction" : (is_inclusive ? "inclusive-scan" : "exclusive-scan")), op.name,
+				  double(prof_time) / 1000.0, compute_bandwidth(prof_time),
+				  dispatch_info.tile_size, dispatch_info.group_count,
+				  (dispatch_info.cooperative ? "cooperative" : "regular"),
+				  (dispatch_info.partials_pass ? "partials pass" : "single pass"));
 		
-		switch (reduction_state.exec_mode) {
-			case reduction_state_struct::EXEC_MODE::REDUCTION_F32: {
-				float sum = 0.0f;
-				red_data_sum->read_to(sum, *dev_queue);
-				const auto abs_diff = abs(double(sum) - expected_sum);
-				log_debug("sum: $, expected: kahan: $, linear: $, $ -> diff: $ (sp: $)",
-						  sum, expected_sum, expected_sum_ld, expected_sum_f, abs_diff, abs(sum - expected_sum_f));
-				break;
-			}
-			case reduction_state_struct::EXEC_MODE::REDUCTION_U32: {
-				uint32_t sum = 0u;
-				red_data_sum->read_to(sum, *dev_queue);
-				const auto abs_diff = abs(int64_t(sum) - int64_t(expected_sum_u32));
-				log_debug("sum: $, expected: $ -> diff: $",
-						  sum, expected_sum_u32, abs_diff);
-				break;
+		if (!is_scan) {
+			array<uint8_t, 64> sum {};
+			red_data_sum->read(*dev_queue, sum.data(), op.value_size);
+			if (op.compare(sum.data(), cpu_result.get())) {
+				log_debug("result: $, expected: $", op.to_string(sum.data()), op.to_string(cpu_result.get()));
+			} else {
+				log_error("result mismatch: $, expected: $", op.to_string(sum.data()), op.to_string(cpu_result.get()));
 			}
-			case reduction_state_struct::EXEC_MODE::INCLUSIVE_SCAN:
-			case reduction_state_struct::EXEC_MODE::EXCLUSIVE_SCAN: {
-				// need to perform an element-wise compare of the CPU and GPU data to validate that everything is correct
-				auto compute_output = compute_output_data->map(*dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
-				auto cpu_data_u32 = (uint32_t*)cpu_data.get();
-				auto compute_data_u32 = (uint32_t*)compute_output;
-				bool correct = true;
-				
-				for (uint32_t i = 0; i < elem_count; ++i) {
-					if (cpu_data_u32[i] != compute_data_u32[i]) {
-						correct = false;
-						log_error("scan output mismatch @$: CPU result: $ != compute device result: $",
-								  i, cpu_data_u32[i], compute_data_u32[i]);
-						break;
+			
+			// deterministic mode: a second run must produce the exact same bits, measure the cost vs. the atomic path
+			if (dispatcher->is_deterministic() && op.has_deterministic) {
+				array<uint8_t, 64> sum_rerun {};
+				if (dispatcher->reduce(*dev_queue, op, compute_data, red_data_sum, elem_count)) {
+					red_data_sum->read(*dev_queue, sum_rerun.data(), op.value_size);
+					if (memcmp(sum.data(), sum_rerun.data(), op.value_size) != 0) {
+						log_error("deterministic reduction is not reproducible: $ != $",
+								  op.to_string(sum.data()), op.to_string(sum_rerun.data()));
 					}
 				}
-				if (correct) {
-					log_debug("scan successful (CPU and compute device results match)");
-				}
-#if 0
-				else {
-					stringstream cpu_dump, gpu_dump;
-					cpu_dump << "CPU: ";
-					gpu_dump << "GPU: ";
-					for (uint32_t i = 0; i < 1024 + 32; ++i) {
-						cpu_dump << cpu_data_u32[i] << ", ";
-						gpu_dump << compute_data_u32[i] << ", ";
-					}
-					log_warn("$", cpu_dump.str());
-					log_warn("$", gpu_dump.str());
+				
+				dispatcher->set_deterministic(false);
+				dev_queue->finish();
+				dev_queue->start_profiling();
+				const auto atomic_dispatched = dispatcher->reduce(*dev_queue, op, compute_data, red_data_sum, elem_count);
+				const auto atomic_prof_time = dev_queue->stop_profiling();
+				dev_queue->finish();
+				dispatcher->set_deterministic(true);
+				if (atomic_dispatched) {
+					const auto det_bandwidth = compute_bandwidth(prof_time);
+					const auto atomic_bandwidth = compute_bandwidth(atomic_prof_time);
+					log_msg("deterministic: $ GB/s, atomic: $ GB/s -> $% throughput cost", det_bandwidth, atomic_bandwidth,
+							(atomic_bandwidth > 0.0 ? (1.0 - det_bandwidth / atomic_bandwidth) * 100.0 : 0.0));
 				}
-#endif
-				compute_output_data->unmap(*dev_queue, compute_output);
-				break;
 			}
+		} else {
+			// need to perform an element-wise compare of the CPU and GPU data to validate that everything is correct
+			auto compute_output = (const uint8_t*)compute_output_data->map(*dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+			const auto cpu_output = cpu_result.get();
+			const auto mismatch = op.find_mismatch(compute_output, cpu_output, elem_count);
+			if (mismatch < elem_count) {
+				const auto offset = size_t(mismatch) * op.value_size;
+				log_error("scan output mismatch @$: CPU result: $ != compute device result: $",
+						  mismatch, op.to_string(cpu_output + offset), op.to_string(compute_output + offset));
+			} else {
+				log_debug("scan successful (CPU and compute device results match)");
+			}
+			compute_output_data->unmap(*dev_queue, (void*)compute_output);
 		}
 		
 		// next
 		++iteration;
 		
-		// when benchmarking, we need to make sure computation is actually finished (all 20 iterations were computed)
-		if ((reduction_state.benchmark && iteration == 20) ||
-			(!reduction_state.benchmark && iteration >= reduction_state.max_iterations)) {
+		if (iteration >= reduction_state.max_iterations) {
 			dev_queue->finish();
 			break;
 		}
@@ -541,6 +580,7 @@ int main(int, char* argv[]) {
 	compute_output_data = nullptr;
 	compute_data = nullptr;
 	red_data_sum = nullptr;
+	dispatcher = nullptr;
 	
 	// kthxbye
 	floor::destroy();
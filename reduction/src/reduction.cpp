@@ -23,23 +23,136 @@
 
 #if defined(FLOOR_COMPUTE)
 
-// POT sizes from 32 - 1024
-#define POT_TILE_SIZES(F) \
-F(32) \
-F(64) \
-F(128) \
-F(256) \
-F(512) \
-F(1024)
+///////////////////////////////////////////////////////////////////////////////
+/// operator-generic building blocks
+
+#if FLOOR_COMPUTE_INFO_HAS_SUB_GROUPS != 0
+//! sub-group reduction via the builtin sub-group functions (only valid if has_sub_group_reduce_v<op_type>)
+template <reduction_op op_type>
+floor_inline_always typename op_type::value_type sub_group_reduce_op(const typename op_type::value_type& value) {
+	static_assert(has_sub_group_reduce_v<op_type>, "no sub-group reduce builtin for this operator");
+	if constexpr (op_type::kind == REDUCTION_OP_KIND::ADD) {
+		return compute_algorithm::sub_group_reduce_add(value);
+	} else if constexpr (op_type::kind == REDUCTION_OP_KIND::MIN) {
+		return compute_algorithm::sub_group_reduce_min(value);
+	} else {
+		return compute_algorithm::sub_group_reduce_max(value);
+	}
+}
+#endif
+
+//! work-group reduction, the result is only valid in work-item #0
+template <uint32_t tile_size, reduction_op op_type>
+floor_inline_always typename op_type::value_type work_group_reduce_op(const typename op_type::value_type& value) {
+	using value_type = typename op_type::value_type;
+	if constexpr (op_type::kind == REDUCTION_OP_KIND::ADD && is_arithmetic_v<value_type>) {
+		local_buffer<value_type, compute_algorithm::reduce_local_memory_elements<tile_size>()> lmem;
+		return compute_algorithm::reduce_add<tile_size>(value, lmem);
+	} else {
+		// generic tree reduction in local memory
+		local_buffer<value_type, tile_size> lmem;
+		lmem[local_id.x] = value;
+		local_barrier();
+#pragma unroll
+		for (uint32_t i = tile_size / 2u; i > 0u; i >>= 1u) {
+			if (local_id.x < i) {
+				lmem[local_id.x] = op_type::combine(lmem[local_id.x], lmem[local_id.x + i]);
+			}
+			local_barrier();
+		}
+		return lmem[0];
+	}
+}
+
+//! work-group exclusive scan, the result is valid in all work-items
+template <uint32_t tile_size, reduction_op op_type>
+floor_inline_always typename op_type::value_type work_group_exclusive_scan_op(const typename op_type::value_type& value) {
+	using value_type = typename op_type::value_type;
+	if constexpr (op_type::kind == REDUCTION_OP_KIND::ADD && is_arithmetic_v<value_type>) {
+		local_buffer<value_type, compute_algorithm::scan_local_memory_elements<tile_size>()> lmem;
+		return compute_algorithm::exclusive_scan_add<tile_size>(value, lmem);
+	} else {
+		// generic double-buffered Hillis-Steele scan in local memory
+		local_buffer<value_type, tile_size * 2u> lmem;
+		uint32_t side = 0u;
+		lmem[local_id.x] = value;
+		local_barrier();
+#pragma unroll
+		for (uint32_t offset = 1u; offset < tile_size; offset <<= 1u) {
+			auto scan_value = lmem[side * tile_size + local_id.x];
+			if (local_id.x >= offset) {
+				scan_value = op_type::combine(lmem[side * tile_size + local_id.x - offset], scan_value);
+			}
+			side ^= 1u;
+			lmem[side * tile_size + local_id.x] = scan_value;
+			local_barrier();
+		}
+		return (local_id.x > 0u ? lmem[side * tile_size + local_id.x - 1u] : op_type::identity());
+	}
+}
+
+//! atomically combines "value" into "*ptr" (only valid if op_type::has_atomic)
+template <reduction_op op_type, typename ptr_type>
+floor_inline_always void atomic_combine(ptr_type ptr, const typename op_type::value_type& value) {
+	static_assert(op_type::has_atomic, "operator has no atomic combine");
+	if constexpr (op_type::kind == REDUCTION_OP_KIND::ADD) {
+		atomic_add(ptr, value);
+	} else if constexpr (op_type::kind == REDUCTION_OP_KIND::MIN) {
+		atomic_min(ptr, value);
+	} else if constexpr (op_type::kind == REDUCTION_OP_KIND::MAX) {
+		atomic_max(ptr, value);
+	} else if constexpr (op_type::kind == REDUCTION_OP_KIND::AND) {
+		atomic_and(ptr, value);
+	} else if constexpr (op_type::kind == REDUCTION_OP_KIND::OR) {
+		atomic_or(ptr, value);
+	} else if constexpr (op_type::kind == REDUCTION_OP_KIND::XOR) {
+		atomic_xor(ptr, value);
+	}
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 /// reduction
+///
+/// reduces all "count" elements of "data" with "op_type":
+///  * atomic operators: the result of each work-group is directly combined into out[0] (must be initialized to the identity)
+///  * other operators: the result of each work-group is written to out[group_id.x],
+///    these partial results must then be reduced in a second "partials pass" (executed with a single work-group)
+///
+/// NOTE: the order in which elements are combined differs between devices and paths -> operators must be commutative
+///
+/// "algorithm" restricts the path selection to the specified algorithm (-> benchmarking), if the device doesn't support
+/// it, the local memory reduction is used
+///
+/// "is_deterministic" disables the atomic path: per-group results are always written to out[group_id.x] and must be reduced
+/// in a partials pass -> with a fixed global size, all elements are always combined in the same order (-> bitwise
+/// reproducible float sums, independent of the work-group scheduling order)
 
-template <uint32_t tile_size, typename data_type>
-floor_inline_always void reduce_add(buffer<const data_type> data, buffer<data_type> sum, const uint32_t count) {
-	static_assert(sizeof(data_type) == 4 || sizeof(data_type) == 8, "invalid data type size (must be 4 or 8 bytes)");
+template <uint32_t tile_size, reduction_op op_type, bool is_partials_pass, REDUCTION_ALGORITHM algorithm = REDUCTION_ALGORITHM::AUTO,
+		  bool is_deterministic = false, typename data_type>
+floor_inline_always void reduce(buffer<const data_type> data, buffer<typename op_type::value_type> out, const uint32_t count) {
+	using value_type = typename op_type::value_type;
+	static constexpr const bool use_atomic { op_type::has_atomic && !is_partials_pass && !is_deterministic };
+	
+	// partials pass: "data" already contains loaded/reduced values
+	const auto load = [&data](const uint32_t idx) -> value_type {
+		if constexpr (is_partials_pass) {
+			return data[idx];
+		} else {
+			return op_type::load(data[idx], idx);
+		}
+	};
+	const auto write_result = [&out](const value_type& red_val) {
+		if constexpr (use_atomic) {
+			atomic_combine<op_type>(&out[0], red_val);
+		} else {
+			out[group_id.x] = red_val;
+		}
+	};
 	
-	if constexpr(device_info::has_cooperative_kernel_support() && device_info::has_sub_group_shuffle()) {
+	// the partials pass is always executed as a non-cooperative kernel
+	if constexpr(!is_partials_pass && has_sub_group_reduce_v<op_type> &&
+				 (algorithm == REDUCTION_ALGORITHM::AUTO || algorithm == REDUCTION_ALGORITHM::COOP) &&
+				 device_info::has_cooperative_kernel_support() && device_info::has_sub_group_shuffle()) {
 #if FLOOR_COMPUTE_INFO_HAS_SUB_GROUPS != 0 && defined(FLOOR_COMPUTE_INFO_CUDA_SM) && FLOOR_COMPUTE_INFO_CUDA_SM >= 60 /* TODO: proper define */
 		// can use shuffle/swizzle + coop kernel
 		static constexpr const uint32_t sub_group_width { max(1u, device_info::simd_width_min()) };
@@ -52,17 +165,17 @@ floor_inline_always void reduce_add(buffer<const data_type> data, buffer<data_ty
 		uint32_t idx = group_id.x * tile_size + local_id.x;
 		
 		// accumulate locally
-		data_type value = data_type(0);
+		auto value = op_type::identity();
 		// TODO: different/linear stride?
 		for (uint32_t i = 0; i < block_count; ++i, idx += item_count) {
 			if(idx < count) {
-				value += data[idx];
+				value = op_type::combine(value, load(idx));
 			}
 		}
 		
 		// reduce in sub-group
-		local_buffer<data_type, tile_count> lmem;
-		auto red_val = compute_algorithm::sub_group_reduce_add(value);
+		local_buffer<value_type, tile_count> lmem;
+		auto red_val = sub_group_reduce_op<op_type>(value);
 		
 		// reduce in work-group if necessary
 		if constexpr(tile_count > 1) {
@@ -74,14 +187,14 @@ floor_inline_always void reduce_add(buffer<const data_type> data, buffer<data_ty
 			
 			if (sub_group_id_1d == 0) {
 				// sub-group #0 does the final reduction
-				const auto sg_val = (uint32_t(sub_group_local_id) < tile_count ? lmem[sub_group_local_id] : data_type(0));
-				red_val = compute_algorithm::sub_group_reduce_add(sg_val);
+				const auto sg_val = (uint32_t(sub_group_local_id) < tile_count ? lmem[sub_group_local_id] : op_type::identity());
+				red_val = sub_group_reduce_op<op_type>(sg_val);
 			}
 		}
 		
-		// add to global sum (item #0 == sub-group item #0 in sub-group #0)
+		// write/combine group result (item #0 == sub-group item #0 in sub-group #0)
 		if (local_id.x == 0) {
-			atomic_add(&sum[0], red_val);
+			write_result(red_val);
 		}
 #endif
 	}
@@ -100,14 +213,16 @@ floor_inline_always void reduce_add(buffer<const data_type> data, buffer<data_ty
 		static constexpr const uint32_t idx_inc { tile_size };
 #endif
 		
-		auto item_sum = data_type(0);
+		auto item_sum = op_type::identity();
 		for (uint32_t i = 0; i < per_item_count; ++i, idx += idx_inc) {
 			if (idx < count) {
-				item_sum += data[idx];
+				item_sum = op_type::combine(item_sum, load(idx));
 			}
 		}
 		
-		if constexpr(device_info::has_sub_group_shuffle() && max(1u, device_info::simd_width_min()) <= tile_size) {
+		if constexpr (has_sub_group_reduce_v<op_type> &&
+					  (algorithm == REDUCTION_ALGORITHM::AUTO || algorithm == REDUCTION_ALGORITHM::SHUFFLE) &&
+					  device_info::has_sub_group_shuffle() && max(1u, device_info::simd_width_min()) <= tile_size) {
 #if FLOOR_COMPUTE_INFO_HAS_SUB_GROUPS != 0
 			// can use shuffle/swizzle
 			static constexpr const uint32_t sub_group_width { max(1u, device_info::simd_width_min()) };
@@ -115,16 +230,16 @@ floor_inline_always void reduce_add(buffer<const data_type> data, buffer<data_ty
 			static_assert(tile_count * sub_group_width == tile_size, "tile size must be a multiple of sub-group width");
 			
 			// reduce in sub-group first (via shuffle)
-			const auto sg_red_val = compute_algorithm::sub_group_reduce_add(item_sum);
+			const auto sg_red_val = sub_group_reduce_op<op_type>(item_sum);
 			
 			if constexpr(tile_count == 1) {
 				// special case where we only have one sub-group
 				if(local_id.x == 0) {
-					atomic_add(&sum[0], sg_red_val);
+					write_result(sg_red_val);
 				}
 			}
 			else {
-				local_buffer<data_type, tile_count> lmem;
+				local_buffer<value_type, tile_count> lmem;
 				
 				// write reduced sub-group value to local memory for the next step
 				if(sub_group_local_id == 0) {
@@ -136,24 +251,24 @@ floor_inline_always void reduce_add(buffer<const data_type> data, buffer<data_ty
 				if constexpr(tile_count <= sub_group_width) {
 					// can do this directly in one sub-group
 					if(sub_group_id_1d == 0) {
-						const auto final_red_val = compute_algorithm::sub_group_reduce_add(tile_count == sub_group_width ?
-																						   lmem[sub_group_local_id] :
-																						   (sub_group_local_id < tile_count ?
-																							lmem[sub_group_local_id] : data_type(0)));
+						const auto final_red_val = sub_group_reduce_op<op_type>(tile_count == sub_group_width ?
+																				lmem[sub_group_local_id] :
+																				(sub_group_local_id < tile_count ?
+																				 lmem[sub_group_local_id] : op_type::identity()));
 						if(sub_group_local_id == 0) {
-							atomic_add(&sum[0], final_red_val);
+							write_result(final_red_val);
 						}
 					}
 				}
 				else if constexpr(tile_count <= sub_group_width * 2) {
 					// tile count is at most 2x sub-group width
 					if(sub_group_id_1d == 0) {
-						const auto final_red_val = compute_algorithm::sub_group_reduce_add(sub_group_local_id * 2u < tile_count ?
-																						   lmem[sub_group_local_id * 2u] +
-																						   lmem[sub_group_local_id * 2u + 1u] :
-																						   data_type(0));
+						const auto final_red_val = sub_group_reduce_op<op_type>(sub_group_local_id * 2u < tile_count ?
+																				op_type::combine(lmem[sub_group_local_id * 2u],
+																								 lmem[sub_group_local_id * 2u + 1u]) :
+																				op_type::identity());
 						if(sub_group_local_id == 0) {
-							atomic_add(&sum[0], final_red_val);
+							write_result(final_red_val);
 						}
 					}
 				}
@@ -162,8 +277,8 @@ floor_inline_always void reduce_add(buffer<const data_type> data, buffer<data_ty
 					static constexpr const uint32_t tile_count_2nd { max(1u, tile_count / sub_group_width) };
 					static_assert(tile_count_2nd <= sub_group_width, "invalid or too small sub-group width");
 					if(sub_group_id_1d < tile_count_2nd) {
-						const auto sg_red_val_2nd = compute_algorithm::sub_group_reduce_add(lmem[sub_group_id_1d * sub_group_width +
-																								 sub_group_local_id]);
+						const auto sg_red_val_2nd = sub_group_reduce_op<op_type>(lmem[sub_group_id_1d * sub_group_width +
+																					  sub_group_local_id]);
 						local_barrier();
 						if(sub_group_local_id == 0) {
 							lmem[sub_group_id_1d] = sg_red_val_2nd;
@@ -172,10 +287,10 @@ floor_inline_always void reduce_add(buffer<const data_type> data, buffer<data_ty
 						
 						// final reduction
 						if(sub_group_id_1d == 0) {
-							const auto final_red_val = compute_algorithm::sub_group_reduce_add(sub_group_local_id < tile_count_2nd ?
-																							   lmem[sub_group_local_id] : data_type(0));
+							const auto final_red_val = sub_group_reduce_op<op_type>(sub_group_local_id < tile_count_2nd ?
+																					lmem[sub_group_local_id] : op_type::identity());
 							if(sub_group_local_id == 0) {
-								atomic_add(&sum[0], final_red_val);
+								write_result(final_red_val);
 							}
 						}
 					}
@@ -187,175 +302,577 @@ floor_inline_always void reduce_add(buffer<const data_type> data, buffer<data_ty
 			// fallback to local memory reduction
 			
 			// local reduction to work-item #0
-			local_buffer<data_type, compute_algorithm::reduce_local_memory_elements<tile_size>()> lmem;
-			const auto red_sum = compute_algorithm::reduce_add<tile_size>(item_sum, lmem);
+			const auto red_sum = work_group_reduce_op<tile_size, op_type>(item_sum);
 			
-			// only work-item #0 knows the reduced sum and will thus write to the total sum
+			// only work-item #0 knows the reduced sum and will thus write the group result
 			if(local_id.x == 0) {
-				atomic_add(&sum[0], red_sum);
+				write_result(red_sum);
 			}
 		}
 	}
 }
 
-// float/uint 32-bit and 64-bit reduction add kernels
-#if defined(FLOOR_COMPUTE_INFO_HAS_64_BIT_ATOMICS_0)
-#define REDUCTION_KERNELS(tile_size) \
-kernel_1d(tile_size) void reduce_add_f32_##tile_size(buffer<const float> data, buffer<float> sum, param<uint32_t> count) { \
-	reduce_add<tile_size>(data, sum, count); \
+// reduction kernels for each operator and tile size:
+//  * reduce_<op>_<tile size>: reduces the input
+//  * reduce_partials_<op>_<tile size>: reduces the per-group partial results of the first pass (non-atomic operators only)
+// "in_offset"/"out_offset" offset the input/output buffer (in elements), so that sub-ranges can be reduced into any output slot
+// NOTE: the input offset is 64-bit (-> inputs with more than 4G elements are reduced in multiple launches by the dispatcher),
+//       "count" of a single launch is limited to REDUCTION_MAX_LAUNCH_COUNT, so that all index computations fit into 32 bits
+#define REDUCTION_KERNELS(tile_size, name, op_type) \
+kernel_1d(tile_size) void reduce_##name##_##tile_size(buffer<const op_type::input_type> data, buffer<op_type::value_type> out, \
+													  param<uint32_t> count, param<uint64_t> in_offset, param<uint32_t> out_offset) { \
+	reduce<tile_size, op_type, false>(&data[in_offset], &out[out_offset], count); \
 } \
-kernel_1d(tile_size) void reduce_add_u32_##tile_size(buffer<const uint32_t> data, buffer<uint32_t> sum, param<uint32_t> count) { \
-	reduce_add<tile_size>(data, sum, count); \
-} \
-kernel_1d(tile_size) void reduce_add_f64_##tile_size() { \
+kernel_1d(tile_size) void reduce_partials_##name##_##tile_size(buffer<const op_type::value_type> partials, \
+															   buffer<op_type::value_type> out, param<uint32_t> count, \
+															   param<uint64_t> in_offset, param<uint32_t> out_offset) { \
+	reduce<tile_size, op_type, true>(&partials[in_offset], &out[out_offset], count); \
+}
+#define REDUCTION_NOP_KERNELS(tile_size, name) \
+kernel_1d(tile_size) void reduce_##name##_##tile_size() { \
 	/* nop */ \
 } \
-kernel_1d(tile_size) void reduce_add_u64_##tile_size() { \
+kernel_1d(tile_size) void reduce_partials_##name##_##tile_size() { \
 	/* nop */ \
 }
-
-#elif defined(FLOOR_NO_DOUBLE)
-#define REDUCTION_KERNELS(tile_size) \
-kernel_1d(tile_size) void reduce_add_f32_##tile_size(buffer<const float> data, buffer<float> sum, param<uint32_t> count) { \
-	reduce_add<tile_size>(data, sum, count); \
-} \
-kernel_1d(tile_size) void reduce_add_u32_##tile_size(buffer<const uint32_t> data, buffer<uint32_t> sum, param<uint32_t> count) { \
-	reduce_add<tile_size>(data, sum, count); \
-} \
-kernel_1d(tile_size) void reduce_add_f64_##tile_size() { \
+#define DETERMINISTIC_REDUCTION_NOP_KERNELS(tile_size, name) \
+kernel_1d(tile_size) void reduce_det_##name##_##tile_size() { \
 	/* nop */ \
-} \
-kernel_1d(tile_size) void reduce_add_u64_##tile_size(buffer<const uint64_t> data, buffer<uint64_t> sum, param<uint32_t> count) { \
-	reduce_add<tile_size>(data, sum, count); \
 }
+#define REDUCTION_OP_KERNELS(name, op_type) POT_TILE_SIZES(REDUCTION_KERNELS, name, op_type)
 
-#else
-#define REDUCTION_KERNELS(tile_size) \
-kernel_1d(tile_size) void reduce_add_f32_##tile_size(buffer<const float> data, buffer<float> sum, param<uint32_t> count) { \
-	reduce_add<tile_size>(data, sum, count); \
-} \
-kernel_1d(tile_size) void reduce_add_u32_##tile_size(buffer<const uint32_t> data, buffer<uint32_t> sum, param<uint32_t> count) { \
-	reduce_add<tile_size>(data, sum, count); \
-} \
-kernel_1d(tile_size) void reduce_add_f64_##tile_size(buffer<const double> data, buffer<double> sum, param<uint32_t> count) { \
-reduce_add<tile_size>(data, sum, count); \
-} \
-kernel_1d(tile_size) void reduce_add_u64_##tile_size(buffer<const uint64_t> data, buffer<uint64_t> sum, param<uint32_t> count) { \
-	reduce_add<tile_size>(data, sum, count); \
+// instantiate kernels
+REDUCTION_OPS(REDUCTION_OP_KERNELS)
+
+// reduction kernels with a forced algorithm (benchmark only): reduce_<lmem|shuffle|coop>_<op>_<tile size>
+#define REDUCTION_ALGORITHM_KERNEL(tile_size, name, op_type, algorithm_name, algorithm) \
+kernel_1d(tile_size) void reduce_##algorithm_name##_##name##_##tile_size(buffer<const op_type::input_type> data, \
+																		 buffer<op_type::value_type> out, param<uint32_t> count, \
+																		 param<uint64_t> in_offset, param<uint32_t> out_offset) { \
+	reduce<tile_size, op_type, false, REDUCTION_ALGORITHM::algorithm>(&data[in_offset], &out[out_offset], count); \
 }
-#endif
+#define REDUCTION_ALGORITHM_KERNELS(tile_size, name, op_type) \
+REDUCTION_ALGORITHM_KERNEL(tile_size, name, op_type, lmem, LOCAL_MEMORY) \
+REDUCTION_ALGORITHM_KERNEL(tile_size, name, op_type, shuffle, SHUFFLE) \
+REDUCTION_ALGORITHM_KERNEL(tile_size, name, op_type, coop, COOP)
+#define REDUCTION_ALGORITHM_OP_KERNELS(name, op_type) POT_TILE_SIZES(REDUCTION_ALGORITHM_KERNELS, name, op_type)
+
+// instantiate kernels
+BENCHMARK_REDUCTION_OPS(REDUCTION_ALGORITHM_OP_KERNELS)
+
+// deterministic reduction kernels (no atomics, always followed by a partials pass): reduce_det_<op>_<tile size>
+#define DETERMINISTIC_REDUCTION_KERNELS(tile_size, name, op_type) \
+kernel_1d(tile_size) void reduce_det_##name##_##tile_size(buffer<const op_type::input_type> data, buffer<op_type::value_type> out, \
+														  param<uint32_t> count, param<uint64_t> in_offset, param<uint32_t> out_offset) { \
+	reduce<tile_size, op_type, false, REDUCTION_ALGORITHM::AUTO, true>(&data[in_offset], &out[out_offset], count); \
+}
+#define DETERMINISTIC_REDUCTION_OP_KERNELS(name, op_type) POT_TILE_SIZES(DETERMINISTIC_REDUCTION_KERNELS, name, op_type)
 
 // instantiate kernels
-POT_TILE_SIZES(REDUCTION_KERNELS)
+DETERMINISTIC_REDUCTION_OPS(DETERMINISTIC_REDUCTION_OP_KERNELS)
+
+// device-to-device copy of "count" uint4 (-> reference bandwidth for the benchmark)
+kernel_1d(256) void copy_uint4(buffer<const uint4> in, buffer<uint4> out, param<uint32_t> count) {
+	for (uint32_t idx = global_id.x, stride = global_size.x; idx < count; idx += stride) {
+		out[idx] = in[idx];
+	}
+}
+
+// float/uint 64-bit reduction kernels
+// NOTE: deterministic f64 kernels are disabled together with the other f64 kernels (they rely on the f64 partials pass)
+#if defined(FLOOR_COMPUTE_INFO_HAS_64_BIT_ATOMICS_0)
+POT_TILE_SIZES(REDUCTION_NOP_KERNELS, add_f64)
+POT_TILE_SIZES(REDUCTION_NOP_KERNELS, add_u64)
+POT_TILE_SIZES(REDUCTION_NOP_KERNELS, add_u32_u64)
+POT_TILE_SIZES(DETERMINISTIC_REDUCTION_NOP_KERNELS, add_f64)
+#elif defined(FLOOR_NO_DOUBLE)
+POT_TILE_SIZES(REDUCTION_NOP_KERNELS, add_f64)
+POT_TILE_SIZES(REDUCTION_KERNELS, add_u64, op_add<uint64_t>)
+POT_TILE_SIZES(REDUCTION_KERNELS, add_u32_u64, op_add_u32_u64)
+POT_TILE_SIZES(DETERMINISTIC_REDUCTION_NOP_KERNELS, add_f64)
+#else
+REDUCTION_OPS_64(REDUCTION_OP_KERNELS)
+DETERMINISTIC_REDUCTION_OPS_64(DETERMINISTIC_REDUCTION_OP_KERNELS)
+#endif
 
 
 ///////////////////////////////////////////////////////////////////////////////
-/// inclusive/exclusive scan:
-///  * first pass: perform scan in each work-group
-///  * second pass: adjust values of each group based on the last value of the previous group
+/// inclusive/exclusive scan: single-pass chained scan with decoupled look-back
+///  * each work-group dynamically acquires a tile id (-> tiles are started in order, so predecessors always make progress)
+///  * each work-item loads REDUCTION_SCAN_ITEMS_PER_WORK_ITEM consecutive elements and scans them sequentially
+///  * the per-item sums are scanned across the work-group, the last work-item then knows the tile aggregate
+///  * the aggregate is published (AGGREGATE flag), then predecessor tiles are inspected in reverse order, combining
+///    their aggregates until a tile with a known inclusive prefix (PREFIX flag) is found
+///  * the inclusive prefix of this tile is published (PREFIX flag) and all elements are written with the tile prefix applied
+///
+/// -> every element is read and written exactly once, all tiles are computed in a single kernel launch
+/// -> unlike the reduction, this only requires operators to be associative
 ///
-/// in : [4 1 5 3 4 2 7 9 1 2 3 4]
+/// chained scans over multiple launches (e.g. when streaming chunks): tile #0 starts with the "carry" value instead
+/// of the identity, and the last element writes its inclusive scan value back to "carry" for the next launch
+/// (tile #0 reads the carry before publishing its prefix, which every other tile waits for -> no race)
 ///
-/// inclusive:
-/// 1st: [4 5 10 13] [4 6 13 22] [1 3 6 10] (group size 4)
-/// 2nd: [4 5 10 13 17 19 26 35 36 38 41 45]
+/// in : [4 1 5 3 4 2 7 9 1 2 3 4] (add)
 ///
-/// exclusive:
-/// 1st: [0 4 5 10 13] [4 6 13 22] [1 3 6] (group size 4)
-/// 2nd: [0 4 5 10 13 17 19 26 35 36 38 41]
+/// tile aggregates (tile size 4): [13] [22] [10]
+/// tile exclusive prefixes:       [0]  [13] [35]
 ///
-/// NOTE: this could be done more efficiently, but the point of this is to test the inclusive_scan/exclusive_scan themselves
+/// inclusive: [4 5 10 13 17 19 26 35 36 38 41 45]
+/// exclusive: [0 4 5 10 13 17 19 26 35 36 38 41]
+///
+/// tile state buffer layout (in 32-bit words, value words == sizeof(value_type) / 4, must be zeroed before each scan):
+///  [0]: tile counter
+///  [1, tile_count]: tile status flags (SCAN_TILE_STATUS)
+///  [tile_count + 1, ...]: tile aggregates (tile_count * value words)
+///  [tile_count * (1 + value words) + 1, ...]: tile inclusive prefixes (tile_count * value words)
+
+enum SCAN_TILE_STATUS : uint32_t {
+	//! nothing has been published yet
+	SCAN_TILE_INVALID = 0u,
+	//! the combination of all elements in the tile is known
+	SCAN_TILE_AGGREGATE = 1u,
+	//! the combination of all elements up to and including the tile is known
+	SCAN_TILE_PREFIX = 2u,
+};
+
+//! atomically stores a value as a sequence of 32-bit words (-> makes it visible to other work-groups)
+template <typename value_type, typename ptr_type>
+floor_inline_always void store_tile_value(ptr_type words, const value_type& value) {
+	const auto value_words = (const uint32_t*)&value;
+#pragma unroll
+	for (uint32_t i = 0; i < sizeof(value_type) / sizeof(uint32_t); ++i) {
+		atomic_store(&words[i], value_words[i]);
+	}
+}
+
+//! atomically loads a value that has been stored via store_tile_value()
+template <typename value_type, typename ptr_type>
+floor_inline_always value_type load_tile_value(ptr_type words) {
+	value_type value;
+	auto value_words = (uint32_t*)&value;
+#pragma unroll
+	for (uint32_t i = 0; i < sizeof(value_type) / sizeof(uint32_t); ++i) {
+		value_words[i] = atomic_load(&words[i]);
+	}
+	return value;
+}
+
+//! initial prefix of a chained scan that doesn't continue a previous one
+template <reduction_op op_type>
+struct identity_prefix {
+	floor_inline_always typename op_type::value_type operator()() const {
+		return op_type::identity();
+	}
+};
 
-template <uint32_t tile_size, bool is_inclusive>
-floor_inline_always void scan_local(buffer<const uint32_t>& in, buffer<uint32_t>& out, const uint32_t count) {
-	local_buffer<uint32_t, compute_algorithm::scan_local_memory_elements<tile_size>()> lmem;
+//! chained single-pass scan of "count" elements with user-defined element loading and result storing:
+//!  * load(idx) -> value_type: returns the element at "idx"
+//!  * store(idx, exclusive scan value, inclusive scan value): writes the result for "idx"
+//! both are only called for idx < count, and in ascending index order within each work-item
+//!  * initial_prefix() -> value_type: prefix of the first element (only called once, by tile #0)
+template <uint32_t tile_size, reduction_op op_type, typename load_func_type, typename store_func_type,
+		  typename prefix_func_type = identity_prefix<op_type>>
+floor_inline_always void scan_chained(load_func_type&& load, store_func_type&& store, buffer<uint32_t>& tile_state, const uint32_t count,
+									  prefix_func_type initial_prefix = {}) {
+	using value_type = typename op_type::value_type;
+	static constexpr const uint32_t items_per_work_item { REDUCTION_SCAN_ITEMS_PER_WORK_ITEM };
+	static constexpr const uint32_t elems_per_tile { tile_size * items_per_work_item };
+	static constexpr const uint32_t value_words { sizeof(value_type) / sizeof(uint32_t) };
+	const auto tile_count = (count + (elems_per_tile - 1u)) / elems_per_tile;
+	auto tile_status = &tile_state[1u];
+	auto tile_aggregates = &tile_state[1u + tile_count];
+	auto tile_prefixes = &tile_state[1u + tile_count * (1u + value_words)];
 	
-	auto value = (global_id.x < count ? in[global_id.x] : 0u);
-	if constexpr (is_inclusive) {
-		value = compute_algorithm::inclusive_scan_add<tile_size>(value, lmem);
-		
-		// can directly write to output
-		if (global_id.x < count) {
-			out[global_id.x] = value;
+	// acquire the tile id (hardware group ids are not guaranteed to be scheduled in order)
+	local_buffer<uint32_t, 1u> tile_id_bcast;
+	if (local_id.x == 0u) {
+		tile_id_bcast[0] = atomic_inc(&tile_state[0]);
+	}
+	local_barrier();
+	const auto tile_id = tile_id_bcast[0];
+	
+	// load and sequentially reduce all items of this work-item
+	const auto item_offset = tile_id * elems_per_tile + local_id.x * items_per_work_item;
+	value_type values[items_per_work_item];
+	auto item_sum = op_type::identity();
+#pragma unroll
+	for (uint32_t i = 0; i < items_per_work_item; ++i) {
+		const auto idx = item_offset + i;
+		values[i] = (idx < count ? load(idx) : op_type::identity());
+		item_sum = op_type::combine(item_sum, values[i]);
+	}
+	
+	// scan all per-item sums in the work-group
+	const auto item_prefix = work_group_exclusive_scan_op<tile_size, op_type>(item_sum);
+	
+	// last work-item knows the tile aggregate -> publish it and look back
+	local_buffer<value_type, 1u> tile_prefix_bcast;
+	if (local_id.x == tile_size - 1u) {
+		const auto aggregate = op_type::combine(item_prefix, item_sum);
+		auto exclusive_prefix = op_type::identity();
+		if (tile_id == 0u) {
+			exclusive_prefix = initial_prefix();
+			store_tile_value(&tile_prefixes[0], op_type::combine(exclusive_prefix, aggregate));
+			global_mem_fence();
+			atomic_store(&tile_status[0], uint32_t(SCAN_TILE_PREFIX));
+		} else {
+			store_tile_value(&tile_aggregates[tile_id * value_words], aggregate);
+			global_mem_fence();
+			atomic_store(&tile_status[tile_id], uint32_t(SCAN_TILE_AGGREGATE));
+			
+			// tile #0 always publishes its prefix, so this will always terminate
+			for (uint32_t pred_id = tile_id - 1u; ; --pred_id) {
+				uint32_t status = SCAN_TILE_INVALID;
+				while ((status = atomic_load(&tile_status[pred_id])) == SCAN_TILE_INVALID) {
+					// spin until the predecessor has published something
+				}
+				global_mem_fence();
+				if (status == SCAN_TILE_PREFIX) {
+					exclusive_prefix = op_type::combine(load_tile_value<value_type>(&tile_prefixes[pred_id * value_words]),
+														exclusive_prefix);
+					break;
+				}
+				exclusive_prefix = op_type::combine(load_tile_value<value_type>(&tile_aggregates[pred_id * value_words]),
+													exclusive_prefix);
+			}
+			
+			store_tile_value(&tile_prefixes[tile_id * value_words], op_type::combine(exclusive_prefix, aggregate));
+			global_mem_fence();
+			atomic_store(&tile_status[tile_id], uint32_t(SCAN_TILE_PREFIX));
 		}
-	} else {
-		const auto scan_value = compute_algorithm::exclusive_scan_add<tile_size>(value, lmem);
-		
-		// first group: write full range
-		// second+ group: never write item #0, but write item #N into the next group block
-		if (group_id.x == 0 || (local_id.x > 0 && global_id.x < count)) {
-			out[global_id.x] = scan_value;
+		tile_prefix_bcast[0] = exclusive_prefix;
+	}
+	local_barrier();
+	
+	// write the final scan values
+	auto running_sum = op_type::combine(tile_prefix_bcast[0], item_prefix);
+#pragma unroll
+	for (uint32_t i = 0; i < items_per_work_item; ++i) {
+		const auto idx = item_offset + i;
+		const auto inclusive_sum = op_type::combine(running_sum, values[i]);
+		if (idx < count) {
+			store(idx, running_sum, inclusive_sum);
+		}
+		running_sum = inclusive_sum;
+	}
+}
+
+//! scans "count" elements starting at "offset" in "in" and writes them to "out" (also starting at "offset"),
+//! if "use_carry" is set, the scan continues from carry[0] and writes its total back to carry[0]
+template <uint32_t tile_size, reduction_op op_type, bool is_inclusive>
+floor_inline_always void scan_single_pass(buffer<const typename op_type::input_type>& in, buffer<typename op_type::value_type>& out,
+										  buffer<uint32_t>& tile_state, buffer<typename op_type::value_type>& carry,
+										  const uint32_t count, const uint64_t offset, const uint32_t use_carry) {
+	using value_type = typename op_type::value_type;
+	scan_chained<tile_size, op_type>([&in, &offset](const uint32_t idx) {
+		return op_type::load(in[offset + idx], idx);
+	}, [&out, &carry, &count, &offset, &use_carry](const uint32_t idx, const value_type& exclusive_sum, const value_type& inclusive_sum) {
+		out[offset + idx] = (is_inclusive ? inclusive_sum : exclusive_sum);
+		if (use_carry != 0u && idx + 1u == count) {
+			carry[0] = inclusive_sum;
 		}
-		if (local_id.x == tile_size - 1u && (global_id.x + 1u) < count) {
-			out[global_id.x + 1u] = scan_value + value;
+	}, tile_state, count, [&carry, &use_carry]() -> value_type {
+		return (use_carry != 0u ? carry[0] : op_type::identity());
+	});
+}
+
+#define SCAN_KERNELS(tile_size, name, op_type) \
+kernel_1d(tile_size) void incl_scan_##name##_##tile_size(buffer<const op_type::input_type> in, buffer<op_type::value_type> out, \
+														 buffer<uint32_t> tile_state, buffer<op_type::value_type> carry, \
+														 param<uint32_t> count, param<uint64_t> offset, param<uint32_t> use_carry) { \
+	scan_single_pass<tile_size, op_type, true>(in, out, tile_state, carry, count, offset, use_carry); \
+} \
+kernel_1d(tile_size) void excl_scan_##name##_##tile_size(buffer<const op_type::input_type> in, buffer<op_type::value_type> out, \
+														 buffer<uint32_t> tile_state, buffer<op_type::value_type> carry, \
+														 param<uint32_t> count, param<uint64_t> offset, param<uint32_t> use_carry) { \
+	scan_single_pass<tile_size, op_type, false>(in, out, tile_state, carry, count, offset, use_carry); \
+}
+#define SCAN_OP_KERNELS(name, op_type) SCAN_TILE_SIZES(SCAN_KERNELS, name, op_type)
+
+// instantiate kernels
+REDUCTION_OPS(SCAN_OP_KERNELS)
+SCAN_OPS_64(SCAN_OP_KERNELS)
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// segmented reduce/scan:
+///  * segments are specified via head flags or via segment offsets (see REDUCTION_SEGMENT_MODE)
+///  * uses the chained scan above with op_segmented<op_type>, i.e. each element additionally carries its head count
+///  * all tiles have the same size, independent of the segment lengths -> load-balanced in a single kernel launch,
+///    segments spanning multiple tiles are handled by the look-back
+///  * segmented reduce only writes the inclusive scan value of the last element of each segment
+///
+/// in :    [4 1 5 3 4 2 7 9 1 2 3 4]
+/// heads:  [1 0 0 1 0 0 0 0 0 1 0 0] / offsets: [0 3 9 12]
+///
+/// reduce:    [10 26 9]
+/// inclusive: [4 5 10 3 7 9 16 25 26 2 5 9]
+/// exclusive: [0 4 5 0 3 7 9 16 25 0 2 5]
+
+//! returns the segment that contains "idx" (last segment with offsets[segment] <= idx -> skips empty segments)
+floor_inline_always uint32_t find_segment(buffer<const uint32_t>& offsets, const uint32_t segment_count, const uint32_t idx) {
+	// upper bound of idx in [0, segment_count]
+	uint32_t first = 0u, len = segment_count + 1u;
+	while (len > 0u) {
+		const auto half_len = len / 2u;
+		if (offsets[first + half_len] <= idx) {
+			first += half_len + 1u;
+			len -= half_len + 1u;
+		} else {
+			len = half_len;
 		}
 	}
+	return first - 1u;
 }
 
-template <uint32_t tile_size, bool is_inclusive>
-floor_inline_always void scan_global(buffer<const uint32_t>& in, buffer<uint32_t>& out, const uint32_t count) {
-	if (group_id.x == 0) {
-		out[global_id.x] = in[global_id.x];
-		if constexpr (!is_inclusive) {
-			if (local_id.x == tile_size - 1u) {
-				out[global_id.x + 1u] = in[global_id.x + 1u];
+//! tracks the segment of the ascending indices processed by one work-item:
+//! binary search for the first index, linear advance for all following ones
+struct segment_cursor {
+	uint32_t segment { ~0u };
+	
+	floor_inline_always uint32_t advance(buffer<const uint32_t>& offsets, const uint32_t segment_count, const uint32_t idx) {
+		if (segment == ~0u) {
+			segment = find_segment(offsets, segment_count, idx);
+		} else {
+			while (offsets[segment + 1u] <= idx) {
+				++segment;
 			}
 		}
-		return;
+		return segment;
 	}
+};
+
+template <uint32_t tile_size, reduction_op op_type, REDUCTION_SEGMENT_MODE mode, bool is_reduce, bool is_inclusive>
+floor_inline_always void segmented_reduce_scan(buffer<const typename op_type::input_type>& in, buffer<const uint32_t>& segments,
+											   buffer<typename op_type::value_type>& out, buffer<uint32_t>& tile_state,
+											   const uint32_t count, const uint32_t segment_count) {
+	using seg_op_type = op_segmented<op_type>;
+	using seg_value_type = typename seg_op_type::value_type;
 	
-	// need to offset each value in each group (past group #0) with:
-	//  * inclusive: the sum of the last values in each previous group block
-	//  * exclusive: the sum of the first values in each previous group block (excluding group #0)
-	const auto per_item_count = max((group_id.x + (tile_size - 1u)) / tile_size, 1u);
-	const auto offset = per_item_count * tile_size * local_id.x;
-	uint32_t idx = offset;
-	if constexpr (is_inclusive) {
-		idx += tile_size - 1u; // -> last value in each group
-	} else {
-		idx += tile_size; // -> first value in each group (past group #0)
-	}
+	segment_cursor load_cursor, store_cursor;
+	const auto load = [&](const uint32_t idx) -> seg_value_type {
+		uint32_t is_head = 0u;
+		if constexpr (mode == REDUCTION_SEGMENT_MODE::HEAD_FLAGS) {
+			is_head = (segments[idx] != 0u ? 1u : 0u);
+		} else {
+			const auto segment = load_cursor.advance(segments, segment_count, idx);
+			is_head = (segments[segment] == idx ? 1u : 0u);
+		}
+		return { op_type::load(in[idx], idx), is_head };
+	};
 	
-	auto item_sum = 0u;
-	const auto first_idx_in_group = min(tile_size * group_id.x + (is_inclusive ? 0u : 1u), count);
-	for (uint32_t i = 0; i < per_item_count; ++i, idx += tile_size) {
-		if (idx < first_idx_in_group) {
-			item_sum += in[idx];
+	const auto store = [&](const uint32_t idx, const seg_value_type& exclusive_sum, const seg_value_type& inclusive_sum) {
+		if constexpr (is_reduce) {
+			// only the last element of each segment writes the segment result
+			if constexpr (mode == REDUCTION_SEGMENT_MODE::HEAD_FLAGS) {
+				if (inclusive_sum.heads > 0u && (idx + 1u == count || segments[idx + 1u] != 0u)) {
+					out[inclusive_sum.heads - 1u] = inclusive_sum.value;
+				}
+			} else {
+				const auto segment = store_cursor.advance(segments, segment_count, idx);
+				if (idx == 0u) {
+					// leading empty segments
+					for (uint32_t empty_segment = 0u; empty_segment < segment; ++empty_segment) {
+						out[empty_segment] = op_type::identity();
+					}
+				}
+				if (idx + 1u == segments[segment + 1u]) {
+					out[segment] = inclusive_sum.value;
+					// empty segments directly following this one
+					for (uint32_t empty_segment = segment + 1u;
+						 empty_segment < segment_count && segments[empty_segment + 1u] == idx + 1u; ++empty_segment) {
+						out[empty_segment] = op_type::identity();
+					}
+				}
+			}
+		} else if constexpr (is_inclusive) {
+			out[idx] = inclusive_sum.value;
+		} else {
+			// head count differs -> this is a head element -> starts with the identity
+			out[idx] = (inclusive_sum.heads != exclusive_sum.heads ? op_type::identity() : exclusive_sum.value);
 		}
+	};
+	
+	scan_chained<tile_size, seg_op_type>(load, store, tile_state, count);
+}
+
+// segmented kernels for each segmented operator and scan tile size (all with the same signature):
+//  * seg_reduce_<flags|offsets>_<op>_<tile size>: writes one value per segment
+//  * seg_<incl|excl>_scan_<flags|offsets>_<op>_<tile size>: writes one value per element
+// "segments" contains the head flags or segment offsets, "segment_count" is ignored in head flags mode
+#define SEGMENTED_KERNEL(tile_size, name, op_type, kernel_name, mode, is_reduce, is_inclusive) \
+kernel_1d(tile_size) void kernel_name##_##name##_##tile_size(buffer<const op_type::input_type> in, buffer<const uint32_t> segments, \
+															 buffer<op_type::value_type> out, buffer<uint32_t> tile_state, \
+															 param<uint32_t> count, param<uint32_t> segment_count) { \
+	segmented_reduce_scan<tile_size, op_type, REDUCTION_SEGMENT_MODE::mode, is_reduce, is_inclusive>(in, segments, out, tile_state, \
+																									  count, segment_count); \
+}
+#define SEGMENTED_KERNELS(tile_size, name, op_type) \
+SEGMENTED_KERNEL(tile_size, name, op_type, seg_reduce_flags, HEAD_FLAGS, true, true) \
+SEGMENTED_KERNEL(tile_size, name, op_type, seg_reduce_offsets, OFFSETS, true, true) \
+SEGMENTED_KERNEL(tile_size, name, op_type, seg_incl_scan_flags, HEAD_FLAGS, false, true) \
+SEGMENTED_KERNEL(tile_size, name, op_type, seg_excl_scan_flags, HEAD_FLAGS, false, false) \
+SEGMENTED_KERNEL(tile_size, name, op_type, seg_incl_scan_offsets, OFFSETS, false, true) \
+SEGMENTED_KERNEL(tile_size, name, op_type, seg_excl_scan_offsets, OFFSETS, false, false)
+#define SEGMENTED_OP_KERNELS(name, op_type) SCAN_TILE_SIZES(SEGMENTED_KERNELS, name, op_type)
+
+// instantiate kernels
+SEGMENTED_REDUCTION_OPS(SEGMENTED_OP_KERNELS)
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// scan-based primitives:
+///  * select (stream compaction / copy_if): writes all elements for which the predicate is true to the front of "out",
+///    in their original order
+///  * partition: like select, but additionally writes all rejected elements behind the selected ones
+///    -> rejected elements are written back to front by the scan and are then reversed in place by a second kernel,
+///       so that the partition is stable for both sides
+///  * run-length encoding: writes the value and length of each run of equal elements
+///  * all of these run the chained scan above over per-element flags and scatter the elements in its store function,
+///    the total amount of selected elements/runs is written by the last element to "out_count[0]"
+///
+/// in (pred: < 5): [4 1 5 3 4 2 7 9 1 2 3 4]
+/// select:         [4 1 3 4 2 1 2 3 4], count: 9
+/// partition:      [4 1 3 4 2 1 2 3 4 | 5 7 9], count: 9
+///
+/// in (rle):       [3 3 1 1 1 7 3 3 3 3]
+/// values:         [3 1 7 3], lengths: [2 3 1 4], count: 4
+
+//! predicate that selects all elements that are less than "pivot"
+template <typename data_type>
+struct less_than_predicate {
+	const data_type pivot;
+	
+	floor_inline_always bool operator()(const data_type& value) const {
+		return (value < pivot);
 	}
+};
 
-	local_buffer<uint32_t, 1u> scan_value_offset;
-	local_buffer<uint32_t, compute_algorithm::reduce_local_memory_elements<tile_size>()> lmem;
-	const auto red_sum = compute_algorithm::reduce_add<tile_size>(item_sum, lmem);
-	if (local_id.x == 0u) {
-		scan_value_offset[0] = red_sum;
+//! selects or partitions "count" elements of "in" with "pred" (see above)
+template <uint32_t tile_size, bool is_partition, typename data_type, typename predicate_type>
+floor_inline_always void select_partition(buffer<const data_type>& in, buffer<data_type>& out, buffer<uint32_t>& out_count,
+										  buffer<uint32_t>& tile_state, const uint32_t count, const predicate_type& pred) {
+	using op_type = op_add<uint32_t>;
+	scan_chained<tile_size, op_type>([&in, &pred](const uint32_t idx) {
+		return (pred(in[idx]) ? 1u : 0u);
+	}, [&in, &out, &out_count, &count](const uint32_t idx, const uint32_t& selected_before, const uint32_t& selected) {
+		if (selected != selected_before) {
+			out[selected_before] = in[idx];
+		} else if constexpr (is_partition) {
+			// #rejected before this element: idx - selected_before
+			out[count - 1u - (idx - selected_before)] = in[idx];
+		}
+		if (idx + 1u == count) {
+			out_count[0] = selected;
+		}
+	}, tile_state, count);
+}
+
+//! reverses the rejected elements of a partition (-> restores their original order)
+template <typename data_type>
+floor_inline_always void partition_reverse_rejected(buffer<data_type>& out, buffer<const uint32_t>& out_count, const uint32_t count) {
+	const auto selected_count = out_count[0];
+	const auto rejected_count = count - selected_count;
+	const auto idx = uint32_t(global_id.x);
+	if (idx >= rejected_count / 2u) {
+		return;
+	}
+	const auto front_idx = selected_count + idx;
+	const auto back_idx = count - 1u - idx;
+	const auto front_value = out[front_idx];
+	out[front_idx] = out[back_idx];
+	out[back_idx] = front_value;
+}
+
+//! run-length encodes "count" elements of "in" (see above)
+template <uint32_t tile_size, typename data_type>
+floor_inline_always void run_length_encode(buffer<const data_type>& in, buffer<data_type>& out_values, buffer<uint32_t>& out_lengths,
+										   buffer<uint32_t>& out_count, buffer<uint32_t>& tile_state, const uint32_t count) {
+	using value_type = typename op_run_length::value_type;
+	scan_chained<tile_size, op_run_length>([&in](const uint32_t idx) -> value_type {
+		// run head: first element or element differs from its predecessor
+		if (idx == 0u || in[idx] != in[idx - 1u]) {
+			return { 1u, idx };
+		}
+		return op_run_length::identity();
+	}, [&in, &out_values, &out_lengths, &out_count, &count](const uint32_t idx, const value_type&, const value_type& run) {
+		// last element of a run writes the run
+		const auto is_last = (idx + 1u == count);
+		if (is_last || in[idx + 1u] != in[idx]) {
+			out_values[run.runs - 1u] = in[idx];
+			out_lengths[run.runs - 1u] = idx + 1u - run.start;
+		}
+		if (is_last) {
+			out_count[0] = run.runs;
+		}
+	}, tile_state, count);
+}
+
+//! histogram of "count" elements with "bin_count" bins, "bin(value)" must return a bin index in [0, bin_count):
+//! every work-group accumulates a private histogram in local memory, which is then added to the global histogram
+//! (-> global atomics only once per non-empty bin per work-group)
+template <uint32_t tile_size, uint32_t bin_count, typename data_type, typename bin_func_type>
+floor_inline_always void histogram_privatized(buffer<const data_type>& in, buffer<uint32_t>& histogram, const uint32_t count,
+											  bin_func_type&& bin) {
+	local_buffer<uint32_t, bin_count> local_histogram;
+	for (uint32_t i = local_id.x; i < bin_count; i += tile_size) {
+		local_histogram[i] = 0u;
 	}
 	local_barrier();
 	
-	if constexpr (is_inclusive) {
-		out[global_id.x] = in[global_id.x] + scan_value_offset[0];
-	} else {
-		if ((global_id.x + 1u) < count) {
-			out[global_id.x + 1u] = in[global_id.x + 1u] + scan_value_offset[0];
+	for (uint32_t idx = global_id.x, stride = global_size.x; idx < count; idx += stride) {
+		atomic_inc(&local_histogram[bin(in[idx])]);
+	}
+	local_barrier();
+	
+	for (uint32_t i = local_id.x; i < bin_count; i += tile_size) {
+		const auto bin_value = local_histogram[i];
+		if (bin_value > 0u) {
+			atomic_add(&histogram[i], bin_value);
 		}
 	}
 }
 
-#define SCAN_KERNELS(tile_size) \
-kernel_1d(tile_size) void incl_scan_local_u32_##tile_size(buffer<const uint32_t> in, buffer<uint32_t> out, param<uint32_t> count) { \
-	scan_local<tile_size, true>(in, out, count); \
-} \
-kernel_1d(tile_size) void excl_scan_local_u32_##tile_size(buffer<const uint32_t> in, buffer<uint32_t> out, param<uint32_t> count) { \
-	scan_local<tile_size, false>(in, out, count); \
-} \
-kernel_1d(tile_size) void incl_scan_global_u32_##tile_size(buffer<const uint32_t> in, buffer<uint32_t> out, param<uint32_t> count) { \
-	scan_global<tile_size, true>(in, out, count); \
+// select/partition kernels for each primitive type and scan tile size, "pivot" is used by the less-than predicate
+#define SELECT_PARTITION_KERNELS(tile_size, name, data_type) \
+kernel_1d(tile_size) void select_##name##_##tile_size(buffer<const data_type> in, buffer<data_type> out, buffer<uint32_t> out_count, \
+													  buffer<uint32_t> tile_state, param<uint32_t> count, param<data_type> pivot) { \
+	select_partition<tile_size, false>(in, out, out_count, tile_state, count, less_than_predicate<data_type> { pivot }); \
 } \
-kernel_1d(tile_size) void excl_scan_global_u32_##tile_size(buffer<const uint32_t> in, buffer<uint32_t> out, param<uint32_t> count) { \
-	scan_global<tile_size, false>(in, out, count); \
+kernel_1d(tile_size) void partition_##name##_##tile_size(buffer<const data_type> in, buffer<data_type> out, buffer<uint32_t> out_count, \
+														 buffer<uint32_t> tile_state, param<uint32_t> count, param<data_type> pivot) { \
+	select_partition<tile_size, true>(in, out, out_count, tile_state, count, less_than_predicate<data_type> { pivot }); \
+}
+#define SELECT_PARTITION_TYPE_KERNELS(name, data_type) \
+SCAN_TILE_SIZES(SELECT_PARTITION_KERNELS, name, data_type) \
+kernel_1d() void partition_reverse_##name(buffer<data_type> out, buffer<const uint32_t> out_count, param<uint32_t> count) { \
+	partition_reverse_rejected(out, out_count, count); \
+}
+
+// instantiate kernels
+PRIMITIVE_TYPES(SELECT_PARTITION_TYPE_KERNELS)
+
+#define RLE_KERNEL(tile_size) \
+kernel_1d(tile_size) void rle_u32_##tile_size(buffer<const uint32_t> in, buffer<uint32_t> out_values, buffer<uint32_t> out_lengths, \
+											  buffer<uint32_t> out_count, buffer<uint32_t> tile_state, param<uint32_t> count) { \
+	run_length_encode<tile_size>(in, out_values, out_lengths, out_count, tile_state, count); \
+}
+
+// instantiate kernels
+SCAN_TILE_SIZES(RLE_KERNEL)
+
+// float histogram over [range_min, range_min + bin_count / inv_bin_width), values outside of this are clamped to the first/last bin
+#define HISTOGRAM_KERNEL(bin_count) \
+kernel_1d(REDUCTION_HISTOGRAM_TILE_SIZE) \
+void histogram_f32_##bin_count(buffer<const float> in, buffer<uint32_t> histogram, param<uint32_t> count, \
+							   param<float> range_min, param<float> inv_bin_width) { \
+	histogram_privatized<REDUCTION_HISTOGRAM_TILE_SIZE, bin_count>(in, histogram, count, [&range_min, &inv_bin_width](const float& value) { \
+		const auto bin = (value - range_min) * inv_bin_width; \
+		return (bin <= 0.0f ? 0u : min(uint32_t(bin), bin_count - 1u)); \
+	}); \
 }
 
 // instantiate kernels
-POT_TILE_SIZES(SCAN_KERNELS)
+HISTOGRAM_BIN_COUNTS(HISTOGRAM_KERNEL)
 
 #endif
@@ -28,6 +28,7 @@
 #endif
 
 #include "reduction_state.hpp"
+#include "reduction_ops.hpp"
 
 #endif
 
@@ -0,0 +1,240 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "reduction_benchmark.hpp"
+#include "reduction_host.hpp"
+#include "../../common/json/json_escape.hpp"
+#include <floor/core/aligned_ptr.hpp>
+#include <fstream>
+
+namespace reduction_benchmark {
+
+#define TILE_SIZE_ENTRY(tile_size) tile_size##u,
+static constexpr const array tile_sizes { POT_TILE_SIZES(TILE_SIZE_ENTRY) };
+#undef TILE_SIZE_ENTRY
+
+static constexpr const array algorithms {
+	REDUCTION_ALGORITHM::AUTO,
+	REDUCTION_ALGORITHM::LOCAL_MEMORY,
+	REDUCTION_ALGORITHM::SHUFFLE,
+	REDUCTION_ALGORITHM::COOP,
+};
+
+static const char* algorithm_name(const REDUCTION_ALGORITHM algorithm) {
+	switch (algorithm) {
+		case REDUCTION_ALGORITHM::AUTO: return "auto";
+		case REDUCTION_ALGORITHM::LOCAL_MEMORY: return "local_memory";
+		case REDUCTION_ALGORITHM::SHUFFLE: return "shuffle";
+		case REDUCTION_ALGORITHM::COOP: return "coop";
+	}
+	return "unknown";
+}
+
+struct result_t {
+	uint32_t count;
+	REDUCTION_ALGORITHM algorithm;
+	uint32_t tile_size;
+	//! median time of all repeats
+	double median_ms;
+	double min_ms;
+	//! achieved bandwidth (bytes read / median time)
+	double gbps;
+	//! copy bandwidth (bytes read + written / median time) of the same element count
+	double copy_gbps;
+	bool verified;
+	
+	//! fraction of the copy bandwidth (-> memory roofline)
+	double copy_fraction() const {
+		return (copy_gbps > 0.0 ? gbps / copy_gbps : 0.0);
+	}
+};
+
+static double compute_bandwidth(const size_t size, const double milliseconds) {
+	return (double(size) / 1000000000.0) / (max(milliseconds, 0.001) / 1000.0);
+}
+
+//! times "repeats" runs of "dispatch", returns the { median, min } time in milliseconds or { -1, -1 } on failure
+template <typename dispatch_func_type>
+static pair<double, double> time_runs(const compute_queue& dev_queue, const uint32_t repeats, dispatch_func_type&& dispatch) {
+	vector<double> times;
+	for (uint32_t i = 0; i < repeats; ++i) {
+		dev_queue.finish();
+		dev_queue.start_profiling();
+		const auto dispatched = dispatch();
+		const auto prof_time = dev_queue.stop_profiling();
+		dev_queue.finish();
+		if (!dispatched) {
+			return { -1.0, -1.0 };
+		}
+		times.emplace_back(double(prof_time) / 1000.0);
+	}
+	sort(times.begin(), times.end());
+	return { times[times.size() / 2u], times[0] };
+}
+
+static bool write_json(const string& file_name, const compute_device& dev, const reduction_op_info& op, const config_t& config,
+					   const vector<result_t>& results) {
+	ofstream json(file_name, ios::out | ios::trunc);
+	if (!json.is_open()) {
+		log_error("failed to open $ for writing", file_name);
+		return false;
+	}
+	
+	json.precision(10);
+	json << "{" << endl;
+	json << "\t\"device\": \"" << json_escape(dev.name) << "\"," << endl;
+	json << "\t\"operator\": \"" << op.name << "\"," << endl;
+	json << "\t\"repeats\": " << config.repeats << "," << endl;
+	json << "\t\"results\": [" << endl;
+	for (size_t i = 0, count = results.size(); i < count; ++i) {
+		const auto& res = results[i];
+		json << "\t\t{ ";
+		json << "\"count\": " << res.count << ", ";
+		json << "\"algorithm\": \"" << algorithm_name(res.algorithm) << "\", ";
+		json << "\"tile_size\": " << res.tile_size << ", ";
+		json << "\"median_ms\": " << res.median_ms << ", ";
+		json << "\"min_ms\": " << res.min_ms << ", ";
+		json << "\"gbps\": " << res.gbps << ", ";
+		json << "\"copy_gbps\": " << res.copy_gbps << ", ";
+		json << "\"copy_fraction\": " << res.copy_fraction() << ", ";
+		json << "\"verified\": " << (res.verified ? "true" : "false");
+		json << " }" << (i + 1 < count ? "," : "") << endl;
+	}
+	json << "\t]" << endl;
+	json << "}" << endl;
+	if (!json.good()) {
+		log_error("failed to write $", file_name);
+		return false;
+	}
+	return true;
+}
+
+static bool write_csv(const string& file_name, const vector<result_t>& results) {
+	ofstream csv(file_name, ios::out | ios::trunc);
+	if (!csv.is_open()) {
+		log_error("failed to open $ for writing", file_name);
+		return false;
+	}
+	
+	csv.precision(10);
+	csv << "count,algorithm,tile_size,median_ms,min_ms,gbps,copy_gbps,copy_fraction,verified" << endl;
+	for (const auto& res : results) {
+		csv << res.count << "," << algorithm_name(res.algorithm) << "," << res.tile_size << ",";
+		csv << res.median_ms << "," << res.min_ms << "," << res.gbps << "," << res.copy_gbps << ",";
+		csv << res.copy_fraction() << "," << (res.verified ? 1 : 0) << endl;
+	}
+	if (!csv.good()) {
+		log_error("failed to write $", file_name);
+		return false;
+	}
+	return true;
+}
+
+bool run(compute_context& ctx, const compute_device& dev, const compute_queue& dev_queue, reduction_dispatcher& dispatcher,
+		 const reduction_op_info& op, const config_t& config) {
+	// largest power-of-two count: input + copy output must fit into device memory (keep some headroom)
+	uint32_t max_count = config.max_count;
+	if (max_count == 0u) {
+		const auto max_buffer_size = min(uint64_t(dev.max_mem_alloc), uint64_t(dev.global_mem_size) / 3u);
+		const auto max_elem_count = min(max_buffer_size / max(op.input_size, uint32_t(sizeof(uint32_t))), uint64_t(1u) << 30u);
+		max_count = 1u;
+		while (uint64_t(max_count) * 2u <= max_elem_count) {
+			max_count *= 2u;
+		}
+	}
+	const auto min_count = max(config.min_count, 4u);
+	if (max_count < min_count) {
+		log_error("invalid benchmark element count range [$, $]", min_count, max_count);
+		return false;
+	}
+	const auto repeats = max(config.repeats, 1u);
+	
+	// all element counts use a prefix of the same random data
+	auto cpu_data = make_aligned_ptr<uint8_t>(size_t(max_count) * op.input_size);
+	op.init_data(cpu_data.get(), max_count, make_random_seed(), 0u);
+	
+	auto input = ctx.create_buffer(dev_queue, size_t(max_count) * op.input_size,
+								   COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+	input->write(dev_queue, cpu_data.get(), size_t(max_count) * op.input_size);
+	input->set_debug_label("benchmark_input");
+	auto copy_output = ctx.create_buffer(dev_queue, size_t(max_count) * op.input_size, COMPUTE_MEMORY_FLAG::READ_WRITE);
+	copy_output->set_debug_label("benchmark_copy_output");
+	auto result = ctx.create_buffer(dev_queue, op.value_size, COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+	result->set_debug_label("benchmark_result");
+	
+	log_msg("benchmarking $ reductions with $ - $ elements ($ repeats per configuration)", op.name, min_count, max_count, repeats);
+	vector<result_t> results;
+	array<uint8_t, 64> expected {}, device_result {};
+	for (uint64_t count_64 = min_count; count_64 <= max_count; count_64 *= 2u) {
+		const auto count = uint32_t(count_64);
+		const auto input_size = size_t(count) * op.input_size;
+		op.host_reduce(cpu_data.get(), count, expected.data());
+		
+		// reference: device-to-device copy of the same amount of data
+		const auto copy_count = uint32_t(input_size / sizeof(uint32_t)) & ~3u;
+		const auto [copy_ms, copy_min_ms] = time_runs(dev_queue, repeats, [&] {
+			return dispatcher.copy(dev_queue, input, copy_output, copy_count);
+		});
+		const auto copy_gbps = (copy_ms > 0.0 ? compute_bandwidth(size_t(copy_count) * sizeof(uint32_t) * 2u, copy_ms) : 0.0);
+		
+		for (const auto& algorithm : algorithms) {
+			if (!dispatcher.is_algorithm_supported(op, algorithm)) {
+				continue;
+			}
+			for (const auto& tile_size : tile_sizes) {
+				const auto [median_ms, min_ms] = time_runs(dev_queue, repeats, [&] {
+					return dispatcher.reduce(dev_queue, op, algorithm, tile_size, input, result, count);
+				});
+				if (median_ms < 0.0) {
+					// no kernel for this configuration (tile size not usable or no forced-algorithm kernels for this operator)
+					continue;
+				}
+				
+				// the result of the last run is still in "result"
+				result->read(dev_queue, device_result.data(), op.value_size);
+				const auto verified = op.compare(device_result.data(), expected.data());
+				if (!verified) {
+					log_error("result mismatch ($ elements, $, tile size $): $, expected: $", count, algorithm_name(algorithm),
+							  tile_size, op.to_string(device_result.data()), op.to_string(expected.data()));
+				}
+				
+				const result_t res {
+					.count = count,
+					.algorithm = algorithm,
+					.tile_size = tile_size,
+					.median_ms = median_ms,
+					.min_ms = min_ms,
+					.gbps = compute_bandwidth(input_size, median_ms),
+					.copy_gbps = copy_gbps,
+					.verified = verified,
+				};
+				log_msg("$ elements, $, tile size $: $ms -> $ GB/s ($% of copy @ $ GB/s)",
+						count, algorithm_name(algorithm), tile_size, res.median_ms, res.gbps, res.copy_fraction() * 100.0, copy_gbps);
+				results.emplace_back(res);
+			}
+		}
+	}
+	
+	if (!write_json(config.json_file_name, dev, op, config, results) || !write_csv(config.csv_file_name, results)) {
+		return false;
+	}
+	log_msg("wrote benchmark results to \"$\" and \"$\"", config.json_file_name, config.csv_file_name);
+	return all_of(results.begin(), results.end(), [](const result_t& res) { return res.verified; });
+}
+	
+} // reduction_benchmark
@@ -0,0 +1,45 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_REDUCTION_REDUCTION_BENCHMARK_HPP__
+#define __FLOOR_REDUCTION_REDUCTION_BENCHMARK_HPP__
+
+#include "reduction_dispatch.hpp"
+
+//! reduction bandwidth benchmark: sweeps power-of-two element counts, all tile sizes and all reduction algorithms
+//! (local memory, shuffle, coop, auto), compares the achieved bandwidth against a device-to-device copy measured
+//! in the same run and writes all results to a JSON and a CSV file
+namespace reduction_benchmark {
+
+struct config_t {
+	uint32_t min_count { 1024u };
+	//! 0 -> largest power-of-two count that fits into device memory
+	uint32_t max_count { 0u };
+	//! #timed runs per configuration (the median is reported)
+	uint32_t repeats { 3u };
+	string json_file_name { "reduction_benchmark.json" };
+	string csv_file_name { "reduction_benchmark.csv" };
+};
+
+//! runs all benchmark configurations for "op", logs the results and writes the JSON/CSV reports
+bool run(compute_context& ctx, const compute_device& dev, const compute_queue& dev_queue, reduction_dispatcher& dispatcher,
+		 const reduction_op_info& op, const config_t& config);
+	
+} // reduction_benchmark
+
+#endif
@@ -0,0 +1,829 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "reduction_dispatch.hpp"
+#include "reduction_host.hpp"
+#include <sstream>
+
+///////////////////////////////////////////////////////////////////////////////
+/// operator info
+
+//! min #elements per range of the parallel host data generation/reduction/scan/verification
+static constexpr const uint64_t host_min_range_size { 64u * 1024u };
+
+//! random input data from the Philox output "bits" of an element: floats in [0, 0.025], integers in [0, 16]
+template <typename data_type>
+static data_type random_value(const array<uint32_t, 4>& bits, const uint32_t component = 0u) {
+	if constexpr (is_same_v<data_type, float>) {
+		return float(bits[component] >> 8u) * 0x1.0p-24f * 0.025f;
+	} else if constexpr (is_same_v<data_type, double>) {
+		const auto bits_53 = ((uint64_t(bits[component]) << 32u) | uint64_t(bits[(component + 1u) % 4u])) >> 11u;
+		return double(bits_53) * 0x1.0p-53 * 0.025;
+	} else if constexpr (is_integral_v<data_type>) {
+		return data_type(bits[component] % 17u);
+	} else {
+		// float vector types: one Philox output per component
+		static_assert(data_type::dim() <= 4u, "too many vector components");
+		data_type vec;
+		for (uint32_t i = 0; i < data_type::dim(); ++i) {
+			vec[i] = random_value<typename data_type::scalar_type>(bits, i);
+		}
+		return vec;
+	}
+}
+
+//! relative compare of floating point values
+template <typename fp_type>
+static bool is_fp_close(const fp_type& device_value, const fp_type& host_value) {
+	static constexpr const fp_type rel_tolerance { fp_type(1e-4) };
+	return (abs(device_value - host_value) <= rel_tolerance * max(abs(host_value), fp_type(1)));
+}
+
+template <typename value_type>
+static bool compare_values(const value_type& device_value, const value_type& host_value, const bool is_exact) {
+	if constexpr (is_integral_v<value_type>) {
+		return (device_value == host_value);
+	} else if constexpr (is_floating_point_v<value_type>) {
+		return (is_exact ? device_value == host_value : is_fp_close(device_value, host_value));
+	} else if constexpr (is_same_v<value_type, moments_t>) {
+		return (device_value.count == host_value.count &&
+				is_fp_close(device_value.mean, host_value.mean) &&
+				is_fp_close(device_value.m2, host_value.m2));
+	} else if constexpr (requires { device_value.index; }) {
+		// arg_value
+		return (device_value.value == host_value.value && device_value.index == host_value.index);
+	} else {
+		// float vector types
+		for (uint32_t i = 0; i < value_type::dim(); ++i) {
+			if (!compare_values(device_value[i], host_value[i], is_exact)) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+template <typename value_type>
+static string value_to_string(const value_type& value) {
+	stringstream sstr;
+	if constexpr (is_same_v<value_type, moments_t>) {
+		sstr << "count: " << value.count << ", mean: " << value.mean << ", variance: ";
+		sstr << (value.count > 0u ? value.m2 / float(value.count) : 0.0f);
+	} else if constexpr (requires { value.index; }) {
+		sstr << value.value << " @" << value.index;
+	} else {
+		sstr << value;
+	}
+	return sstr.str();
+}
+
+//! pairwise reduction: sequential for small ranges, recursive split otherwise
+template <typename op_type>
+static typename op_type::value_type host_reduce_pairwise(const typename op_type::input_type* data,
+														 const uint64_t offset, const uint64_t count) {
+	static constexpr const uint64_t sequential_count { 1024u };
+	if (count <= sequential_count) {
+		auto value = op_type::identity();
+		for (uint64_t i = offset, end = offset + count; i < end; ++i) {
+			// NOTE: index-dependent operators are limited to 32-bit element indices
+			value = op_type::combine(value, op_type::load(data[i], uint32_t(i)));
+		}
+		return value;
+	}
+	const auto half_count = count / 2u;
+	return op_type::combine(host_reduce_pairwise<op_type>(data, offset, half_count),
+							host_reduce_pairwise<op_type>(data, offset + half_count, count - half_count));
+}
+
+//! parallel pairwise reduction: each host range is reduced pairwise, range results are combined in order
+template <typename op_type>
+static typename op_type::value_type host_reduce_parallel(const typename op_type::input_type* data, const uint64_t count) {
+	vector<typename op_type::value_type> range_values(host_parallel_range_count(count, host_min_range_size));
+	host_parallel_for(count, host_min_range_size, [data, &range_values](const uint32_t range_index, const uint64_t begin, const uint64_t end) {
+		range_values[range_index] = host_reduce_pairwise<op_type>(data, begin, end - begin);
+	});
+	auto value = op_type::identity();
+	for (const auto& range_value : range_values) {
+		value = op_type::combine(value, range_value);
+	}
+	return value;
+}
+
+//! sequential scan of [begin, end) starting with "prefix",
+//! float additions use Kahan summation (-> sequential float sums would stagnate for large counts)
+template <typename op_type>
+static void host_scan_range(const typename op_type::input_type* data, typename op_type::value_type* out,
+							const uint64_t begin, const uint64_t end, const bool inclusive,
+							const typename op_type::value_type& prefix) {
+	using value_type = typename op_type::value_type;
+	static constexpr const bool use_kahan { op_type::kind == REDUCTION_OP_KIND::ADD && !is_integral_v<value_type> };
+	auto sum = prefix;
+	auto kahan_c = op_type::identity();
+	for (uint64_t i = begin; i < end; ++i) {
+		const auto value = op_type::load(data[i], uint32_t(i));
+		if (!inclusive) {
+			out[i] = sum;
+		}
+		if constexpr (use_kahan) {
+			const value_type kahan_y = value - kahan_c;
+			const value_type kahan_t = sum + kahan_y;
+			kahan_c = (kahan_t - sum) - kahan_y;
+			sum = kahan_t;
+		} else {
+			sum = op_type::combine(sum, value);
+		}
+		if (inclusive) {
+			out[i] = sum;
+		}
+	}
+}
+
+//! parallel scan: reduces all host ranges (pairwise), computes the exclusive prefix of each range from these and
+//! then scans all ranges in parallel, starting from their prefix
+template <typename op_type>
+static void host_scan(const typename op_type::input_type* data, typename op_type::value_type* out,
+					  const uint64_t count, const bool inclusive) {
+	const auto range_count = host_parallel_range_count(count, host_min_range_size);
+	vector<typename op_type::value_type> range_prefixes(range_count);
+	if (range_count > 1u) {
+		host_parallel_for(count, host_min_range_size, [data, &range_prefixes](const uint32_t range_index, const uint64_t begin,
+																			  const uint64_t end) {
+			range_prefixes[range_index] = host_reduce_pairwise<op_type>(data, begin, end - begin);
+		});
+	}
+	auto prefix = op_type::identity();
+	for (auto& range_prefix : range_prefixes) {
+		const auto range_value = range_prefix;
+		range_prefix = prefix;
+		prefix = op_type::combine(prefix, range_value);
+	}
+	
+	host_parallel_for(count, host_min_range_size, [data, out, inclusive, &range_prefixes](const uint32_t range_index,
+																							const uint64_t begin, const uint64_t end) {
+		host_scan_range<op_type>(data, out, begin, end, inclusive, range_prefixes[range_index]);
+	});
+}
+
+template <reduction_op op_type>
+static reduction_op_info make_op_info(const char* name, const bool reduce_only) {
+	using input_type = typename op_type::input_type;
+	using value_type = typename op_type::value_type;
+	static constexpr const bool is_exact {
+		op_type::kind != REDUCTION_OP_KIND::ADD ? !is_same_v<op_type, op_moments> : is_integral_v<value_type>
+	};
+	return {
+		.name = name,
+		.input_size = sizeof(input_type),
+		.value_size = sizeof(value_type),
+		.has_atomic = op_type::has_atomic,
+		.has_sub_group_reduce = has_sub_group_reduce_v<op_type>,
+		.is_exact = is_exact,
+		.reduce_only = reduce_only,
+		.has_segmented = has_segmented_kernels_v<op_type>,
+		.has_deterministic = has_deterministic_kernels_v<op_type>,
+		.is_index_dependent = requires(const value_type& value) { value.index; },
+		.identity = [](void* dst) {
+			*(value_type*)dst = op_type::identity();
+		},
+		.init_data = [](void* dst, const uint64_t count, const uint64_t seed, const uint64_t first_index) {
+			auto data = (input_type*)dst;
+			host_parallel_for(count, host_min_range_size, [data, seed, first_index](const uint32_t, const uint64_t begin,
+																					const uint64_t end) {
+				for (uint64_t i = begin; i < end; ++i) {
+					data[i] = random_value<input_type>(philox_random(seed, first_index + i));
+				}
+			});
+		},
+		.host_reduce = [](const void* data, const uint64_t count, void* result) {
+			*(value_type*)result = host_reduce_parallel<op_type>((const input_type*)data, count);
+		},
+		.host_scan = [](const void* data, void* out, const uint64_t count, const bool inclusive) {
+			host_scan<op_type>((const input_type*)data, (value_type*)out, count, inclusive);
+		},
+		.combine = [](const void* lhs, const void* rhs, void* result) {
+			*(value_type*)result = op_type::combine(*(const value_type*)lhs, *(const value_type*)rhs);
+		},
+		.compare = [](const void* device_value, const void* host_value) {
+			return compare_values(*(const value_type*)device_value, *(const value_type*)host_value, is_exact);
+		},
+		.find_mismatch = [](const void* device_values, const void* host_values, const uint64_t count) {
+			// first mismatch per range, the smallest one wins
+			vector<uint64_t> range_mismatch(host_parallel_range_count(count, host_min_range_size), count);
+			host_parallel_for(count, host_min_range_size, [device_values, host_values, &range_mismatch](const uint32_t range_index,
+																										const uint64_t begin,
+																										const uint64_t end) {
+				for (uint64_t i = begin; i < end; ++i) {
+					if (!compare_values(((const value_type*)device_values)[i], ((const value_type*)host_values)[i], is_exact)) {
+						range_mismatch[range_index] = i;
+						return;
+					}
+				}
+			});
+			return *min_element(range_mismatch.begin(), range_mismatch.end());
+		},
+		.to_string = [](const void* value) {
+			return value_to_string(*(const value_type*)value);
+		},
+	};
+}
+
+const vector<reduction_op_info>& get_reduction_ops() {
+#define REDUCTION_OP_INFO(name, op_type) make_op_info<op_type>(#name, false),
+#define REDUCTION_OP_INFO_64(name, op_type) make_op_info<op_type>(#name, !has_scan_64_kernels_v<op_type>),
+	static const vector<reduction_op_info> ops {
+		REDUCTION_OPS(REDUCTION_OP_INFO)
+		REDUCTION_OPS_64(REDUCTION_OP_INFO_64)
+	};
+#undef REDUCTION_OP_INFO
+#undef REDUCTION_OP_INFO_64
+	return ops;
+}
+
+const reduction_op_info* find_reduction_op(const string& name) {
+	for (const auto& op : get_reduction_ops()) {
+		if (op.name == name) {
+			return &op;
+		}
+	}
+	return nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// dispatcher
+
+#define TILE_SIZE_ENTRY(tile_size) tile_size##u,
+static constexpr const array reduce_tile_sizes { POT_TILE_SIZES(TILE_SIZE_ENTRY) };
+static constexpr const array scan_tile_sizes { SCAN_TILE_SIZES(TILE_SIZE_ENTRY) };
+static constexpr const array histogram_bin_counts { HISTOGRAM_BIN_COUNTS(TILE_SIZE_ENTRY) };
+#undef TILE_SIZE_ENTRY
+
+unique_ptr<reduction_dispatcher> reduction_dispatcher::create(compute_context& ctx, const compute_device& dev,
+															  const compute_program& prog) {
+	unique_ptr<reduction_dispatcher> dispatcher { new reduction_dispatcher(ctx, dev) };
+	
+	const auto add_kernel = [&dispatcher, &dev, &prog](const string& kernel_name, const uint32_t tile_size) {
+		auto kernel = prog.get_kernel(kernel_name);
+		if (kernel == nullptr) {
+			log_error("failed to retrieve kernel $ from program", kernel_name);
+			return false;
+		}
+		const auto entry = kernel->get_kernel_entry(dev);
+		const auto max_local_size = entry->max_total_local_size;
+		bool usable = true;
+		if (dev.context->get_compute_type() != COMPUTE_TYPE::HOST) {
+			// usable if max local size >= required tile size, and if #args != 0 (i.e. kernel isn't disabled for other reasons)
+			usable = (tile_size <= max_local_size && !entry->info->args.empty());
+		}
+		// else: always usable with host-compute
+		log_debug("$: local size: $, usable: $", kernel_name, max_local_size, usable);
+		dispatcher->kernels.emplace(kernel_name, kernel_entry_t { kernel, tile_size, usable });
+		return true;
+	};
+	
+	for (const auto& op : get_reduction_ops()) {
+		for (const auto& tile_size : reduce_tile_sizes) {
+			if (!add_kernel(string("reduce_") + op.name + "_" + to_string(tile_size), tile_size) ||
+				!add_kernel(string("reduce_partials_") + op.name + "_" + to_string(tile_size), tile_size)) {
+				return {};
+			}
+		}
+		if (op.has_deterministic) {
+			for (const auto& tile_size : reduce_tile_sizes) {
+				if (!add_kernel(string("reduce_det_") + op.name + "_" + to_string(tile_size), tile_size)) {
+					return {};
+				}
+			}
+		}
+		if (op.reduce_only) {
+			continue;
+		}
+		for (const auto& tile_size : scan_tile_sizes) {
+			if (!add_kernel(string("incl_scan_") + op.name + "_" + to_string(tile_size), tile_size) ||
+				!add_kernel(string("excl_scan_") + op.name + "_" + to_string(tile_size), tile_size)) {
+				return {};
+			}
+		}
+		if (!op.has_segmented) {
+			continue;
+		}
+		for (const auto& tile_size : scan_tile_sizes) {
+			for (const auto& seg_kernel_prefix : { "seg_reduce_flags_", "seg_reduce_offsets_",
+												   "seg_incl_scan_flags_", "seg_excl_scan_flags_",
+												   "seg_incl_scan_offsets_", "seg_excl_scan_offsets_" }) {
+				if (!add_kernel(string(seg_kernel_prefix) + op.name + "_" + to_string(tile_size), tile_size)) {
+					return {};
+				}
+			}
+		}
+	}
+	
+	// forced algorithm reduction kernels and the copy kernel (benchmark)
+	for (const auto& algorithm_name : { "lmem_", "shuffle_", "coop_" }) {
+#define BENCHMARK_OP_NAME(name, op_type) #name,
+		for (const auto& op_name : { BENCHMARK_REDUCTION_OPS(BENCHMARK_OP_NAME) }) {
+			for (const auto& tile_size : reduce_tile_sizes) {
+				if (!add_kernel(string("reduce_") + algorithm_name + op_name + "_" + to_string(tile_size), tile_size)) {
+					return {};
+				}
+			}
+		}
+#undef BENCHMARK_OP_NAME
+	}
+	if (!add_kernel("copy_uint4", 256u)) {
+		return {};
+	}
+	
+	// scan-based primitives and histograms
+	for (const auto& type_name : { "f32", "u32" }) {
+		for (const auto& tile_size : scan_tile_sizes) {
+			if (!add_kernel(string("select_") + type_name + "_" + to_string(tile_size), tile_size) ||
+				!add_kernel(string("partition_") + type_name + "_" + to_string(tile_size), tile_size)) {
+				return {};
+			}
+		}
+		if (!add_kernel(string("partition_reverse_") + type_name, 0u)) {
+			return {};
+		}
+	}
+	for (const auto& tile_size : scan_tile_sizes) {
+		if (!add_kernel("rle_u32_" + to_string(tile_size), tile_size)) {
+			return {};
+		}
+	}
+	for (const auto& bin_count : histogram_bin_counts) {
+		if (!add_kernel("histogram_f32_" + to_string(bin_count), REDUCTION_HISTOGRAM_TILE_SIZE)) {
+			return {};
+		}
+	}
+	return dispatcher;
+}
+
+const reduction_dispatcher::kernel_entry_t* reduction_dispatcher::find_kernel(const string& prefix, const reduction_op_info& op,
+																			  const uint32_t max_tile_size) const {
+	return find_kernel(prefix + op.name + "_", max_tile_size);
+}
+
+const reduction_dispatcher::kernel_entry_t* reduction_dispatcher::find_kernel(const string& prefix, const uint32_t max_tile_size) const {
+	const kernel_entry_t* best_entry = nullptr;
+	for (const auto& tile_size : reduce_tile_sizes) {
+		if (tile_size > max_tile_size) {
+			break;
+		}
+		const auto iter = kernels.find(prefix + to_string(tile_size));
+		if (iter != kernels.end() && iter->second.usable) {
+			best_entry = &iter->second;
+		}
+	}
+	if (best_entry == nullptr) {
+		log_error("no usable $ kernel", prefix);
+	}
+	return best_entry;
+}
+
+const shared_ptr<compute_buffer>& reduction_dispatcher::get_scratch_buffer(shared_ptr<compute_buffer>& buffer,
+																		   const compute_queue& dev_queue,
+																		   const size_t size, const char* debug_label) {
+	if (!buffer || buffer->get_size() < size) {
+		buffer = ctx.create_buffer(dev_queue, size, COMPUTE_MEMORY_FLAG::READ_WRITE);
+		buffer->set_debug_label(debug_label);
+	}
+	return buffer;
+}
+
+uint32_t reduction_dispatcher::get_reduction_global_size(const uint32_t tile_size) const {
+	// compute the ideal global size (#units * local size), if the unit count is unknown, assume 12, so that we still get good throughput
+	static constexpr const uint32_t unit_count_fallback { 12u };
+	if (dev.units == 0) {
+		log_error("device #units is 0 - assuming $", unit_count_fallback);
+	}
+	const uint32_t dev_unit_count = (dev.units != 0 ? dev.units : unit_count_fallback);
+	return dev_unit_count * tile_size * (dev.is_gpu() ? 2u : 1u);
+}
+
+const shared_ptr<compute_buffer>& reduction_dispatcher::prepare_chained_scan(const compute_queue& dev_queue,
+																			 const kernel_entry_t& kernel_entry, const uint32_t count,
+																			 const uint32_t value_size, uint32_t& tile_count) {
+	const auto elems_per_tile = kernel_entry.tile_size * REDUCTION_SCAN_ITEMS_PER_WORK_ITEM;
+	tile_count = (count + (elems_per_tile - 1u)) / elems_per_tile;
+	last_dispatch_info = {
+		.tile_size = kernel_entry.tile_size,
+		.group_count = tile_count,
+		.cooperative = false,
+		.partials_pass = false,
+	};
+	
+	// tile counter + status/aggregate/prefix per tile
+	const auto value_words = value_size / uint32_t(sizeof(uint32_t));
+	const auto state_size = (1u + size_t(tile_count) * (1u + 2u * value_words)) * sizeof(uint32_t);
+	const auto& tile_state = get_scratch_buffer(scan_state_buffer, dev_queue, state_size, "scan_tile_state");
+	tile_state->zero(dev_queue);
+	return tile_state;
+}
+
+bool reduction_dispatcher::reduce(const compute_queue& dev_queue, const reduction_op_info& op,
+								  const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& result,
+								  const uint64_t count, const uint64_t input_offset, const uint32_t result_offset) {
+	// same as the builtin device-side path selection: cooperative kernels are only used if sub-group reduction is possible
+	const bool use_coop = (dev.cooperative_kernel_support && op.has_sub_group_reduce);
+	const bool use_deterministic = (deterministic && op.has_deterministic);
+	const auto kernel_entry = find_kernel(use_deterministic ? "reduce_det_" : "reduce_", op, use_coop ? 512u : 1024u);
+	if (kernel_entry == nullptr) {
+		return false;
+	}
+	const bool use_atomic = (op.has_atomic && !use_deterministic);
+	if (count <= REDUCTION_MAX_LAUNCH_COUNT) {
+		return reduce_dispatch(dev_queue, op, *kernel_entry, use_coop, use_atomic, input, result, uint32_t(count),
+							   input_offset, result_offset);
+	}
+	
+	// too many elements for a single launch: reduce each part into its own slot of the split results buffer,
+	// then reduce these with the partials kernel
+	if (op.is_index_dependent) {
+		log_error("operator $ can't reduce more than $ elements (32-bit element index)", op.name, REDUCTION_MAX_LAUNCH_COUNT);
+		return false;
+	}
+	const auto partials_entry = find_kernel("reduce_partials_", op, 1024u);
+	if (partials_entry == nullptr) {
+		return false;
+	}
+	const auto part_count = uint32_t((count + (REDUCTION_MAX_LAUNCH_COUNT - 1u)) / REDUCTION_MAX_LAUNCH_COUNT);
+	get_scratch_buffer(split_results_buffer, dev_queue, size_t(part_count) * op.value_size, "reduction_split_results");
+	for (uint32_t part = 0; part < part_count; ++part) {
+		const auto part_offset = uint64_t(part) * REDUCTION_MAX_LAUNCH_COUNT;
+		const auto part_elem_count = uint32_t(min(count - part_offset, uint64_t(REDUCTION_MAX_LAUNCH_COUNT)));
+		if (!reduce_dispatch(dev_queue, op, *kernel_entry, use_coop, use_atomic, input, split_results_buffer, part_elem_count,
+							 input_offset + part_offset, part)) {
+			return false;
+		}
+	}
+	dev_queue.finish();
+	dev_queue.execute_with_parameters(*partials_entry->kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { partials_entry->tile_size, 1u, 1u },
+		.local_work_size = { partials_entry->tile_size, 1u, 1u },
+		.args = { split_results_buffer, result, part_count, uint64_t(0u), result_offset },
+		.wait_until_completion = false,
+		.debug_label = "reduce_split_results",
+	});
+	return true;
+}
+
+bool reduction_dispatcher::reduce(const compute_queue& dev_queue, const reduction_op_info& op, const REDUCTION_ALGORITHM algorithm,
+								  const uint32_t tile_size, const shared_ptr<compute_buffer>& input,
+								  const shared_ptr<compute_buffer>& result, const uint32_t count) {
+	if (!is_algorithm_supported(op, algorithm)) {
+		return false;
+	}
+	string kernel_name = "reduce_";
+	switch (algorithm) {
+		case REDUCTION_ALGORITHM::AUTO: break;
+		case REDUCTION_ALGORITHM::LOCAL_MEMORY: kernel_name += "lmem_"; break;
+		case REDUCTION_ALGORITHM::SHUFFLE: kernel_name += "shuffle_"; break;
+		case REDUCTION_ALGORITHM::COOP: kernel_name += "coop_"; break;
+	}
+	kernel_name += op.name + string("_") + to_string(tile_size);
+	const auto iter = kernels.find(kernel_name);
+	if (iter == kernels.end() || !iter->second.usable) {
+		return false;
+	}
+	const auto use_coop = (algorithm == REDUCTION_ALGORITHM::COOP ||
+						   (algorithm == REDUCTION_ALGORITHM::AUTO && dev.cooperative_kernel_support && op.has_sub_group_reduce));
+	if (use_coop && tile_size > 512u) {
+		return false;
+	}
+	return reduce_dispatch(dev_queue, op, iter->second, use_coop, op.has_atomic, input, result, count, 0u, 0u);
+}
+
+bool reduction_dispatcher::is_algorithm_supported(const reduction_op_info& op, const REDUCTION_ALGORITHM algorithm) const {
+	switch (algorithm) {
+		case REDUCTION_ALGORITHM::AUTO:
+		case REDUCTION_ALGORITHM::LOCAL_MEMORY:
+			return true;
+		case REDUCTION_ALGORITHM::SHUFFLE:
+			return (op.has_sub_group_reduce && dev.sub_group_shuffle_support);
+		case REDUCTION_ALGORITHM::COOP:
+			return (op.has_sub_group_reduce && dev.sub_group_shuffle_support && dev.cooperative_kernel_support);
+	}
+	return false;
+}
+
+bool reduction_dispatcher::copy(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input,
+								const shared_ptr<compute_buffer>& output, const uint32_t count) {
+	const auto iter = kernels.find("copy_uint4");
+	if (iter == kernels.end() || !iter->second.usable) {
+		log_error("no usable copy kernel");
+		return false;
+	}
+	// grid-stride loop: enough work-items to saturate the device, but not more than elements
+	const auto tile_size = iter->second.tile_size;
+	const auto vec_count = count / 4u;
+	const auto global_size = min(((vec_count + tile_size - 1u) / tile_size) * tile_size, get_reduction_global_size(tile_size) * 8u);
+	dev_queue.execute_with_parameters(*iter->second.kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { max(global_size, tile_size), 1u, 1u },
+		.local_work_size = { tile_size, 1u, 1u },
+		.args = { input, output, vec_count },
+		.wait_until_completion = false,
+		.debug_label = "copy",
+	});
+	return true;
+}
+
+bool reduction_dispatcher::reduce_dispatch(const compute_queue& dev_queue, const reduction_op_info& op, const kernel_entry_t& kernel_entry,
+										   const bool use_coop, const bool use_atomic, const shared_ptr<compute_buffer>& input,
+										   const shared_ptr<compute_buffer>& result, const uint32_t count,
+										   const uint64_t input_offset, const uint32_t result_offset) {
+	const auto tile_size = kernel_entry.tile_size;
+	const uint32_t global_size = (use_coop ?
+								  uint32_t(dev.max_coop_total_local_size) /* max concurrent threads */ * dev.units /* #multiprocessors */ :
+								  get_reduction_global_size(tile_size));
+	const auto group_count = global_size / tile_size;
+	last_dispatch_info = {
+		.tile_size = tile_size,
+		.group_count = group_count,
+		.cooperative = use_coop,
+		.partials_pass = !use_atomic,
+	};
+	
+	// atomic operators: all groups directly combine their result into "result", which must initially contain the identity
+	// other operators (or deterministic reductions): all groups write their result into the partials buffer, which is then reduced in a second pass
+	shared_ptr<compute_buffer> group_output = result;
+	if (use_atomic) {
+		array<uint8_t, 64> identity_value {};
+		op.identity(identity_value.data());
+		result->write(dev_queue, identity_value.data(), op.value_size, size_t(result_offset) * op.value_size);
+	} else {
+		group_output = get_scratch_buffer(partials_buffer, dev_queue, size_t(group_count) * op.value_size, "reduction_partials");
+	}
+	
+	// partials are always written from the start of the partials buffer
+	const auto group_output_offset = (use_atomic ? result_offset : 0u);
+	if (use_coop) {
+		dev_queue.execute_cooperative(*kernel_entry.kernel, uint1 { global_size }, uint1 { tile_size },
+									  input, group_output, count, input_offset, group_output_offset);
+	} else {
+		dev_queue.execute_with_parameters(*kernel_entry.kernel, compute_queue::execution_parameters_t {
+			.execution_dim = 1u,
+			.global_work_size = { global_size, 1u, 1u },
+			.local_work_size = { tile_size, 1u, 1u },
+			.args = { input, group_output, count, input_offset, group_output_offset },
+			.wait_until_completion = !use_atomic, // must wait if there is a dependent partials pass
+			.debug_label = "reduce",
+		});
+	}
+	
+	if (!use_atomic) {
+		// reduce all partial results with a single work-group
+		const auto partials_entry = find_kernel("reduce_partials_", op, 1024u);
+		if (partials_entry == nullptr) {
+			return false;
+		}
+		dev_queue.execute_with_parameters(*partials_entry->kernel, compute_queue::execution_parameters_t {
+			.execution_dim = 1u,
+			.global_work_size = { partials_entry->tile_size, 1u, 1u },
+			.local_work_size = { partials_entry->tile_size, 1u, 1u },
+			.args = { partials_buffer, result, group_count, uint64_t(0u), result_offset },
+			.wait_until_completion = false,
+			.debug_label = "reduce_partials",
+		});
+	}
+	return true;
+}
+
+bool reduction_dispatcher::scan(const compute_queue& dev_queue, const reduction_op_info& op, const bool inclusive,
+								const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& output,
+								const uint64_t count, const uint64_t offset, const shared_ptr<compute_buffer>& carry) {
+	if (op.reduce_only) {
+		log_error("no scan kernels exist for operator $", op.name);
+		return false;
+	}
+	
+	// prefer 256 work-items per tile: large enough to hide latency, small enough for a short look-back chain
+	const auto kernel_entry = find_kernel(inclusive ? "incl_scan_" : "excl_scan_", op, 256u);
+	if (kernel_entry == nullptr) {
+		return false;
+	}
+	
+	// too many elements for a single launch: all parts are chained via a carry (starting with the identity if none was specified)
+	if (count > REDUCTION_MAX_LAUNCH_COUNT && op.is_index_dependent) {
+		log_error("operator $ can't scan more than $ elements (32-bit element index)", op.name, REDUCTION_MAX_LAUNCH_COUNT);
+		return false;
+	}
+	shared_ptr<compute_buffer> chain_carry = carry;
+	if (count > REDUCTION_MAX_LAUNCH_COUNT && !chain_carry) {
+		array<uint8_t, 64> identity_value {};
+		op.identity(identity_value.data());
+		chain_carry = get_scratch_buffer(split_carry_buffer, dev_queue, 64u, "scan_split_carry");
+		chain_carry->write(dev_queue, identity_value.data(), op.value_size);
+	}
+	
+	const auto tile_size = kernel_entry->tile_size;
+	const auto& carry_arg = (chain_carry ? chain_carry : get_scratch_buffer(unused_carry_buffer, dev_queue, 64u, "unused_scan_carry"));
+	for (uint64_t part_offset = 0; part_offset < count; part_offset += REDUCTION_MAX_LAUNCH_COUNT) {
+		const auto part_count = uint32_t(min(count - part_offset, uint64_t(REDUCTION_MAX_LAUNCH_COUNT)));
+		uint32_t tile_count = 0u;
+		const auto& tile_state = prepare_chained_scan(dev_queue, *kernel_entry, part_count, op.value_size, tile_count);
+		dev_queue.execute_with_parameters(*kernel_entry->kernel, compute_queue::execution_parameters_t {
+			.execution_dim = 1u,
+			.global_work_size = { tile_count * tile_size, 1u, 1u },
+			.local_work_size = { tile_size, 1u, 1u },
+			.args = { input, output, tile_state, carry_arg, part_count, offset + part_offset, chain_carry ? 1u : 0u },
+			// the tile state is reused by the next part
+			.wait_until_completion = (part_offset + part_count < count),
+			.debug_label = (inclusive ? "incl_scan" : "excl_scan"),
+		});
+	}
+	return true;
+}
+
+bool reduction_dispatcher::segmented_reduce(const compute_queue& dev_queue, const reduction_op_info& op, const REDUCTION_SEGMENT_MODE mode,
+											const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& segments,
+											const shared_ptr<compute_buffer>& output, const uint32_t count, const uint32_t segment_count) {
+	return segmented_dispatch(dev_queue, op, (mode == REDUCTION_SEGMENT_MODE::HEAD_FLAGS ? "seg_reduce_flags_" : "seg_reduce_offsets_"),
+							  input, segments, output, count, segment_count);
+}
+
+bool reduction_dispatcher::segmented_scan(const compute_queue& dev_queue, const reduction_op_info& op, const REDUCTION_SEGMENT_MODE mode,
+										  const bool inclusive, const shared_ptr<compute_buffer>& input,
+										  const shared_ptr<compute_buffer>& segments, const shared_ptr<compute_buffer>& output,
+										  const uint32_t count, const uint32_t segment_count) {
+	const auto kernel_prefix = string(inclusive ? "seg_incl_scan_" : "seg_excl_scan_") +
+							   (mode == REDUCTION_SEGMENT_MODE::HEAD_FLAGS ? "flags_" : "offsets_");
+	return segmented_dispatch(dev_queue, op, kernel_prefix, input, segments, output, count, segment_count);
+}
+
+bool reduction_dispatcher::segmented_dispatch(const compute_queue& dev_queue, const reduction_op_info& op, const string& kernel_prefix,
+											  const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& segments,
+											  const shared_ptr<compute_buffer>& output, const uint32_t count, const uint32_t segment_count) {
+	if (!op.has_segmented) {
+		log_error("no segmented kernels exist for operator $", op.name);
+		return false;
+	}
+	
+	const auto kernel_entry = find_kernel(kernel_prefix, op, 256u);
+	if (kernel_entry == nullptr) {
+		return false;
+	}
+	// segmented values additionally carry the 32-bit head count
+	const auto tile_size = kernel_entry->tile_size;
+	uint32_t tile_count = 0u;
+	const auto& tile_state = prepare_chained_scan(dev_queue, *kernel_entry, count, op.value_size + uint32_t(sizeof(uint32_t)),
+												  tile_count);
+	dev_queue.execute_with_parameters(*kernel_entry->kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { tile_count * tile_size, 1u, 1u },
+		.local_work_size = { tile_size, 1u, 1u },
+		.args = { input, segments, output, tile_state, count, segment_count },
+		.wait_until_completion = false,
+		.debug_label = kernel_prefix.c_str(),
+	});
+	return true;
+}
+
+template <typename data_type>
+bool reduction_dispatcher::select_if(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input,
+									 const shared_ptr<compute_buffer>& output, const shared_ptr<compute_buffer>& out_count,
+									 const uint32_t count, const data_type pivot) {
+	return select_partition(dev_queue, false, input, output, out_count, count, pivot);
+}
+
+template <typename data_type>
+bool reduction_dispatcher::partition(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input,
+									 const shared_ptr<compute_buffer>& output, const shared_ptr<compute_buffer>& out_count,
+									 const uint32_t count, const data_type pivot) {
+	return select_partition(dev_queue, true, input, output, out_count, count, pivot);
+}
+
+template <typename data_type>
+bool reduction_dispatcher::select_partition(const compute_queue& dev_queue, const bool is_partition,
+											const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& output,
+											const shared_ptr<compute_buffer>& out_count, const uint32_t count,
+											const data_type pivot) {
+	static_assert(is_same_v<data_type, float> || is_same_v<data_type, uint32_t>, "unsupported primitive type");
+	const string type_name = (is_same_v<data_type, float> ? "f32" : "u32");
+	const auto kernel_entry = find_kernel((is_partition ? "partition_" : "select_") + type_name + "_", 256u);
+	if (kernel_entry == nullptr) {
+		return false;
+	}
+	
+	// the scanned values are the 0/1 selection flags
+	const auto tile_size = kernel_entry->tile_size;
+	uint32_t tile_count = 0u;
+	const auto& tile_state = prepare_chained_scan(dev_queue, *kernel_entry, count, uint32_t(sizeof(uint32_t)), tile_count);
+	dev_queue.execute_with_parameters(*kernel_entry->kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { tile_count * tile_size, 1u, 1u },
+		.local_work_size = { tile_size, 1u, 1u },
+		.args = { input, output, out_count, tile_state, count, pivot },
+		.wait_until_completion = false,
+		.debug_label = (is_partition ? "partition" : "select"),
+	});
+	if (!is_partition) {
+		return true;
+	}
+	
+	// restore the order of the rejected elements (#rejected is only known on the device -> launch for the worst case)
+	const auto reverse_iter = kernels.find("partition_reverse_" + type_name);
+	if (reverse_iter == kernels.end() || !reverse_iter->second.usable) {
+		log_error("no usable partition_reverse_$ kernel", type_name);
+		return false;
+	}
+	const auto reverse_local_size = min(256u, uint32_t(reverse_iter->second.kernel->get_kernel_entry(dev)->max_total_local_size));
+	const auto reverse_count = max(count / 2u, 1u);
+	dev_queue.execute_with_parameters(*reverse_iter->second.kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { ((reverse_count + reverse_local_size - 1u) / reverse_local_size) * reverse_local_size, 1u, 1u },
+		.local_work_size = { reverse_local_size, 1u, 1u },
+		.args = { output, out_count, count },
+		.wait_until_completion = false,
+		.debug_label = "partition_reverse",
+	});
+	return true;
+}
+
+// instantiate for all primitive types
+#define PRIMITIVE_INSTANTIATION(name, data_type) \
+template bool reduction_dispatcher::select_if<data_type>(const compute_queue&, const shared_ptr<compute_buffer>&, \
+														 const shared_ptr<compute_buffer>&, const shared_ptr<compute_buffer>&, \
+														 const uint32_t, const data_type); \
+template bool reduction_dispatcher::partition<data_type>(const compute_queue&, const shared_ptr<compute_buffer>&, \
+														 const shared_ptr<compute_buffer>&, const shared_ptr<compute_buffer>&, \
+														 const uint32_t, const data_type);
+PRIMITIVE_TYPES(PRIMITIVE_INSTANTIATION)
+#undef PRIMITIVE_INSTANTIATION
+
+bool reduction_dispatcher::run_length_encode(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input,
+											 const shared_ptr<compute_buffer>& out_values, const shared_ptr<compute_buffer>& out_lengths,
+											 const shared_ptr<compute_buffer>& out_count, const uint32_t count) {
+	const auto kernel_entry = find_kernel("rle_u32_", 256u);
+	if (kernel_entry == nullptr) {
+		return false;
+	}
+	
+	// the scanned values are run_value pairs (#runs, run start)
+	const auto tile_size = kernel_entry->tile_size;
+	uint32_t tile_count = 0u;
+	const auto& tile_state = prepare_chained_scan(dev_queue, *kernel_entry, count, uint32_t(sizeof(run_value)), tile_count);
+	dev_queue.execute_with_parameters(*kernel_entry->kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { tile_count * tile_size, 1u, 1u },
+		.local_work_size = { tile_size, 1u, 1u },
+		.args = { input, out_values, out_lengths, out_count, tile_state, count },
+		.wait_until_completion = false,
+		.debug_label = "run_length_encode",
+	});
+	return true;
+}
+
+bool reduction_dispatcher::histogram(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input,
+									 const shared_ptr<compute_buffer>& histogram, const uint32_t count, const uint32_t bin_count,
+									 const float range_min, const float range_max) {
+	const auto iter = kernels.find("histogram_f32_" + to_string(bin_count));
+	if (iter == kernels.end()) {
+		log_error("no histogram kernel for $ bins", bin_count);
+		return false;
+	}
+	if (!iter->second.usable) {
+		log_error("histogram kernel for $ bins is not usable on this device", bin_count);
+		return false;
+	}
+	if (!(range_max > range_min)) {
+		log_error("invalid histogram range [$, $)", range_min, range_max);
+		return false;
+	}
+	
+	// grid-stride loop over all elements, the work-group histograms are added to the zeroed global histogram
+	const auto tile_size = iter->second.tile_size;
+	const auto global_size = get_reduction_global_size(tile_size);
+	last_dispatch_info = {
+		.tile_size = tile_size,
+		.group_count = global_size / tile_size,
+		.cooperative = false,
+		.partials_pass = false,
+	};
+	histogram->zero(dev_queue);
+	dev_queue.execute_with_parameters(*iter->second.kernel, compute_queue::execution_parameters_t {
+		.execution_dim = 1u,
+		.global_work_size = { global_size, 1u, 1u },
+		.local_work_size = { tile_size, 1u, 1u },
+		.args = { input, histogram, count, range_min, float(bin_count) / (range_max - range_min) },
+		.wait_until_completion = false,
+		.debug_label = "histogram",
+	});
+	return true;
+}
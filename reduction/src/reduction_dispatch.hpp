@@ -0,0 +1,234 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_REDUCTION_REDUCTION_DISPATCH_HPP__
+#define __FLOOR_REDUCTION_REDUCTION_DISPATCH_HPP__
+
+#include <floor/floor/floor.hpp>
+#include <floor/compute/compute_kernel.hpp>
+#include <random>
+#include "reduction_state.hpp"
+#include "reduction_ops.hpp"
+
+//! host-side information about a reduction/scan operator (one entry per REDUCTION_OPS/REDUCTION_OPS_64 entry)
+struct reduction_op_info {
+	//! operator name (== kernel name suffix)
+	const char* name;
+	//! size of an input element in bytes
+	uint32_t input_size;
+	//! size of a reduced/scanned value in bytes
+	uint32_t value_size;
+	//! per-group results are combined via atomics (otherwise a second partials pass is necessary)
+	bool has_atomic;
+	//! sub-group reduce builtins can be used (-> enables the cooperative kernel path)
+	bool has_sub_group_reduce;
+	//! if true, device results must exactly match the host results (otherwise a relative tolerance is used)
+	bool is_exact;
+	//! only reduce kernels exist for this operator
+	bool reduce_only;
+	//! segmented reduce/scan kernels exist for this operator (see SEGMENTED_REDUCTION_OPS)
+	bool has_segmented;
+	//! deterministic reduce kernels exist for this operator (see DETERMINISTIC_REDUCTION_OPS)
+	bool has_deterministic;
+	//! values depend on the element index (argmin/argmax) -> can't be combined across separately processed chunks
+	bool is_index_dependent;
+	
+	//! writes the identity value to "dst"
+	void (*identity)(void* dst);
+	//! fills "dst" with "count" random input elements (in parallel on the host),
+	//! element i is the element "first_index + i" of the counter-based random stream "seed"
+	void (*init_data)(void* dst, const uint64_t count, const uint64_t seed, const uint64_t first_index);
+	//! reference reduction on the host (parallel pairwise)
+	void (*host_reduce)(const void* data, const uint64_t count, void* result);
+	//! reference inclusive/exclusive scan on the host (parallel)
+	void (*host_scan)(const void* data, void* out, const uint64_t count, const bool inclusive);
+	//! combines the values "lhs" and "rhs" on the host and writes the result to "result"
+	void (*combine)(const void* lhs, const void* rhs, void* result);
+	//! compares a device result value with a host result value
+	bool (*compare)(const void* device_value, const void* host_value);
+	//! compares "count" device result values with "count" host result values (in parallel on the host),
+	//! returns the index of the first mismatch or "count" if all values match
+	uint64_t (*find_mismatch)(const void* device_values, const void* host_values, const uint64_t count);
+	//! returns a printable representation of a value
+	string (*to_string)(const void* value);
+};
+
+//! returns the info of all known operators
+const vector<reduction_op_info>& get_reduction_ops();
+//! returns the operator info for "name", or nullptr if it doesn't exist
+const reduction_op_info* find_reduction_op(const string& name);
+
+//! retrieves all reduce/scan kernels of the reduction program and dispatches them,
+//! picking the tile size and the cooperative or non-cooperative path based on the device capabilities
+class reduction_dispatcher {
+public:
+	//! retrieves all kernels from "prog", returns nullptr on failure
+	static unique_ptr<reduction_dispatcher> create(compute_context& ctx, const compute_device& dev, const compute_program& prog);
+	
+	//! reduces "count" elements of "input" (starting at element "input_offset") with "op",
+	//! the resulting value is written to "result" at element "result_offset"
+	//! NOTE: more than REDUCTION_MAX_LAUNCH_COUNT elements are reduced in multiple launches (not possible for index-dependent operators)
+	bool reduce(const compute_queue& dev_queue, const reduction_op_info& op,
+				const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& result, const uint64_t count,
+				const uint64_t input_offset = 0u, const uint32_t result_offset = 0u);
+	
+	//! reduces "count" elements of "input" with "op" using the specified algorithm and tile size (-> benchmarking),
+	//! returns false if there is no usable kernel for this configuration
+	//! NOTE: forced algorithms (!= AUTO) are only available for BENCHMARK_REDUCTION_OPS
+	bool reduce(const compute_queue& dev_queue, const reduction_op_info& op, const REDUCTION_ALGORITHM algorithm,
+				const uint32_t tile_size, const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& result,
+				const uint32_t count);
+	
+	//! if enabled, reduce() never combines per-group results via atomics for operators whose result depends on the combination
+	//! order (see DETERMINISTIC_REDUCTION_OPS), but reduces them in a fixed order in a partials pass (-> bitwise reproducible)
+	void set_deterministic(const bool state) {
+		deterministic = state;
+	}
+	bool is_deterministic() const {
+		return deterministic;
+	}
+	
+	//! returns true if "algorithm" can be used with "op" on this device
+	bool is_algorithm_supported(const reduction_op_info& op, const REDUCTION_ALGORITHM algorithm) const;
+	
+	//! copies "count" uint32_t elements (must be a multiple of 4) from "input" to "output" on the device
+	bool copy(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& output,
+			  const uint32_t count);
+	
+	//! computes the inclusive/exclusive scan of "count" elements of "input" with "op" and writes it to "output",
+	//! both starting at element "offset"
+	//! if "carry" is specified, the scan continues from the value in "carry" and writes its total back to it
+	//! (-> chains scans over multiple calls, "carry" must initially contain the identity)
+	//! NOTE: more than REDUCTION_MAX_LAUNCH_COUNT elements are scanned in multiple launches that are chained via a carry
+	//!       (not possible for index-dependent operators), use add_u32_u64 for 64-bit prefix sums of 32-bit values
+	bool scan(const compute_queue& dev_queue, const reduction_op_info& op, const bool inclusive,
+			  const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& output, const uint64_t count,
+			  const uint64_t offset = 0u, const shared_ptr<compute_buffer>& carry = {});
+	
+	//! segmented reduce of "count" elements of "input" with "op" in a single launch, one value per segment is written to "output"
+	//! "segments" contains the head flags or the segment offsets (segment_count + 1 entries), depending on "mode"
+	bool segmented_reduce(const compute_queue& dev_queue, const reduction_op_info& op, const REDUCTION_SEGMENT_MODE mode,
+						  const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& segments,
+						  const shared_ptr<compute_buffer>& output, const uint32_t count, const uint32_t segment_count);
+	
+	//! segmented inclusive/exclusive scan of "count" elements of "input" with "op" in a single launch (see segmented_reduce)
+	bool segmented_scan(const compute_queue& dev_queue, const reduction_op_info& op, const REDUCTION_SEGMENT_MODE mode,
+						const bool inclusive, const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& segments,
+						const shared_ptr<compute_buffer>& output, const uint32_t count, const uint32_t segment_count);
+	
+	//! stream compaction: writes all elements of "input" that are less than "pivot" to the front of "output" (in order),
+	//! the amount of selected elements is written to "out_count" (only implemented for float and uint32_t, see PRIMITIVE_TYPES)
+	template <typename data_type>
+	bool select_if(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& output,
+				   const shared_ptr<compute_buffer>& out_count, const uint32_t count, const data_type pivot);
+	
+	//! stable two-way partition: like select_if, but additionally writes all other elements (in order) behind the selected ones
+	template <typename data_type>
+	bool partition(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& output,
+				   const shared_ptr<compute_buffer>& out_count, const uint32_t count, const data_type pivot);
+	
+	//! run-length encodes "count" uint32_t elements of "input": the value and length of each run are written to
+	//! "out_values" and "out_lengths", the amount of runs is written to "out_count"
+	bool run_length_encode(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input,
+						   const shared_ptr<compute_buffer>& out_values, const shared_ptr<compute_buffer>& out_lengths,
+						   const shared_ptr<compute_buffer>& out_count, const uint32_t count);
+	
+	//! computes the "bin_count" bin histogram (see HISTOGRAM_BIN_COUNTS) of "count" floats in "input" over [range_min, range_max)
+	//! and writes it to "histogram", values outside of the range are clamped to the first/last bin
+	bool histogram(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& histogram,
+				   const uint32_t count, const uint32_t bin_count, const float range_min, const float range_max);
+	
+	//! configuration that was used by the last reduce()/scan() call
+	struct dispatch_info_t {
+		uint32_t tile_size { 0u };
+		uint32_t group_count { 0u };
+		bool cooperative { false };
+		bool partials_pass { false };
+	};
+	const dispatch_info_t& get_last_dispatch_info() const {
+		return last_dispatch_info;
+	}
+	
+protected:
+	reduction_dispatcher(compute_context& ctx_, const compute_device& dev_) : ctx(ctx_), dev(dev_) {}
+	
+	compute_context& ctx;
+	const compute_device& dev;
+	
+	struct kernel_entry_t {
+		shared_ptr<compute_kernel> kernel;
+		uint32_t tile_size { 0u };
+		bool usable { false };
+	};
+	//! kernel name -> kernel entry
+	unordered_map<string, kernel_entry_t> kernels;
+	
+	//! per-group partial results of non-atomic reductions
+	shared_ptr<compute_buffer> partials_buffer;
+	//! scan tile counter/status/aggregates/prefixes
+	shared_ptr<compute_buffer> scan_state_buffer;
+	//! unused carry argument of scans without a carry
+	shared_ptr<compute_buffer> unused_carry_buffer;
+	//! per-launch results of reductions that are split into multiple launches
+	shared_ptr<compute_buffer> split_results_buffer;
+	//! carry of scans that are split into multiple launches (if no carry was specified)
+	shared_ptr<compute_buffer> split_carry_buffer;
+	
+	dispatch_info_t last_dispatch_info;
+	
+	//! see set_deterministic()
+	bool deterministic { false };
+	
+	//! returns the usable kernel "<prefix><op name>_<tile size>" with the largest tile size <= "max_tile_size",
+	//! or nullptr if there is none
+	const kernel_entry_t* find_kernel(const string& prefix, const reduction_op_info& op, const uint32_t max_tile_size) const;
+	//! returns the usable kernel "<prefix><tile size>" with the largest tile size <= "max_tile_size", or nullptr if there is none
+	const kernel_entry_t* find_kernel(const string& prefix, const uint32_t max_tile_size) const;
+	
+	//! returns "buffer", (re)allocated so that it has a size of at least "size" bytes
+	const shared_ptr<compute_buffer>& get_scratch_buffer(shared_ptr<compute_buffer>& buffer, const compute_queue& dev_queue,
+														  const size_t size, const char* debug_label);
+	
+	//! #units * local size, with a fallback if the unit count is unknown
+	uint32_t get_reduction_global_size(const uint32_t tile_size) const;
+	
+	//! reduce implementation with an already selected kernel
+	//! if "use_atomic" is false, per-group results are reduced in a partials pass
+	bool reduce_dispatch(const compute_queue& dev_queue, const reduction_op_info& op, const kernel_entry_t& kernel_entry,
+						 const bool use_coop, const bool use_atomic, const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& result,
+						 const uint32_t count, const uint64_t input_offset, const uint32_t result_offset);
+	
+	//! sets up a chained scan of "count" elements with "kernel_entry" (scanned value size "value_size"):
+	//! computes the tile count, updates the last dispatch info and returns the zeroed tile state buffer
+	const shared_ptr<compute_buffer>& prepare_chained_scan(const compute_queue& dev_queue, const kernel_entry_t& kernel_entry,
+														   const uint32_t count, const uint32_t value_size, uint32_t& tile_count);
+	
+	//! shared implementation of select_if()/partition()
+	template <typename data_type>
+	bool select_partition(const compute_queue& dev_queue, const bool is_partition, const shared_ptr<compute_buffer>& input,
+						  const shared_ptr<compute_buffer>& output, const shared_ptr<compute_buffer>& out_count,
+						  const uint32_t count, const data_type pivot);
+	
+	//! shared implementation of segmented_reduce()/segmented_scan()
+	bool segmented_dispatch(const compute_queue& dev_queue, const reduction_op_info& op, const string& kernel_prefix,
+							const shared_ptr<compute_buffer>& input, const shared_ptr<compute_buffer>& segments,
+							const shared_ptr<compute_buffer>& output, const uint32_t count, const uint32_t segment_count);
+	
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "reduction_host.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+
+//! fixed-size thread pool: the calling thread participates, tasks are fetched from a shared counter
+class host_thread_pool {
+public:
+	explicit host_thread_pool(const uint32_t worker_count) {
+		for (uint32_t i = 0; i < worker_count; ++i) {
+			workers.emplace_back([this] { worker_loop(); });
+		}
+	}
+	
+	~host_thread_pool() {
+		{
+			lock_guard<mutex> lock(pool_lock);
+			shutdown = true;
+		}
+		work_cv.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+	
+	uint32_t get_thread_count() const {
+		return uint32_t(workers.size()) + 1u;
+	}
+	
+	//! executes "task(task_index)" for all task indices in [0, task_count), returns once all tasks have finished
+	void run(const uint32_t task_count, const function<void(const uint32_t)>& task) {
+		if (task_count <= 1u || workers.empty()) {
+			for (uint32_t i = 0; i < task_count; ++i) {
+				task(i);
+			}
+			return;
+		}
+		
+		// only one parallel job at a time
+		lock_guard<mutex> run_guard(run_lock);
+		{
+			lock_guard<mutex> lock(pool_lock);
+			cur_task = &task;
+			cur_task_count = task_count;
+			next_task = 0u;
+			active_workers = uint32_t(workers.size());
+			++generation;
+		}
+		work_cv.notify_all();
+		execute_tasks(task, task_count);
+		
+		unique_lock<mutex> lock(pool_lock);
+		done_cv.wait(lock, [this] { return (active_workers == 0u); });
+		cur_task = nullptr;
+	}
+	
+protected:
+	vector<thread> workers;
+	mutex run_lock;
+	mutex pool_lock;
+	condition_variable work_cv;
+	condition_variable done_cv;
+	const function<void(const uint32_t)>* cur_task { nullptr };
+	uint32_t cur_task_count { 0u };
+	atomic<uint32_t> next_task { 0u };
+	uint32_t active_workers { 0u };
+	uint64_t generation { 0u };
+	bool shutdown { false };
+	
+	void execute_tasks(const function<void(const uint32_t)>& task, const uint32_t task_count) {
+		for (uint32_t task_index = next_task++; task_index < task_count; task_index = next_task++) {
+			task(task_index);
+		}
+	}
+	
+	void worker_loop() {
+		uint64_t seen_generation = 0u;
+		for (;;) {
+			const function<void(const uint32_t)>* task = nullptr;
+			uint32_t task_count = 0u;
+			{
+				unique_lock<mutex> lock(pool_lock);
+				work_cv.wait(lock, [this, &seen_generation] { return (shutdown || generation != seen_generation); });
+				if (shutdown) {
+					return;
+				}
+				seen_generation = generation;
+				task = cur_task;
+				task_count = cur_task_count;
+			}
+			
+			execute_tasks(*task, task_count);
+			
+			{
+				lock_guard<mutex> lock(pool_lock);
+				--active_workers;
+			}
+			done_cv.notify_one();
+		}
+	}
+	
+};
+
+uint64_t make_random_seed() {
+	random_device rd;
+	return (uint64_t(rd()) << 32u) | uint64_t(rd());
+}
+
+static host_thread_pool& get_host_thread_pool() {
+	static host_thread_pool pool(max(thread::hardware_concurrency(), 1u) - 1u);
+	return pool;
+}
+
+uint32_t host_thread_count() {
+	return get_host_thread_pool().get_thread_count();
+}
+
+uint32_t host_parallel_range_count(const uint64_t count, const uint64_t min_range_size) {
+	// a few ranges per thread for load balancing
+	const auto max_range_count = uint64_t(host_thread_count()) * 4u;
+	return uint32_t(max(min(count / max(min_range_size, uint64_t(1u)), max_range_count), uint64_t(1u)));
+}
+
+void host_parallel_for(const uint64_t count, const uint64_t min_range_size,
+					   const function<void(const uint32_t range_index, const uint64_t begin, const uint64_t end)>& func) {
+	const auto range_count = host_parallel_range_count(count, min_range_size);
+	get_host_thread_pool().run(range_count, [&func, count, range_count](const uint32_t range_index) {
+		const auto begin = (count * range_index) / range_count;
+		const auto end = (count * (range_index + 1u)) / range_count;
+		func(range_index, begin, end);
+	});
+}
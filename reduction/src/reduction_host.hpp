@@ -0,0 +1,70 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_REDUCTION_REDUCTION_HOST_HPP__
+#define __FLOOR_REDUCTION_REDUCTION_HOST_HPP__
+
+#include <floor/core/essentials.hpp>
+#include <array>
+#include <functional>
+
+//! host-side helpers of the reduction example: counter-based random numbers and a thread pool for data generation and
+//! verification (-> the harness must not dominate the iteration time)
+
+//! Philox4x32-10 counter-based random number generator: returns 4 random 32-bit values for "counter" and "key"
+//! (-> any element can be generated independently of all other elements, i.e. in parallel and in any order)
+constexpr array<uint32_t, 4> philox4x32_10(array<uint32_t, 4> counter, array<uint32_t, 2> key) {
+	constexpr const uint32_t mul_0 { 0xD2511F53u }, mul_1 { 0xCD9E8D57u };
+	constexpr const uint32_t weyl_0 { 0x9E3779B9u }, weyl_1 { 0xBB67AE85u };
+	for (uint32_t round = 0; round < 10u; ++round) {
+		const auto prod_0 = uint64_t(mul_0) * uint64_t(counter[0]);
+		const auto prod_1 = uint64_t(mul_1) * uint64_t(counter[2]);
+		counter = {
+			uint32_t(prod_1 >> 32u) ^ counter[1] ^ key[0],
+			uint32_t(prod_1),
+			uint32_t(prod_0 >> 32u) ^ counter[3] ^ key[1],
+			uint32_t(prod_0),
+		};
+		key[0] += weyl_0;
+		key[1] += weyl_1;
+	}
+	return counter;
+}
+
+//! returns the random values of element "index" of the stream "seed"
+constexpr array<uint32_t, 4> philox_random(const uint64_t seed, const uint64_t index) {
+	return philox4x32_10({ uint32_t(index), uint32_t(index >> 32u), 0u, 0u }, { uint32_t(seed), uint32_t(seed >> 32u) });
+}
+
+//! returns a non-deterministic 64-bit seed
+uint64_t make_random_seed();
+
+//! returns the amount of host threads used for parallel work (including the calling thread)
+uint32_t host_thread_count();
+
+//! returns the amount of ranges [0, count) is split into by host_parallel_for (each range has at least "min_range_size" elements,
+//! unless "count" is smaller)
+uint32_t host_parallel_range_count(const uint64_t count, const uint64_t min_range_size);
+
+//! splits [0, count) into host_parallel_range_count() contiguous ranges and calls "func(range_index, begin, end)" for each range
+//! on the host thread pool, blocks until all ranges have been processed
+//! NOTE: range boundaries only depend on "count" and "min_range_size" and the thread count, must not be called recursively
+void host_parallel_for(const uint64_t count, const uint64_t min_range_size,
+					   const function<void(const uint32_t range_index, const uint64_t begin, const uint64_t end)>& func);
+
+#endif
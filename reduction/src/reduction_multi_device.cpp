@@ -0,0 +1,280 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "reduction_multi_device.hpp"
+#include "reduction_host.hpp"
+#include <floor/core/timer.hpp>
+#include <floor/core/aligned_ptr.hpp>
+#include <thread>
+
+namespace reduction_multi_device {
+
+//! per-device state
+struct device_part_t {
+	const compute_device* dev { nullptr };
+	shared_ptr<compute_queue> queue;
+	unique_ptr<reduction_dispatcher> dispatcher;
+	//! measured reduction bandwidth in GB/s
+	double bandwidth { 0.0 };
+	//! part of the input that is processed by this device
+	uint64_t offset { 0u };
+	uint64_t count { 0u };
+	shared_ptr<compute_buffer> input;
+	shared_ptr<compute_buffer> output;
+	//! reduction result (reduce) or scan carry/prefix (scan)
+	shared_ptr<compute_buffer> result;
+	//! time of the last concurrent dispatch in microseconds
+	uint64_t time { 0u };
+};
+
+//! part sizes are multiples of this (-> full scan tiles and aligned offsets on all devices)
+static constexpr const uint64_t part_alignment { 4096u };
+
+//! measures the reduction bandwidth of "part" with (up to) "count" elements of "data"
+static bool measure_bandwidth(compute_context& ctx, device_part_t& part, const reduction_op_info& op, const uint8_t* data,
+							  const uint64_t count) {
+	auto input = ctx.create_buffer(*part.queue, size_t(count) * op.input_size,
+								   COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+	auto result = ctx.create_buffer(*part.queue, op.value_size, COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+	input->write(*part.queue, data, size_t(count) * op.input_size);
+	
+	// warm-up, then use the best of 3 runs
+	uint64_t best_time = ~0ull;
+	for (uint32_t i = 0; i < 4u; ++i) {
+		part.queue->finish();
+		part.queue->start_profiling();
+		const auto dispatched = part.dispatcher->reduce(*part.queue, op, input, result, count);
+		const auto prof_time = part.queue->stop_profiling();
+		part.queue->finish();
+		if (!dispatched) {
+			return false;
+		}
+		if (i > 0u) {
+			best_time = min(best_time, max(prof_time, uint64_t(1u)));
+		}
+	}
+	part.bandwidth = (double(count * op.input_size) / 1000000000.0) / (double(best_time) / 1000000.0);
+	return true;
+}
+
+//! splits "elem_count" elements across all parts proportionally to their bandwidth
+static void split_input(vector<device_part_t>& parts, const uint64_t elem_count) {
+	double bandwidth_sum = 0.0;
+	for (const auto& part : parts) {
+		bandwidth_sum += part.bandwidth;
+	}
+	uint64_t offset = 0u;
+	for (size_t i = 0, part_count = parts.size(); i < part_count; ++i) {
+		auto& part = parts[i];
+		part.offset = offset;
+		if (i + 1u == part_count) {
+			// last part gets all remaining elements
+			part.count = elem_count - offset;
+		} else {
+			const auto share = uint64_t(double(elem_count) * (part.bandwidth / bandwidth_sum));
+			part.count = min((share / part_alignment) * part_alignment, elem_count - offset);
+		}
+		offset += part.count;
+	}
+}
+
+//! runs "func(part)" for all parts with a non-zero element count concurrently (one thread per device), waits until all are done,
+//! returns false if any call failed
+template <typename func_type>
+static bool run_concurrently(vector<device_part_t>& parts, func_type&& func) {
+	vector<thread> threads;
+	vector<uint8_t> success(parts.size(), 0u);
+	for (size_t i = 0; i < parts.size(); ++i) {
+		if (parts[i].count == 0u) {
+			success[i] = 1u;
+			continue;
+		}
+		threads.emplace_back([&parts, &func, &success, i] {
+			auto& part = parts[i];
+			const auto start = floor_timer::start();
+			success[i] = (func(part) ? 1u : 0u);
+			part.queue->finish();
+			part.time = floor_timer::stop<chrono::microseconds>(start);
+		});
+	}
+	for (auto& th : threads) {
+		th.join();
+	}
+	return all_of(success.begin(), success.end(), [](const uint8_t& part_success) { return (part_success != 0u); });
+}
+
+bool run(compute_context& ctx, const compute_program& prog, const reduction_op_info& op, const uint64_t elem_count,
+		 const config_t& config) {
+	if (config.is_scan && op.reduce_only) {
+		log_error("operator $ can only be used for reductions", op.name);
+		return false;
+	}
+	
+	// input data
+	auto cpu_data = make_aligned_ptr<uint8_t>(size_t(elem_count) * op.input_size);
+	op.init_data(cpu_data.get(), elem_count, make_random_seed(), 0u);
+	
+	// set up all devices and measure their reduction bandwidth
+	vector<device_part_t> parts;
+	const auto calibration_count = min(elem_count, uint64_t(16u * 1024u * 1024u));
+	for (const auto& dev : ctx.get_devices()) {
+		device_part_t part;
+		part.dev = dev;
+		part.queue = ctx.create_queue(*dev);
+		part.dispatcher = reduction_dispatcher::create(ctx, *dev, prog);
+		if (!part.queue || !part.dispatcher) {
+			log_warn("can't use device $ for the multi-device reduction", dev->name);
+			continue;
+		}
+		if (!measure_bandwidth(ctx, part, op, cpu_data.get(), calibration_count)) {
+			log_warn("failed to measure the reduction bandwidth of device $", dev->name);
+			continue;
+		}
+		log_msg("device $: $ GB/s", dev->name, part.bandwidth);
+		parts.emplace_back(std::move(part));
+	}
+	if (parts.empty()) {
+		log_error("no usable device");
+		return false;
+	}
+	
+	// fallback to the fastest device if the input is too small (or the operator can't be split)
+	if (parts.size() > 1u && (elem_count < config.min_count || op.is_index_dependent)) {
+		if (op.is_index_dependent) {
+			log_warn("operator $ depends on the element index and can't be split across devices", op.name);
+		}
+		auto fastest = max_element(parts.begin(), parts.end(), [](const device_part_t& lhs, const device_part_t& rhs) {
+			return (lhs.bandwidth < rhs.bandwidth);
+		});
+		auto fastest_part = std::move(*fastest);
+		parts.clear();
+		parts.emplace_back(std::move(fastest_part));
+		log_msg("$ elements: using a single device ($)", elem_count, parts[0].dev->name);
+	}
+	split_input(parts, elem_count);
+	
+	// per-device buffers
+	for (auto& part : parts) {
+		if (part.count == 0u) {
+			continue;
+		}
+		log_msg("device $: $ elements @$", part.dev->name, part.count, part.offset);
+		part.input = ctx.create_buffer(*part.queue, size_t(part.count) * op.input_size,
+									   COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+		part.input->write(*part.queue, cpu_data.get() + part.offset * op.input_size, size_t(part.count) * op.input_size);
+		part.input->set_debug_label("multi_device_input");
+		if (config.is_scan) {
+			part.output = ctx.create_buffer(*part.queue, size_t(part.count) * op.value_size,
+											COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+			part.output->set_debug_label("multi_device_output");
+		}
+		part.result = ctx.create_buffer(*part.queue, op.value_size, COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+		part.result->set_debug_label("multi_device_result");
+		part.queue->finish();
+	}
+	
+	// expected result
+	auto cpu_result = make_aligned_ptr<uint8_t>(config.is_scan ? size_t(elem_count) * op.value_size : op.value_size);
+	if (config.is_scan) {
+		op.host_scan(cpu_data.get(), cpu_result.get(), elem_count, config.is_inclusive);
+	} else {
+		op.host_reduce(cpu_data.get(), elem_count, cpu_result.get());
+	}
+	auto device_result = make_aligned_ptr<uint8_t>(config.is_scan ? size_t(elem_count) * op.value_size : op.value_size);
+	
+	const auto data_size = elem_count * (op.input_size + (config.is_scan ? op.value_size : 0u));
+	for (uint32_t iteration = 0; iteration < config.iterations; ++iteration) {
+		const auto start = floor_timer::start();
+		
+		// reduce all parts (reduce: final result, scan: prefix of all following parts)
+		if (!run_concurrently(parts, [&op](device_part_t& part) {
+			return part.dispatcher->reduce(*part.queue, op, part.input, part.result, part.count);
+		})) {
+			return false;
+		}
+		vector<array<uint8_t, 64>> part_values(parts.size());
+		for (size_t i = 0; i < parts.size(); ++i) {
+			op.identity(part_values[i].data());
+			if (parts[i].count > 0u) {
+				parts[i].result->read(*parts[i].queue, part_values[i].data(), op.value_size);
+			}
+		}
+		const auto reduce_time = floor_timer::stop<chrono::microseconds>(start);
+		
+		// combine the per-device results in device order
+		array<uint8_t, 64> combined {}, tmp {};
+		op.identity(combined.data());
+		for (size_t i = 0; i < parts.size(); ++i) {
+			if (config.is_scan && parts[i].count > 0u) {
+				// exclusive prefix of this part -> carry of its scan
+				parts[i].result->write(*parts[i].queue, combined.data(), op.value_size);
+			}
+			op.combine(combined.data(), part_values[i].data(), tmp.data());
+			memcpy(combined.data(), tmp.data(), op.value_size);
+		}
+		
+		const auto scan_start = floor_timer::start();
+		if (config.is_scan) {
+			if (!run_concurrently(parts, [&op, &config](device_part_t& part) {
+				return part.dispatcher->scan(*part.queue, op, config.is_inclusive, part.input, part.output, part.count, 0u, part.result);
+			})) {
+				return false;
+			}
+		}
+		const auto scan_time = floor_timer::stop<chrono::microseconds>(scan_start);
+		const auto total_time = floor_timer::stop<chrono::microseconds>(start);
+		
+		// verify
+		bool correct = true;
+		if (config.is_scan) {
+			for (const auto& part : parts) {
+				if (part.count > 0u) {
+					part.output->read(*part.queue, device_result.get() + part.offset * op.value_size, size_t(part.count) * op.value_size);
+				}
+			}
+			const auto mismatch = op.find_mismatch(device_result.get(), cpu_result.get(), elem_count);
+			if (mismatch < elem_count) {
+				const auto offset = size_t(mismatch) * op.value_size;
+				log_error("multi-device scan output mismatch @$: CPU result: $ != compute device result: $",
+						  mismatch, op.to_string(cpu_result.get() + offset), op.to_string(device_result.get() + offset));
+				correct = false;
+			}
+		} else if (!op.compare(combined.data(), cpu_result.get())) {
+			log_error("multi-device result mismatch: $, expected: $", op.to_string(combined.data()), op.to_string(cpu_result.get()));
+			correct = false;
+		}
+		if (!correct) {
+			return false;
+		}
+		
+		const auto bandwidth = (double(data_size) / 1000000000.0) / (double(max(total_time, uint64_t(1u))) / 1000000.0);
+		if (config.is_scan) {
+			log_msg("multi-device scan ($, $ devices) computed in $ms -> $ GB/s (reduce pass: $ms, scan pass: $ms)", op.name, parts.size(),
+					double(total_time) / 1000.0, bandwidth, double(reduce_time) / 1000.0, double(scan_time) / 1000.0);
+		} else {
+			log_msg("multi-device reduction ($, $ devices) computed in $ms -> $ GB/s", op.name, parts.size(),
+					double(total_time) / 1000.0, bandwidth);
+		}
+		for (const auto& part : parts) {
+			log_msg("\t$: $ elements in $ms", part.dev->name, part.count, double(part.time) / 1000.0);
+		}
+	}
+	return true;
+}
+	
+} // reduction_multi_device
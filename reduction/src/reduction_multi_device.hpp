@@ -0,0 +1,47 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_REDUCTION_REDUCTION_MULTI_DEVICE_HPP__
+#define __FLOOR_REDUCTION_REDUCTION_MULTI_DEVICE_HPP__
+
+#include "reduction_dispatch.hpp"
+
+//! multi-device reduce/scan: splits the input across all devices of the context proportionally to their measured
+//! reduction bandwidth and runs the per-device reductions/scans concurrently (one host thread per device queue)
+//!  * reduce: per-device results are combined on the host (in device order)
+//!  * scan: all devices first reduce their part, the host computes the exclusive prefix of each part from these,
+//!          then all devices scan their part concurrently, starting from their prefix (-> via the scan carry)
+//! below "min_count" elements (or with only one usable device) everything runs on the fastest device
+namespace reduction_multi_device {
+
+struct config_t {
+	//! min #elements for which the work is split across devices
+	uint64_t min_count { 16u * 1024u * 1024u };
+	bool is_scan { false };
+	bool is_inclusive { true };
+	uint32_t iterations { 1u };
+};
+
+//! runs and verifies the multi-device reduce/scan of "elem_count" random elements with "op" on all devices in "ctx"
+//! (kernels are taken from "prog", which must have been compiled for all devices), reports the throughput per iteration
+bool run(compute_context& ctx, const compute_program& prog, const reduction_op_info& op, const uint64_t elem_count,
+		 const config_t& config);
+	
+} // reduction_multi_device
+
+#endif
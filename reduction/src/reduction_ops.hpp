@@ -0,0 +1,349 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_REDUCTION_REDUCTION_OPS_HPP__
+#define __FLOOR_REDUCTION_REDUCTION_OPS_HPP__
+
+#include <floor/core/essentials.hpp>
+
+//! reduction/scan operators (usable on the host and on the compute device)
+//!
+//! every operator must fulfill the "reduction_op" concept:
+//!  * input_type: type of the input elements
+//!  * value_type: type that is reduced/scanned and written to the output (size must be a multiple of 4 bytes)
+//!  * identity(): neutral element of combine()
+//!  * load(): converts the input element at the specified global index to value_type
+//!  * combine(): associative binary operator
+//!  * kind: used to select builtin sub-group/work-group algorithms and atomics (CUSTOM -> generic code is used)
+//!  * has_atomic: if true, per-group results can be directly combined into the result via atomics
+//!                (otherwise per-group partial results are written and reduced in a second pass)
+
+enum class REDUCTION_OP_KIND : uint32_t {
+	ADD,
+	MIN,
+	MAX,
+	AND,
+	OR,
+	XOR,
+	CUSTOM,
+};
+
+template <typename op_type>
+concept reduction_op = requires(const typename op_type::input_type& in, const typename op_type::value_type& val, const uint32_t idx) {
+	{ op_type::identity() } -> same_as<typename op_type::value_type>;
+	{ op_type::load(in, idx) } -> same_as<typename op_type::value_type>;
+	{ op_type::combine(val, val) } -> same_as<typename op_type::value_type>;
+	{ op_type::kind } -> convertible_to<REDUCTION_OP_KIND>;
+	{ op_type::has_atomic } -> convertible_to<bool>;
+} && (sizeof(typename op_type::value_type) % sizeof(uint32_t) == 0);
+
+//! true if the sub-group reduce builtins can be used for this operator
+template <typename op_type>
+constexpr bool has_sub_group_reduce_v = (is_arithmetic_v<typename op_type::value_type> &&
+										 (op_type::kind == REDUCTION_OP_KIND::ADD ||
+										  op_type::kind == REDUCTION_OP_KIND::MIN ||
+										  op_type::kind == REDUCTION_OP_KIND::MAX));
+
+//! addition (scalar and vector types), optionally accumulating in a wider type (e.g. 64-bit sums of 32-bit inputs)
+template <typename data_type, typename accum_type = data_type>
+struct op_add {
+	using input_type = data_type;
+	using value_type = accum_type;
+	static constexpr const REDUCTION_OP_KIND kind { REDUCTION_OP_KIND::ADD };
+	static constexpr const bool has_atomic { is_arithmetic_v<accum_type> };
+	
+	floor_inline_always static constexpr value_type identity() {
+		return accum_type(0);
+	}
+	floor_inline_always static value_type load(const input_type& in, const uint32_t) {
+		return value_type(in);
+	}
+	floor_inline_always static value_type combine(const value_type& lhs, const value_type& rhs) {
+		return lhs + rhs;
+	}
+};
+
+//! minimum
+template <typename data_type>
+struct op_min {
+	using input_type = data_type;
+	using value_type = data_type;
+	static constexpr const REDUCTION_OP_KIND kind { REDUCTION_OP_KIND::MIN };
+	static constexpr const bool has_atomic { is_integral_v<data_type> };
+	
+	floor_inline_always static constexpr value_type identity() {
+		if constexpr (is_floating_point_v<data_type>) {
+			return numeric_limits<data_type>::infinity();
+		} else {
+			return numeric_limits<data_type>::max();
+		}
+	}
+	floor_inline_always static value_type load(const input_type& in, const uint32_t) {
+		return in;
+	}
+	floor_inline_always static value_type combine(const value_type& lhs, const value_type& rhs) {
+		return min(lhs, rhs);
+	}
+};
+
+//! maximum
+template <typename data_type>
+struct op_max {
+	using input_type = data_type;
+	using value_type = data_type;
+	static constexpr const REDUCTION_OP_KIND kind { REDUCTION_OP_KIND::MAX };
+	static constexpr const bool has_atomic { is_integral_v<data_type> };
+	
+	floor_inline_always static constexpr value_type identity() {
+		if constexpr (is_floating_point_v<data_type>) {
+			return -numeric_limits<data_type>::infinity();
+		} else {
+			return numeric_limits<data_type>::lowest();
+		}
+	}
+	floor_inline_always static value_type load(const input_type& in, const uint32_t) {
+		return in;
+	}
+	floor_inline_always static value_type combine(const value_type& lhs, const value_type& rhs) {
+		return max(lhs, rhs);
+	}
+};
+
+//! bitwise and/or/xor
+#define REDUCTION_BITWISE_OP(name, kind_, op, identity_) \
+template <typename data_type> \
+struct op_##name { \
+	using input_type = data_type; \
+	using value_type = data_type; \
+	static constexpr const REDUCTION_OP_KIND kind { REDUCTION_OP_KIND::kind_ }; \
+	static constexpr const bool has_atomic { true }; \
+	\
+	floor_inline_always static constexpr value_type identity() { \
+		return identity_; \
+	} \
+	floor_inline_always static value_type load(const input_type& in, const uint32_t) { \
+		return in; \
+	} \
+	floor_inline_always static value_type combine(const value_type& lhs, const value_type& rhs) { \
+		return lhs op rhs; \
+	} \
+};
+REDUCTION_BITWISE_OP(and, AND, &, ~data_type(0))
+REDUCTION_BITWISE_OP(or, OR, |, data_type(0))
+REDUCTION_BITWISE_OP(xor, XOR, ^, data_type(0))
+#undef REDUCTION_BITWISE_OP
+
+//! value + index of the value in the input
+template <typename data_type>
+struct arg_value {
+	data_type value;
+	uint32_t index;
+};
+
+//! argmin/argmax: on equal values, the lowest index wins
+template <typename data_type, bool is_min>
+struct op_arg_min_max {
+	using input_type = data_type;
+	using value_type = arg_value<data_type>;
+	static constexpr const REDUCTION_OP_KIND kind { REDUCTION_OP_KIND::CUSTOM };
+	static constexpr const bool has_atomic { false };
+	
+	floor_inline_always static constexpr value_type identity() {
+		return { is_min ? op_min<data_type>::identity() : op_max<data_type>::identity(), ~0u };
+	}
+	floor_inline_always static value_type load(const input_type& in, const uint32_t idx) {
+		return { in, idx };
+	}
+	floor_inline_always static value_type combine(const value_type& lhs, const value_type& rhs) {
+		const auto rhs_better = (is_min ? rhs.value < lhs.value : rhs.value > lhs.value);
+		return (rhs_better || (rhs.value == lhs.value && rhs.index < lhs.index) ? rhs : lhs);
+	}
+};
+template <typename data_type> using op_argmin = op_arg_min_max<data_type, true>;
+template <typename data_type> using op_argmax = op_arg_min_max<data_type, false>;
+
+//! element count, mean and sum of squared differences from the mean
+struct moments_t {
+	uint32_t count;
+	float mean;
+	float m2;
+};
+
+//! example of a user-defined monoid: computes the mean and variance (m2 / count) in a single pass,
+//! partial results are merged with Chan et al.'s parallel variant of Welford's algorithm
+struct op_moments {
+	using input_type = float;
+	using value_type = moments_t;
+	static constexpr const REDUCTION_OP_KIND kind { REDUCTION_OP_KIND::CUSTOM };
+	static constexpr const bool has_atomic { false };
+	
+	floor_inline_always static constexpr value_type identity() {
+		return { 0u, 0.0f, 0.0f };
+	}
+	floor_inline_always static value_type load(const input_type& in, const uint32_t) {
+		return { 1u, in, 0.0f };
+	}
+	floor_inline_always static value_type combine(const value_type& lhs, const value_type& rhs) {
+		const auto count = lhs.count + rhs.count;
+		if (count == 0u) {
+			return identity();
+		}
+		const auto lhs_count = float(lhs.count);
+		const auto rhs_count = float(rhs.count);
+		const auto delta = rhs.mean - lhs.mean;
+		const auto rhs_weight = rhs_count / float(count);
+		return {
+			count,
+			lhs.mean + delta * rhs_weight,
+			lhs.m2 + rhs.m2 + delta * delta * lhs_count * rhs_weight,
+		};
+	}
+};
+
+//! value + number of segment heads up to and including this value
+template <typename data_type>
+struct segmented_value {
+	data_type value;
+	uint32_t heads;
+};
+
+//! turns "op_type" into a segmented operator: values are only combined within a segment (a head restarts the
+//! combination), while the head count accumulates across segments (-> inclusive head count - 1 == segment index)
+template <reduction_op op_type>
+struct op_segmented {
+	using input_type = typename op_type::input_type;
+	using value_type = segmented_value<typename op_type::value_type>;
+	static constexpr const REDUCTION_OP_KIND kind { REDUCTION_OP_KIND::CUSTOM };
+	static constexpr const bool has_atomic { false };
+	
+	floor_inline_always static constexpr value_type identity() {
+		return { op_type::identity(), 0u };
+	}
+	//! NOTE: heads are set by the segmented kernels
+	floor_inline_always static value_type load(const input_type& in, const uint32_t idx) {
+		return { op_type::load(in, idx), 0u };
+	}
+	floor_inline_always static value_type combine(const value_type& lhs, const value_type& rhs) {
+		return { rhs.heads > 0u ? rhs.value : op_type::combine(lhs.value, rhs.value), lhs.heads + rhs.heads };
+	}
+};
+
+//! number of runs + start index of the current run
+struct run_value {
+	uint32_t runs;
+	uint32_t start;
+};
+
+//! run-length encoding scan operator: counts run heads and keeps the start index of the last run
+//! (run heads are ascending, so the last one is the max one)
+struct op_run_length {
+	using input_type = uint32_t;
+	using value_type = run_value;
+	static constexpr const REDUCTION_OP_KIND kind { REDUCTION_OP_KIND::CUSTOM };
+	static constexpr const bool has_atomic { false };
+	
+	floor_inline_always static constexpr value_type identity() {
+		return { 0u, 0u };
+	}
+	//! NOTE: heads are determined by the run-length encoding kernel, this treats every element as a run head
+	floor_inline_always static value_type load(const input_type&, const uint32_t idx) {
+		return { 1u, idx };
+	}
+	floor_inline_always static value_type combine(const value_type& lhs, const value_type& rhs) {
+		return { lhs.runs + rhs.runs, max(lhs.start, rhs.start) };
+	}
+};
+
+//! how segments are specified for segmented reduce/scan
+enum class REDUCTION_SEGMENT_MODE : uint32_t {
+	//! one uint32_t per element, != 0 if a segment starts at the element (empty segments are not possible)
+	HEAD_FLAGS,
+	//! #segments + 1 ascending uint32_t offsets, offsets[0] == 0 and offsets[#segments] == #elements
+	OFFSETS,
+};
+
+//! all operators for which reduce and scan kernels are instantiated: F(name, op type)
+#define REDUCTION_OPS(F) \
+F(add_f32, op_add<float>) \
+F(add_u32, op_add<uint32_t>) \
+F(min_f32, op_min<float>) \
+F(max_f32, op_max<float>) \
+F(min_u32, op_min<uint32_t>) \
+F(max_u32, op_max<uint32_t>) \
+F(argmin_f32, op_argmin<float>) \
+F(argmax_f32, op_argmax<float>) \
+F(and_u32, op_and<uint32_t>) \
+F(or_u32, op_or<uint32_t>) \
+F(xor_u32, op_xor<uint32_t>) \
+F(add_float2, op_add<float2>) \
+F(add_float4, op_add<float4>) \
+F(moments_f32, op_moments)
+
+//! 64-bit sums of 32-bit inputs (alias, so that it can be used as a macro argument)
+using op_add_u32_u64 = op_add<uint32_t, uint64_t>;
+
+//! 64-bit operators (reduce kernels are only usable if the device supports 64-bit atomics and/or doubles)
+#define REDUCTION_OPS_64(F) \
+F(add_f64, op_add<double>) \
+F(add_u64, op_add<uint64_t>) \
+F(add_u32_u64, op_add_u32_u64)
+
+//! 64-bit operators for which scan kernels are instantiated (64-bit integer values, no 64-bit atomics required): F(name, op type)
+//! NOTE: add_u32_u64 computes 64-bit prefix sums of 32-bit inputs (e.g. offsets into buffers with more than 4G elements)
+#define SCAN_OPS_64(F) \
+F(add_u64, op_add<uint64_t>) \
+F(add_u32_u64, op_add_u32_u64)
+
+//! operators for which segmented reduce and scan kernels are instantiated: F(name, op type)
+#define SEGMENTED_REDUCTION_OPS(F) \
+F(add_f32, op_add<float>) \
+F(add_u32, op_add<uint32_t>) \
+F(min_f32, op_min<float>) \
+F(max_f32, op_max<float>) \
+F(add_float4, op_add<float4>)
+
+//! operators whose atomic reduction result depends on the combination order (float additions): F(name, op type)
+//! deterministic reduce kernels (per-group partials + fixed-order partials pass) are instantiated for these
+//! NOTE: all other operators are either exact (integers, min/max) or never use atomics -> always deterministic
+#define DETERMINISTIC_REDUCTION_OPS(F) \
+F(add_f32, op_add<float>)
+
+//! 64-bit operators for which deterministic reduce kernels are instantiated (only usable if the device supports doubles)
+#define DETERMINISTIC_REDUCTION_OPS_64(F) \
+F(add_f64, op_add<double>)
+
+template <typename op_type>
+constexpr bool has_deterministic_kernels_v = false;
+#define DETERMINISTIC_OP_TRAIT(name, op_type) template <> constexpr bool has_deterministic_kernels_v<op_type> = true;
+DETERMINISTIC_REDUCTION_OPS(DETERMINISTIC_OP_TRAIT)
+DETERMINISTIC_REDUCTION_OPS_64(DETERMINISTIC_OP_TRAIT)
+#undef DETERMINISTIC_OP_TRAIT
+
+template <typename op_type>
+constexpr bool has_scan_64_kernels_v = false;
+#define SCAN_OP_64_TRAIT(name, op_type) template <> constexpr bool has_scan_64_kernels_v<op_type> = true;
+SCAN_OPS_64(SCAN_OP_64_TRAIT)
+#undef SCAN_OP_64_TRAIT
+
+template <typename op_type>
+constexpr bool has_segmented_kernels_v = false;
+#define SEGMENTED_OP_TRAIT(name, op_type) template <> constexpr bool has_segmented_kernels_v<op_type> = true;
+SEGMENTED_REDUCTION_OPS(SEGMENTED_OP_TRAIT)
+#undef SEGMENTED_OP_TRAIT
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "reduction_primitives.hpp"
+#include <floor/core/aligned_ptr.hpp>
+
+namespace reduction_primitives {
+
+//! GB/s for "size" bytes in "microseconds"
+static double compute_bandwidth(const size_t size, const uint64_t microseconds) {
+	return (double(size) / 1000000000.0) / (double(max(microseconds, uint64_t(1u))) / 1000000.0);
+}
+
+//! reads the 32-bit count that was written by a primitive
+static uint32_t read_count(const compute_queue& dev_queue, const shared_ptr<compute_buffer>& count_buffer) {
+	uint32_t count = 0u;
+	count_buffer->read(dev_queue, &count, sizeof(uint32_t));
+	return count;
+}
+
+//! compares "count" elements of "device_data" with "host_data", logs the first mismatch
+template <typename data_type>
+static bool compare_output(const char* primitive_name, const data_type* device_data, const data_type* host_data, const size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		if (device_data[i] != host_data[i]) {
+			log_error("$ output mismatch @$: CPU result: $ != compute device result: $", primitive_name, i, host_data[i], device_data[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool is_valid_histogram_bin_count(const uint32_t bin_count) {
+#define HISTOGRAM_BIN_COUNT_ENTRY(count) count##u,
+	static constexpr const array bin_counts { HISTOGRAM_BIN_COUNTS(HISTOGRAM_BIN_COUNT_ENTRY) };
+#undef HISTOGRAM_BIN_COUNT_ENTRY
+	return (find(bin_counts.begin(), bin_counts.end(), bin_count) != bin_counts.end());
+}
+
+bool run(compute_context& ctx, const compute_queue& dev_queue, reduction_dispatcher& dispatcher,
+		 const uint32_t elem_count, const config_t& config) {
+	if (!is_valid_histogram_bin_count(config.histogram_bins)) {
+		log_error("invalid histogram bin count $ (must be 64, 256, 1024 or 4096)", config.histogram_bins);
+		return false;
+	}
+	
+	random_device rd;
+	mt19937 gen(rd());
+	
+	// inputs: floats in [0, 1) (-> select/partition with pivot 0.5 selects ~50%, histogram over [0, 1)),
+	// uint32_t runs with geometrically distributed lengths (mean 8)
+	vector<float> float_data(elem_count);
+	uniform_real_distribution<float> float_dist(0.0f, 1.0f);
+	for (auto& value : float_data) {
+		value = float_dist(gen);
+	}
+	vector<uint32_t> run_data(elem_count);
+	geometric_distribution<uint32_t> run_length_dist(1.0 / 8.0);
+	uniform_int_distribution<uint32_t> run_value_dist(0u, 15u);
+	for (uint32_t i = 0, value = 0u; i < elem_count; ) {
+		// consecutive runs always differ
+		value = (value + 1u + run_value_dist(gen)) % 17u;
+		for (uint32_t j = 0, run_length = run_length_dist(gen) + 1u; j < run_length && i < elem_count; ++j, ++i) {
+			run_data[i] = value;
+		}
+	}
+	static constexpr const float pivot { 0.5f };
+	
+	// host references
+	vector<float> expected_partition(float_data);
+	const auto expected_selected = uint32_t(distance(expected_partition.begin(),
+													 stable_partition(expected_partition.begin(), expected_partition.end(),
+																	  [](const float& value) { return value < pivot; })));
+	vector<uint32_t> expected_run_values, expected_run_lengths;
+	for (uint32_t i = 0; i < elem_count; ++i) {
+		if (i == 0u || run_data[i] != run_data[i - 1u]) {
+			expected_run_values.emplace_back(run_data[i]);
+			expected_run_lengths.emplace_back(0u);
+		}
+		++expected_run_lengths.back();
+	}
+	const auto bin_count = config.histogram_bins;
+	vector<uint32_t> expected_histogram(bin_count, 0u);
+	for (const auto& value : float_data) {
+		// same binning as the device
+		const auto bin = (value - 0.0f) * (float(bin_count) / 1.0f);
+		++expected_histogram[bin <= 0.0f ? 0u : min(uint32_t(bin), bin_count - 1u)];
+	}
+	
+	// device buffers
+	const auto data_size = size_t(elem_count) * sizeof(uint32_t);
+	auto float_input = ctx.create_buffer(dev_queue, data_size, COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+	float_input->write(dev_queue, float_data.data(), data_size);
+	auto run_input = ctx.create_buffer(dev_queue, data_size, COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+	run_input->write(dev_queue, run_data.data(), data_size);
+	auto output = ctx.create_buffer(dev_queue, data_size, COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+	auto output_lengths = ctx.create_buffer(dev_queue, data_size, COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+	auto out_count = ctx.create_buffer(dev_queue, sizeof(uint32_t), COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+	auto histogram = ctx.create_buffer(dev_queue, bin_count * sizeof(uint32_t),
+									   COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+	float_input->set_debug_label("primitives_float_input");
+	run_input->set_debug_label("primitives_run_input");
+	output->set_debug_label("primitives_output");
+	output_lengths->set_debug_label("primitives_output_lengths");
+	out_count->set_debug_label("primitives_out_count");
+	histogram->set_debug_label("primitives_histogram");
+	
+	vector<uint32_t> device_output(elem_count), device_lengths(elem_count);
+	const auto run_primitive = [&dev_queue](const char* name, const size_t transferred_size, auto&& dispatch) {
+		dev_queue.finish();
+		dev_queue.start_profiling();
+		const auto dispatched = dispatch();
+		const auto prof_time = dev_queue.stop_profiling();
+		dev_queue.finish();
+		if (dispatched) {
+			log_msg("$: $ms -> $ GB/s", name, double(prof_time) / 1000.0, compute_bandwidth(transferred_size, prof_time));
+		}
+		return dispatched;
+	};
+	
+	log_msg("primitives: $ elements, $ selected, $ runs, $ histogram bins",
+			elem_count, expected_selected, expected_run_values.size(), bin_count);
+	for (uint32_t iteration = 0; iteration < config.iterations; ++iteration) {
+		// select: reads all elements, writes the selected ones
+		if (!run_primitive("select", data_size + size_t(expected_selected) * sizeof(float), [&] {
+			return dispatcher.select_if(dev_queue, float_input, output, out_count, elem_count, pivot);
+		})) {
+			return false;
+		}
+		if (const auto selected = read_count(dev_queue, out_count); selected != expected_selected) {
+			log_error("select: selected $ elements, expected $", selected, expected_selected);
+			return false;
+		}
+		output->read(dev_queue, device_output.data(), size_t(expected_selected) * sizeof(float));
+		if (!compare_output("select", (const float*)device_output.data(), expected_partition.data(), expected_selected)) {
+			return false;
+		}
+		
+		// partition: reads and writes all elements
+		if (!run_primitive("partition", data_size * 2u, [&] {
+			return dispatcher.partition(dev_queue, float_input, output, out_count, elem_count, pivot);
+		})) {
+			return false;
+		}
+		if (const auto selected = read_count(dev_queue, out_count); selected != expected_selected) {
+			log_error("partition: selected $ elements, expected $", selected, expected_selected);
+			return false;
+		}
+		output->read(dev_queue, device_output.data(), data_size);
+		if (!compare_output("partition", (const float*)device_output.data(), expected_partition.data(), elem_count)) {
+			return false;
+		}
+		
+		// run-length encoding: reads all elements, writes value + length per run
+		const auto run_count = uint32_t(expected_run_values.size());
+		if (!run_primitive("run-length encode", data_size + size_t(run_count) * sizeof(uint32_t) * 2u, [&] {
+			return dispatcher.run_length_encode(dev_queue, run_input, output, output_lengths, out_count, elem_count);
+		})) {
+			return false;
+		}
+		if (const auto runs = read_count(dev_queue, out_count); runs != run_count) {
+			log_error("run-length encode: encoded $ runs, expected $", runs, run_count);
+			return false;
+		}
+		output->read(dev_queue, device_output.data(), size_t(run_count) * sizeof(uint32_t));
+		output_lengths->read(dev_queue, device_lengths.data(), size_t(run_count) * sizeof(uint32_t));
+		if (!compare_output("run-length encode (values)", device_output.data(), expected_run_values.data(), run_count) ||
+			!compare_output("run-length encode (lengths)", device_lengths.data(), expected_run_lengths.data(), run_count)) {
+			return false;
+		}
+		
+		// histogram: reads all elements
+		if (!run_primitive("histogram", data_size, [&] {
+			return dispatcher.histogram(dev_queue, float_input, histogram, elem_count, bin_count, 0.0f, 1.0f);
+		})) {
+			return false;
+		}
+		// NOTE: bin count may be larger than the element count -> can't reuse device_output here
+		vector<uint32_t> device_histogram(bin_count);
+		histogram->read(dev_queue, device_histogram.data(), bin_count * sizeof(uint32_t));
+		if (!compare_output("histogram", device_histogram.data(), expected_histogram.data(), bin_count)) {
+			return false;
+		}
+	}
+	log_msg("all primitives verified");
+	return true;
+}
+	
+} // reduction_primitives
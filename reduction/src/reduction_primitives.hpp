@@ -0,0 +1,43 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_REDUCTION_REDUCTION_PRIMITIVES_HPP__
+#define __FLOOR_REDUCTION_REDUCTION_PRIMITIVES_HPP__
+
+#include "reduction_dispatch.hpp"
+
+//! benchmark of the scan-based primitives (select, partition, run-length encoding) and the privatized histogram:
+//! each primitive is verified against a host reference and its throughput is reported in GB/s
+namespace reduction_primitives {
+
+struct config_t {
+	uint32_t iterations { 3u };
+	//! must be one of HISTOGRAM_BIN_COUNTS
+	uint32_t histogram_bins { 256u };
+};
+
+//! returns true if "bin_count" is one of HISTOGRAM_BIN_COUNTS
+bool is_valid_histogram_bin_count(const uint32_t bin_count);
+
+//! runs all primitives over "elem_count" elements
+bool run(compute_context& ctx, const compute_queue& dev_queue, reduction_dispatcher& dispatcher,
+		 const uint32_t elem_count, const config_t& config);
+	
+} // reduction_primitives
+
+#endif
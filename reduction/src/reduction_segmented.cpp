@@ -0,0 +1,188 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "reduction_segmented.hpp"
+#include "reduction_host.hpp"
+#include <floor/core/aligned_ptr.hpp>
+#include <cmath>
+
+namespace reduction_segmented {
+
+//! returns #segments + 1 ascending offsets with heavy-tailed (log-uniform) segment lengths that sum up to "elem_count",
+//! empty segments are only generated if "allow_empty" is set
+static vector<uint32_t> make_segment_offsets(const uint32_t elem_count, const uint32_t segment_count, const bool allow_empty,
+											 mt19937& gen) {
+	// lengths span 4 orders of magnitude, ~1% of all segments are empty (if allowed)
+	uniform_real_distribution<double> log_dist(0.0, log(10000.0));
+	uniform_real_distribution<double> empty_dist(0.0, 1.0);
+	vector<double> weights(segment_count);
+	double weight_sum = 0.0;
+	for (auto& weight : weights) {
+		weight = (allow_empty && empty_dist(gen) < 0.01 ? 0.0 : exp(log_dist(gen)));
+		weight_sum += weight;
+	}
+	
+	// every segment gets at least one element if empty segments are not allowed
+	const auto min_length = (allow_empty ? 0u : 1u);
+	const auto distributed_count = elem_count - min_length * segment_count;
+	vector<uint32_t> offsets(segment_count + 1u);
+	uint64_t offset = 0u;
+	for (uint32_t i = 0; i < segment_count; ++i) {
+		offsets[i] = uint32_t(offset);
+		const auto length = (weight_sum > 0.0 ? uint64_t((weights[i] / weight_sum) * double(distributed_count)) : 0u);
+		offset = min(offset + min_length + length, uint64_t(elem_count));
+	}
+	// all remaining elements (rounding) go to the last segment
+	offsets[segment_count] = elem_count;
+	return offsets;
+}
+
+bool run(compute_context& ctx, const compute_queue& dev_queue, reduction_dispatcher& dispatcher,
+		 const reduction_op_info& op, const uint32_t elem_count, const config_t& config) {
+	if (!op.has_segmented) {
+		log_error("no segmented kernels exist for operator $", op.name);
+		return false;
+	}
+	if (config.is_scan && op.reduce_only) {
+		log_error("operator $ can only be used for reductions", op.name);
+		return false;
+	}
+	if (config.segment_count == 0u || (config.use_head_flags && config.segment_count > elem_count)) {
+		log_error("invalid segment count $ for $ elements", config.segment_count, elem_count);
+		return false;
+	}
+	
+	const auto mode = (config.use_head_flags ? REDUCTION_SEGMENT_MODE::HEAD_FLAGS : REDUCTION_SEGMENT_MODE::OFFSETS);
+	const auto segment_count = config.segment_count;
+	const auto output_count = (config.is_scan ? elem_count : segment_count);
+	const auto output_size = size_t(output_count) * op.value_size;
+	
+	random_device rd;
+	mt19937 gen(rd());
+	const auto offsets = make_segment_offsets(elem_count, segment_count, !config.use_head_flags, gen);
+	
+	// input data + segment description
+	auto input = ctx.create_buffer(dev_queue, size_t(elem_count) * op.input_size,
+								   COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+	auto cpu_data = make_aligned_ptr<uint8_t>(size_t(elem_count) * op.input_size);
+	op.init_data(cpu_data.get(), elem_count, make_random_seed(), 0u);
+	input->write(dev_queue, cpu_data.get(), size_t(elem_count) * op.input_size);
+	input->set_debug_label("segmented_input");
+	
+	shared_ptr<compute_buffer> segments;
+	if (config.use_head_flags) {
+		vector<uint32_t> head_flags(elem_count, 0u);
+		for (uint32_t i = 0; i < segment_count; ++i) {
+			head_flags[offsets[i]] = 1u;
+		}
+		segments = ctx.create_buffer(dev_queue, head_flags.size() * sizeof(uint32_t),
+									 COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+		segments->write(dev_queue, head_flags.data(), head_flags.size() * sizeof(uint32_t));
+	} else {
+		segments = ctx.create_buffer(dev_queue, offsets.size() * sizeof(uint32_t),
+									 COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE);
+		segments->write(dev_queue, offsets.data(), offsets.size() * sizeof(uint32_t));
+	}
+	segments->set_debug_label(config.use_head_flags ? "segment_head_flags" : "segment_offsets");
+	
+	auto output = ctx.create_buffer(dev_queue, output_size, COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+	output->set_debug_label("segmented_output");
+	
+	// expected result: computed per segment on the host
+	auto cpu_result = make_aligned_ptr<uint8_t>(output_size);
+	for (uint32_t i = 0; i < segment_count; ++i) {
+		const auto seg_offset = offsets[i];
+		const auto seg_count = offsets[i + 1u] - seg_offset;
+		const auto seg_data = cpu_data.get() + size_t(seg_offset) * op.input_size;
+		if (config.is_scan) {
+			op.host_scan(seg_data, cpu_result.get() + size_t(seg_offset) * op.value_size, seg_count, config.is_inclusive);
+		} else {
+			op.host_reduce(seg_data, seg_count, cpu_result.get() + size_t(i) * op.value_size);
+		}
+	}
+	
+	// segmented data is read once (input + segment description) and written once (output)
+	const auto segments_size = (config.use_head_flags ? size_t(elem_count) : size_t(segment_count + 1u)) * sizeof(uint32_t);
+	const auto transferred_size = size_t(elem_count) * op.input_size + segments_size + output_size;
+	const auto compute_bandwidth = [&transferred_size](const uint64_t& microseconds) {
+		return (double(transferred_size) / 1000000000.0) / (double(max(microseconds, uint64_t(1u))) / 1000000.0);
+	};
+	const auto kind_name = (config.is_scan ? (config.is_inclusive ? "inclusive-scan" : "exclusive-scan") : "reduction");
+	log_msg("segmented $ ($): $ elements, $ segments ($)", kind_name, op.name, elem_count, segment_count,
+			config.use_head_flags ? "head flags" : "offsets");
+	
+	for (uint32_t iteration = 0; iteration < config.iterations; ++iteration) {
+		// single launch over all segments
+		dev_queue.finish();
+		dev_queue.start_profiling();
+		const auto dispatched = (config.is_scan ?
+								 dispatcher.segmented_scan(dev_queue, op, mode, config.is_inclusive, input, segments, output,
+														   elem_count, segment_count) :
+								 dispatcher.segmented_reduce(dev_queue, op, mode, input, segments, output,
+															 elem_count, segment_count));
+		const auto seg_time = dev_queue.stop_profiling();
+		dev_queue.finish();
+		if (!dispatched) {
+			return false;
+		}
+		
+		// verify
+		{
+			auto device_output = (const uint8_t*)output->map(dev_queue, COMPUTE_MEMORY_MAP_FLAG::READ | COMPUTE_MEMORY_MAP_FLAG::BLOCK);
+			const auto mismatch = op.find_mismatch(device_output, cpu_result.get(), output_count);
+			const auto correct = (mismatch == output_count);
+			if (!correct) {
+				const auto offset = size_t(mismatch) * op.value_size;
+				log_error("segmented output mismatch @$: CPU result: $ != compute device result: $",
+						  mismatch, op.to_string(cpu_result.get() + offset), op.to_string(device_output + offset));
+			}
+			output->unmap(dev_queue, (void*)device_output);
+			if (!correct) {
+				return false;
+			}
+		}
+		
+		// baseline: one launch per (non-empty) segment
+		dev_queue.finish();
+		dev_queue.start_profiling();
+		for (uint32_t i = 0; i < segment_count; ++i) {
+			const auto seg_offset = offsets[i];
+			const auto seg_count = offsets[i + 1u] - seg_offset;
+			if (seg_count == 0u) {
+				continue;
+			}
+			const auto baseline_dispatched = (config.is_scan ?
+											  dispatcher.scan(dev_queue, op, config.is_inclusive, input, output, seg_count, seg_offset) :
+											  dispatcher.reduce(dev_queue, op, input, output, seg_count, seg_offset, i));
+			if (!baseline_dispatched) {
+				dev_queue.stop_profiling();
+				return false;
+			}
+		}
+		const auto baseline_time = dev_queue.stop_profiling();
+		dev_queue.finish();
+		
+		log_msg("segmented: $ms -> $ GB/s, launch-per-segment: $ms -> $ GB/s, speedup: $x",
+				double(seg_time) / 1000.0, compute_bandwidth(seg_time),
+				double(baseline_time) / 1000.0, compute_bandwidth(baseline_time),
+				double(baseline_time) / double(max(seg_time, uint64_t(1u))));
+	}
+	return true;
+}
+	
+} // reduction_segmented
@@ -0,0 +1,43 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_REDUCTION_REDUCTION_SEGMENTED_HPP__
+#define __FLOOR_REDUCTION_REDUCTION_SEGMENTED_HPP__
+
+#include "reduction_dispatch.hpp"
+
+//! segmented reduce/scan benchmark: generates heavy-tailed segment lengths, runs the single-launch segmented
+//! kernels and a launch-per-segment baseline, verifies the segmented results on the host and reports GB/s + speedup
+namespace reduction_segmented {
+
+struct config_t {
+	uint32_t segment_count { 65536u };
+	//! head flags instead of segment offsets (-> no empty segments)
+	bool use_head_flags { false };
+	bool is_scan { false };
+	bool is_inclusive { true };
+	uint32_t iterations { 3u };
+};
+
+//! runs the segmented benchmark for "op" over "elem_count" elements
+bool run(compute_context& ctx, const compute_queue& dev_queue, reduction_dispatcher& dispatcher,
+		 const reduction_op_info& op, const uint32_t elem_count, const config_t& config);
+	
+} // reduction_segmented
+
+#endif
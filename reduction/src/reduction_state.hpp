@@ -19,6 +19,56 @@
 #ifndef __FLOOR_REDUCTION_REDUCTION_STATE_HPP__
 #define __FLOOR_REDUCTION_REDUCTION_STATE_HPP__
 
+// POT sizes from 32 - 1024: F(tile_size, args...)
+#define POT_TILE_SIZES(F, ...) \
+F(32 __VA_OPT__(,) __VA_ARGS__) \
+F(64 __VA_OPT__(,) __VA_ARGS__) \
+F(128 __VA_OPT__(,) __VA_ARGS__) \
+F(256 __VA_OPT__(,) __VA_ARGS__) \
+F(512 __VA_OPT__(,) __VA_ARGS__) \
+F(1024 __VA_OPT__(,) __VA_ARGS__)
+
+// tile sizes for which scan kernels are instantiated: F(tile_size, args...)
+#define SCAN_TILE_SIZES(F, ...) \
+F(128 __VA_OPT__(,) __VA_ARGS__) \
+F(256 __VA_OPT__(,) __VA_ARGS__) \
+F(512 __VA_OPT__(,) __VA_ARGS__)
+
+// amount of consecutive elements each work-item loads/stores in the single-pass scan
+#define REDUCTION_SCAN_ITEMS_PER_WORK_ITEM 8u
+
+// max #elements of a single reduce/scan launch (larger inputs are split into multiple launches by the dispatcher),
+// keeps all per-launch index computations within 32 bits
+#define REDUCTION_MAX_LAUNCH_COUNT (1u << 30u)
+
+// element types for which select/partition kernels are instantiated: F(name, type, args...)
+#define PRIMITIVE_TYPES(F, ...) \
+F(f32, float __VA_OPT__(,) __VA_ARGS__) \
+F(u32, uint32_t __VA_OPT__(,) __VA_ARGS__)
+
+// bin counts for which histogram kernels are instantiated: F(bin_count)
+#define HISTOGRAM_BIN_COUNTS(F) \
+F(64) \
+F(256) \
+F(1024) \
+F(4096)
+
+// work-group size of the histogram kernels
+#define REDUCTION_HISTOGRAM_TILE_SIZE 256u
+
+// reduction algorithm/path selection (AUTO: best path supported by the device -> coop > shuffle > local memory)
+enum class REDUCTION_ALGORITHM : uint32_t {
+	AUTO,
+	LOCAL_MEMORY,
+	SHUFFLE,
+	COOP,
+};
+
+// operators for which reduce kernels with a forced algorithm are instantiated (used by the benchmark): F(name, op type)
+#define BENCHMARK_REDUCTION_OPS(F) \
+F(add_f32, op_add<float>) \
+F(add_u32, op_add<uint32_t>)
+
 struct reduction_state_struct {
 	//
 	bool done { false };
@@ -29,6 +79,9 @@ struct reduction_state_struct {
 	//
 	uint32_t max_iterations { 3u };
 	
+	// if != 0, overrides the element count (in benchmark mode: the largest element count of the sweep)
+	uint64_t size { 0u };
+	
 	//
 	enum class EXEC_MODE {
 		REDUCTION_F32,
@@ -38,6 +91,42 @@ struct reduction_state_struct {
 	};
 	EXEC_MODE exec_mode { EXEC_MODE::REDUCTION_F32 };
 	
+	// if != 0, runs the segmented reduce/scan benchmark with this amount of segments
+	uint32_t segment_count { 0u };
+	// segments are specified via head flags instead of segment offsets
+	bool segment_head_flags { false };
+	
+	// runs the select/partition/run-length encoding/histogram benchmark
+	bool primitives { false };
+	// bin count of the histogram benchmark (see HISTOGRAM_BIN_COUNTS)
+	uint32_t histogram_bins { 256u };
+	
+#if !defined(FLOOR_COMPUTE) || defined(FLOOR_COMPUTE_HOST)
+	// reduction/scan operator name (see REDUCTION_OPS), defaults to add_f32/add_u32 depending on the exec mode if empty
+	string op_name;
+	
+	// if set, streams this file of raw input elements through the device (out-of-core reduce/scan)
+	string stream_file;
+	
+	// benchmark output files
+	string benchmark_json_file { "reduction_benchmark.json" };
+	string benchmark_csv_file { "reduction_benchmark.csv" };
+#endif
+	// if != 0, generates the stream file with this amount of random elements first
+	uint64_t stream_generate_count { 0u };
+	// streamed chunk size in MiB
+	uint32_t stream_chunk_mib { 64u };
+	// amount of rotating device buffers used for streaming (2 or 3)
+	uint32_t stream_buffer_count { 3u };
+	
+	// float reductions are bitwise reproducible (no atomics for order-dependent operators)
+	bool deterministic { false };
+	
+	// splits the reduction/scan across all devices of the context
+	bool multi_device { false };
+	// min #elements for which the multi-device mode actually uses more than one device
+	uint64_t multi_device_min_count { 16u * 1024u * 1024u };
+	
 };
 #if !defined(FLOOR_COMPUTE) || defined(FLOOR_COMPUTE_HOST)
 extern reduction_state_struct reduction_state;
@@ -0,0 +1,409 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "reduction_streaming.hpp"
+#include "reduction_host.hpp"
+#include <floor/core/timer.hpp>
+#include <floor/core/aligned_ptr.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#if !defined(__WINDOWS__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace reduction_streaming {
+
+//! read-only memory mapping of a whole file
+class mapped_file {
+public:
+	//! maps "file_name", returns nullptr on failure
+	static unique_ptr<mapped_file> map(const string& file_name) {
+		unique_ptr<mapped_file> file { new mapped_file() };
+#if !defined(__WINDOWS__)
+		file->fd = ::open(file_name.c_str(), O_RDONLY);
+		if (file->fd < 0) {
+			log_error("failed to open $", file_name);
+			return {};
+		}
+		struct stat file_stat {};
+		if (fstat(file->fd, &file_stat) != 0) {
+			log_error("failed to stat $", file_name);
+			return {};
+		}
+		file->file_size = uint64_t(file_stat.st_size);
+		if (file->file_size > 0u) {
+			auto mapping = mmap(nullptr, file->file_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+			if (mapping == MAP_FAILED) {
+				log_error("failed to map $", file_name);
+				return {};
+			}
+			file->mapping = (const uint8_t*)mapping;
+			// chunks are only read once, in order
+			madvise(mapping, file->file_size, MADV_SEQUENTIAL);
+		}
+#else
+		file->file_handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+										FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file->file_handle == INVALID_HANDLE_VALUE) {
+			log_error("failed to open $", file_name);
+			return {};
+		}
+		LARGE_INTEGER file_size {};
+		if (!GetFileSizeEx(file->file_handle, &file_size)) {
+			log_error("failed to retrieve the size of $", file_name);
+			return {};
+		}
+		file->file_size = uint64_t(file_size.QuadPart);
+		if (file->file_size > 0u) {
+			file->mapping_handle = CreateFileMappingA(file->file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (file->mapping_handle == nullptr) {
+				log_error("failed to map $", file_name);
+				return {};
+			}
+			file->mapping = (const uint8_t*)MapViewOfFile(file->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+			if (file->mapping == nullptr) {
+				log_error("failed to map $", file_name);
+				return {};
+			}
+		}
+#endif
+		return file;
+	}
+	
+	~mapped_file() {
+#if !defined(__WINDOWS__)
+		if (mapping != nullptr) {
+			munmap((void*)mapping, file_size);
+		}
+		if (fd >= 0) {
+			::close(fd);
+		}
+#else
+		if (mapping != nullptr) {
+			UnmapViewOfFile(mapping);
+		}
+		if (mapping_handle != nullptr) {
+			CloseHandle(mapping_handle);
+		}
+		if (file_handle != INVALID_HANDLE_VALUE) {
+			CloseHandle(file_handle);
+		}
+#endif
+	}
+	
+	const uint8_t* data() const {
+		return mapping;
+	}
+	uint64_t size() const {
+		return file_size;
+	}
+	
+protected:
+	mapped_file() = default;
+	
+	const uint8_t* mapping { nullptr };
+	uint64_t file_size { 0u };
+#if !defined(__WINDOWS__)
+	int fd { -1 };
+#else
+	HANDLE file_handle { INVALID_HANDLE_VALUE };
+	HANDLE mapping_handle { nullptr };
+#endif
+};
+
+//! writes "count" random input elements of "op" to "file_name"
+static bool generate_file(const string& file_name, const reduction_op_info& op, const uint64_t count) {
+	ofstream file(file_name, ios::out | ios::binary | ios::trunc);
+	if (!file.is_open()) {
+		log_error("failed to create $", file_name);
+		return false;
+	}
+	
+	static constexpr const uint32_t gen_chunk_count { 1024u * 1024u };
+	auto chunk_data = make_aligned_ptr<uint8_t>(size_t(gen_chunk_count) * op.input_size);
+	const auto seed = make_random_seed();
+	for (uint64_t offset = 0; offset < count; offset += gen_chunk_count) {
+		const auto chunk_count = uint32_t(min(uint64_t(gen_chunk_count), count - offset));
+		op.init_data(chunk_data.get(), chunk_count, seed, offset);
+		file.write((const char*)chunk_data.get(), streamsize(chunk_count) * op.input_size);
+	}
+	if (!file.good()) {
+		log_error("failed to write $", file_name);
+		return false;
+	}
+	log_msg("generated $ ($ elements, $ MiB)", file_name, count, (count * op.input_size) / (1024u * 1024u));
+	return true;
+}
+
+//! chunked reference reduction on the host (the file may be larger than the 32-bit element count of host_reduce)
+static void host_reduce_chunked(const reduction_op_info& op, const uint8_t* data, const uint64_t count, const uint32_t chunk_count,
+								uint8_t* result) {
+	array<uint8_t, 64> chunk_result {}, combined {};
+	op.identity(result);
+	for (uint64_t offset = 0; offset < count; offset += chunk_count) {
+		const auto elem_count = uint32_t(min(uint64_t(chunk_count), count - offset));
+		op.host_reduce(data + offset * op.input_size, elem_count, chunk_result.data());
+		op.combine(result, chunk_result.data(), combined.data());
+		memcpy(result, combined.data(), op.value_size);
+	}
+}
+
+//! device scan output of a single element (global element index + value)
+struct scan_sample_t {
+	uint64_t index;
+	array<uint8_t, 64> value;
+};
+
+//! offsets within a scanned chunk of "elem_count" elements whose device output is verified
+static array<uint32_t, 3> scan_sample_offsets(const uint32_t elem_count) {
+	return { 0u, elem_count / 2u, elem_count - 1u };
+}
+
+//! host reference pass: reduces all elements into "result" and checks the sampled scan outputs (sorted by index) on the way,
+//! returns false if a sample doesn't match
+//! NOTE: the sample prefixes are reduced incrementally, so that the file is only read once
+static bool host_reference(const reduction_op_info& op, const uint8_t* data, const uint64_t count, const uint32_t chunk_count,
+						   const bool is_inclusive, const vector<scan_sample_t>& samples, uint8_t* result) {
+	array<uint8_t, 64> partial {}, combined {};
+	op.identity(result);
+	uint64_t reduced_count = 0u;
+	const auto reduce_up_to = [&](const uint64_t end) {
+		host_reduce_chunked(op, data + reduced_count * op.input_size, end - reduced_count, chunk_count, partial.data());
+		op.combine(result, partial.data(), combined.data());
+		memcpy(result, combined.data(), op.value_size);
+		reduced_count = end;
+	};
+	for (const auto& sample : samples) {
+		// inclusive: prefix includes the sample element, exclusive: all elements before it
+		reduce_up_to(sample.index + (is_inclusive ? 1u : 0u));
+		if (!op.compare(sample.value.data(), result)) {
+			log_error("scan output mismatch @$: $, expected: $", sample.index, op.to_string(sample.value.data()), op.to_string(result));
+			return false;
+		}
+	}
+	reduce_up_to(count);
+	return true;
+}
+
+bool run(compute_context& ctx, const compute_device& dev, const compute_queue& dev_queue, reduction_dispatcher& dispatcher,
+		 const reduction_op_info& op, const config_t& config) {
+	if (config.is_scan && op.reduce_only) {
+		log_error("operator $ can only be used for reductions", op.name);
+		return false;
+	}
+	if (op.is_index_dependent) {
+		log_error("operator $ depends on the element index and can't be streamed in chunks", op.name);
+		return false;
+	}
+	if (config.buffer_count < 2u || config.buffer_count > 3u) {
+		log_error("invalid stream buffer count $ (must be 2 or 3)", config.buffer_count);
+		return false;
+	}
+	if (config.generate_count > 0u && !generate_file(config.file_name, op, config.generate_count)) {
+		return false;
+	}
+	
+	auto file = mapped_file::map(config.file_name);
+	if (!file) {
+		return false;
+	}
+	const auto total_count = file->size() / op.input_size;
+	if (total_count == 0u) {
+		log_error("$ contains no elements", config.file_name);
+		return false;
+	}
+	if (file->size() % op.input_size != 0u) {
+		log_warn("size of $ is not a multiple of the element size $, ignoring the trailing bytes", config.file_name, op.input_size);
+	}
+	
+	// keep the per-chunk element count in 32-bit range (scan tile state and kernel params are 32-bit)
+	const auto chunk_elem_count = uint32_t(clamp(config.chunk_size / op.input_size, uint64_t(1u), uint64_t(1u) << 30u));
+	const auto chunk_count = uint32_t((total_count + chunk_elem_count - 1u) / chunk_elem_count);
+	const auto buffer_count = min(config.buffer_count, chunk_count);
+	log_msg("streaming $ ($ elements, $ MiB) in $ chunks of $ elements through $ buffers",
+			config.file_name, total_count, file->size() / (1024u * 1024u), chunk_count, chunk_elem_count, buffer_count);
+	
+	// rotating input buffers, scan output buffer/carry or per-chunk reduction results
+	vector<shared_ptr<compute_buffer>> input_buffers;
+	for (uint32_t i = 0; i < buffer_count; ++i) {
+		input_buffers.emplace_back(ctx.create_buffer(dev_queue, size_t(chunk_elem_count) * op.input_size,
+													 COMPUTE_MEMORY_FLAG::READ | COMPUTE_MEMORY_FLAG::HOST_WRITE));
+		input_buffers.back()->set_debug_label("stream_input_" + to_string(i));
+	}
+	shared_ptr<compute_buffer> scan_output, scan_carry, chunk_results;
+	if (config.is_scan) {
+		scan_output = ctx.create_buffer(dev_queue, size_t(chunk_elem_count) * op.value_size,
+										COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ);
+		scan_output->set_debug_label("stream_scan_output");
+		scan_carry = ctx.create_buffer(dev_queue, op.value_size, COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+		scan_carry->set_debug_label("stream_scan_carry");
+	} else {
+		chunk_results = ctx.create_buffer(dev_queue, size_t(chunk_count) * op.value_size,
+										  COMPUTE_MEMORY_FLAG::READ_WRITE | COMPUTE_MEMORY_FLAG::HOST_READ_WRITE);
+		chunk_results->set_debug_label("stream_chunk_results");
+	}
+	// scan results are downloaded into this (-> would be written to the output storage in a real application)
+	aligned_ptr<uint8_t> host_scan_output;
+	if (config.is_scan) {
+		host_scan_output = make_aligned_ptr<uint8_t>(size_t(chunk_elem_count) * op.value_size);
+	}
+	
+	// expected result: reduction of all elements (== inclusive scan value of the last element == final carry)
+	// NOTE: this is computed by a host reference pass after each streamed pass (-> the first pass reads the file cold,
+	//       unless it was just generated or otherwise read before, all further passes read it from the page cache)
+	array<uint8_t, 64> expected {}, result {};
+	vector<scan_sample_t> scan_samples;
+	
+	// uploads are performed on their own queue, so that they can overlap the kernel execution on "dev_queue"
+	auto upload_queue = ctx.create_queue(dev);
+	
+	for (uint32_t iteration = 0; iteration < config.iterations; ++iteration) {
+		mutex stream_lock;
+		condition_variable stream_cv;
+		uint32_t uploaded_chunks = 0u, consumed_chunks = 0u;
+		bool aborted = false;
+		
+		scan_samples.clear();
+		if (config.is_scan) {
+			array<uint8_t, 64> identity_value {};
+			op.identity(identity_value.data());
+			scan_carry->write(dev_queue, identity_value.data(), op.value_size);
+		}
+		dev_queue.finish();
+		
+		const auto e2e_start = floor_timer::start();
+		uint64_t upload_time = 0u;
+		thread upload_thread([&] {
+			for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+				// wait until the buffer of this chunk is no longer used by a kernel
+				{
+					unique_lock<mutex> lock(stream_lock);
+					stream_cv.wait(lock, [&] { return (aborted || chunk - consumed_chunks < buffer_count); });
+					if (aborted) {
+						return;
+					}
+				}
+				const auto chunk_offset = uint64_t(chunk) * chunk_elem_count;
+				const auto elem_count = uint32_t(min(uint64_t(chunk_elem_count), total_count - chunk_offset));
+				const auto upload_start = floor_timer::start();
+				// NOTE: reading from the mapping page-faults the file contents in
+				input_buffers[chunk % buffer_count]->write(*upload_queue, file->data() + chunk_offset * op.input_size,
+														   size_t(elem_count) * op.input_size);
+				upload_queue->finish();
+				upload_time += floor_timer::stop<chrono::microseconds>(upload_start);
+				{
+					lock_guard<mutex> lock(stream_lock);
+					uploaded_chunks = chunk + 1u;
+				}
+				stream_cv.notify_all();
+			}
+		});
+		
+		bool success = true;
+		uint64_t kernel_time = 0u;
+		for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+			{
+				unique_lock<mutex> lock(stream_lock);
+				stream_cv.wait(lock, [&] { return (uploaded_chunks > chunk); });
+			}
+			
+			const auto elem_count = uint32_t(min(uint64_t(chunk_elem_count), total_count - uint64_t(chunk) * chunk_elem_count));
+			const auto& input = input_buffers[chunk % buffer_count];
+			dev_queue.start_profiling();
+			const auto dispatched = (config.is_scan ?
+									 dispatcher.scan(dev_queue, op, config.is_inclusive, input, scan_output, elem_count, 0u, scan_carry) :
+									 dispatcher.reduce(dev_queue, op, input, chunk_results, elem_count, 0u, chunk));
+			kernel_time += dev_queue.stop_profiling();
+			dev_queue.finish();
+			if (!dispatched) {
+				success = false;
+			} else if (config.is_scan) {
+				scan_output->read(dev_queue, host_scan_output.get(), size_t(elem_count) * op.value_size);
+				// keep a few outputs of each chunk for verification (-> checks the chaining of the carry across chunks)
+				for (const auto& offset : scan_sample_offsets(elem_count)) {
+					auto& sample = scan_samples.emplace_back(scan_sample_t { uint64_t(chunk) * chunk_elem_count + offset, {} });
+					memcpy(sample.value.data(), host_scan_output.get() + size_t(offset) * op.value_size, op.value_size);
+				}
+			}
+			
+			// the input buffer of this chunk can now be reused
+			{
+				lock_guard<mutex> lock(stream_lock);
+				consumed_chunks = chunk + 1u;
+				aborted = !success;
+			}
+			stream_cv.notify_all();
+			if (!success) {
+				break;
+			}
+		}
+		upload_thread.join();
+		if (!success) {
+			return false;
+		}
+		
+		// final result: carry of the last scanned chunk, or reduction of all chunk results
+		if (config.is_scan) {
+			scan_carry->read(dev_queue, result.data(), op.value_size);
+		} else {
+			auto chunk_values = make_aligned_ptr<uint8_t>(size_t(chunk_count) * op.value_size);
+			chunk_results->read(dev_queue, chunk_values.get(), size_t(chunk_count) * op.value_size);
+			array<uint8_t, 64> combined {};
+			op.identity(result.data());
+			for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+				op.combine(result.data(), chunk_values.get() + size_t(chunk) * op.value_size, combined.data());
+				memcpy(result.data(), combined.data(), op.value_size);
+			}
+		}
+		const auto e2e_time = floor_timer::stop<chrono::microseconds>(e2e_start);
+		
+		if (!host_reference(op, file->data(), total_count, chunk_elem_count, config.is_inclusive, scan_samples, expected.data())) {
+			return false;
+		}
+		if (op.compare(result.data(), expected.data())) {
+			log_debug("result: $, expected: $", op.to_string(result.data()), op.to_string(expected.data()));
+		} else {
+			log_error("result mismatch: $, expected: $", op.to_string(result.data()), op.to_string(expected.data()));
+			return false;
+		}
+		
+		// end-to-end: file size (+ downloaded scan output), kernel: same as the in-memory reduce/scan
+		const auto input_size = total_count * op.input_size;
+		const auto output_size = (config.is_scan ? total_count * op.value_size : 0u);
+		const auto bandwidth = [](const uint64_t size, const uint64_t microseconds) {
+			return (double(size) / 1000000000.0) / (double(max(microseconds, uint64_t(1u))) / 1000000.0);
+		};
+		log_msg("streamed $ ($) in $ms -> end-to-end: $ GB/s, kernels: $ GB/s ($ms), uploads: $ GB/s ($ms)",
+				(!config.is_scan ? "reduction" : (config.is_inclusive ? "inclusive-scan" : "exclusive-scan")), op.name,
+				double(e2e_time) / 1000.0, bandwidth(input_size + output_size, e2e_time),
+				bandwidth(input_size + output_size, kernel_time), double(kernel_time) / 1000.0,
+				bandwidth(input_size, upload_time), double(upload_time) / 1000.0);
+	}
+	return true;
+}
+	
+} // reduction_streaming
@@ -0,0 +1,50 @@
+/*
+ *  Flo's Open libRary (floor)
+ *  Copyright (C) 2004 - 2024 Florian Ziesche
+ *  
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License only.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __FLOOR_REDUCTION_REDUCTION_STREAMING_HPP__
+#define __FLOOR_REDUCTION_REDUCTION_STREAMING_HPP__
+
+#include "reduction_dispatch.hpp"
+
+//! out-of-core reduce/scan: streams a memory-mapped file of raw input elements through 2 or 3 rotating device buffers,
+//! the upload of the next chunks (on a separate upload queue/thread) overlaps the reduction/scan of the current one,
+//! scans are chained across chunks via a device-side carry
+namespace reduction_streaming {
+
+struct config_t {
+	//! file containing the raw input elements (native endianness)
+	string file_name;
+	//! if != 0, (re)generates the input file with this amount of random elements first
+	uint64_t generate_count { 0u };
+	//! size of each streamed chunk in bytes
+	uint64_t chunk_size { 64ull * 1024ull * 1024ull };
+	//! amount of rotating device input buffers (2 or 3)
+	uint32_t buffer_count { 3u };
+	bool is_scan { false };
+	bool is_inclusive { true };
+	uint32_t iterations { 1u };
+};
+
+//! streams the file with "op", verifies the result (and a few scan outputs of each chunk) against a chunked host reduction,
+//! then reports the end-to-end throughput (file -> device -> result) and the pure kernel throughput in GB/s
+bool run(compute_context& ctx, const compute_device& dev, const compute_queue& dev_queue, reduction_dispatcher& dispatcher,
+		 const reduction_op_info& op, const config_t& config);
+	
+} // reduction_streaming
+
+#endif